@@ -0,0 +1,352 @@
+// Plays looping clips on many components and on skinned meshes of 32 bones
+// with an animator, and measures the nodes animated per millisecond against
+// sampling and setting every transform per node as an application would.
+// The animator's transforms must match the per-node ones. A skinned strip is
+// then rendered: in the bind pose it must draw the same image as the plain
+// mesh, and posed it must not.
+//
+// usage: animation [nodes] [frames] [shader-directory]
+
+#include <mrr/graphics/animation.hxx>
+#include <mrr/graphics/gl-common.hxx>
+#include <mrr/graphics/headless.hxx>
+#include <mrr/graphics/offscreen.hxx>
+#include <mrr/graphics/parallel.hxx>
+#include <mrr/graphics/pool.hxx>
+#include <mrr/graphics/timing.hxx>
+
+#include "fixtures.hxx"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+
+#define GLM_FORCE_RADIANS
+#include <glm/gtc/matrix_transform.hpp>
+
+namespace gl = ::mrr::graphics::gl;
+namespace impl = ::mrr::graphics::gl::impl;
+namespace bench = ::mrr::graphics::bench;
+
+static GLsizei const image_size = 128;
+static std::size_t const bones_per_skeleton = 32;
+static char const* strip_obj_path = "/tmp/mrr-animation-strip.obj";
+
+static glm::vec4 axis_angle(glm::vec3 const& axis, float angle)
+{
+	glm::vec3 a = glm::normalize(axis) * std::sin(angle / 2.0f);
+	return glm::vec4(a.x, a.y, a.z, std::cos(angle / 2.0f));
+}
+
+// A looping track of keys keys over duration, varied by seed.
+static gl::trs_track make_track(float duration, int keys, int seed)
+{
+	gl::trs_track track;
+	for (int k = 0; k <= keys; ++k)
+	{
+		float t = duration * k / keys;
+		float phase = 6.2831853f * (k % keys) / keys + seed;
+		track.translation.add(t, glm::vec3(std::sin(phase), 0.5f * std::cos(phase), 0.1f * seed));
+		track.rotation.add(t, axis_angle(glm::vec3(0.3f, 1.0f, 0.2f * seed), phase));
+		if (k % 2 == 0)
+			track.scale.add(t, glm::vec3(1.0f + 0.2f * std::sin(phase)));
+	}
+	return track;
+}
+
+//m=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-
+// The per-node way: search every channel, interpolate, and build the matrix
+// from translate, rotate and scale.
+
+template <typename T>
+static T sample(gl::keyframe_track<T> const& track, float t, T const& identity)
+{
+	if (track.times.empty())
+		return identity;
+	auto next = std::upper_bound(track.times.begin(), track.times.end(), t);
+	if (next == track.times.begin())
+		return track.values.front();
+	if (next == track.times.end())
+		return track.values.back();
+
+	std::size_t b = next - track.times.begin(), a = b - 1;
+	float span = track.times[b] - track.times[a];
+	float w = span > 0.0f ? (t - track.times[a]) / span : 0.0f;
+	return track.values[a] + (track.values[b] - track.values[a]) * w;
+}
+
+static glm::mat4 reference_local(gl::trs_track const& track, float t)
+{
+	glm::vec3 translation = sample(track.translation, t, glm::vec3(0.0f));
+	glm::vec3 scale = sample(track.scale, t, glm::vec3(1.0f));
+
+	glm::vec4 q(0.0f, 0.0f, 0.0f, 1.0f);
+	if (!track.rotation.times.empty())
+	{
+		auto next = std::upper_bound(track.rotation.times.begin(), track.rotation.times.end(), t);
+		std::size_t b = std::min<std::size_t>(next - track.rotation.times.begin(), track.rotation.times.size() - 1);
+		std::size_t a = next == track.rotation.times.begin() || next == track.rotation.times.end() ? b : b - 1;
+		glm::vec4 q0 = track.rotation.values[a], q1 = track.rotation.values[b];
+		float span = track.rotation.times[b] - track.rotation.times[a];
+		float w = span > 0.0f ? (t - track.rotation.times[a]) / span : 0.0f;
+		if (glm::dot(q0, q1) < 0.0f)
+			q1 = q1 * -1.0f;
+		q = glm::normalize(q0 + (q1 - q0) * w);
+	}
+
+	// Angle and axis of q, for glm::rotate.
+	float angle = 2.0f * std::acos(std::min(std::max(q.w, -1.0f), 1.0f));
+	glm::vec3 axis(q.x, q.y, q.z);
+	glm::mat4 R = glm::length(axis) > 1e-6f ? glm::rotate(glm::mat4(1.0f), angle, axis) : glm::mat4(1.0f);
+
+	return glm::scale(glm::translate(glm::mat4(1.0f), translation) * R, scale);
+}
+
+static float wrap(float t, float duration)
+{
+	return t - duration * std::floor(t / duration);
+}
+
+static float max_difference(glm::mat4 const& a, glm::mat4 const& b)
+{
+	float d = 0.0f;
+	for (int c = 0; c < 4; ++c)
+		for (int r = 0; r < 4; ++r)
+			d = std::max(d, std::fabs(a[c][r] - b[c][r]));
+	return d;
+}
+
+//m=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-
+
+// A strip of quads along x over [-2, 2].
+static void write_strip(char const* path)
+{
+	std::ofstream out(path);
+	int const segments = 16;
+	for (int i = 0; i <= segments; ++i)
+	{
+		float x = -2.0f + 4.0f * i / segments;
+		out << "v " << x << " -0.3 0\nv " << x << " 0.3 0\n";
+	}
+	out << "vt 0 0\nvn 0 0 1\n";
+	for (int i = 0; i < segments; ++i)
+	{
+		int a = 2 * i + 1, b = a + 1, c = a + 2, d = a + 3;
+		out << "f " << a << "/1/1 " << c << "/1/1 " << b << "/1/1\n"
+		    << "f " << b << "/1/1 " << c << "/1/1 " << d << "/1/1\n";
+	}
+}
+
+static std::size_t differing_pixels(std::vector<unsigned char> const& a, std::vector<unsigned char> const& b)
+{
+	std::size_t differing = 0;
+	for (std::size_t p = 0; p < a.size(); p += 4)
+		differing += !std::equal(a.begin() + p, a.begin() + p + 4, b.begin() + p);
+	return differing;
+}
+
+// Renders a strip skinned to two bones, the second of which the clip bends
+// at its second key.
+static bool check_skinned_render(std::string const& directory)
+{
+	gl::framebuffer target(image_size, image_size);
+	if (!target.is_complete())
+		return false;
+
+	write_strip(strip_obj_path);
+	gl::shader_handle plain_shader(directory + "/colour-vertex-shader.glsl", directory + "/colour-fragment-shader.glsl");
+	gl::shader_handle skinned_shader(directory + "/skinned-vertex-shader.glsl", directory + "/colour-fragment-shader.glsl");
+
+	gl::component plain;
+	gl::skinned_mesh skinned;
+	for (gl::component* c : { &plain, static_cast<gl::component*>(&skinned) })
+	{
+		c->set_shader(c == &plain ? plain_shader : skinned_shader);
+		c->load_wavefront(strip_obj_path);
+		c->set_colour(glm::vec3(0.9f, 0.6f, 0.2f));
+		c->add_point_source(glm::vec3(0, 0, 5), glm::vec3(1, 1, 1), 30.0f);
+	}
+	std::remove(strip_obj_path);
+
+	auto bones = std::make_shared<gl::skeleton>();
+	bones->parents = { -1, 0 };
+	bones->inverse_bind = { glm::mat4(1.0f), glm::mat4(1.0f) };
+	if (!skinned.set_skeleton(bones))
+		return false;
+
+	// The right half follows the second bone, blended across the middle.
+	std::vector<gl::skin_weights> skin;
+	for (glm::vec3 const& v : skinned.get_vertices())
+	{
+		float w = std::min(std::max(v.x * 0.5f + 0.5f, 0.0f), 1.0f);
+		gl::skin_weights s = { { 0, 1, 0, 0 }, { 0, 0, 0, 0 } };
+		s.weights[1] = std::uint8_t(std::lround(w * 255.0f));
+		s.weights[0] = 255 - s.weights[1];
+		skin.push_back(s);
+	}
+	skinned.set_skin_data(skin);
+
+	auto clip = std::make_shared<gl::animation_clip>(2.0f);
+	gl::trs_track root, bend;
+	bend.rotation.add(0.0f, glm::vec4(0.0f, 0.0f, 0.0f, 1.0f));
+	bend.rotation.add(1.0f, axis_angle(glm::vec3(0, 0, 1), 1.2f));
+	clip->add_track(root);
+	clip->add_track(bend);
+
+	gl::animator a;
+	gl::animation_playback hold;
+	hold.loop = false;
+	a.bind_skeleton(skinned, clip, hold);
+
+	glm::mat4 P = glm::perspective(glm::radians(60.0f), 1.0f, 0.1f, 100.0f);
+	glm::mat4 V = glm::lookAt(glm::vec3(0, 0, 6), glm::vec3(0, 0, 0), glm::vec3(0, 1, 0));
+	a.advance(0.0f);
+	std::size_t bind_pose = differing_pixels(bench::render(target, plain, V, P), bench::render(target, skinned, V, P));
+	a.advance(1.0f);
+	std::size_t posed = differing_pixels(bench::render(target, plain, V, P), bench::render(target, skinned, V, P));
+
+	std::printf("skinned strip: %zu differing pixels in the bind pose, %zu posed\n", bind_pose, posed);
+	return bind_pose == 0 && posed > 0;
+}
+
+int main(int argc, char* argv[])
+{
+	std::size_t count = argc > 1 ? std::atoi(argv[1]) : 8192;
+	int frames = argc > 2 ? std::atoi(argv[2]) : 60;
+	std::string directory = argc > 3 ? argv[3] : "/usr/local/share/mrr/graphics/shaders";
+	float const dt = 1.0f / 60.0f;
+
+	::mrr::graphics::egl::headless_context context;
+	gl::init(0.1f, 0.1f, 0.1f, 1.0f);
+	gl::vertex_array va;
+	va.bind();
+
+	// A few clips shared by every node, and one 32 bone clip for the
+	// skeletons.
+	std::vector<std::shared_ptr<gl::animation_clip>> clips;
+	for (int c = 0; c < 4; ++c)
+	{
+		clips.push_back(std::make_shared<gl::animation_clip>(1.0f + c * 0.5f));
+		for (int track = 0; track < 4; ++track)
+			clips.back()->add_track(make_track(clips.back()->get_duration(), 8 + 4 * c, track + c));
+	}
+	auto walk = std::make_shared<gl::animation_clip>(1.5f);
+	for (std::size_t bone = 0; bone < bones_per_skeleton; ++bone)
+		walk->add_track(make_track(walk->get_duration(), 12, bone));
+
+	auto bones = std::make_shared<gl::skeleton>();
+	for (std::size_t bone = 0; bone < bones_per_skeleton; ++bone)
+	{
+		bones->parents.push_back(int(bone) - 1);
+		bones->inverse_bind.push_back(glm::translate(glm::mat4(1.0f), glm::vec3(0.0f, -0.1f * bone, 0.0f)));
+	}
+
+	std::size_t const skeleton_count = std::max<std::size_t>(count / 64, 1);
+	gl::node_pool<gl::component> components;
+	std::vector<gl::component*> nodes, reference_nodes;
+	std::vector<gl::skinned_mesh> skins(skeleton_count);
+	for (std::size_t i = 0; i < count; ++i)
+	{
+		glm::mat4 base = glm::translate(glm::mat4(1.0f), glm::vec3(float(i % 128), 0.0f, float(i / 128)));
+		for (auto* list : { &nodes, &reference_nodes })
+		{
+			list->push_back(components.create());
+			list->back()->set_model(base);
+		}
+	}
+	for (gl::skinned_mesh& s : skins)
+		s.set_skeleton(bones);
+
+	gl::animator a;
+	for (std::size_t i = 0; i < count; ++i)
+	{
+		gl::animation_playback playback;
+		playback.time = 0.01f * i;
+		playback.speed = 0.5f + (i % 3) * 0.25f;
+		a.bind(*nodes[i], clips[i % clips.size()], i % 4, playback);
+	}
+	for (std::size_t i = 0; i < skeleton_count; ++i)
+	{
+		gl::animation_playback playback;
+		playback.time = 0.05f * i;
+		a.bind_skeleton(skins[i], walk, playback);
+	}
+
+	// Batched.
+	double batched_ms = 0.0, evaluate_ms = 0.0, apply_ms = 0.0;
+	for (int f = 0; f < frames; ++f)
+	{
+		auto start = std::chrono::steady_clock::now();
+		a.advance(dt);
+		batched_ms += impl::elapsed_ms(start);
+		evaluate_ms += a.get_stats().evaluate_ms;
+		apply_ms += a.get_stats().apply_ms;
+	}
+
+	// Per node, keeping the times the same way the animator does.
+	std::vector<glm::mat4> bases;
+	std::vector<float> times;
+	for (std::size_t i = 0; i < count; ++i)
+	{
+		bases.push_back(reference_nodes[i]->get_model());
+		times.push_back(0.01f * i);
+	}
+	std::vector<std::vector<glm::mat4>> palettes(skeleton_count, std::vector<glm::mat4>(bones_per_skeleton));
+	std::vector<float> skeleton_times;
+	for (std::size_t i = 0; i < skeleton_count; ++i)
+		skeleton_times.push_back(0.05f * i);
+
+	auto start = std::chrono::steady_clock::now();
+	for (int f = 0; f < frames; ++f)
+	{
+		for (std::size_t i = 0; i < count; ++i)
+		{
+			gl::animation_clip const& clip = *clips[i % clips.size()];
+			times[i] = wrap(times[i] + (0.5f + (i % 3) * 0.25f) * dt, clip.get_duration());
+			reference_nodes[i]->set_model(bases[i] * reference_local(clip.get_track(i % 4), times[i]));
+		}
+		for (std::size_t i = 0; i < skeleton_count; ++i)
+		{
+			skeleton_times[i] = wrap(skeleton_times[i] + dt, walk->get_duration());
+			std::vector<glm::mat4>& global = palettes[i];
+			for (std::size_t bone = 0; bone < bones_per_skeleton; ++bone)
+			{
+				glm::mat4 local = reference_local(walk->get_track(bone), skeleton_times[i]);
+				global[bone] = bones->parents[bone] < 0 ? local : global[bones->parents[bone]] * local;
+			}
+			for (std::size_t bone = 0; bone < bones_per_skeleton; ++bone)
+				global[bone] = global[bone] * bones->inverse_bind[bone];
+		}
+	}
+	double per_node_ms = impl::elapsed_ms(start);
+
+	float node_error = 0.0f, bone_error = 0.0f;
+	for (std::size_t i = 0; i < count; ++i)
+		node_error = std::max(node_error, max_difference(nodes[i]->get_model(), reference_nodes[i]->get_model()));
+	for (std::size_t i = 0; i < skeleton_count; ++i)
+		for (std::size_t bone = 0; bone < bones_per_skeleton; ++bone)
+			bone_error = std::max(bone_error, max_difference(skins[i].get_palette()[bone], palettes[i][bone]));
+
+	std::size_t animated = count + skeleton_count * bones_per_skeleton;
+	std::printf("%zu nodes, %zu skeletons of %zu bones, %d frames, %zu worker threads\n",
+	            count, skeleton_count, bones_per_skeleton, frames, gl::impl::worker_count());
+	std::printf("%-10s %12s %12s %12s %14s\n", "", "total (ms)", "evaluate", "apply", "nodes per ms");
+	std::printf("%-10s %12.2f %12.2f %12.2f %14.0f\n",
+	            "batched", batched_ms / frames, evaluate_ms / frames, apply_ms / frames, animated * frames / batched_ms);
+	std::printf("%-10s %12.2f %12s %12s %14.0f\n",
+	            "per node", per_node_ms / frames, "-", "-", animated * frames / per_node_ms);
+	std::printf("speedup: %.1fx, max error: %g nodes, %g bones\n", per_node_ms / batched_ms, node_error, bone_error);
+
+	std::clog.setstate(std::ios::failbit);
+	bool rendered = check_skinned_render(directory);
+	std::clog.clear();
+
+	return node_error < 1e-3f && bone_error < 1e-3f && rendered ? 0 : 1;
+}
@@ -0,0 +1,198 @@
+// Moves boxes about a square arena for a number of frames and finds the
+// overlapping pairs with a broadphase. For small counts the pairs are
+// checked against every pair of world bounds, and the distance checks the
+// simulations did before are timed alongside.
+//
+// usage: broadphase [components...]
+
+#include <mrr/graphics/broadphase.hxx>
+#include <mrr/graphics/gl-common.hxx>
+#include <mrr/graphics/headless.hxx>
+#include <mrr/graphics/timing.hxx>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <iterator>
+#include <memory>
+#include <random>
+#include <utility>
+#include <vector>
+
+#define GLM_FORCE_RADIANS
+#include <glm/gtc/matrix_transform.hpp>
+
+namespace gl = ::mrr::graphics::gl;
+namespace impl = ::mrr::graphics::gl::impl;
+
+// A unit box, as triangles.
+static std::vector<GLfloat> box_vertices()
+{
+	static int const faces[6][4][3] = {
+		{ { 0, 0, 0 }, { 1, 0, 0 }, { 1, 1, 0 }, { 0, 1, 0 } },
+		{ { 0, 0, 1 }, { 1, 0, 1 }, { 1, 1, 1 }, { 0, 1, 1 } },
+		{ { 0, 0, 0 }, { 0, 1, 0 }, { 0, 1, 1 }, { 0, 0, 1 } },
+		{ { 1, 0, 0 }, { 1, 1, 0 }, { 1, 1, 1 }, { 1, 0, 1 } },
+		{ { 0, 0, 0 }, { 1, 0, 0 }, { 1, 0, 1 }, { 0, 0, 1 } },
+		{ { 0, 1, 0 }, { 1, 1, 0 }, { 1, 1, 1 }, { 0, 1, 1 } }
+	};
+	static int const corners[6] = { 0, 1, 2, 0, 2, 3 };
+
+	std::vector<GLfloat> vertices;
+	for (auto const& face : faces)
+		for (int corner : corners)
+			for (int axis = 0; axis < 3; ++axis)
+				vertices.push_back(face[corner][axis] - 0.5f);
+	return vertices;
+}
+
+static bool overlap(gl::aabb const& a, gl::aabb const& b)
+{
+	for (int axis = 0; axis < 3; ++axis)
+		if (a.upper[axis] < b.lower[axis] || b.upper[axis] < a.lower[axis])
+			return false;
+	return true;
+}
+
+static std::pair<gl::component*, gl::component*> ordered(gl::component* a, gl::component* b)
+{
+	return a < b ? std::make_pair(a, b) : std::make_pair(b, a);
+}
+
+// Brute force is quadratic, so only up to this many components.
+static std::size_t const brute_force_limit = 10000;
+static int const frames = 30;
+
+static bool run(std::size_t count, std::vector<GLfloat> const& box)
+{
+	// About one box in eight overlaps another.
+	float const extent = std::sqrt(float(count)) * 3.0f;
+	std::mt19937 random(static_cast<unsigned>(count));
+	std::uniform_real_distribution<float> position(-extent, extent), turn(-0.2f, 0.2f);
+
+	std::vector<std::unique_ptr<gl::component>> components;
+	std::vector<float> headings;
+	for (std::size_t i = 0; i < count; ++i)
+	{
+		components.emplace_back(new gl::component());
+		gl::component& c = *components.back();
+		c.set_vertex_data(box.data(), int(box.size() * sizeof(GLfloat)));
+		c.set_model(glm::translate(glm::mat4(1.0f), glm::vec3(position(random), 0.0f, position(random))));
+		headings.push_back(position(random));
+	}
+
+	gl::broadphase broadphase;
+	std::size_t begun = 0, ended = 0;
+	broadphase.set_begin_callback([&](gl::component&, gl::component&) { ++begun; });
+	broadphase.set_end_callback([&](gl::component&, gl::component&) { ++ended; });
+
+	gl::model root;
+	for (auto const& c : components)
+		root.add_component(*c);
+
+	auto start = std::chrono::steady_clock::now();
+	broadphase.add(root);
+	broadphase.update();
+	double first_ms = impl::elapsed_ms(start);
+
+	double move_ms = 0.0, update_ms = 0.0, distance_ms = 0.0;
+	std::size_t swaps = 0, close = 0;
+	for (int frame = 0; frame < frames; ++frame)
+	{
+		// Each box drives on, turning a little, and wraps around the arena.
+		start = std::chrono::steady_clock::now();
+		for (std::size_t i = 0; i < count; ++i)
+		{
+			headings[i] += turn(random);
+			glm::vec3 step(0.3f * std::cos(headings[i]), 0.0f, 0.3f * std::sin(headings[i]));
+			glm::vec3 at = components[i]->get_location() + step;
+			if (std::fabs(at.x) > extent || std::fabs(at.z) > extent)
+				step = -2.0f * components[i]->get_location() * 0.999f;
+			components[i]->update_model(glm::translate(glm::mat4(1.0f), step));
+		}
+		move_ms += impl::elapsed_ms(start);
+
+		start = std::chrono::steady_clock::now();
+		broadphase.update();
+		update_ms += impl::elapsed_ms(start);
+		swaps += broadphase.get_stats().swaps;
+
+		if (count <= brute_force_limit && frame == 0)
+		{
+			start = std::chrono::steady_clock::now();
+			for (std::size_t i = 0; i < count; ++i)
+				for (std::size_t j = i + 1; j < count; ++j)
+				{
+					glm::vec3 d = components[i]->get_location() - components[j]->get_location();
+					close += glm::dot(d, d) < 3.0f;
+				}
+			distance_ms = impl::elapsed_ms(start);
+		}
+	}
+
+	// The pairs of the last frame, against every pair of bounds.
+	std::size_t missing = 0, extra = 0;
+	if (count <= brute_force_limit)
+	{
+		std::vector<std::pair<gl::component*, gl::component*>> expected, found;
+		std::vector<gl::aabb> bounds;
+		for (auto const& c : components)
+			bounds.push_back(c->get_world_bounds());
+		for (std::size_t i = 0; i < count; ++i)
+			for (std::size_t j = i + 1; j < count; ++j)
+				if (overlap(bounds[i], bounds[j]))
+					expected.push_back(ordered(components[i].get(), components[j].get()));
+
+		for (auto const& p : broadphase.get_pairs())
+			found.push_back(ordered(p.first, p.second));
+		std::sort(expected.begin(), expected.end());
+		std::sort(found.begin(), found.end());
+
+		std::vector<std::pair<gl::component*, gl::component*>> difference;
+		std::set_difference(expected.begin(), expected.end(), found.begin(), found.end(), std::back_inserter(difference));
+		missing = difference.size();
+		difference.clear();
+		std::set_difference(found.begin(), found.end(), expected.begin(), expected.end(), std::back_inserter(difference));
+		extra = difference.size();
+	}
+
+	std::printf(
+		"%10zu %12.3f %12.3f %12.3f %12.1f %10zu %10zu",
+		count, first_ms, move_ms / frames, update_ms / frames,
+		double(swaps) / frames, broadphase.get_pairs().size(), begun + ended
+	);
+	if (count <= brute_force_limit)
+		std::printf(" %12.3f %8zu %8zu %8zu\n", distance_ms, close, missing, extra);
+	else
+		std::printf(" %12s %8s %8s %8s\n", "-", "-", "-", "-");
+
+	broadphase.remove(root);
+	return missing == 0 && extra == 0;
+}
+
+int main(int argc, char* argv[])
+{
+	std::vector<std::size_t> counts;
+	for (int i = 1; i < argc; ++i)
+		counts.push_back(std::size_t(std::atol(argv[i])));
+	if (counts.empty())
+		counts = { 1000, 10000, 25000, 50000, 100000 };
+
+	::mrr::graphics::egl::headless_context context;
+	gl::init(0.1f, 0.1f, 0.1f, 1.0f);
+
+	std::vector<GLfloat> const box = box_vertices();
+
+	std::printf(
+		"%10s %12s %12s %12s %12s %10s %10s %12s %8s %8s %8s\n",
+		"components", "first ms", "move ms", "update ms", "swaps", "pairs",
+		"changes", "distance ms", "close", "missing", "extra"
+	);
+	bool ok = true;
+	for (std::size_t count : counts)
+		ok = run(count, box) && ok;
+
+	return ok ? 0 : 1;
+}
@@ -0,0 +1,228 @@
+// Feeds dds::parse valid headers, every truncation of them, overflowing
+// dimensions, mip and array counts, and randomly mutated bytes, without a
+// GL context. Every input is copied to a buffer of exactly its size, so a
+// build with -fsanitize=address also catches reads past the end; every
+// accepted input must describe surfaces that lie inside it.
+//
+// usage: dds-parse [mutations]
+
+#include <mrr/graphics/dds.hxx>
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <vector>
+
+namespace dds = ::mrr::graphics::gl::dds;
+
+namespace {
+
+struct header_fields
+{
+	char const* fourcc;
+	std::uint32_t width;
+	std::uint32_t height;
+	std::uint32_t mip_count;
+	bool cubemap;
+	// Used with the "DX10" fourcc only.
+	std::uint32_t dxgi_format;
+	std::uint32_t array_size;
+};
+
+void put_u32(std::vector<unsigned char>& file, std::size_t offset, std::uint32_t value)
+{
+	for (int i = 0; i < 4; ++i)
+		file[offset + i] = static_cast<unsigned char>(value >> (8 * i));
+}
+
+// A DDS file with the header described and data_bytes of surfaces.
+std::vector<unsigned char> make_file(header_fields const& h, std::size_t data_bytes)
+{
+	bool dx10 = std::strcmp(h.fourcc, "DX10") == 0;
+	std::vector<unsigned char> file(4 + 124 + (dx10 ? 20 : 0) + data_bytes, 0);
+	std::memcpy(&file[0], "DDS ", 4);
+	put_u32(file, 4, 124);
+	put_u32(file, 8, 0x1 | 0x2 | 0x4 | 0x1000 | 0x20000);
+	put_u32(file, 12, h.height);
+	put_u32(file, 16, h.width);
+	put_u32(file, 28, h.mip_count);
+	put_u32(file, 76, 32);
+	put_u32(file, 80, 0x4);
+	std::memcpy(&file[84], h.fourcc, 4);
+	put_u32(file, 112, h.cubemap ? 0x200 | 0xFC00 : 0);
+
+	if (dx10)
+	{
+		put_u32(file, 128, h.dxgi_format);
+		put_u32(file, 132, 3);
+		put_u32(file, 136, h.cubemap ? 0x4 : 0);
+		put_u32(file, 140, h.array_size);
+	}
+	return file;
+}
+
+// Bytes of every surface of a valid header, as the parser should compute.
+std::size_t surfaces_size(header_fields const& h, std::size_t block_bytes)
+{
+	std::size_t chain = 0;
+	for (std::uint32_t level = 0; level < h.mip_count; ++level)
+	{
+		std::size_t w = std::max<std::uint32_t>(h.width >> level, 1);
+		std::size_t hh = std::max<std::uint32_t>(h.height >> level, 1);
+		chain += ((w + 3) / 4) * ((hh + 3) / 4) * block_bytes;
+	}
+	return chain * (h.cubemap ? 6 : 1) * (std::strcmp(h.fourcc, "DX10") == 0 ? h.array_size : 1);
+}
+
+// Parses a copy of size bytes of data held in a buffer of exactly that size,
+// and checks that an accepted image lies inside it.
+dds::error parse_exact(unsigned char const* data, std::size_t size, dds::image& img, bool& inside)
+{
+	std::unique_ptr<unsigned char[]> copy(new unsigned char[size > 0 ? size : 1]);
+	if (size > 0)
+		std::memcpy(copy.get(), data, size);
+
+	dds::error e = dds::parse(copy.get(), size, img);
+	inside = true;
+	if (e == dds::error::none)
+	{
+		std::uint32_t last = img.mip_count - 1;
+		inside = img.data_offset <= size && img.data_size <= size - img.data_offset
+			&& img.surface_offset(img.array_size - 1, img.faces - 1, last) + img.mip_size(last)
+			   == img.data_offset + img.data_size;
+	}
+	return e;
+}
+
+// xorshift64*, so runs are repeatable.
+struct random_bytes
+{
+	std::uint64_t state;
+
+	std::uint64_t next()
+	{
+		state ^= state >> 12;
+		state ^= state << 25;
+		state ^= state >> 27;
+		return state * 0x2545F4914F6CDD1Dull;
+	}
+};
+
+} // namespace
+
+
+int main(int argc, char* argv[])
+{
+	long mutations = argc > 1 ? std::atol(argv[1]) : 200000;
+	bool ok = true;
+
+	// Valid files parse, and describe exactly the surfaces they hold.
+	header_fields const bc1 = { "DXT1", 64, 32, 7, false, 0, 1 };
+	header_fields const bc7_cube_array = { "DX10", 16, 16, 5, true, 98, 3 };
+	header_fields const bc5_odd = { "ATI2", 13, 5, 3, false, 0, 1 };
+	header_fields const* const valid[] = { &bc1, &bc7_cube_array, &bc5_odd };
+	std::size_t const block_bytes[] = { 8, 16, 16 };
+
+	std::vector<std::vector<unsigned char>> seeds;
+	for (int v = 0; v < 3; ++v)
+	{
+		header_fields const& h = *valid[v];
+		seeds.push_back(make_file(h, surfaces_size(h, block_bytes[v])));
+
+		dds::image img;
+		bool inside;
+		dds::error e = parse_exact(seeds.back().data(), seeds.back().size(), img, inside);
+		bool valid_ok = e == dds::error::none && inside
+			&& img.width == h.width && img.height == h.height && img.mip_count == h.mip_count
+			&& img.faces == (h.cubemap ? 6u : 1u) && img.block_bytes == block_bytes[v]
+			&& img.data_size == surfaces_size(h, block_bytes[v]);
+		std::printf("valid %s %ux%u: %s\n", h.fourcc, h.width, h.height, valid_ok ? "ok" : dds::describe(e));
+		ok = ok && valid_ok;
+	}
+
+	// Every proper prefix of a valid file is rejected.
+	std::size_t truncations = 0, accepted_truncations = 0;
+	for (auto const& seed : seeds)
+		for (std::size_t size = 0; size < seed.size(); ++size, ++truncations)
+		{
+			dds::image img;
+			bool inside;
+			accepted_truncations += parse_exact(seed.data(), size, img, inside) == dds::error::none;
+		}
+	dds::image unused;
+	accepted_truncations += dds::parse(nullptr, 0, unused) == dds::error::none;
+	std::printf("truncations: %zu, accepted: %zu\n", truncations, accepted_truncations);
+	ok = ok && accepted_truncations == 0;
+
+	// Sizes and counts that would overflow, or that no file holds.
+	struct overflow_case
+	{
+		header_fields h;
+		std::size_t data_bytes;
+		dds::error expected;
+	};
+	overflow_case const overflows[] = {
+		{ { "DXT1", 0xFFFFFFFF, 0xFFFFFFFF, 1, false, 0, 1 }, 64, dds::error::bad_dimensions },
+		{ { "DXT1", 65537, 4, 1, false, 0, 1 }, 64, dds::error::bad_dimensions },
+		{ { "DXT1", 0, 4, 1, false, 0, 1 }, 64, dds::error::bad_dimensions },
+		{ { "DXT1", 64, 64, 0xFFFFFFFF, false, 0, 1 }, 4096, dds::error::bad_mip_count },
+		{ { "DXT1", 64, 64, 8, false, 0, 1 }, 4096, dds::error::bad_mip_count },
+		{ { "DX10", 64, 64, 1, false, 98, 0xFFFFFFFF }, 4096, dds::error::bad_array_size },
+		{ { "DX10", 64, 64, 1, false, 98, 0 }, 4096, dds::error::bad_array_size },
+		{ { "DX10", 65536, 65536, 17, true, 98, 2048 }, 4096, dds::error::truncated_data },
+		{ { "DX10", 64, 32, 1, true, 98, 1 }, 4096, dds::error::bad_dimensions },
+		{ { "DXT1", 64, 64, 7, false, 0, 1 }, 2048, dds::error::truncated_data },
+		{ { "DX10", 64, 64, 1, false, 1000, 1 }, 4096, dds::error::unsupported_format },
+		{ { "RGBA", 64, 64, 1, false, 0, 1 }, 4096, dds::error::unsupported_format }
+	};
+	std::size_t wrong = 0;
+	for (overflow_case const& c : overflows)
+	{
+		std::vector<unsigned char> file = make_file(c.h, c.data_bytes);
+		dds::image img;
+		bool inside;
+		dds::error e = parse_exact(file.data(), file.size(), img, inside);
+		if (e != c.expected)
+		{
+			std::printf("  %s %ux%u, %u mips, %u layers: %s, expected %s\n", c.h.fourcc, c.h.width, c.h.height,
+			            c.h.mip_count, c.h.array_size, dds::describe(e), dds::describe(c.expected));
+			++wrong;
+		}
+	}
+	std::printf("overflowing headers: %zu, wrong errors: %zu\n", sizeof(overflows) / sizeof(overflows[0]), wrong);
+	ok = ok && wrong == 0;
+
+	// Random mutations of the seeds, mostly in their headers, sometimes
+	// truncated: whatever is accepted must lie inside the file.
+	random_bytes random = { 0x9E3779B97F4A7C15ull };
+	std::size_t accepted = 0, outside = 0;
+	for (long m = 0; m < mutations; ++m)
+	{
+		std::vector<unsigned char> file = seeds[random.next() % seeds.size()];
+		std::size_t edits = 1 + random.next() % 8;
+		for (std::size_t i = 0; i < edits; ++i)
+		{
+			std::size_t span = random.next() % 4 ? std::min<std::size_t>(file.size(), 148) : file.size();
+			std::size_t at = random.next() % span;
+			if (random.next() % 4)
+				file[at] = static_cast<unsigned char>(random.next());
+			else
+				file[at] ^= static_cast<unsigned char>(1u << (random.next() % 8));
+		}
+		if (random.next() % 8 == 0)
+			file.resize(random.next() % (file.size() + 1));
+
+		dds::image img;
+		bool inside;
+		accepted += parse_exact(file.data(), file.size(), img, inside) == dds::error::none;
+		outside += !inside;
+	}
+	std::printf("mutations: %ld, accepted: %zu, outside the file: %zu\n", mutations, accepted, outside);
+	ok = ok && outside == 0;
+
+	std::printf("%s\n", ok ? "ok" : "MISMATCH");
+	return ok ? 0 : 1;
+}
@@ -0,0 +1,97 @@
+#ifndef MRR_GRAPHICS_BENCH_FIXTURES_HXX__
+#define MRR_GRAPHICS_BENCH_FIXTURES_HXX__
+
+// Meshes the benchmarks write to temporary OBJ files and load back, and
+// frames they render and read back to compare.
+
+#include <mrr/graphics/gl-common.hxx>
+#include <mrr/graphics/offscreen.hxx>
+
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+namespace mrr {
+namespace graphics {
+namespace bench {
+
+// An axis aligned cube from (lo, lo, lo) to (hi, hi, hi): twelve outward
+// facing triangles with face normals and each face's uvs over [0, 1].
+inline void write_cube(char const* path, float lo = -1.0f, float hi = 1.0f)
+{
+	std::ofstream out(path);
+	for (int v = 0; v < 8; ++v)
+		out << "v " << ((v + 1) & 2 ? hi : lo) << ' ' << (v & 2 ? hi : lo) << ' ' << (v & 4 ? hi : lo) << '\n';
+	out << "vt 0 0\nvt 1 0\nvt 1 1\nvt 0 1\n"
+	       "vn 0 0 -1\nvn 0 0 1\nvn -1 0 0\nvn 1 0 0\nvn 0 -1 0\nvn 0 1 0\n"
+	       "f 1/1/1 3/3/1 2/2/1\nf 1/1/1 4/4/1 3/3/1\n"
+	       "f 5/1/2 6/2/2 7/3/2\nf 5/1/2 7/3/2 8/4/2\n"
+	       "f 1/1/3 5/2/3 8/3/3\nf 1/1/3 8/3/3 4/4/3\n"
+	       "f 2/1/4 3/4/4 7/3/4\nf 2/1/4 7/3/4 6/2/4\n"
+	       "f 1/1/5 2/2/5 6/3/5\nf 1/1/5 6/3/5 5/4/5\n"
+	       "f 4/1/6 8/4/6 7/3/6\nf 4/1/6 7/3/6 3/2/6\n";
+}
+
+// Height of the terrain at (x, z), rolling within [-0.3, 0.3].
+inline float terrain_height(float x, float z)
+{
+	return 0.3f * std::sin(x * 5.0f) * std::cos(z * 4.0f);
+}
+
+// pattern, a printf format with one %d, for one terrain resolution.
+inline std::string terrain_path(char const* pattern, int resolution)
+{
+	char path[256];
+	std::snprintf(path, sizeof(path), pattern, resolution);
+	return path;
+}
+
+// A resolution by resolution grid of quads over [-1, 1] on x-z, raised to
+// terrain_height, with uvs over [0, 1] and a single upward normal.
+inline void write_terrain(std::string const& path, int resolution)
+{
+	std::ofstream out(path);
+	float step = 2.0f / resolution;
+	for (int z = 0; z <= resolution; ++z)
+		for (int x = 0; x <= resolution; ++x)
+		{
+			float px = -1.0f + x * step, pz = -1.0f + z * step;
+			out << "v " << px << ' ' << terrain_height(px, pz) << ' ' << pz << '\n'
+			    << "vt " << x / float(resolution) << ' ' << z / float(resolution) << '\n';
+		}
+	out << "vn 0 1 0\n";
+
+	int row = resolution + 1;
+	for (int z = 0; z < resolution; ++z)
+		for (int x = 0; x < resolution; ++x)
+		{
+			int a = z * row + x + 1, b = a + 1, c = a + row, d = c + 1;
+			out << "f " << a << '/' << a << "/1 " << c << '/' << c << "/1 " << b << '/' << b << "/1\n"
+			    << "f " << b << '/' << b << "/1 " << c << '/' << c << "/1 " << d << '/' << d << "/1\n";
+		}
+}
+
+// Clears target, renders m into it and reads it back: tightly packed RGBA
+// rows, bottom row first.
+inline std::vector<unsigned char> render(
+	gl::framebuffer const& target, gl::model const& m, glm::mat4 const& V, glm::mat4 const& P
+)
+{
+	target.bind();
+	::glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+	m.render(V, P);
+
+	std::vector<unsigned char> pixels(std::size_t(target.get_width()) * target.get_height() * 4);
+	::glReadPixels(0, 0, target.get_width(), target.get_height(), GL_RGBA, GL_UNSIGNED_BYTE, pixels.data());
+	return pixels;
+}
+
+} // namespace bench
+} // namespace graphics
+} // namespace mrr
+
+#endif // #ifndef MRR_GRAPHICS_BENCH_FIXTURES_HXX__
@@ -0,0 +1,163 @@
+// Counts the heap allocations of every frame of a main loop over a pooled
+// scene: waypoints moving components about, a loop body gathering the
+// nearby components into frame arena storage, and a render of the tree.
+// Every operator new in the process is counted, and frames after the
+// first few must make none.
+//
+// usage: frame-allocations [frames] [components] [shader-directory]
+
+#include <mrr/graphics/gl-common.hxx>
+#include <mrr/graphics/headless.hxx>
+#include <mrr/graphics/offscreen.hxx>
+#include <mrr/graphics/pool.hxx>
+#include <mrr/graphics/stats.hxx>
+#include <mrr/graphics/waypoint.hxx>
+
+#include "fixtures.hxx"
+
+#include <atomic>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <new>
+#include <string>
+#include <vector>
+
+#define GLM_FORCE_RADIANS
+#include <glm/gtc/matrix_transform.hpp>
+
+namespace gl = ::mrr::graphics::gl;
+namespace bench = ::mrr::graphics::bench;
+
+static std::atomic<std::size_t> heap_allocations(0);
+
+void* operator new(std::size_t size)
+{
+	++heap_allocations;
+	if (void* p = std::malloc(size != 0 ? size : 1))
+		return p;
+	throw std::bad_alloc();
+}
+
+void operator delete(void* p) noexcept
+{
+	std::free(p);
+}
+
+static char const* cube_obj_path = "/tmp/mrr-frame-allocations-cube.obj";
+
+// Frames allowed to allocate while the driver, pools and arena warm up.
+static int const warm_up_frames = 3;
+
+int main(int argc, char* argv[])
+{
+	int frames = argc > 1 ? std::atoi(argv[1]) : 120;
+	int count = argc > 2 ? std::atoi(argv[2]) : 1024;
+	std::string directory = argc > 3 ? argv[3] : "/usr/local/share/mrr/graphics/shaders";
+
+	::mrr::graphics::egl::headless_context context;
+	gl::init(0.1f, 0.1f, 0.1f, 1.0f);
+	gl::vertex_array va;
+	gl::framebuffer target(256, 256);
+	if (!target.is_complete())
+		return 1;
+
+	bench::write_cube(cube_obj_path);
+	gl::shader_handle shader(
+		directory + "/colour-vertex-shader.glsl", directory + "/colour-fragment-shader.glsl"
+	);
+
+	// Groups of 16 components under a root, all from pools.
+	gl::node_pool<gl::model> models;
+	gl::node_pool<gl::component> components;
+	gl::model& root = *models.create();
+	root.set_shader(shader);
+	root.add_point_source(glm::vec3(0, 20, 30), glm::vec3(1, 1, 1), 2000.0f);
+
+	std::clog.setstate(std::ios::failbit);
+	std::vector<gl::component*> all;
+	std::vector<gl::waypoint> waypoints;
+	gl::model* group = nullptr;
+	for (int i = 0; i < count; ++i)
+	{
+		if (i % 16 == 0)
+		{
+			group = models.create();
+			root.add_component(*group);
+		}
+
+		gl::component& c = *components.create();
+		c.set_shader(shader);
+		c.load_wavefront(cube_obj_path);
+		c.set_model(glm::translate(glm::mat4(1.0f), glm::vec3(i % 32 * 3.0f - 48.0f, i / 32 * 3.0f - 48.0f, 0.0f)));
+		group->add_component(c);
+		all.push_back(&c);
+
+		// Every fourth component drifts away from a waypoint until it leaves it.
+		if (i % 4 == 0)
+		{
+			waypoints.push_back(gl::waypoint(c.get_location(), 1.0));
+			waypoints.back().add_action(c, [](gl::component& target) {
+				target.update_model(glm::translate(glm::mat4(1.0f), glm::vec3(0.0f, 0.0f, -0.01f)));
+			});
+		}
+	}
+	std::remove(cube_obj_path);
+	std::clog.clear();
+
+	glm::mat4 P = glm::perspective(glm::radians(60.0f), 1.0f, 0.1f, 500.0f);
+	glm::mat4 V = glm::lookAt(glm::vec3(0, 0, 120), glm::vec3(0, 0, 0), glm::vec3(0, 1, 0));
+
+	gl::frame_arena arena;
+	std::size_t nearby_total = 0, steady_allocations = 0;
+	double distance_total = 0.0;
+	std::printf("%6s %12s %12s %12s\n", "frame", "operator new", "pool/arena", "arena bytes");
+
+	// As window_handle::main_loop runs each frame.
+	for (int frame = 0; frame < frames; ++frame)
+	{
+		std::size_t before = heap_allocations;
+
+		gl::next_frame_stats();
+		arena.reset();
+		gl::process_waypoints(waypoints);
+
+		// The loop body's temporaries: the components near a moving point.
+		glm::vec3 probe(40.0f * std::sin(frame * 0.05f), 40.0f * std::cos(frame * 0.05f), 0.0f);
+		std::vector<gl::component*, gl::arena_allocator<gl::component*>> nearby{
+			gl::arena_allocator<gl::component*>(arena)
+		};
+		for (gl::component* c : all)
+			if (glm::length(c->get_location() - probe) < 20.0f)
+				nearby.push_back(c);
+		float* distances = arena.allocate_array<float>(nearby.size());
+		for (std::size_t i = 0; i < nearby.size(); ++i)
+			distances[i] = glm::length(nearby[i]->get_location() - probe);
+		for (std::size_t i = 0; i < nearby.size(); ++i)
+			distance_total += distances[i];
+		nearby_total += nearby.size();
+
+		target.bind();
+		::glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+		va.bind();
+		root.render(V, P);
+		::glFinish();
+
+		std::size_t allocations = heap_allocations - before;
+		if (frame >= warm_up_frames)
+			steady_allocations += allocations;
+		if (frame < warm_up_frames + 3 || frame + 1 == frames)
+			std::printf("%6d %12zu %12zu %12zu\n",
+			            frame, allocations, gl::frame_stats().heap_allocations, gl::frame_stats().arena_bytes);
+	}
+
+	std::printf("components: %d, pooled models: %zu, pooled components: %zu\n",
+	            count, models.size(), components.size());
+	std::printf("arena high water: %zu bytes, capacity: %zu bytes, nearby per frame: %.1f at %.2f\n",
+	            arena.get_high_water(), arena.get_capacity(), double(nearby_total) / frames,
+	            nearby_total != 0 ? distance_total / nearby_total : 0.0);
+	std::printf("allocations after frame %d: %zu\n", warm_up_frames, steady_allocations);
+
+	return steady_allocations == 0 ? 0 : 1;
+}
@@ -0,0 +1,147 @@
+// Measures how many frames per second a headless context renders and reads
+// back, once with a blocking glReadPixels per frame and once through
+// async_readback with double-buffered pixel pack buffers. Run it with
+// LIBGL_ALWAYS_SOFTWARE=true to measure Mesa's llvmpipe.
+//
+// usage: headless-throughput [frames] [width] [height] [shader-directory] [last-frame.ppm]
+
+#include <mrr/graphics/gl-common.hxx>
+#include <mrr/graphics/headless.hxx>
+#include <mrr/graphics/offscreen.hxx>
+
+#include "fixtures.hxx"
+
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <string>
+#include <vector>
+
+#define GLM_FORCE_RADIANS
+#include <glm/gtc/matrix_transform.hpp>
+
+namespace gl = ::mrr::graphics::gl;
+namespace bench = ::mrr::graphics::bench;
+
+static char const* cube_obj_path = "/tmp/mrr-headless-throughput-cube.obj";
+
+// Stands in for the work a batch job does with every image, so that the
+// read back pixels are actually touched.
+static unsigned long checksum(unsigned char const* rgba, GLsizei width, GLsizei height)
+{
+	unsigned long sum = 0;
+	std::size_t size = std::size_t(width) * height * 4;
+	for (std::size_t i = 0; i < size; i += 4)
+		sum += rgba[i] + rgba[i + 1] + rgba[i + 2];
+	return sum;
+}
+
+int main(int argc, char* argv[])
+{
+	int frames = argc > 1 ? std::atoi(argv[1]) : 300;
+	GLsizei width = argc > 2 ? std::atoi(argv[2]) : 512;
+	GLsizei height = argc > 3 ? std::atoi(argv[3]) : 512;
+	std::string directory = argc > 4 ? argv[4] : "/usr/local/share/mrr/graphics/shaders";
+	char const* image_path = argc > 5 ? argv[5] : nullptr;
+
+	::mrr::graphics::egl::headless_context context;
+	gl::init(0.1f, 0.1f, 0.1f, 1.0f);
+	gl::vertex_array va;
+
+	gl::framebuffer target(width, height);
+	if (!target.is_complete())
+		return 1;
+
+	bench::write_cube(cube_obj_path);
+	gl::shader_handle shader(
+		directory + "/colour-vertex-shader.glsl", directory + "/colour-fragment-shader.glsl"
+	);
+
+	gl::model scene;
+	scene.set_shader(shader);
+	scene.add_point_source(glm::vec3(0, 20, 30), glm::vec3(1, 1, 1), 2000.0f);
+
+	int const side = 8;
+	std::vector<std::unique_ptr<gl::component>> components;
+	for (int i = 0; i < side * side; ++i)
+	{
+		components.emplace_back(new gl::component());
+		gl::component& c = *components.back();
+		c.set_shader(shader);
+		c.load_wavefront(cube_obj_path);
+		c.set_colour(glm::vec3(0.2f + 0.6f * (i % side) / side, 0.4f, 0.8f));
+		c.set_model(glm::translate(
+			glm::mat4(1.0f),
+			glm::vec3((i % side - side / 2) * 3.0f, (i / side - side / 2) * 3.0f, 0.0f)
+		));
+		scene.add_component(c);
+	}
+	std::remove(cube_obj_path);
+
+	glm::mat4 P = glm::perspective(glm::radians(60.0f), float(width) / height, 0.1f, 500.0f);
+	auto view = [](int frame) {
+		float angle = frame * 0.01f;
+		return glm::lookAt(
+			glm::vec3(40.0f * std::sin(angle), 10.0f, 40.0f * std::cos(angle)),
+			glm::vec3(0, 0, 0), glm::vec3(0, 1, 0)
+		);
+	};
+
+	auto render = [&](int frame) {
+		target.bind();
+		::glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+		va.bind();
+		scene.render(view(frame), P);
+	};
+
+	unsigned long sync_sum = 0;
+	unsigned long async_sum = 0;
+	std::vector<unsigned char> pixels(std::size_t(width) * height * 4);
+
+	// Warm up shader compilation and driver allocations.
+	render(0);
+	::glReadPixels(0, 0, width, height, GL_RGBA, GL_UNSIGNED_BYTE, pixels.data());
+
+	auto start = std::chrono::steady_clock::now();
+	for (int i = 0; i < frames; ++i)
+	{
+		render(i);
+		::glReadPixels(0, 0, width, height, GL_RGBA, GL_UNSIGNED_BYTE, pixels.data());
+		sync_sum += checksum(pixels.data(), width, height);
+	}
+	double sync_s = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+	gl::async_readback readback(
+		width, height,
+		[&](unsigned char const* rgba, GLsizei w, GLsizei h, std::size_t frame) {
+			async_sum += checksum(rgba, w, h);
+			if (image_path && frame + 1 == std::size_t(frames))
+				gl::write_ppm(image_path, rgba, w, h);
+		}
+	);
+
+	start = std::chrono::steady_clock::now();
+	for (int i = 0; i < frames; ++i)
+	{
+		render(i);
+		readback.capture();
+	}
+	readback.flush();
+	double async_s = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+	std::printf("renderer: %s\n", context.get_renderer());
+	std::printf("frames: %d at %dx%d, %d objects\n", frames, int(width), int(height), side * side);
+	std::printf("%-14s %12s %12s\n", "readback", "frames/s", "ms/frame");
+	std::printf("%-14s %12.1f %12.3f\n", "glReadPixels", frames / sync_s, 1000.0 * sync_s / frames);
+	std::printf("%-14s %12.1f %12.3f\n", "pbo x2", frames / async_s, 1000.0 * async_s / frames);
+	std::printf("speedup: %.2fx\n", sync_s / async_s);
+
+	if (sync_sum != async_sum)
+	{
+		std::fprintf(stderr, "Read back images differ between the two modes.\n");
+		return 1;
+	}
+	return 0;
+}
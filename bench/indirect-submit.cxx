@@ -0,0 +1,120 @@
+// Compares the CPU time spent submitting a scene through model::render with
+// the time spent by indirect_renderer::render, for growing object counts.
+//
+// usage: indirect-submit [max-objects] [shader-directory]
+
+#include <mrr/graphics/gl-common.hxx>
+#include <mrr/graphics/headless.hxx>
+#include <mrr/graphics/indirect.hxx>
+#include <mrr/graphics/offscreen.hxx>
+
+#include "fixtures.hxx"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+
+#define GLM_FORCE_RADIANS
+#include <glm/gtc/matrix_transform.hpp>
+
+namespace gl = ::mrr::graphics::gl;
+namespace bench = ::mrr::graphics::bench;
+
+static char const* cube_obj_path = "/tmp/mrr-indirect-submit-cube.obj";
+
+template <typename Render>
+static double time_submit(Render&& render, int frames)
+{
+	double total = 0.0;
+	for (int i = 0; i < frames; ++i)
+	{
+		auto start = std::chrono::steady_clock::now();
+		render();
+		auto end = std::chrono::steady_clock::now();
+		total += std::chrono::duration<double, std::milli>(end - start).count();
+
+		// Keep GPU execution out of the next frame's CPU measurement.
+		::glFinish();
+	}
+	return total / frames;
+}
+
+int main(int argc, char* argv[])
+{
+	int max_objects = argc > 1 ? std::atoi(argv[1]) : 16384;
+	std::string directory = argc > 2 ? argv[2] : "/usr/local/share/mrr/graphics/shaders";
+	int const frames = 32;
+
+	::mrr::graphics::egl::headless_context context(4, 3);
+	gl::init(0.0f, 0.0f, 0.0f, 1.0f);
+	gl::vertex_array va;
+	gl::framebuffer target(256, 256);
+	if (!target.is_complete())
+		return 2;
+
+	if (!gl::indirect_renderer::is_supported())
+	{
+		std::cerr << "GL 4.3 multi-draw indirect is not supported; nothing to compare.\n";
+		return 1;
+	}
+
+	bench::write_cube(cube_obj_path);
+
+	std::clog.setstate(std::ios::failbit);
+	gl::shader_handle shader(
+		directory + "/colour-vertex-shader.glsl", directory + "/colour-fragment-shader.glsl"
+	);
+	gl::shader_handle multi_draw_shader(
+		directory + "/indirect-vertex-shader.glsl", directory + "/indirect-fragment-shader.glsl"
+	);
+
+	glm::mat4 P = glm::perspective(glm::radians(60.0f), 1.0f, 0.1f, 1000.0f);
+	glm::mat4 V = glm::lookAt(glm::vec3(0, 0, 200), glm::vec3(0, 0, 0), glm::vec3(0, 1, 0));
+
+	std::printf("%10s %16s %16s\n", "objects", "per-draw (ms)", "indirect (ms)");
+
+	for (int n = 64; n <= max_objects; n *= 4)
+	{
+		gl::model scene;
+		scene.set_shader(shader);
+		scene.add_point_source(glm::vec3(0, 0, 50), glm::vec3(1, 1, 1), 1000.0f);
+
+		std::vector<std::unique_ptr<gl::component>> components;
+		int side = 1;
+		while (side * side < n)
+			++side;
+
+		for (int i = 0; i < n; ++i)
+		{
+			components.emplace_back(new gl::component());
+			gl::component& c = *components.back();
+			c.set_shader(shader);
+			c.load_wavefront(cube_obj_path);
+			c.set_colour(glm::vec3(0.2f, 0.4f, 0.8f));
+			c.set_model(glm::translate(
+				glm::mat4(1.0f),
+				glm::vec3((i % side - side / 2) * 3.0f, (i / side - side / 2) * 3.0f, 0.0f)
+			));
+			scene.add_component(c);
+		}
+
+		gl::indirect_renderer indirect;
+		indirect.set_shader(multi_draw_shader);
+		indirect.add(scene);
+		indirect.build();
+
+		va.bind();
+		target.bind();
+		double per_draw = time_submit([&] { scene.render(V, P); }, frames);
+		double multi = time_submit([&] { indirect.render(V, P); }, frames);
+
+		std::printf("%10d %16.3f %16.3f\n", n, per_draw, multi);
+	}
+
+	std::remove(cube_obj_path);
+	return 0;
+}
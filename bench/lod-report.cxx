@@ -0,0 +1,78 @@
+// Loads a Wavefront OBJ, generates its LODs and reports the triangles
+// submitted per frame with and without LOD as the camera backs away from a
+// grid of instances.
+//
+// usage: lod-report model.obj [instances-per-side]
+
+#include <mrr/graphics/common.hxx>
+
+#include <cstdlib>
+#include <iostream>
+#include <memory>
+#include <vector>
+
+#define GLM_FORCE_RADIANS
+#include <glm/gtc/matrix_transform.hpp>
+
+namespace gl = ::mrr::graphics::gl;
+
+int main(int argc, char* argv[])
+{
+	if (argc < 2)
+	{
+		std::cerr << "usage: " << argv[0] << " model.obj [instances-per-side]\n";
+		return 1;
+	}
+
+	int side = argc > 2 ? std::atoi(argv[2]) : 8;
+
+	::mrr::graphics::glfw::init();
+	::glfwWindowHint(GLFW_VISIBLE, GL_FALSE);
+	::mrr::graphics::glfw::window_handle window(512, 512, "lod-report");
+	::mrr::graphics::glew::init();
+	gl::init(0.0f, 0.0f, 0.0f, 1.0f);
+	gl::vertex_array va;
+
+	gl::shader_handle shader = gl::colour_shader();
+
+	gl::model scene;
+	scene.set_shader(shader);
+
+	std::vector<std::unique_ptr<gl::component>> components;
+	for (int i = 0; i < side * side; ++i)
+	{
+		components.emplace_back(new gl::component());
+		gl::component& c = *components.back();
+		c.set_shader(shader);
+		c.load_wavefront(argv[1]);
+		c.generate_lods();
+		c.set_colour(glm::vec3(0.8f, 0.8f, 0.8f));
+
+		float spacing = 2.5f * c.get_bounds().radius();
+		c.set_model(glm::translate(
+			glm::mat4(1.0f),
+			glm::vec3((i % side - side / 2) * spacing, (i / side - side / 2) * spacing, 0.0f)
+		));
+		scene.add_component(c);
+	}
+
+	float radius = components.front()->get_bounds().radius();
+	glm::mat4 P = glm::perspective(glm::radians(60.0f), 1.0f, 0.1f, 10000.0f);
+
+	std::cout << "distance\ttriangles\tfull detail\tratio\n";
+	for (float distance = 2.0f * radius; distance < 2000.0f * radius; distance *= 2.0f)
+	{
+		glm::mat4 V = glm::lookAt(glm::vec3(0, 0, distance), glm::vec3(0, 0, 0), glm::vec3(0, 1, 0));
+
+		::glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+		scene.render(V, P);
+		gl::next_frame_stats();
+
+		gl::render_stats const& s = gl::previous_frame_stats();
+		std::cout << distance << '\t' << s.triangles_submitted << '\t'
+		          << s.triangles_full_detail << '\t'
+		          << double(s.triangles_submitted) / double(s.triangles_full_detail) << '\n';
+	}
+
+	return 0;
+}
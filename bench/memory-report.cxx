@@ -0,0 +1,174 @@
+// Loads textured components from a few OBJ files and reports where their
+// memory is, by category and by asset. Then releases the CPU copies of the
+// meshes: CPU memory must drop by the size of those copies while GPU memory
+// and the rendered image stay the same, and destroying the components must
+// leave only the render target accounted.
+//
+// usage: memory-report [components] [shader-directory]
+
+#include <mrr/graphics/gl-common.hxx>
+#include <mrr/graphics/headless.hxx>
+#include <mrr/graphics/memory_accounting.hxx>
+#include <mrr/graphics/offscreen.hxx>
+
+#include "fixtures.hxx"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#define GLM_FORCE_RADIANS
+#include <glm/gtc/matrix_transform.hpp>
+
+namespace gl = ::mrr::graphics::gl;
+namespace bench = ::mrr::graphics::bench;
+
+static GLsizei const image_size = 256;
+static char const* terrain_obj_path = "/tmp/mrr-memory-report-terrain-%d.obj";
+static char const* checker_dds_path = "/tmp/mrr-memory-report-checker.dds";
+
+// A 64x64 BC1 checkerboard of solid 4x4 blocks, one mip level.
+static void write_checker(char const* path)
+{
+	std::uint32_t const size = 64;
+	std::vector<std::uint32_t> header(32, 0);
+	std::memcpy(&header[0], "DDS ", 4);
+	header[1] = 124;
+	header[2] = 0x1 | 0x2 | 0x4 | 0x1000 | 0x80000;
+	header[3] = size;
+	header[4] = size;
+	header[5] = size * size / 2;
+	header[19] = 32;
+	header[20] = 0x4;
+	std::memcpy(&header[21], "DXT1", 4);
+	header[27] = 0x1000;
+
+	std::ofstream out(path, std::ios::binary);
+	out.write(reinterpret_cast<char const*>(header.data()), header.size() * 4);
+
+	for (std::uint32_t y = 0; y < size / 4; ++y)
+		for (std::uint32_t x = 0; x < size / 4; ++x)
+		{
+			std::uint16_t colour = ((x / 2 + y / 2) % 2) ? 0xffff : 0xf800;
+			std::uint16_t block[4] = { colour, colour, 0, 0 };
+			out.write(reinterpret_cast<char const*>(block), sizeof(block));
+		}
+}
+
+static std::size_t category(gl::memory_report const& r, gl::memory_category c)
+{
+	return r.bytes[std::size_t(c)];
+}
+
+int main(int argc, char* argv[])
+{
+	int count = argc > 1 ? std::atoi(argv[1]) : 64;
+	std::string directory = argc > 2 ? argv[2] : "/usr/local/share/mrr/graphics/shaders";
+
+	::mrr::graphics::egl::headless_context context;
+	gl::init(0.1f, 0.1f, 0.1f, 1.0f);
+	gl::vertex_array va;
+	va.bind();
+	gl::framebuffer target(image_size, image_size);
+	if (!target.is_complete())
+		return 1;
+
+	int const resolutions[] = { 16, 32, 64 };
+	for (int resolution : resolutions)
+		bench::write_terrain(bench::terrain_path(terrain_obj_path, resolution), resolution);
+	write_checker(checker_dds_path);
+
+	gl::memory_report empty = gl::get_memory_report();
+	bool ok = true;
+	{
+		std::clog.setstate(std::ios::failbit);
+		gl::shader_handle shader(directory + "/texture-vertex-shader.glsl", directory + "/texture-fragment-shader.glsl");
+		gl::model root;
+		root.set_shader(shader);
+		root.add_point_source(glm::vec3(0, 30, 30), glm::vec3(1, 1, 1), 1500.0f);
+
+		std::vector<std::unique_ptr<gl::component>> components;
+		int const side = int(std::ceil(std::sqrt(double(count))));
+		std::size_t expected_vertex_bytes = 0;
+		for (int i = 0; i < count; ++i)
+		{
+			components.emplace_back(new gl::component());
+			gl::component& c = *components.back();
+			c.set_shader(shader);
+			c.load_wavefront(bench::terrain_path(terrain_obj_path, resolutions[i % 3]));
+			if (i % 4 == 1)
+				c.generate_lods(3);
+			c.load_texture(checker_dds_path);
+			c.set_model(glm::translate(glm::mat4(1.0f), glm::vec3((i % side - side / 2) * 2.5f, 0.0f, (i / side - side / 2) * 2.5f)));
+			root.add_component(c);
+			expected_vertex_bytes += c.get_vertex_count() * (2 * sizeof(glm::vec3) + sizeof(glm::vec2));
+		}
+		std::clog.clear();
+
+		glm::mat4 P = glm::perspective(glm::radians(60.0f), 1.0f, 0.1f, 500.0f);
+		glm::mat4 V = glm::lookAt(glm::vec3(0, 20, 30), glm::vec3(0, 0, 0), glm::vec3(0, 1, 0));
+		std::vector<unsigned char> kept_image = bench::render(target, root, V, P);
+		gl::memory_report kept = gl::get_memory_report();
+		std::cout << "kept: " << kept << '\n';
+
+		for (auto& c : components)
+			c->set_cpu_copy_policy(gl::cpu_copy_policy::release);
+		std::vector<unsigned char> released_image = bench::render(target, root, V, P);
+		gl::memory_report released = gl::get_memory_report();
+		std::cout << "released: " << released << '\n';
+
+		std::size_t differing = 0;
+		for (std::size_t p = 0; p < kept_image.size(); p += 4)
+			differing += !std::equal(kept_image.begin() + p, kept_image.begin() + p + 4, released_image.begin() + p);
+
+		std::size_t freed = kept.cpu_bytes - released.cpu_bytes;
+		std::printf("vertex buffers: %zu bytes, expected %zu\n",
+		            category(kept, gl::memory_category::vertex_buffers), expected_vertex_bytes);
+		std::printf("release: %zu of %zu CPU bytes freed (%.0f%%), GPU %zu -> %zu bytes, %zu differing pixels\n",
+		            freed, kept.cpu_bytes, 100.0 * freed / kept.cpu_bytes, kept.gpu_bytes, released.gpu_bytes, differing);
+
+		ok = category(kept, gl::memory_category::vertex_buffers) == expected_vertex_bytes
+			&& category(kept, gl::memory_category::mesh_arrays) >= expected_vertex_bytes
+			&& category(kept, gl::memory_category::textures) == std::size_t(count) * 64 * 64 / 2
+			&& category(released, gl::memory_category::mesh_arrays) == 0
+			&& category(released, gl::memory_category::index_arrays) == category(kept, gl::memory_category::index_arrays)
+			&& released.gpu_bytes == kept.gpu_bytes
+			&& kept.assets.size() == 3 + 2
+			&& differing == 0;
+
+		// Every other frame, through the hook that main_loop calls.
+		std::stringstream dumps;
+		gl::set_memory_dump(&dumps, 2);
+		for (int frame = 0; frame < 5; ++frame)
+			gl::dump_memory_report();
+		gl::set_memory_dump(nullptr, 0);
+
+		std::size_t dump_count = 0;
+		for (std::string line; std::getline(dumps, line);)
+			dump_count += line.compare(0, 8, "Memory: ") == 0;
+		std::printf("periodic dump: %zu reports in 5 frames\n", dump_count);
+		ok = ok && dump_count == 2;
+	}
+
+	// Only the render target is left, as before loading.
+	gl::memory_report destroyed = gl::get_memory_report();
+	std::cout << "destroyed: " << destroyed << '\n';
+	ok = ok && destroyed.cpu_bytes == empty.cpu_bytes && destroyed.gpu_bytes == empty.gpu_bytes
+		&& category(destroyed, gl::memory_category::render_targets) == std::size_t(image_size) * image_size * 8;
+
+	for (int resolution : resolutions)
+		std::remove(bench::terrain_path(terrain_obj_path, resolution).c_str());
+	std::remove(checker_dds_path);
+
+	std::printf("%s\n", ok ? "ok" : "MISMATCH");
+	return ok ? 0 : 1;
+}
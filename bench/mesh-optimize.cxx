@@ -0,0 +1,48 @@
+// Runs the load-time mesh optimization on Wavefront OBJ files without a GL
+// context and reports the vertex cache statistics before and after.
+//
+// usage: mesh-optimize model.obj...
+
+#include <mrr/graphics/obj_loader.hxx>
+#include <mrr/graphics/mesh.hxx>
+
+#include <chrono>
+#include <cstdio>
+#include <vector>
+
+namespace impl = ::mrr::graphics::gl::impl;
+
+int main(int argc, char* argv[])
+{
+	if (argc < 2)
+	{
+		std::fprintf(stderr, "usage: %s model.obj...\n", argv[0]);
+		return 1;
+	}
+
+	std::printf("%-32s %10s %10s %16s %16s %10s\n",
+	            "mesh", "triangles", "vertices", "ACMR", "ATVR", "time (ms)");
+
+	for (int i = 1; i < argc; ++i)
+	{
+		std::vector<glm::vec3> vertices, normals;
+		std::vector<glm::vec2> uvs;
+		std::vector<unsigned int> indices;
+
+		if (!impl::load_wavefront(argv[i], vertices, uvs, normals))
+			return 1;
+
+		impl::weld_vertices(vertices, uvs, normals, indices);
+
+		auto start = std::chrono::steady_clock::now();
+		impl::mesh_optimization_report r = impl::optimize_mesh(vertices, uvs, normals, indices);
+		auto end = std::chrono::steady_clock::now();
+
+		std::printf("%-32s %10zu %10zu %7.3f -> %5.3f %7.3f -> %5.3f %10.1f\n",
+		            argv[i], indices.size() / 3, vertices.size(),
+		            r.before.acmr, r.after.acmr, r.before.atvr, r.after.atvr,
+		            std::chrono::duration<double, std::milli>(end - start).count());
+	}
+
+	return 0;
+}
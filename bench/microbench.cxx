@@ -0,0 +1,242 @@
+// Microbenchmarks of the CPU hot paths, on synthetic data:
+//
+//   load_wavefront/<n>                 an n x n grid of quads with uvs and normals
+//   update_model/<depth>/<width>       a model tree with width children per node
+//   apply_fp_transformation/<d>/<w>    and components at the leaves
+//   process_waypoints/<w>/<t>          w waypoints acting on t components each
+//
+// Components need a GL context for their uniform lookups, so the suite runs
+// in a headless one.
+//
+// usage: microbench [--filter=<substring>] [--min-time=<seconds>] [--json=<path|->]
+
+#include <mrr/graphics/gl-common.hxx>
+#include <mrr/graphics/headless.hxx>
+#include <mrr/graphics/obj_loader.hxx>
+#include <mrr/graphics/waypoint.hxx>
+
+#include "microbench.hxx"
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+
+#define GLM_FORCE_RADIANS
+#include <glm/gtc/matrix_transform.hpp>
+
+namespace gl = ::mrr::graphics::gl;
+namespace bench = ::mrr::graphics::bench;
+
+static std::string grid_obj_path(long n)
+{
+	return "/tmp/mrr-microbench-grid-" + std::to_string(n) + ".obj";
+}
+
+// Writes an n x n grid of quads, split into triangles, and returns the file
+// size.
+static std::size_t write_grid(std::string const& path, long n)
+{
+	std::ofstream out(path);
+	for (long y = 0; y <= n; ++y)
+		for (long x = 0; x <= n; ++x)
+			out << "v " << x << " " << y << " " << ((x * 7 + y * 3) % 5) * 0.1f << "\n";
+	for (long y = 0; y <= n; ++y)
+		for (long x = 0; x <= n; ++x)
+			out << "vt " << float(x) / n << " " << float(y) / n << "\n";
+	out << "vn 0 0 1\n";
+
+	for (long y = 0; y < n; ++y)
+		for (long x = 0; x < n; ++x)
+		{
+			long a = y * (n + 1) + x + 1;
+			long b = a + 1;
+			long c = a + n + 1;
+			long d = c + 1;
+			out << "f " << a << "/" << a << "/1 " << b << "/" << b << "/1 " << d << "/" << d << "/1\n"
+			    << "f " << a << "/" << a << "/1 " << d << "/" << d << "/1 " << c << "/" << c << "/1\n";
+		}
+
+	return std::size_t(out.tellp());
+}
+
+static void bm_load_wavefront(bench::state& state)
+{
+	long const n = state.range(0);
+	std::string const path = grid_obj_path(n);
+	std::size_t const file_size = write_grid(path, n);
+
+	std::vector<glm::vec3> vertices;
+	std::vector<glm::vec2> uvs;
+	std::vector<glm::vec3> normals;
+	while (state.keep_running())
+	{
+		vertices.clear();
+		uvs.clear();
+		normals.clear();
+		if (!gl::impl::load_wavefront(path, vertices, uvs, normals))
+		{
+			std::cerr << "Failed to load the generated grid.\n";
+			std::exit(1);
+		}
+	}
+
+	std::remove(path.c_str());
+	state.set_items_processed(state.iterations() * vertices.size() / 3);
+	state.set_bytes_processed(state.iterations() * file_size);
+}
+
+
+//m=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-
+// A tree of models of the given depth (number of model levels above the
+// components) with width children per node.
+struct hierarchy
+{
+	gl::model root;
+	std::vector<std::unique_ptr<gl::model>> models;
+	std::vector<std::unique_ptr<gl::component>> components;
+
+	hierarchy(long depth, long width)
+	{
+		std::vector<gl::model*> level(1, &root);
+		for (long d = 1; d < depth; ++d)
+		{
+			std::vector<gl::model*> next;
+			for (gl::model* parent : level)
+				for (long w = 0; w < width; ++w)
+				{
+					models.emplace_back(new gl::model());
+					parent->add_component(*models.back());
+					next.push_back(models.back().get());
+				}
+			level.swap(next);
+		}
+
+		for (gl::model* parent : level)
+			for (long w = 0; w < width; ++w)
+			{
+				components.emplace_back(new gl::component());
+				gl::component& c = *components.back();
+				c.set_model(glm::translate(glm::mat4(1.0f), glm::vec3(components.size(), w, 0)));
+				parent->add_component(c);
+			}
+	}
+};
+
+static void bm_update_model(bench::state& state)
+{
+	hierarchy h(state.range(0), state.range(1));
+	glm::mat4 const t = glm::translate(glm::mat4(1.0f), glm::vec3(1e-3f, 0.0f, 0.0f));
+
+	while (state.keep_running())
+		h.root.update_model(t);
+
+	state.set_items_processed(state.iterations() * h.components.size());
+}
+
+static void bm_apply_fp_transformation(bench::state& state)
+{
+	hierarchy h(state.range(0), state.range(1));
+	glm::mat4 const t = glm::rotate(glm::mat4(1.0f), 1e-3f, glm::vec3(0, 1, 0));
+
+	while (state.keep_running())
+		h.root.apply_fp_transformation(t);
+
+	state.set_items_processed(state.iterations() * h.components.size());
+}
+
+
+//m=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-
+// Waypoints on a line with every target attached to each; targets are spread
+// so that about half of the checks fall within the radius.
+static void bm_process_waypoints(bench::state& state)
+{
+	long const waypoint_count = state.range(0);
+	long const target_count = state.range(1);
+
+	std::vector<std::unique_ptr<gl::component>> targets;
+	for (long i = 0; i < target_count; ++i)
+	{
+		targets.emplace_back(new gl::component());
+		targets.back()->set_model(glm::translate(
+			glm::mat4(1.0f), glm::vec3(float(i) / target_count * waypoint_count, 0.0f, 0.0f)
+		));
+	}
+
+	std::size_t actions_run = 0;
+	std::vector<gl::waypoint> waypoints;
+	for (long i = 0; i < waypoint_count; ++i)
+	{
+		waypoints.emplace_back(glm::vec3(i, 0.0f, 0.0f), waypoint_count / 4.0);
+		for (auto& target : targets)
+			waypoints.back().add_action(*target, [&actions_run](gl::component&) { ++actions_run; });
+	}
+
+	while (state.keep_running())
+		gl::process_waypoints(waypoints);
+
+	state.set_items_processed(state.iterations() * waypoint_count * target_count);
+	if (actions_run == 0)
+		std::cerr << "process_waypoints ran no actions.\n";
+}
+
+
+//m=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-
+int main(int argc, char* argv[])
+{
+	std::string filter;
+	std::string json_path;
+	double min_time = 0.5;
+
+	for (int i = 1; i < argc; ++i)
+	{
+		if (std::strncmp(argv[i], "--filter=", 9) == 0)
+			filter = argv[i] + 9;
+		else if (std::strncmp(argv[i], "--min-time=", 11) == 0)
+			min_time = std::atof(argv[i] + 11);
+		else if (std::strncmp(argv[i], "--json=", 7) == 0)
+			json_path = argv[i] + 7;
+		else
+		{
+			std::cerr << "usage: microbench [--filter=<substring>] [--min-time=<seconds>] [--json=<path|->]\n";
+			return 2;
+		}
+	}
+
+	::mrr::graphics::egl::headless_context context;
+
+	// The loader logs every file it reads.
+	std::clog.setstate(std::ios::failbit);
+
+	bench::suite suite;
+	suite.set_min_time(min_time);
+
+	suite.add("load_wavefront", bm_load_wavefront)
+		.args({ 16 }).args({ 64 }).args({ 256 });
+
+	suite.add("update_model", bm_update_model)
+		.args({ 1, 1024 }).args({ 2, 32 }).args({ 5, 4 }).args({ 10, 2 });
+
+	suite.add("apply_fp_transformation", bm_apply_fp_transformation)
+		.args({ 1, 1024 }).args({ 2, 32 }).args({ 5, 4 }).args({ 10, 2 });
+
+	suite.add("process_waypoints", bm_process_waypoints)
+		.args({ 16, 16 }).args({ 64, 256 }).args({ 256, 1024 });
+
+	// With JSON on stdout the table moves to stderr.
+	std::vector<bench::result> results = suite.run(filter, json_path == "-" ? stderr : stdout);
+
+	if (!json_path.empty())
+	{
+		if (!bench::suite::write_json(json_path, argv[0], results))
+		{
+			std::cerr << "ERROR: Cannot write results...\tpath: " << json_path << std::endl;
+			return 1;
+		}
+	}
+	return 0;
+}
@@ -0,0 +1,273 @@
+#ifndef MRR_GRAPHICS_BENCH_MICROBENCH_HXX__
+#define MRR_GRAPHICS_BENCH_MICROBENCH_HXX__
+
+// A minimal harness in the style of Google Benchmark, so that the CPU paths
+// can be measured without another dependency. Each benchmark is run with
+// doubling iteration counts until it takes at least the minimum time; its
+// results are printed as a table and can be written as JSON in Google
+// Benchmark's layout, which its compare.py and other tools read.
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <ctime>
+#include <fstream>
+#include <functional>
+#include <iomanip>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace mrr {
+namespace graphics {
+namespace bench {
+
+class state
+{
+public:
+	state(std::size_t iterations, std::vector<long> const& arguments)
+		: iterations_(iterations), remaining_(iterations), arguments_(arguments),
+		  items_processed_(0), bytes_processed_(0), running_(false),
+		  real_seconds_(0.0), cpu_seconds_(0.0)
+	{
+	}
+
+	// Timing starts on the first call, so setup before the loop is free.
+	bool keep_running()
+	{
+		if (!running_)
+		{
+			running_ = true;
+			start();
+		}
+		if (remaining_ > 0)
+		{
+			--remaining_;
+			return true;
+		}
+		stop();
+		return false;
+	}
+
+	// Excludes per-iteration setup from the measurement.
+	void pause_timing() { stop(); }
+	void resume_timing() { start(); }
+
+	long range(std::size_t i) const { return arguments_.at(i); }
+	std::size_t iterations() const { return iterations_; }
+
+	// Totals over all iterations.
+	void set_items_processed(std::size_t items) { items_processed_ = items; }
+	void set_bytes_processed(std::size_t bytes) { bytes_processed_ = bytes; }
+
+	std::size_t items_processed() const { return items_processed_; }
+	std::size_t bytes_processed() const { return bytes_processed_; }
+	double real_seconds() const { return real_seconds_; }
+	double cpu_seconds() const { return cpu_seconds_; }
+
+private:
+	void start()
+	{
+		real_start_ = std::chrono::steady_clock::now();
+		cpu_start_ = std::clock();
+	}
+
+	void stop()
+	{
+		real_seconds_ += std::chrono::duration<double>(
+			std::chrono::steady_clock::now() - real_start_
+		).count();
+		cpu_seconds_ += double(std::clock() - cpu_start_) / CLOCKS_PER_SEC;
+	}
+
+	std::size_t iterations_;
+	std::size_t remaining_;
+	std::vector<long> arguments_;
+	std::size_t items_processed_;
+	std::size_t bytes_processed_;
+	bool running_;
+	std::chrono::steady_clock::time_point real_start_;
+	std::clock_t cpu_start_;
+	double real_seconds_;
+	double cpu_seconds_;
+};
+
+
+class benchmark
+{
+public:
+	using function_type = std::function<void (state&)>;
+
+	benchmark(std::string const& name, function_type const& function)
+		: name_(name), function_(function)
+	{
+	}
+
+	benchmark& args(std::vector<long> const& arguments)
+	{
+		argument_sets_.push_back(arguments);
+		return *this;
+	}
+
+	std::string const& get_name() const { return name_; }
+	function_type const& get_function() const { return function_; }
+
+	std::vector<std::vector<long>> get_argument_sets() const
+	{
+		return argument_sets_.empty() ? std::vector<std::vector<long>>(1) : argument_sets_;
+	}
+
+private:
+	std::string name_;
+	function_type function_;
+	std::vector<std::vector<long>> argument_sets_;
+};
+
+
+struct result
+{
+	std::string name;
+	std::size_t iterations;
+	double real_ns;
+	double cpu_ns;
+	double items_per_second;
+	double bytes_per_second;
+};
+
+
+class suite
+{
+public:
+	suite() : min_time_(0.5) {}
+
+	benchmark& add(std::string const& name, benchmark::function_type const& function)
+	{
+		benchmarks_.emplace_back(name, function);
+		return benchmarks_.back();
+	}
+
+	void set_min_time(double seconds) { min_time_ = seconds; }
+
+	// Runs every benchmark whose name contains filter, printing a table of
+	// the results to table.
+	std::vector<result> run(std::string const& filter, std::FILE* table) const
+	{
+		std::vector<result> results;
+		std::fprintf(table, "%-40s %14s %14s %12s %14s\n",
+			"benchmark", "time (ns)", "cpu (ns)", "iterations", "items/s");
+
+		for (benchmark const& b : benchmarks_)
+			for (std::vector<long> const& arguments : b.get_argument_sets())
+			{
+				std::string name = b.get_name();
+				for (long a : arguments)
+					name += "/" + std::to_string(a);
+				if (name.find(filter) == std::string::npos)
+					continue;
+
+				results.push_back(run_one(name, b.get_function(), arguments));
+				result const& r = results.back();
+				std::fprintf(table, "%-40s %14.0f %14.0f %12zu %14.4g\n",
+					r.name.c_str(), r.real_ns, r.cpu_ns, r.iterations, r.items_per_second);
+				std::fflush(table);
+			}
+
+		return results;
+	}
+
+	static bool write_json(
+		std::string const& path, std::string const& executable, std::vector<result> const& results
+	)
+	{
+		std::time_t now = std::time(nullptr);
+		char date[32];
+		std::strftime(date, sizeof date, "%Y-%m-%dT%H:%M:%S%z", std::localtime(&now));
+
+		std::ostringstream out;
+		out << std::setprecision(10)
+		    << "{\n"
+		    << "  \"context\": {\n"
+		    << "    \"date\": \"" << date << "\",\n"
+		    << "    \"executable\": \"" << executable << "\",\n"
+		    << "    \"num_cpus\": " << std::thread::hardware_concurrency() << ",\n"
+#ifdef NDEBUG
+		    << "    \"library_build_type\": \"release\"\n"
+#else
+		    << "    \"library_build_type\": \"debug\"\n"
+#endif
+		    << "  },\n"
+		    << "  \"benchmarks\": [\n";
+
+		for (std::size_t i = 0; i < results.size(); ++i)
+		{
+			result const& r = results[i];
+			out << "    {\n"
+			    << "      \"name\": \"" << r.name << "\",\n"
+			    << "      \"run_name\": \"" << r.name << "\",\n"
+			    << "      \"run_type\": \"iteration\",\n"
+			    << "      \"iterations\": " << r.iterations << ",\n"
+			    << "      \"real_time\": " << r.real_ns << ",\n"
+			    << "      \"cpu_time\": " << r.cpu_ns << ",\n"
+			    << "      \"time_unit\": \"ns\"";
+			if (r.items_per_second > 0.0)
+				out << ",\n      \"items_per_second\": " << r.items_per_second;
+			if (r.bytes_per_second > 0.0)
+				out << ",\n      \"bytes_per_second\": " << r.bytes_per_second;
+			out << "\n    }" << (i + 1 < results.size() ? "," : "") << "\n";
+		}
+		out << "  ]\n}\n";
+
+		if (path == "-")
+		{
+			std::fputs(out.str().c_str(), stdout);
+			return true;
+		}
+
+		std::ofstream file(path);
+		file << out.str();
+		return bool(file);
+	}
+
+private:
+	result run_one(
+		std::string const& name, benchmark::function_type const& function,
+		std::vector<long> const& arguments
+	) const
+	{
+		std::size_t iterations = 1;
+		for (;;)
+		{
+			state s(iterations, arguments);
+			function(s);
+
+			bool done = s.real_seconds() >= min_time_ || iterations >= (std::size_t(1) << 30);
+			if (done)
+			{
+				result r;
+				r.name = name;
+				r.iterations = iterations;
+				r.real_ns = 1e9 * s.real_seconds() / iterations;
+				r.cpu_ns = 1e9 * s.cpu_seconds() / iterations;
+				r.items_per_second = s.real_seconds() > 0.0 ? s.items_processed() / s.real_seconds() : 0.0;
+				r.bytes_per_second = s.real_seconds() > 0.0 ? s.bytes_processed() / s.real_seconds() : 0.0;
+				return r;
+			}
+
+			// Aim straight for the minimum time once there is a usable estimate.
+			double estimate = s.real_seconds() > 1e-3
+				? 1.4 * min_time_ / s.real_seconds() * iterations
+				: 10.0 * iterations;
+			iterations = std::max<std::size_t>(iterations * 2, std::size_t(estimate));
+		}
+	}
+
+	std::vector<benchmark> benchmarks_;
+	double min_time_;
+};
+
+} // namespace bench
+} // namespace graphics
+} // namespace mrr
+
+#endif // #ifndef MRR_GRAPHICS_BENCH_MICROBENCH_HXX__
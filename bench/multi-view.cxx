@@ -0,0 +1,186 @@
+// Compares the CPU cost of rendering a scene into 1 to 16 viewports by
+// calling viewport::render per view against one multi_view_renderer pass,
+// both replayed and, where supported, instanced. Every mode must produce
+// the same image as the per-view one, to within a small tolerance.
+//
+// Times are CPU time in the render calls, averaged over the frames.
+//
+// usage: multi-view [components] [frames] [shader-directory]
+
+#include <mrr/graphics/gl-common.hxx>
+#include <mrr/graphics/headless.hxx>
+#include <mrr/graphics/multiview.hxx>
+#include <mrr/graphics/offscreen.hxx>
+#include <mrr/graphics/shader_variants.hxx>
+#include <mrr/graphics/stats.hxx>
+#include <mrr/graphics/timing.hxx>
+
+#include "fixtures.hxx"
+
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+
+#define GLM_FORCE_RADIANS
+#include <glm/gtc/matrix_transform.hpp>
+
+namespace gl = ::mrr::graphics::gl;
+namespace impl = ::mrr::graphics::gl::impl;
+namespace bench = ::mrr::graphics::bench;
+
+static GLsizei const image_size = 512;
+
+// The instanced path runs another program, which may round slightly
+// differently; the tolerances are render-regression's.
+static int const channel_tolerance = 8;
+static double const pixel_tolerance = 0.001;
+
+static char const* cube_obj_path = "/tmp/mrr-multi-view-cube.obj";
+
+// A grid of views around the scene, like the panes of a CAD layout.
+static std::vector<gl::view> make_views(int count)
+{
+	int columns = int(std::ceil(std::sqrt(float(count))));
+	int rows = (count + columns - 1) / columns;
+	GLsizei width = image_size / columns;
+	GLsizei height = image_size / rows;
+
+	glm::mat4 P = glm::perspective(glm::radians(60.0f), float(width) / height, 0.1f, 500.0f);
+
+	std::vector<gl::view> views;
+	for (int i = 0; i < count; ++i)
+	{
+		float angle = 6.2831853f * i / count;
+		glm::vec3 eye(std::sin(angle) * 90.0f, 30.0f, std::cos(angle) * 90.0f);
+		views.push_back(gl::view{
+			gl::viewport((i % columns) * width, (i / columns) * height, width, height),
+			glm::lookAt(eye, glm::vec3(0, 0, 0), glm::vec3(0, 1, 0)),
+			P
+		});
+	}
+	return views;
+}
+
+int main(int argc, char* argv[])
+{
+	int component_count = argc > 1 ? std::atoi(argv[1]) : 1024;
+	int frames = argc > 2 ? std::atoi(argv[2]) : 32;
+	std::string directory = argc > 3 ? argv[3] : "/usr/local/share/mrr/graphics/shaders";
+
+	::mrr::graphics::egl::headless_context context;
+	gl::init(0.1f, 0.1f, 0.1f, 1.0f);
+	gl::vertex_array va;
+	gl::framebuffer target(image_size, image_size);
+	if (!target.is_complete())
+		return 2;
+
+	bench::write_cube(cube_obj_path);
+
+	gl::default_shader_variants() = gl::shader_variants(
+		directory + "/variant-vertex-shader.glsl", directory + "/variant-fragment-shader.glsl"
+	);
+
+	std::clog.setstate(std::ios::failbit);
+	gl::model root;
+	root.add_point_source(glm::vec3(0, 60, 40), glm::vec3(1, 1, 1), 6000.0f);
+	std::vector<std::unique_ptr<gl::component>> components;
+	int side = int(std::ceil(std::sqrt(float(component_count))));
+	for (int i = 0; i < component_count; ++i)
+	{
+		components.emplace_back(new gl::component());
+		gl::component& c = *components.back();
+		c.load_wavefront(cube_obj_path);
+		c.set_colour(glm::vec3(float(i % side) / side, float(i / side) / side, 0.5f));
+		c.set_model(glm::translate(
+			glm::mat4(1.0f), glm::vec3((i % side - side / 2) * 3.0f, 0.0f, (i / side - side / 2) * 3.0f)
+		));
+		root.add_component(c);
+		c.use_shader_variants();
+	}
+	std::clog.clear();
+
+	gl::multi_view_renderer renderer;
+	bool const instancing = gl::multi_view_renderer::is_supported();
+
+	std::printf("renderer: %s\n", context.get_renderer());
+	std::printf("components: %d, instancing: %s\n", component_count, instancing ? "yes" : "no");
+	std::printf("%6s %14s %14s %14s %10s %10s\n",
+		"views", "per view (ms)", "replayed (ms)", "instanced (ms)", "draws", "diff px");
+
+	std::vector<unsigned char> reference(std::size_t(image_size) * image_size * 4);
+	std::vector<unsigned char> pixels(reference.size());
+	int failures = 0;
+
+	for (int count : { 1, 2, 4, 8, 16 })
+	{
+		std::vector<gl::view> views = make_views(count);
+
+		enum mode { per_view, replayed, instanced };
+		double ms[3] = { 0.0, 0.0, 0.0 };
+		std::size_t draws[3] = { 0, 0, 0 };
+		std::size_t differing = 0;
+
+		for (int m = per_view; m <= instanced; ++m)
+		{
+			if (m == instanced && !instancing)
+				continue;
+			renderer.set_instancing(m == instanced);
+
+			for (int frame = -1; frame < frames; ++frame)
+			{
+				target.bind();
+				::glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+				va.bind();
+
+				auto start = std::chrono::steady_clock::now();
+				if (m == per_view)
+					for (gl::view const& v : views)
+						v.area.render(root, v.V, v.P);
+				else
+					renderer.render(root, views);
+				double frame_ms = impl::elapsed_ms(start);
+				::glFinish();
+
+				// The first frame compiles the variants.
+				if (frame >= 0)
+				{
+					ms[m] += frame_ms;
+					draws[m] = gl::frame_stats().draw_calls;
+				}
+				gl::next_frame_stats();
+			}
+
+			target.bind();
+			::glReadPixels(0, 0, image_size, image_size, GL_RGBA, GL_UNSIGNED_BYTE, pixels.data());
+			if (m == per_view)
+				reference = pixels;
+
+			for (std::size_t i = 0; i < pixels.size(); i += 4)
+				for (std::size_t c = 0; c < 3; ++c)
+					if (std::abs(int(pixels[i + c]) - int(reference[i + c])) > channel_tolerance)
+					{
+						++differing;
+						break;
+					}
+		}
+		failures += differing > pixel_tolerance * image_size * image_size;
+
+		std::printf("%6d %14.3f %14.3f %14.3f %10zu %10zu\n",
+			count, ms[per_view] / frames, ms[replayed] / frames, ms[instanced] / frames,
+			instancing ? draws[instanced] : draws[replayed], differing);
+	}
+
+	gl::default_shader_variants().clear();
+
+	if (failures > 0)
+	{
+		std::cerr << failures << " view counts rendered differently.\n";
+		return 1;
+	}
+	return 0;
+}
@@ -0,0 +1,220 @@
+// Walks a camera through a plant of walled rooms full of equipment and
+// renders it with every occlusion_culler backend, reporting culled counts
+// and frame times against frustum culling alone. The last frame of every
+// backend is compared with the frustum culled one; culling must not change
+// the image.
+//
+// Frame times are CPU time in render() and the time to glFinish(), averaged
+// over the walk.
+//
+// usage: occlusion-culling [rooms-per-side] [frames] [shader-directory]
+
+#include <mrr/graphics/gl-common.hxx>
+#include <mrr/graphics/headless.hxx>
+#include <mrr/graphics/occlusion.hxx>
+#include <mrr/graphics/offscreen.hxx>
+#include <mrr/graphics/stats.hxx>
+
+#include "fixtures.hxx"
+
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+
+#define GLM_FORCE_RADIANS
+#include <glm/gtc/matrix_transform.hpp>
+
+namespace gl = ::mrr::graphics::gl;
+namespace bench = ::mrr::graphics::bench;
+
+static GLsizei const image_width = 512;
+static GLsizei const image_height = 256;
+static float const room_size = 20.0f;
+static float const door_width = 3.0f;
+static float const wall_height = 4.0f;
+
+static char const* cube_obj_path = "/tmp/mrr-occlusion-culling-cube.obj";
+
+struct plant
+{
+	gl::model root;
+	std::vector<std::unique_ptr<gl::component>> components;
+	std::size_t walls;
+};
+
+static void add_box(
+	plant& p, gl::shader_handle const& shader, glm::vec3 const& lower, glm::vec3 const& size,
+	glm::vec3 const& colour
+)
+{
+	p.components.emplace_back(new gl::component());
+	gl::component& c = *p.components.back();
+	c.set_shader(shader);
+	c.load_wavefront(cube_obj_path);
+	c.set_colour(colour);
+	c.set_model(glm::scale(glm::translate(glm::mat4(1.0f), lower), size));
+	p.root.add_component(c);
+}
+
+// Rooms on the x-z plane, with a door in the middle of every wall, and a
+// grid of 4x4 pieces of equipment in each.
+static void build_plant(plant& p, gl::shader_handle const& shader, int rooms)
+{
+	p.root.set_shader(shader);
+	p.root.add_point_source(glm::vec3(0, 50, 0), glm::vec3(1, 1, 1), 20000.0f);
+
+	float const segment = (room_size - door_width) / 2;
+	float const thickness = 0.3f;
+	glm::vec3 const wall_colour(0.6f, 0.6f, 0.55f);
+
+	for (int line = 0; line <= rooms; ++line)
+		for (int room = 0; room < rooms; ++room)
+		{
+			float along = room * room_size;
+			float across = line * room_size;
+			for (float offset : { 0.0f, segment + door_width })
+			{
+				add_box(p, shader, glm::vec3(along + offset, 0, across),
+					glm::vec3(segment, wall_height, thickness), wall_colour);
+				add_box(p, shader, glm::vec3(across, 0, along + offset),
+					glm::vec3(thickness, wall_height, segment), wall_colour);
+			}
+		}
+	p.walls = p.components.size();
+
+	for (int room = 0; room < rooms * rooms; ++room)
+		for (int i = 0; i < 16; ++i)
+		{
+			glm::vec3 lower(
+				(room % rooms) * room_size + 3.0f + (i % 4) * 4.0f,
+				0.0f,
+				(room / rooms) * room_size + 3.0f + (i / 4) * 4.0f
+			);
+			add_box(p, shader, lower, glm::vec3(1.5f, 1.0f + (i % 3), 1.5f),
+				glm::vec3(0.2f + 0.2f * (i % 4), 0.4f, 0.8f - 0.2f * (i / 4)));
+		}
+}
+
+// Along the middle of the first row of rooms, through its doors, turning
+// back and forth.
+static glm::mat4 camera(int frame, int frames, int rooms)
+{
+	float t = float(frame) / frames;
+	glm::vec3 eye(room_size * 0.5f + t * (rooms - 1) * room_size, 1.7f, room_size * 0.5f);
+	float yaw = 0.6f * std::sin(t * 12.0f);
+	glm::vec3 forward(std::cos(yaw), 0.0f, std::sin(yaw));
+	return glm::lookAt(eye, eye + forward, glm::vec3(0, 1, 0));
+}
+
+int main(int argc, char* argv[])
+{
+	int rooms = argc > 1 ? std::atoi(argv[1]) : 8;
+	int frames = argc > 2 ? std::atoi(argv[2]) : 120;
+	std::string directory = argc > 3 ? argv[3] : "/usr/local/share/mrr/graphics/shaders";
+
+	::mrr::graphics::egl::headless_context context;
+	gl::init(0.1f, 0.1f, 0.1f, 1.0f);
+	gl::vertex_array va;
+	gl::framebuffer target(image_width, image_height);
+	if (!target.is_complete())
+		return 2;
+
+	bench::write_cube(cube_obj_path, 0.0f, 1.0f);
+
+	std::clog.setstate(std::ios::failbit);
+	gl::shader_handle shader(
+		directory + "/colour-vertex-shader.glsl", directory + "/colour-fragment-shader.glsl"
+	);
+	gl::shader_handle box_shader(
+		directory + "/occlusion-box-vertex-shader.glsl", directory + "/occlusion-box-fragment-shader.glsl"
+	);
+	plant p;
+	build_plant(p, shader, rooms);
+	std::clog.clear();
+
+	glm::mat4 const P = glm::perspective(
+		glm::radians(70.0f), float(image_width) / image_height, 0.1f, 500.0f
+	);
+
+	struct backend
+	{
+		char const* name;
+		gl::occlusion_backend value;
+	};
+	backend const backends[] = {
+		{ "frustum", gl::occlusion_backend::none },
+		{ "hi-z", gl::occlusion_backend::depth_pyramid },
+		{ "queries", gl::occlusion_backend::queries },
+	};
+
+	std::printf("renderer: %s\n", context.get_renderer());
+	std::printf("components: %zu (%zu walls)\n", p.components.size(), p.walls);
+	std::printf("%-10s %10s %10s %10s %10s %10s %10s %10s\n",
+		"backend", "cpu (ms)", "frame (ms)", "cull (ms)", "draws", "frustum", "occluded", "diff px");
+
+	std::vector<unsigned char> reference(std::size_t(image_width) * image_height * 4);
+	std::vector<unsigned char> pixels(reference.size());
+	int failures = 0;
+
+	for (backend const& b : backends)
+	{
+		gl::occlusion_culler culler(b.value);
+		culler.set_box_shader(box_shader);
+		target.bind();
+
+		double cpu_ms = 0.0, frame_ms = 0.0, cull_ms = 0.0;
+		std::size_t draws = 0, frustum_culled = 0, occluded = 0;
+
+		for (int frame = -1; frame < frames; ++frame)
+		{
+			glm::mat4 V = camera(std::max(frame, 0), frames, rooms);
+
+			auto start = std::chrono::steady_clock::now();
+			::glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+			va.bind();
+			culler.render(p.root, V, P);
+			auto submitted = std::chrono::steady_clock::now();
+			::glFinish();
+			auto finished = std::chrono::steady_clock::now();
+
+			// The first frame warms up, as do the queries.
+			if (frame >= 0)
+			{
+				cpu_ms += std::chrono::duration<double, std::milli>(submitted - start).count();
+				frame_ms += std::chrono::duration<double, std::milli>(finished - start).count();
+				cull_ms += culler.get_stats().cull_ms;
+				draws += gl::frame_stats().draw_calls;
+				frustum_culled += culler.get_stats().frustum_culled;
+				occluded += culler.get_stats().occluded;
+			}
+			gl::next_frame_stats();
+		}
+
+		::glReadPixels(0, 0, image_width, image_height, GL_RGBA, GL_UNSIGNED_BYTE, pixels.data());
+		if (b.value == gl::occlusion_backend::none)
+			reference = pixels;
+
+		std::size_t differing = 0;
+		for (std::size_t i = 0; i < pixels.size(); i += 4)
+			differing += pixels[i] != reference[i] || pixels[i + 1] != reference[i + 1]
+				|| pixels[i + 2] != reference[i + 2];
+		failures += differing > 0;
+
+		std::printf("%-10s %10.3f %10.3f %10.3f %10.1f %10.1f %10.1f %10zu\n",
+			b.name, cpu_ms / frames, frame_ms / frames, cull_ms / frames,
+			double(draws) / frames, double(frustum_culled) / frames, double(occluded) / frames,
+			differing);
+	}
+
+	if (failures > 0)
+	{
+		std::cerr << failures << " backends changed the image.\n";
+		return 1;
+	}
+	return 0;
+}
@@ -0,0 +1,211 @@
+// Picks a grid of cursor positions over a terrain mesh scattered with
+// boxes, by brute force over every triangle and with a picker, one ray at a
+// time and in packets. Every hit must match brute force.
+//
+// usage: picking [terrain-resolution] [boxes-per-side] [rays-per-side]
+
+#include <mrr/graphics/gl-common.hxx>
+#include <mrr/graphics/headless.hxx>
+#include <mrr/graphics/picking.hxx>
+#include <mrr/graphics/timing.hxx>
+
+#include "fixtures.hxx"
+
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <vector>
+
+#define GLM_FORCE_RADIANS
+#include <glm/gtc/matrix_transform.hpp>
+
+namespace gl = ::mrr::graphics::gl;
+namespace impl = ::mrr::graphics::gl::impl;
+namespace bench = ::mrr::graphics::bench;
+
+static char const* terrain_obj_path = "/tmp/mrr-picking-terrain.obj";
+static char const* cube_obj_path = "/tmp/mrr-picking-cube.obj";
+
+static float height(float x, float z)
+{
+	return 2.0f * std::sin(x * 0.3f) * std::cos(z * 0.2f);
+}
+
+// A resolution by resolution grid of quads over [-50, 50] on x-z.
+static void write_terrain(char const* path, int resolution)
+{
+	std::ofstream out(path);
+	float step = 100.0f / resolution;
+	for (int z = 0; z <= resolution; ++z)
+		for (int x = 0; x <= resolution; ++x)
+		{
+			float px = -50.0f + x * step, pz = -50.0f + z * step;
+			out << "v " << px << ' ' << height(px, pz) << ' ' << pz << '\n';
+		}
+	out << "vt 0 0\nvn 0 1 0\n";
+
+	int row = resolution + 1;
+	for (int z = 0; z < resolution; ++z)
+		for (int x = 0; x < resolution; ++x)
+		{
+			int a = z * row + x + 1, b = a + 1, c = a + row, d = c + 1;
+			out << "f " << a << "/1/1 " << c << "/1/1 " << b << "/1/1\n"
+			    << "f " << b << "/1/1 " << c << "/1/1 " << d << "/1/1\n";
+		}
+}
+
+// Every triangle of every component, as the tool did before.
+static gl::ray_hit brute_force(
+	std::vector<std::unique_ptr<gl::component>> const& components, gl::ray const& r
+)
+{
+	gl::ray_hit hit;
+	hit.t = r.t_max;
+	for (auto const& c : components)
+	{
+		glm::mat4 inverse_model = glm::inverse(c->get_model());
+		glm::vec3 o(inverse_model * glm::vec4(r.origin, 1.0f));
+		glm::vec3 d(inverse_model * glm::vec4(r.direction, 0.0f));
+
+		std::vector<glm::vec3> const& v = c->get_vertices();
+		std::vector<unsigned int> const& indices = c->get_indices();
+		for (std::size_t t = 0; t < indices.size() / 3; ++t)
+		{
+			glm::vec3 v0 = v[indices[3 * t]];
+			glm::vec3 e1 = v[indices[3 * t + 1]] - v0, e2 = v[indices[3 * t + 2]] - v0;
+			glm::vec3 p = glm::cross(d, e2);
+			float det = glm::dot(e1, p);
+			if (det == 0.0f)
+				continue;
+			glm::vec3 s = o - v0;
+			float u = glm::dot(s, p) / det;
+			glm::vec3 q = glm::cross(s, e1);
+			float w = glm::dot(d, q) / det;
+			float distance = glm::dot(e2, q) / det;
+			if (u >= 0.0f && w >= 0.0f && u + w <= 1.0f && distance >= r.t_min && distance < hit.t)
+			{
+				hit.target = c.get();
+				hit.triangle = t;
+				hit.t = distance;
+				hit.barycentrics = glm::vec2(u, w);
+			}
+		}
+	}
+	return hit;
+}
+
+static bool same_hit(gl::ray_hit const& a, gl::ray_hit const& b)
+{
+	if (a.target != b.target)
+		return false;
+	if (a.target == nullptr)
+		return true;
+	// Ties between triangles sharing an edge may go either way.
+	return a.triangle == b.triangle || std::fabs(a.t - b.t) <= 1e-5f * std::fabs(a.t);
+}
+
+int main(int argc, char* argv[])
+{
+	int resolution = argc > 1 ? std::atoi(argv[1]) : 512;
+	int boxes = argc > 2 ? std::atoi(argv[2]) : 32;
+	int rays_per_side = argc > 3 ? std::atoi(argv[3]) : 64;
+
+	::mrr::graphics::egl::headless_context context;
+	gl::init(0.1f, 0.1f, 0.1f, 1.0f);
+
+	write_terrain(terrain_obj_path, resolution);
+	bench::write_cube(cube_obj_path);
+
+	std::clog.setstate(std::ios::failbit);
+	gl::model root;
+	std::vector<std::unique_ptr<gl::component>> components;
+	components.emplace_back(new gl::component());
+	components.back()->load_wavefront(terrain_obj_path);
+	root.add_component(*components.back());
+
+	for (int i = 0; i < boxes * boxes; ++i)
+	{
+		float x = -45.0f + 90.0f * (i % boxes) / boxes, z = -45.0f + 90.0f * (i / boxes) / boxes;
+		components.emplace_back(new gl::component());
+		gl::component& c = *components.back();
+		c.load_wavefront(cube_obj_path);
+		c.set_model(glm::rotate(
+			glm::translate(glm::mat4(1.0f), glm::vec3(x, height(x, z) + 1.0f, z)),
+			0.1f * i, glm::vec3(0, 1, 0)
+		));
+		root.add_component(c);
+	}
+	std::clog.clear();
+
+	std::size_t triangles = 0;
+	for (auto const& c : components)
+		triangles += c->get_indices().size() / 3;
+
+	gl::picker picker;
+	auto start = std::chrono::steady_clock::now();
+	picker.update(root);
+	double build_ms = impl::elapsed_ms(start);
+
+	// Rebuilding only the top level, with every mesh cached.
+	start = std::chrono::steady_clock::now();
+	picker.update(root);
+	double refresh_ms = impl::elapsed_ms(start);
+
+	gl::mesh_bvh const& terrain = *picker.get_mesh_bvh(*components.front());
+
+	std::printf("components: %zu, triangles: %zu\n", components.size(), triangles);
+	std::printf("terrain bvh: %zu nodes, depth %zu\n", terrain.get_node_count(), terrain.get_depth());
+	std::printf("build: %.3f ms, update with meshes cached: %.3f ms\n", build_ms, refresh_ms);
+
+	float const width = 1280.0f, window_height = 720.0f;
+	glm::mat4 V = glm::lookAt(glm::vec3(0, 40, 70), glm::vec3(0, 0, 0), glm::vec3(0, 1, 0));
+	glm::mat4 P = glm::perspective(glm::radians(60.0f), width / window_height, 0.1f, 500.0f);
+
+	std::vector<gl::ray> rays;
+	for (int y = 0; y < rays_per_side; ++y)
+		for (int x = 0; x < rays_per_side; ++x)
+			rays.push_back(gl::pick_ray(
+				(x + 0.5f) * width / rays_per_side, (y + 0.5f) * window_height / rays_per_side,
+				width, window_height, V, P
+			));
+
+	// Brute force is slow, so only every 64th ray.
+	std::size_t const brute_stride = 64;
+	std::vector<gl::ray_hit> expected;
+	start = std::chrono::steady_clock::now();
+	for (std::size_t i = 0; i < rays.size(); i += brute_stride)
+		expected.push_back(brute_force(components, rays[i]));
+	double brute_us = impl::elapsed_ms(start) * 1000.0 / expected.size();
+
+	std::vector<gl::ray_hit> single(rays.size());
+	start = std::chrono::steady_clock::now();
+	for (std::size_t i = 0; i < rays.size(); ++i)
+		single[i] = picker.intersect(rays[i]);
+	double single_us = impl::elapsed_ms(start) * 1000.0 / rays.size();
+
+	std::vector<gl::ray_hit> packets(rays.size());
+	start = std::chrono::steady_clock::now();
+	picker.intersect(rays.data(), packets.data(), rays.size());
+	double packet_us = impl::elapsed_ms(start) * 1000.0 / rays.size();
+
+	std::size_t hits = 0, mismatches = 0;
+	for (std::size_t i = 0; i < rays.size(); ++i)
+	{
+		hits += single[i].target != nullptr;
+		mismatches += !same_hit(single[i], packets[i]);
+		if (i % brute_stride == 0)
+			mismatches += !same_hit(single[i], expected[i / brute_stride]);
+	}
+
+	std::printf("%-12s %12s\n", "query", "us per ray");
+	std::printf("%-12s %12.3f\n", "brute force", brute_us);
+	std::printf("%-12s %12.3f\n", "bvh", single_us);
+	std::printf("%-12s %12.3f\n", "bvh packets", packet_us);
+	std::printf("rays: %zu, hits: %zu, mismatches: %zu\n", rays.size(), hits, mismatches);
+
+	return mismatches == 0 ? 0 : 1;
+}
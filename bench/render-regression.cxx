@@ -0,0 +1,389 @@
+// Renders canonical scenes headlessly through component::render and checks
+// them against golden images and performance baselines recorded by an
+// earlier run:
+//
+//   <golden-directory>/<scenario>.ppm    the last frame
+//   <golden-directory>/<scenario>.stats  draw calls, state changes and CPU
+//                                        frame time
+//
+// A scenario fails if more than 0.1% of its pixels differ from the golden
+// image by more than 8 in any channel, if it issues more draw calls or state
+// changes than its baseline, or if its CPU frame time exceeds the baseline
+// by more than half, or if its goldens are missing. Goldens are only
+// recorded with --update. The image of a failing scenario is kept as
+// <scenario>.actual.ppm.
+//
+// Goldens depend on the rasterizer; record and check them on the same one,
+// e.g. with LIBGL_ALWAYS_SOFTWARE=true for Mesa's llvmpipe.
+//
+// usage: render-regression [--update] <golden-directory> [shader-directory]
+
+#include <mrr/graphics/clustered.hxx>
+#include <mrr/graphics/gl-common.hxx>
+#include <mrr/graphics/headless.hxx>
+#include <mrr/graphics/offscreen.hxx>
+#include <mrr/graphics/stats.hxx>
+
+#include "fixtures.hxx"
+
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+
+#define GLM_FORCE_RADIANS
+#include <glm/gtc/matrix_transform.hpp>
+
+namespace gl = ::mrr::graphics::gl;
+namespace bench = ::mrr::graphics::bench;
+
+static GLsizei const image_size = 256;
+static int const frames = 32;
+static int const channel_tolerance = 8;
+static double const pixel_tolerance = 0.001;
+static double const time_tolerance = 1.5;
+
+static char const* cube_obj_path = "/tmp/mrr-render-regression-cube.obj";
+static char const* checker_dds_path = "/tmp/mrr-render-regression-checker.dds";
+
+// A 64x64 BC1 checkerboard of solid 4x4 blocks, one mip level.
+static void write_checker(char const* path)
+{
+	std::uint32_t const size = 64;
+	std::vector<std::uint32_t> header(32, 0);
+	std::memcpy(&header[0], "DDS ", 4);
+	header[1] = 124;
+	header[2] = 0x1 | 0x2 | 0x4 | 0x1000 | 0x80000;
+	header[3] = size;
+	header[4] = size;
+	header[5] = size * size / 2;
+	header[19] = 32;
+	header[20] = 0x4;
+	std::memcpy(&header[21], "DXT1", 4);
+	header[27] = 0x1000;
+
+	std::ofstream out(path, std::ios::binary);
+	out.write(reinterpret_cast<char const*>(header.data()), header.size() * 4);
+
+	for (std::uint32_t y = 0; y < size / 4; ++y)
+		for (std::uint32_t x = 0; x < size / 4; ++x)
+		{
+			std::uint16_t colour = ((x / 2 + y / 2) % 2) ? 0xffff : 0xf800;
+			std::uint16_t block[4] = { colour, colour, 0, 0 };
+			out.write(reinterpret_cast<char const*>(block), sizeof(block));
+		}
+}
+
+static bool read_ppm(
+	std::string const& path, GLsizei& width, GLsizei& height, std::vector<unsigned char>& rgb
+)
+{
+	std::ifstream in(path, std::ios::binary);
+	std::string magic;
+	int max_value;
+	if (!(in >> magic >> width >> height >> max_value) || magic != "P6" || max_value != 255)
+		return false;
+	in.get();
+
+	rgb.resize(std::size_t(width) * height * 3);
+	return bool(in.read(reinterpret_cast<char*>(rgb.data()), rgb.size()));
+}
+
+
+//m=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-
+struct scene
+{
+	gl::model root;
+	std::vector<std::unique_ptr<gl::component>> components;
+	std::unique_ptr<gl::light_clusters> clusters;
+	glm::mat4 V;
+};
+
+struct scenario
+{
+	char const* name;
+	std::function<void (scene&, std::string const& shader_directory)> build;
+};
+
+static gl::component& add_cube(scene& s, gl::shader_handle const& shader, glm::vec3 const& at)
+{
+	s.components.emplace_back(new gl::component());
+	gl::component& c = *s.components.back();
+	c.set_shader(shader);
+	c.load_wavefront(cube_obj_path);
+	c.set_model(glm::translate(glm::mat4(1.0f), at));
+	s.root.add_component(c);
+	return c;
+}
+
+static void build_many_components(scene& s, std::string const& directory)
+{
+	gl::shader_handle shader(
+		directory + "/colour-vertex-shader.glsl", directory + "/colour-fragment-shader.glsl"
+	);
+	s.root.set_shader(shader);
+	s.root.add_point_source(glm::vec3(0, 30, 60), glm::vec3(1, 1, 1), 4000.0f);
+
+	int const side = 32;
+	for (int i = 0; i < side * side; ++i)
+	{
+		gl::component& c = add_cube(
+			s, shader,
+			glm::vec3((i % side - side / 2) * 3.0f, (i / side - side / 2) * 3.0f, 0.0f)
+		);
+		c.set_colour(glm::vec3(float(i % side) / side, float(i / side) / side, 0.5f));
+	}
+	s.V = glm::lookAt(glm::vec3(0, 0, 110), glm::vec3(0, 0, 0), glm::vec3(0, 1, 0));
+}
+
+static void build_many_lights(scene& s, std::string const& directory)
+{
+	gl::shader_handle shader(
+		directory + "/clustered-colour-vertex-shader.glsl",
+		directory + "/clustered-colour-fragment-shader.glsl"
+	);
+	s.root.set_shader(shader);
+
+	int const side = 16;
+	for (int i = 0; i < side * side; ++i)
+		add_cube(
+			s, shader,
+			glm::vec3((i % side - side / 2) * 3.0f, 0.0f, (i / side - side / 2) * 3.0f)
+		).set_colour(glm::vec3(0.8f, 0.8f, 0.8f));
+
+	// A deterministic grid of coloured lights just above the cubes.
+	for (int i = 0; i < side * side; ++i)
+		s.root.add_point_source(
+			glm::vec3((i % side - side / 2) * 3.0f + 1.5f, 2.5f, (i / side - side / 2) * 3.0f + 1.5f),
+			glm::vec3(i % 3 == 0, i % 3 == 1, i % 3 == 2),
+			4.0f
+		);
+
+	s.clusters.reset(new gl::light_clusters());
+	s.root.set_light_clusters(s.clusters.get());
+	s.V = glm::lookAt(glm::vec3(0, 30, 40), glm::vec3(0, 0, 0), glm::vec3(0, 1, 0));
+}
+
+static void build_textured(scene& s, std::string const& directory)
+{
+	gl::shader_handle shader(
+		directory + "/texture-vertex-shader.glsl", directory + "/texture-fragment-shader.glsl"
+	);
+	s.root.set_shader(shader);
+	s.root.add_point_source(glm::vec3(10, 20, 30), glm::vec3(1, 1, 1), 1500.0f);
+	s.root.add_point_source(glm::vec3(-20, -10, 20), glm::vec3(0.3f, 0.3f, 1), 800.0f);
+
+	int const side = 8;
+	for (int i = 0; i < side * side; ++i)
+	{
+		gl::component& c = add_cube(
+			s, shader,
+			glm::vec3((i % side - side / 2) * 3.0f, (i / side - side / 2) * 3.0f, 0.0f)
+		);
+		c.load_texture(checker_dds_path);
+		c.set_model(glm::rotate(c.get_model(), i * 0.3f, glm::vec3(1, 1, 0)));
+	}
+	s.V = glm::lookAt(glm::vec3(0, 0, 35), glm::vec3(0, 0, 0), glm::vec3(0, 1, 0));
+}
+
+
+//m=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-
+struct baseline
+{
+	std::size_t draw_calls;
+	std::size_t state_changes;
+	double cpu_ms;
+};
+
+static bool read_baseline(std::string const& path, baseline& b)
+{
+	std::ifstream in(path);
+	std::string draw_calls, state_changes, cpu_ms;
+	return bool(
+		in >> draw_calls >> b.draw_calls >> state_changes >> b.state_changes >> cpu_ms >> b.cpu_ms
+	);
+}
+
+static bool write_baseline(std::string const& path, baseline const& b)
+{
+	std::ofstream out(path);
+	out << "draw_calls " << b.draw_calls << "\n"
+	    << "state_changes " << b.state_changes << "\n"
+	    << "cpu_ms " << b.cpu_ms << "\n";
+	return bool(out);
+}
+
+// Fraction of pixels of rgba (bottom row first) that differ from the golden
+// rgb image (top row first) by more than the channel tolerance.
+static double image_difference(
+	unsigned char const* rgba, std::vector<unsigned char> const& golden,
+	GLsizei width, GLsizei height
+)
+{
+	std::size_t differing = 0;
+	for (GLsizei y = 0; y < height; ++y)
+		for (GLsizei x = 0; x < width; ++x)
+		{
+			unsigned char const* a = rgba + (std::size_t(y) * width + x) * 4;
+			unsigned char const* g = &golden[(std::size_t(height - 1 - y) * width + x) * 3];
+			for (int c = 0; c < 3; ++c)
+				if (std::abs(int(a[c]) - int(g[c])) > channel_tolerance)
+				{
+					++differing;
+					break;
+				}
+		}
+	return double(differing) / (std::size_t(width) * height);
+}
+
+int main(int argc, char* argv[])
+{
+	bool update = false;
+	std::vector<std::string> arguments;
+	for (int i = 1; i < argc; ++i)
+	{
+		if (std::strcmp(argv[i], "--update") == 0)
+			update = true;
+		else
+			arguments.push_back(argv[i]);
+	}
+
+	if (arguments.empty())
+	{
+		std::cerr << "usage: render-regression [--update] <golden-directory> [shader-directory]\n";
+		return 2;
+	}
+	std::string golden_directory = arguments[0];
+	std::string shader_directory
+		= arguments.size() > 1 ? arguments[1] : "/usr/local/share/mrr/graphics/shaders";
+
+	::mrr::graphics::egl::headless_context context;
+	gl::init(0.1f, 0.1f, 0.1f, 1.0f);
+	gl::vertex_array va;
+	gl::framebuffer target(image_size, image_size);
+	if (!target.is_complete())
+		return 2;
+
+	bench::write_cube(cube_obj_path);
+	write_checker(checker_dds_path);
+
+	std::vector<scenario> const scenarios = {
+		{ "many-components", build_many_components },
+		{ "many-lights", build_many_lights },
+		{ "textured", build_textured },
+	};
+
+	glm::mat4 const P = glm::perspective(glm::radians(60.0f), 1.0f, 0.1f, 500.0f);
+	std::vector<unsigned char> pixels(std::size_t(image_size) * image_size * 4);
+	int failures = 0;
+
+	std::printf("renderer: %s\n", context.get_renderer());
+	std::printf("%-16s %10s %10s %10s %10s %12s %10s  %s\n",
+		"scenario", "cpu (ms)", "draws", "states", "elided", "triangles", "diff (%)", "result");
+
+	for (scenario const& sc : scenarios)
+	{
+		scene s;
+		sc.build(s, shader_directory);
+		target.bind();
+
+		auto render_frame = [&] {
+			::glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+			va.bind();
+			if (s.clusters)
+				s.clusters->update(s.root, s.V, P);
+			s.root.render(s.V, P);
+		};
+
+		// The warm up frame absorbs shader compilation and uploads.
+		render_frame();
+		::glFinish();
+		gl::next_frame_stats();
+
+		double cpu_ms = 0.0;
+		for (int i = 0; i < frames; ++i)
+		{
+			auto start = std::chrono::steady_clock::now();
+			render_frame();
+			auto end = std::chrono::steady_clock::now();
+			cpu_ms += std::chrono::duration<double, std::milli>(end - start).count();
+			::glFinish();
+			gl::next_frame_stats();
+		}
+		cpu_ms /= frames;
+
+		gl::render_stats const stats = gl::previous_frame_stats();
+		baseline const measured = { stats.draw_calls, stats.state_changes, cpu_ms };
+
+		::glPixelStorei(GL_PACK_ALIGNMENT, 1);
+		::glReadPixels(0, 0, image_size, image_size, GL_RGBA, GL_UNSIGNED_BYTE, pixels.data());
+
+		std::string const prefix = golden_directory + "/" + sc.name;
+		std::string result;
+		double difference = 0.0;
+
+		GLsizei golden_width = 0, golden_height = 0;
+		std::vector<unsigned char> golden;
+		baseline expected;
+
+		if (update)
+		{
+			bool written = gl::write_ppm(prefix + ".ppm", pixels.data(), image_size, image_size)
+				&& write_baseline(prefix + ".stats", measured);
+			result = written ? "recorded" : "FAILED (cannot record)";
+			failures += !written;
+		}
+		else if (!read_ppm(prefix + ".ppm", golden_width, golden_height, golden)
+		         || !read_baseline(prefix + ".stats", expected))
+		{
+			result = "FAILED (no golden, record with --update)";
+			gl::write_ppm(prefix + ".actual.ppm", pixels.data(), image_size, image_size);
+			++failures;
+		}
+		else if (golden_width != image_size || golden_height != image_size)
+		{
+			result = "FAILED (golden size)";
+			++failures;
+		}
+		else
+		{
+			difference = image_difference(pixels.data(), golden, image_size, image_size);
+
+			if (difference > pixel_tolerance)
+				result += " image";
+			if (measured.draw_calls > expected.draw_calls)
+				result += " draw-calls";
+			if (measured.state_changes > expected.state_changes)
+				result += " state-changes";
+			if (measured.cpu_ms > expected.cpu_ms * time_tolerance)
+				result += " cpu-time";
+
+			if (result.empty())
+			{
+				result = "ok";
+				std::remove((prefix + ".actual.ppm").c_str());
+			}
+			else
+			{
+				result = "FAILED (" + result.substr(1) + ")";
+				gl::write_ppm(prefix + ".actual.ppm", pixels.data(), image_size, image_size);
+				++failures;
+			}
+		}
+
+		std::printf("%-16s %10.3f %10zu %10zu %10zu %12zu %10.3f  %s\n",
+			sc.name, cpu_ms, stats.draw_calls, stats.state_changes, stats.state_changes_elided,
+			stats.triangles_submitted, 100.0 * difference, result.c_str());
+	}
+
+	std::remove(cube_obj_path);
+	std::remove(checker_dds_path);
+	return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,207 @@
+// Builds a scene of many components through load_wavefront, set_shader,
+// add_component and add_point_source as an application would, saves a
+// snapshot of it, and loads the snapshot once with the file evicted from the
+// page cache and once with it cached. The loaded scene must render the same
+// image and behave the same under its waypoints as the built one.
+//
+// usage: scene-snapshot [components] [shader-directory]
+
+#include <mrr/graphics/gl-common.hxx>
+#include <mrr/graphics/headless.hxx>
+#include <mrr/graphics/offscreen.hxx>
+#include <mrr/graphics/pool.hxx>
+#include <mrr/graphics/scene.hxx>
+#include <mrr/graphics/timing.hxx>
+#include <mrr/graphics/waypoint.hxx>
+
+#include "fixtures.hxx"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <tuple>
+#include <vector>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#define GLM_FORCE_RADIANS
+#include <glm/gtc/matrix_transform.hpp>
+
+namespace gl = ::mrr::graphics::gl;
+namespace impl = ::mrr::graphics::gl::impl;
+namespace bench = ::mrr::graphics::bench;
+
+static GLsizei const image_size = 256;
+static char const* snapshot_path = "/tmp/mrr-scene-snapshot.scene";
+static char const* terrain_obj_path = "/tmp/mrr-scene-snapshot-terrain-%d.obj";
+
+// Drops the file from the page cache, so that the next load reads the disk.
+static void evict(char const* path)
+{
+	int fd = ::open(path, O_RDONLY);
+	if (fd < 0)
+		return;
+	::fdatasync(fd);
+	::posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+	::close(fd);
+}
+
+// What can be compared between two trees whose children are in different
+// orders: every component's state, sorted.
+typedef std::tuple<float, float, float, GLsizei, std::size_t, std::size_t, std::size_t, float, float> component_signature;
+
+static void collect(gl::model const& m, std::vector<component_signature>& out)
+{
+	if (auto* c = dynamic_cast<gl::component const*>(&m))
+	{
+		glm::vec3 const& l = c->get_location();
+		out.push_back(component_signature(
+			l.x, l.y, l.z, c->get_vertex_count(), c->get_lod_count(), c->get_indices().size(), c->get_tangents().size(),
+			c->get_colour().x + c->get_colour().y + c->get_colour().z,
+			c->get_point_source_powers().empty() ? 0.0f : c->get_point_source_powers().back()
+		));
+	}
+	for (gl::model* child : m.get_components())
+		collect(*child, out);
+}
+
+static std::vector<component_signature> signature(gl::model const& root)
+{
+	std::vector<component_signature> s;
+	collect(root, s);
+	std::sort(s.begin(), s.end());
+	return s;
+}
+
+int main(int argc, char* argv[])
+{
+	int count = argc > 1 ? std::atoi(argv[1]) : 500;
+	std::string directory = argc > 2 ? argv[2] : "/usr/local/share/mrr/graphics/shaders";
+
+	::mrr::graphics::egl::headless_context context;
+	gl::init(0.1f, 0.1f, 0.1f, 1.0f);
+	gl::vertex_array va;
+	va.bind();
+	gl::framebuffer target(image_size, image_size);
+	if (!target.is_complete())
+		return 1;
+
+	int const resolutions[] = { 8, 16, 24, 32 };
+	for (int resolution : resolutions)
+		bench::write_terrain(bench::terrain_path(terrain_obj_path, resolution), resolution);
+
+	gl::scene_actions actions;
+	actions.add("sink", [](gl::component& c) {
+		c.update_model(glm::translate(glm::mat4(1.0f), glm::vec3(0.0f, -0.05f, 0.0f)));
+	});
+	actions.add("spin", [](gl::component& c) {
+		c.apply_fp_transformation(glm::rotate(glm::mat4(1.0f), 0.1f, glm::vec3(0, 1, 0)));
+	});
+
+	// The scene as an application builds it.
+	std::clog.setstate(std::ios::failbit);
+	auto start = std::chrono::steady_clock::now();
+
+	gl::node_pool<gl::model> models;
+	gl::node_pool<gl::component> components;
+	gl::model& root = *models.create();
+	gl::shader_handle shader(directory + "/colour-vertex-shader.glsl", directory + "/colour-fragment-shader.glsl");
+	root.set_shader(shader);
+	root.set_ambient_light_colour(glm::vec3(0.2f, 0.2f, 0.2f));
+	root.add_point_source(glm::vec3(0, 30, 30), glm::vec3(1, 1, 1), 1500.0f);
+
+	std::vector<gl::waypoint> waypoints;
+	gl::model* group = nullptr;
+	int const side = int(std::ceil(std::sqrt(double(count))));
+	for (int i = 0; i < count; ++i)
+	{
+		if (i % 32 == 0)
+		{
+			group = models.create();
+			group->set_shader(shader);
+			root.add_component(*group);
+			group->add_point_source(glm::vec3(i % 7, 10, i % 5), glm::vec3(1, 0.5f, 0.2f), 50.0f + i);
+		}
+
+		gl::component& c = *components.create();
+		c.set_shader(shader);
+		c.load_wavefront(bench::terrain_path(terrain_obj_path, resolutions[i % 4]));
+		if (i % 8 == 3)
+			c.set_vertex_format(gl::vertex_format::quantized);
+		if (i % 16 == 5)
+			c.generate_lods(3);
+		if (i % 16 == 9)
+			c.generate_tangents();
+		c.set_colour(glm::vec3(0.2f + 0.6f * (i % 5) / 4.0f, 0.5f, 0.8f - 0.6f * (i % 3) / 2.0f));
+		c.set_model(glm::translate(glm::mat4(1.0f), glm::vec3((i % side - side / 2) * 2.5f, 0.0f, (i / side - side / 2) * 2.5f)));
+		c.set_init_model(c.get_model());
+		c.save();
+		group->add_component(c);
+
+		if (i % 10 == 0)
+		{
+			waypoints.push_back(gl::waypoint(c.get_location(), 1.0));
+			waypoints.back().add_action(c, actions.get(i % 20 == 0 ? "sink" : "spin"));
+		}
+	}
+	double build_ms = impl::elapsed_ms(start);
+	std::clog.clear();
+
+	gl::scene_save_report saved;
+	if (!gl::save_scene(snapshot_path, root, waypoints, &saved))
+		return 1;
+
+	evict(snapshot_path);
+	gl::scene cold, warm;
+	gl::scene_load_report cold_report, warm_report;
+	if (!gl::load_scene(snapshot_path, cold, actions, &cold_report)
+	    || !gl::load_scene(snapshot_path, warm, actions, &warm_report))
+		return 1;
+
+	std::printf("%-10s %10s %10s %10s %10s %10s %10s\n",
+	            "", "total (ms)", "map (ms)", "shader", "upload", "texture", "resident");
+	std::printf("%-10s %10.1f\n", "build", build_ms);
+	std::printf("%-10s %10.1f %10s %10s %10s %10s %10s  (%zu bytes, %zu meshes, %zu shared)\n",
+	            "save", saved.save_ms, "-", "-", "-", "-", "-", saved.bytes, saved.meshes, saved.shared_meshes);
+	for (auto const& row : { std::make_pair("cold load", &cold_report), std::make_pair("warm load", &warm_report) })
+		std::printf("%-10s %10.1f %10.2f %10.1f %10.1f %10.1f %9.0f%%\n",
+		            row.first, row.second->total_ms, row.second->map_ms, row.second->shader_ms,
+		            row.second->upload_ms, row.second->texture_ms, row.second->resident * 100.0);
+	std::printf("speedup: %.1fx cold, %.1fx warm\n", build_ms / cold_report.total_ms, build_ms / warm_report.total_ms);
+
+	// The loaded scene must match the built one, before and after its
+	// waypoints have acted.
+	glm::mat4 P = glm::perspective(glm::radians(60.0f), 1.0f, 0.1f, 500.0f);
+	glm::mat4 V = glm::lookAt(glm::vec3(0, 40, 60), glm::vec3(0, 0, 0), glm::vec3(0, 1, 0));
+	bool same = true;
+	for (int step = 0; step < 2; ++step)
+	{
+		std::vector<unsigned char> expected = bench::render(target, root, V, P);
+		std::vector<unsigned char> actual = bench::render(target, *warm.get_root(), V, P);
+		std::size_t differing = 0;
+		for (std::size_t p = 0; p < expected.size(); p += 4)
+			differing += !std::equal(expected.begin() + p, expected.begin() + p + 4, actual.begin() + p);
+
+		bool state = signature(root) == signature(*warm.get_root());
+		std::printf("%s: %zu differing pixels, component state %s\n",
+		            step == 0 ? "loaded" : "after waypoints", differing, state ? "equal" : "DIFFERENT");
+		same = same && differing == 0 && state;
+
+		for (int i = 0; i < 10; ++i)
+		{
+			gl::process_waypoints(waypoints);
+			gl::process_waypoints(warm.get_waypoints());
+		}
+	}
+
+	for (int resolution : resolutions)
+		std::remove(bench::terrain_path(terrain_obj_path, resolution).c_str());
+	std::remove(snapshot_path);
+
+	return same ? 0 : 1;
+}
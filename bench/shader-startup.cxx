@@ -0,0 +1,97 @@
+// Measures the startup time of compiling N shader programs one at a time
+// with load_shaders against a single shader_batch. Every program is a
+// distinct variant of the variant shaders, with a unique define so that
+// neither run hits programs compiled by the other.
+//
+// Drivers with an on-disk shader cache should have it disabled for
+// meaningful numbers, e.g. MESA_SHADER_CACHE_DISABLE=true for Mesa.
+//
+// usage: shader-startup [programs] [shader-directory]
+
+#include <mrr/graphics/common.hxx>
+#include <mrr/graphics/shader.hxx>
+#include <mrr/graphics/shader_variants.hxx>
+#include <mrr/graphics/timing.hxx>
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <vector>
+
+namespace gl = ::mrr::graphics::gl;
+namespace impl = ::mrr::graphics::gl::impl;
+
+static std::string program_defines(int seed)
+{
+	// Cycle through the real feature combinations.
+	gl::shader_key key = gl::make_shader_key(
+		seed & 1, seed & 2, true, seed & 4, 1 + (seed / 8) % gl::max_variant_lights
+	);
+	return gl::get_shader_defines(key) + "#define VARIANT_SEED " + std::to_string(seed) + "\n";
+}
+
+int main(int argc, char* argv[])
+{
+	int programs = argc > 1 ? std::atoi(argv[1]) : 64;
+	std::string directory = argc > 2 ? argv[2] : "/usr/local/share/mrr/graphics/shaders";
+
+	std::string vertex_file = directory + "/variant-vertex-shader.glsl";
+	std::string fragment_file = directory + "/variant-fragment-shader.glsl";
+
+	::mrr::graphics::glfw::init();
+	::glfwWindowHint(GLFW_VISIBLE, GL_FALSE);
+	::mrr::graphics::glfw::window_handle window(64, 64, "shader-startup");
+	::mrr::graphics::glew::init();
+
+	std::clog.setstate(std::ios::failbit);
+
+	std::vector<GLuint> sequential;
+	auto start = std::chrono::steady_clock::now();
+	for (int i = 0; i < programs; ++i)
+		sequential.push_back(
+			::load_shaders(vertex_file.c_str(), fragment_file.c_str(), program_defines(i).c_str())
+		);
+	::glFinish();
+	double sequential_ms = impl::elapsed_ms(start);
+
+	start = std::chrono::steady_clock::now();
+	shader_batch batch;
+	for (int i = 0; i < programs; ++i)
+		batch.add(vertex_file, fragment_file, program_defines(programs + i));
+	batch.submit();
+	double submit_ms = impl::elapsed_ms(start);
+	std::vector<GLuint> batched = batch.finish();
+	::glFinish();
+	double batch_ms = impl::elapsed_ms(start);
+
+	std::clog.clear();
+
+	int failed = 0;
+	for (GLuint id : sequential)
+		failed += id == 0;
+	for (GLuint id : batched)
+		failed += id == 0;
+
+	std::printf("programs: %d\n", programs);
+	std::printf("parallel shader compile: %s\n",
+		GLEW_KHR_parallel_shader_compile || GLEW_ARB_parallel_shader_compile ? "yes" : "no");
+	std::printf("%-12s %12s %12s\n", "mode", "total (ms)", "per program");
+	std::printf("%-12s %12.2f %12.3f\n", "sequential", sequential_ms, sequential_ms / programs);
+	std::printf("%-12s %12.2f %12.3f\n", "batch", batch_ms, batch_ms / programs);
+	std::printf("batch submit returned after %.2f ms\n", submit_ms);
+	std::printf("speedup: %.2fx\n", sequential_ms / batch_ms);
+
+	for (GLuint id : sequential)
+		::glDeleteProgram(id);
+	for (GLuint id : batched)
+		::glDeleteProgram(id);
+
+	if (failed > 0)
+	{
+		std::cerr << failed << " programs failed to build.\n";
+		return 1;
+	}
+	return 0;
+}
@@ -0,0 +1,324 @@
+// Generates normals and tangents for a multi-million triangle grid without
+// a GL context, against a serial reference, and loads OBJ files whose faces
+// lack normals or use the other corner forms, quads, n-gons, negative
+// indices and smoothing groups. Reports how far the resident size peaks
+// above its starting point while an OBJ file is streamed, where /proc
+// allows.
+//
+// usage: tangent-space [grid-size] [obj-grid-size]
+
+#include <mrr/graphics/obj_loader.hxx>
+#include <mrr/graphics/parallel.hxx>
+#include <mrr/graphics/tangent_space.hxx>
+#include <mrr/graphics/timing.hxx>
+
+#include "fixtures.hxx"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#ifdef __GLIBC__
+#include <malloc.h>
+#endif
+
+namespace impl = ::mrr::graphics::gl::impl;
+namespace bench = ::mrr::graphics::bench;
+
+static char const* grid_obj_path = "/tmp/mrr-tangent-space-grid.obj";
+static char const* corners_obj_path = "/tmp/mrr-tangent-space-corners.obj";
+static char const* groups_obj_path = "/tmp/mrr-tangent-space-groups.obj";
+
+// A size by size grid of quads over [-1, 1] on x-z, raised to the terrain
+// height, each split from its first corner as a fan triangulated OBJ quad
+// is.
+static void make_grid(int size, std::vector<glm::vec3>& positions, std::vector<glm::vec2>& uvs, std::vector<unsigned int>& indices)
+{
+	float step = 2.0f / size;
+	for (int z = 0; z <= size; ++z)
+		for (int x = 0; x <= size; ++x)
+		{
+			float px = -1.0f + x * step, pz = -1.0f + z * step;
+			positions.push_back(glm::vec3(px, bench::terrain_height(px, pz), pz));
+			uvs.push_back(glm::vec2(x / float(size), z / float(size)));
+		}
+
+	unsigned int row = size + 1;
+	for (int z = 0; z < size; ++z)
+		for (int x = 0; x < size; ++x)
+		{
+			unsigned int a = z * row + x, b = a + 1, c = b + row, d = a + row;
+			unsigned int const quad[6] = { a, d, c, a, c, b };
+			indices.insert(indices.end(), quad, quad + 6);
+		}
+}
+
+static void write_grid(char const* path, int size)
+{
+	std::vector<glm::vec3> positions;
+	std::vector<glm::vec2> uvs;
+	std::vector<unsigned int> indices;
+	make_grid(size, positions, uvs, indices);
+
+	std::ofstream out(path);
+	for (std::size_t i = 0; i < positions.size(); ++i)
+		out << "v " << positions[i].x << ' ' << positions[i].y << ' ' << positions[i].z << '\n'
+		    << "vt " << uvs[i].x << ' ' << uvs[i].y << '\n';
+	for (std::size_t q = 0; q < indices.size(); q += 6)
+		out << "f " << indices[q] + 1 << '/' << indices[q] + 1 << ' ' << indices[q + 1] + 1 << '/' << indices[q + 1] + 1
+		    << ' ' << indices[q + 2] + 1 << '/' << indices[q + 2] + 1 << ' ' << indices[q + 5] + 1 << '/' << indices[q + 5] + 1 << '\n';
+}
+
+// One face of each corner form, a pentagon, and negative indices, all in
+// the z = 0 plane facing +z.
+static void write_corners(char const* path)
+{
+	std::ofstream out(path);
+	out << "v 0 0 0\nv 1 0 0\nv 1 1 0\nv 0 1 0\nv 2 0 0\nv 2 1 0\nv 1 -1 0\r\n"
+	       "vt 0 0\nvt 1 1\nvn 0 0 1\n"
+	       "f 1 2 3 4\n"
+	       "f 2/1 5/2 6/2 3/1\n"
+	       "f -7//1 -6//-1 -4//1\n"
+	       "f 1 7 5 6 4\r\n"
+	       "s off\n"
+	       "f 1/1/1 2/1/1 3/1/1\n";
+}
+
+// Two triangles folded at a right angle along the edge from 1 to 2, facing
+// +z and +y, in the smoothing groups given.
+static void write_groups(char const* path, char const* first, char const* second)
+{
+	std::ofstream out(path);
+	out << "v 0 0 0\nv 1 0 0\nv 0 1 0\nv 0 0 1\n"
+	    << "s " << first << "\nf 1 2 3\n"
+	    << "s " << second << "\nf 1 4 2\n";
+}
+
+// Serial scalar angle weighted normals, one per position.
+static void reference_normals(std::vector<glm::vec3> const& positions, std::vector<unsigned int> const& indices, std::vector<glm::vec3>& out)
+{
+	out.assign(positions.size(), glm::vec3(0.0f));
+	for (std::size_t t = 0; t < indices.size(); t += 3)
+	{
+		glm::vec3 const p[3] = { positions[indices[t]], positions[indices[t + 1]], positions[indices[t + 2]] };
+		glm::vec3 n = glm::cross(p[1] - p[0], p[2] - p[0]);
+		float length = glm::length(n);
+		if (length == 0.0f)
+			continue;
+		n /= length;
+
+		for (int i = 0; i < 3; ++i)
+		{
+			glm::vec3 e1 = glm::normalize(p[(i + 1) % 3] - p[i]), e2 = glm::normalize(p[(i + 2) % 3] - p[i]);
+			out[indices[t + i]] += n * std::acos(std::max(-1.0f, std::min(1.0f, glm::dot(e1, e2))));
+		}
+	}
+	for (glm::vec3& n : out)
+		n = glm::normalize(n);
+}
+
+static float angle_degrees(glm::vec3 const& a, glm::vec3 const& b)
+{
+	return std::acos(std::max(-1.0f, std::min(1.0f, glm::dot(a, b)))) * 57.2957795f;
+}
+
+static bool near(glm::vec3 const& a, glm::vec3 const& b)
+{
+	return glm::length(a - b) < 1e-3f;
+}
+
+// Kilobytes in a field of /proc/self/status, such as "VmRSS", or -1.
+static long status_kib(char const* field)
+{
+	std::ifstream in("/proc/self/status");
+	std::size_t const length = std::strlen(field);
+	std::string line;
+	while (std::getline(in, line))
+		if (line.compare(0, length, field) == 0 && line.size() > length && line[length] == ':')
+			return std::atol(line.c_str() + length + 1);
+	return -1;
+}
+
+// Lowers VmHWM, the peak resident size, to the current one (Linux 4.0 on).
+static bool reset_peak_resident()
+{
+	std::ofstream out("/proc/self/clear_refs");
+	out << "5";
+	out.flush();
+	return bool(out);
+}
+
+int main(int argc, char* argv[])
+{
+	int grid = argc > 1 ? std::atoi(argv[1]) : 1200;
+	int obj_grid = argc > 2 ? std::atoi(argv[2]) : 700;
+	bool ok = true;
+
+	std::vector<glm::vec3> positions;
+	std::vector<glm::vec2> uvs;
+	std::vector<unsigned int> indices;
+	make_grid(grid, positions, uvs, indices);
+	double const triangles = indices.size() / 3;
+	std::printf("grid: %.0f triangles, %zu vertices, %zu workers\n", triangles, positions.size(), impl::worker_count());
+
+	auto start = std::chrono::steady_clock::now();
+	std::vector<glm::vec3> reference;
+	reference_normals(positions, indices, reference);
+	double reference_ms = impl::elapsed_ms(start);
+
+	start = std::chrono::steady_clock::now();
+	std::vector<glm::vec3> normals;
+	impl::generate_normals(positions, indices, std::vector<std::uint32_t>(), normals);
+	double normals_ms = impl::elapsed_ms(start);
+
+	float normal_error = 0.0f;
+	for (std::size_t c = 0; c < indices.size(); ++c)
+		normal_error = std::max(normal_error, angle_degrees(normals[c], reference[indices[c]]));
+
+	start = std::chrono::steady_clock::now();
+	std::vector<glm::vec4> tangents;
+	impl::generate_tangents(positions, uvs, reference, indices, tangents);
+	double tangents_ms = impl::elapsed_ms(start);
+
+	float orthogonality = 0.0f, unit = 0.0f;
+	std::size_t left_handed = 0;
+	for (std::size_t v = 0; v < positions.size(); ++v)
+	{
+		glm::vec3 t(tangents[v].x, tangents[v].y, tangents[v].z);
+		orthogonality = std::max(orthogonality, std::fabs(glm::dot(t, reference[v])));
+		unit = std::max(unit, std::fabs(glm::length(t) - 1.0f));
+		left_handed += tangents[v].w < 0.0f;
+	}
+
+	std::printf("%-18s %10s %14s\n", "pass", "time (ms)", "Mtriangles/s");
+	std::printf("%-18s %10.1f %14.1f\n", "reference normals", reference_ms, triangles / reference_ms / 1000.0);
+	std::printf("%-18s %10.1f %14.1f  (%.1fx, max error %.4f degrees)\n", "generate_normals", normals_ms,
+	            triangles / normals_ms / 1000.0, reference_ms / normals_ms, normal_error);
+	std::printf("%-18s %10.1f %14.1f  (|t.n| <= %.2g, ||t| - 1| <= %.2g, %zu left handed)\n", "generate_tangents",
+	            tangents_ms, triangles / tangents_ms / 1000.0, orthogonality, unit, left_handed);
+	// v runs along +z while cross(+y, +x) is -z: every frame is left handed.
+	ok = ok && normal_error < 0.05f && orthogonality < 1e-4f && unit < 1e-4f && left_handed == positions.size();
+
+	// A quad OBJ without normals, loaded whole and streamed.
+	std::clog.setstate(std::ios::failbit);
+	write_grid(grid_obj_path, obj_grid);
+	std::vector<glm::vec3> obj_positions;
+	std::vector<glm::vec2> obj_uvs;
+	std::vector<unsigned int> obj_indices;
+	make_grid(obj_grid, obj_positions, obj_uvs, obj_indices);
+	std::vector<glm::vec3> obj_reference;
+	reference_normals(obj_positions, obj_indices, obj_reference);
+
+	impl::wavefront_counts counts;
+	std::vector<glm::vec3> loaded_vertices, loaded_normals;
+	std::vector<glm::vec2> loaded_uvs;
+	start = std::chrono::steady_clock::now();
+	bool loaded = impl::scan_wavefront(grid_obj_path, counts)
+		&& impl::load_wavefront(grid_obj_path, loaded_vertices, loaded_uvs, loaded_normals);
+	double load_ms = impl::elapsed_ms(start);
+
+	float load_error = loaded ? 0.0f : 180.0f;
+	for (std::size_t c = 0; loaded && c < obj_indices.size(); ++c)
+		load_error = std::max(load_error, angle_degrees(loaded_normals[c], obj_reference[obj_indices[c]]));
+
+	// Heap pages freed by the passes above are handed back first where the
+	// C library allows, so that the stream cannot reuse them unseen.
+#ifdef __GLIBC__
+	::malloc_trim(0);
+#endif
+	bool const measured = reset_peak_resident();
+	long const resident_before = status_kib("VmRSS");
+
+	std::size_t streamed = 0;
+	bool stream_ok = impl::stream_wavefront(grid_obj_path, counts, 1 << 14,
+		[&](glm::vec3 const*, glm::vec2 const*, glm::vec3 const* normals, std::size_t count) {
+			for (std::size_t i = 0; i < count; ++i)
+				stream_ok = stream_ok && normals[i].y > 0.0f;
+			streamed += count;
+			return true;
+		}
+	);
+	long const resident_peak = status_kib("VmHWM");
+	std::clog.clear();
+
+	std::printf("obj: %zu triangles (%zu without normals), loaded in %.1f ms, max error %.4f degrees, %zu corners streamed\n",
+	            counts.triangles, counts.triangles_without_normals, load_ms, load_error, streamed);
+	ok = ok && loaded && stream_ok
+		&& counts.triangles == obj_indices.size() / 3 && counts.triangles_without_normals == counts.triangles
+		&& loaded_vertices.size() == obj_indices.size() && streamed == obj_indices.size() && load_error < 0.05f;
+
+	double const mib = 1024.0 * 1024.0;
+	double const pool_bytes = counts.positions * sizeof(glm::vec3) + counts.uvs * sizeof(glm::vec2)
+		+ counts.normals * sizeof(glm::vec3);
+	double const expanded_bytes = 3 * counts.triangles * (2 * sizeof(glm::vec3) + sizeof(glm::vec2));
+	if (measured && resident_before >= 0 && resident_peak >= 0)
+		std::printf("stream: peak resident +%.1f MiB, pools %.1f MiB, expanded mesh %.1f MiB\n",
+		            (resident_peak - resident_before) / 1024.0, pool_bytes / mib, expanded_bytes / mib);
+	else
+		std::printf("stream: peak resident size unavailable\n");
+
+	// Every corner form, loaded whole and streamed, must face +z.
+	write_corners(corners_obj_path);
+	std::vector<glm::vec3> corner_vertices, corner_normals;
+	std::vector<glm::vec2> corner_uvs;
+	impl::wavefront_counts corner_counts;
+	std::clog.setstate(std::ios::failbit);
+	bool corners_ok = impl::scan_wavefront(corners_obj_path, corner_counts)
+		&& impl::load_wavefront(corners_obj_path, corner_vertices, corner_uvs, corner_normals)
+		&& corner_counts.triangles == 9 && corner_counts.triangles_without_normals == 7
+		&& corner_vertices.size() == 27 && corner_uvs.size() == 27;
+	for (glm::vec3 const& n : corner_normals)
+		corners_ok = corners_ok && near(n, glm::vec3(0, 0, 1));
+	corners_ok = corners_ok && impl::stream_wavefront(corners_obj_path, corner_counts, 4,
+		[&](glm::vec3 const*, glm::vec2 const*, glm::vec3 const* normals, std::size_t count) {
+			for (std::size_t i = 0; i < count; ++i)
+				corners_ok = corners_ok && near(normals[i], glm::vec3(0, 0, 1));
+			return true;
+		}
+	);
+	std::clog.clear();
+	std::printf("corner forms: %zu triangles, %s\n", corner_counts.triangles, corners_ok ? "ok" : "MISMATCH");
+	ok = ok && corners_ok;
+
+	// The corner at 1 is shared by both triangles of one group, and by
+	// neither otherwise.
+	struct group_case
+	{
+		char const* first;
+		char const* second;
+		glm::vec3 expected[2];
+	};
+	float const s = std::sqrt(0.5f);
+	group_case const cases[] = {
+		{ "1", "1", { glm::vec3(0, s, s), glm::vec3(0, s, s) } },
+		{ "1", "2", { glm::vec3(0, 0, 1), glm::vec3(0, 1, 0) } },
+		{ "off", "0", { glm::vec3(0, 0, 1), glm::vec3(0, 1, 0) } }
+	};
+	for (group_case const& g : cases)
+	{
+		write_groups(groups_obj_path, g.first, g.second);
+		std::vector<glm::vec3> v, n;
+		std::vector<glm::vec2> uv;
+		std::clog.setstate(std::ios::failbit);
+		bool group_ok = impl::load_wavefront(groups_obj_path, v, uv, n) && n.size() == 6
+			&& near(n[0], g.expected[0]) && near(n[3], g.expected[1]);
+		std::clog.clear();
+		std::printf("smoothing groups %s and %s: %s\n", g.first, g.second, group_ok ? "ok" : "MISMATCH");
+		ok = ok && group_ok;
+	}
+
+	std::remove(grid_obj_path);
+	std::remove(corners_obj_path);
+	std::remove(groups_obj_path);
+
+	std::printf("%s\n", ok ? "ok" : "MISMATCH");
+	return ok ? 0 : 1;
+}
@@ -0,0 +1,245 @@
+#ifndef MRR_GRAPHICS_ANIMATION_HXX__
+#define MRR_GRAPHICS_ANIMATION_HXX__
+
+#include <mrr/graphics/gl-common.hxx>
+
+#include <cstddef>
+#include <cstdint>
+#include <iosfwd>
+#include <memory>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+namespace mrr {
+namespace graphics {
+namespace gl {
+
+// Keyframes of one channel, at ascending times. Values between keys are
+// interpolated linearly; before the first and after the last key they hold.
+// A track without keys leaves its channel at the identity.
+template <typename T>
+struct keyframe_track
+{
+	void add(float time, T const& value)
+	{
+		times.push_back(time);
+		values.push_back(value);
+	}
+
+	std::vector<float> times;
+	std::vector<T> values;
+};
+
+// Translation, rotation and scale curves of one node or bone. Rotations are
+// unit quaternions stored as (x, y, z, w) and interpolated by normalized
+// lerp along the shorter arc, which is close to slerp at keyframe spacings.
+struct trs_track
+{
+	keyframe_track<::glm::vec3> translation;
+	keyframe_track<::glm::vec4> rotation;
+	keyframe_track<::glm::vec3> scale;
+};
+
+// Tracks that play together: one for a node, one per bone for a skeleton.
+class animation_clip
+{
+public:
+	explicit animation_clip(float duration);
+
+	std::size_t add_track(trs_track const& track);
+
+	float get_duration() const;
+	std::size_t get_track_count() const;
+	trs_track const& get_track(std::size_t i) const;
+
+private:
+	float duration_;
+	std::vector<trs_track> tracks_;
+};
+
+
+// Bones of a skinned mesh, parents before their children.
+struct skeleton
+{
+	// -1 for roots.
+	std::vector<int> parents;
+	// From mesh space to the space of each bone in the bind pose.
+	std::vector<::glm::mat4> inverse_bind;
+};
+
+// Up to four bones per vertex, with unorm8 weights that sum to 255.
+struct skin_weights
+{
+	std::uint8_t bones[4];
+	std::uint8_t weights[4];
+};
+
+// Size of the BonePalette uniform of the skinned shader.
+std::size_t const max_skin_bones = 64;
+
+// A component deformed by a skeleton, drawn with
+// shaders/skinned-vertex-shader.glsl. Skin weights are given per vertex of
+// get_vertices(), as load_wavefront left them. The bone palette is written
+// by an animator; the bounds remain those of the bind pose. Multi-view and
+// indirect rendering draw the bind pose.
+class skinned_mesh : public component
+{
+public:
+	skinned_mesh();
+
+	// Prints the reason and returns false for skeletons over max_skin_bones.
+	bool set_skeleton(::std::shared_ptr<skeleton const> const& s);
+	skeleton const* get_skeleton() const;
+
+	void set_skin_data(std::vector<skin_weights> const& skin);
+
+	// Bone matrices from mesh space in the bind pose to mesh space in the
+	// current pose.
+	std::vector<::glm::mat4> const& get_palette() const;
+
+	virtual void render(::glm::mat4 const& V, ::glm::mat4 const& P) const;
+
+protected:
+	void get_uniform_locations();
+
+private:
+	friend class animator;
+
+	::std::shared_ptr<skeleton const> skeleton_;
+	std::vector<::glm::mat4> palette_;
+	::mrr::graphics::gl::buffer skin_buffer_;
+	GLuint palette_id_;
+	GLuint bone_count_id_;
+};
+
+
+struct animation_playback
+{
+	animation_playback();
+
+	float time;
+	// Seconds of clip per second of advance(); may be negative.
+	float speed;
+	// Wrap around at the ends instead of holding the first or last pose.
+	bool loop;
+};
+
+// Timings of the last evaluation.
+struct animation_stats
+{
+	animation_stats();
+
+	std::size_t nodes;
+	std::size_t skeletons;
+	// Tracks sampled: one per node, one per bone.
+	std::size_t tracks;
+	double evaluate_ms;
+	double apply_ms;
+};
+
+::std::ostream& operator <<(::std::ostream& out, animation_stats const& s);
+
+// Plays clips on components and skinned meshes in batches. Every track of
+// every binding is sampled in one flat array, four at a time with SSE, into
+// local matrices; node transforms and bone palettes are then composed per
+// binding. Both passes run in parallel chunks on a worker thread started by
+// start(), so the render thread can do other work meanwhile. finish() waits
+// for it and writes every transform in one pass, through set_model() so that
+// locations and broadphases follow.
+//
+// Components must outlive their bindings, and bindings, clips and the bound
+// components' transforms must not be changed between start() and finish().
+class animator
+{
+public:
+	animator();
+	animator(animator const&) = delete;
+	animator& operator =(animator const&) = delete;
+	~animator();
+
+	// Animates c with track of clip. Its model becomes base * TRS(t), with
+	// base its model at the time of binding. Binding a component again
+	// replaces its binding.
+	void bind(
+		component& c,
+		::std::shared_ptr<animation_clip const> const& clip,
+		std::size_t track = 0,
+		animation_playback const& playback = animation_playback()
+	);
+
+	// Poses the skeleton of m with clip, one track per bone. Bind again after
+	// changing the skeleton.
+	void bind_skeleton(
+		skinned_mesh& m,
+		::std::shared_ptr<animation_clip const> const& clip,
+		animation_playback const& playback = animation_playback()
+	);
+
+	void unbind(component& c);
+	std::size_t size() const;
+
+	void set_time(component& c, float time);
+	void set_speed(component& c, float speed);
+
+	// Advances every binding by dt seconds and evaluates them off this
+	// thread; finish() applies the result. start() finishes first if needed.
+	void start(float dt);
+	void finish();
+
+	void advance(float dt);
+
+	animation_stats const& get_stats() const;
+
+private:
+	struct binding
+	{
+		component* target;
+		skinned_mesh* skin;
+		::std::shared_ptr<animation_clip const> clip;
+		animation_playback playback;
+		::glm::mat4 base;
+		// Track of a node in clip; bones use tracks from 0.
+		std::size_t track;
+		// The binding's tracks in samplers_.
+		std::size_t first_sampler;
+		std::size_t sampler_count;
+	};
+
+	// One track of one binding, with the key each channel was last found at.
+	struct sampler
+	{
+		trs_track const* track;
+		std::uint32_t binding;
+		std::uint32_t cursor[3];
+	};
+
+	void add(binding&& b);
+	binding* find(component& c);
+	void rebuild_samplers();
+	void evaluate(float dt);
+	void sample(std::size_t begin, std::size_t end);
+	void compose(std::size_t begin, std::size_t end);
+
+	std::vector<binding> bindings_;
+	std::unordered_map<component*, std::size_t> index_;
+	std::vector<sampler> samplers_;
+
+	// Per sampler and per binding results of the last evaluation.
+	std::vector<::glm::mat4> local_;
+	std::vector<::glm::mat4> models_;
+	std::vector<::glm::mat4> palettes_;
+
+	std::thread worker_;
+	bool pending_;
+	animation_stats stats_;
+};
+
+} // namespace gl
+} // namespace graphics
+} // namespace mrr
+
+#endif // #ifndef MRR_GRAPHICS_ANIMATION_HXX__
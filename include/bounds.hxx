@@ -0,0 +1,55 @@
+#ifndef MRR_GRAPHICS_BOUNDS_HXX__
+#define MRR_GRAPHICS_BOUNDS_HXX__
+
+#include <vector>
+
+#include <glm/glm.hpp>
+
+namespace mrr {
+namespace graphics {
+namespace gl {
+
+// Axis aligned bounding box. A default constructed box is empty and grows
+// as points are added to it.
+class aabb
+{
+public:
+	aabb();
+	aabb(::glm::vec3 const& lower, ::glm::vec3 const& upper);
+
+	void expand(::glm::vec3 const& p);
+	void expand(aabb const& b);
+
+	bool is_empty() const;
+	::glm::vec3 center() const;
+	::glm::vec3 extent() const;
+	float radius() const;
+
+	aabb transformed(::glm::mat4 const& m) const;
+
+	::glm::vec3 lower;
+	::glm::vec3 upper;
+};
+
+aabb compute_bounds(::std::vector<::glm::vec3> const& points);
+aabb compute_bounds(::glm::vec3 const* points, ::std::size_t count);
+
+
+// View frustum extracted from a view-projection matrix.
+class frustum
+{
+public:
+	frustum() = default;
+	explicit frustum(::glm::mat4 const& view_projection);
+
+	bool intersects(aabb const& b) const;
+
+private:
+	::glm::vec4 planes_[6];
+};
+
+} // namespace gl
+} // namespace graphics
+} // namespace mrr
+
+#endif // #ifndef MRR_GRAPHICS_BOUNDS_HXX__
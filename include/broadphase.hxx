@@ -0,0 +1,133 @@
+#ifndef MRR_GRAPHICS_BROADPHASE_HXX__
+#define MRR_GRAPHICS_BROADPHASE_HXX__
+
+#include <mrr/graphics/bounds.hxx>
+#include <mrr/graphics/gl-common.hxx>
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <iosfwd>
+#include <utility>
+#include <vector>
+
+namespace mrr {
+namespace graphics {
+namespace gl {
+
+struct broadphase_stats
+{
+	broadphase_stats();
+
+	::std::size_t components;
+	// Components whose location changed since the last update.
+	::std::size_t moved;
+	// Exchanges made by the insertion sort; small while motion is coherent.
+	::std::size_t swaps;
+	::std::size_t pairs;
+	::std::size_t begun;
+	::std::size_t ended;
+	double update_ms;
+};
+
+::std::ostream& operator <<(::std::ostream& out, broadphase_stats const& s);
+
+
+// Finds the components whose world bounds overlap, by sweep and prune: the
+// bounds are kept sorted along one axis, and only those overlapping along it
+// are tested along the other two. Bounds are cached and refreshed by
+// component::update_location, so only components that moved cost anything
+// beyond the sweep, and the order changes little between frames, which the
+// insertion sort that keeps it relies on.
+//
+// update() sweeps on several threads for large counts, then calls the
+// callbacks on the calling thread: end for pairs that no longer overlap,
+// begin for new ones, then overlap for every current pair. Components may
+// be moved by the callbacks, and from several threads between updates, but
+// not added or removed while update() runs.
+//
+// A component belongs to at most one broadphase, and leaves it when it is
+// destroyed.
+class broadphase
+{
+public:
+	using callback_type = ::std::function<void(component&, component&)>;
+	using pair_type = ::std::pair<component*, component*>;
+
+	broadphase();
+	~broadphase();
+	broadphase(broadphase const&) = delete;
+	broadphase& operator =(broadphase const&) = delete;
+
+	// Adds a component, or every component of a model tree. Pairs involving
+	// it are found from the next update().
+	void add(model& m);
+	// Pairs involving a removed component end without a callback.
+	void remove(model& m);
+
+	void set_begin_callback(callback_type const& callback);
+	void set_overlap_callback(callback_type const& callback);
+	void set_end_callback(callback_type const& callback);
+
+	void update();
+
+	// The overlapping pairs as of the last update().
+	::std::vector<pair_type> const& get_pairs() const;
+	broadphase_stats const& get_stats() const;
+	// Axis of the sweep, that with the widest spread of component centers.
+	int get_axis() const;
+
+private:
+	friend class component;
+
+	struct proxy
+	{
+		aabb bounds;
+		// Null for free proxies.
+		component* target;
+		bool moved;
+	};
+
+	// A proxy's bounds at the last update, sorted along the axis.
+	struct endpoint
+	{
+		::glm::vec3 lower;
+		::std::uint32_t id;
+		::glm::vec3 upper;
+		float padding;
+	};
+
+	// Called by component::update_location.
+	void move(::std::uint32_t id, aabb const& bounds);
+
+	// Returns whether the axis changed, when the order must be rebuilt.
+	bool choose_axis();
+	void sort(bool resort);
+	void sweep(::std::vector<::std::uint64_t>& keys) const;
+	void report(::std::vector<::std::uint64_t> const& keys);
+
+	::std::vector<proxy> proxies_;
+	::std::vector<::std::uint32_t> free_;
+	::std::vector<endpoint> endpoints_;
+	// Endpoints appended since the last update, and proxies removed since
+	// then, which are freed once their endpoints are gone.
+	::std::size_t added_;
+	::std::vector<::std::uint32_t> removed_;
+	int axis_;
+
+	// Keys of the overlapping pairs, (lower id << 32) | higher id, sorted.
+	::std::vector<::std::uint64_t> keys_;
+	::std::vector<pair_type> pairs_;
+
+	callback_type begin_callback_;
+	callback_type overlap_callback_;
+	callback_type end_callback_;
+
+	broadphase_stats stats_;
+};
+
+} // namespace gl
+} // namespace graphics
+} // namespace mrr
+
+#endif // #ifndef MRR_GRAPHICS_BROADPHASE_HXX__
@@ -0,0 +1,124 @@
+#ifndef MRR_GRAPHICS_CLUSTERED_HXX__
+#define MRR_GRAPHICS_CLUSTERED_HXX__
+
+#include <mrr/graphics/gl-common.hxx>
+
+#include <cstdint>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+namespace mrr {
+namespace graphics {
+namespace gl {
+
+shader_handle clustered_colour_shader();
+shader_handle clustered_texture_shader();
+
+
+// Clustered forward lighting. The view frustum is divided into a grid of
+// froxels (screen tiles by exponentially spaced depth slices); every frame
+// update() bins the point sources of a model into the froxels their range of
+// influence touches and uploads the per-froxel light lists as texture
+// buffers. The clustered shaders then only loop over the lights of the
+// fragment's own froxel, so there is no limit on the number of lights and
+// shading cost follows local light density.
+//
+// A light's range is where its unattenuated contribution falls below the
+// cutoff intensity (1/512 by default, under one 8-bit step), so results
+// match the unclustered shaders.
+//
+// Components use the clusters once model::set_light_clusters() has been
+// called on them (or an ancestor) and they use one of the clustered shaders.
+class light_clusters
+{
+public:
+	// Bound to texture units 1, 2 and 3; unit 0 is left to the diffuse texture.
+	static GLint const grid_texture_unit = 1;
+	static GLint const index_texture_unit = 2;
+	static GLint const light_texture_unit = 3;
+
+	light_clusters(unsigned tiles_x = 16, unsigned tiles_y = 9, unsigned slices = 24);
+	light_clusters(light_clusters const&) = delete;
+	light_clusters& operator =(light_clusters const&) = delete;
+	~light_clusters();
+
+	void set_cutoff_intensity(float intensity);
+	void set_max_lights_per_cluster(std::size_t count);
+
+	// Bins the point sources of lights for the current GL viewport.
+	void update(model const& lights, ::glm::mat4 const& V, ::glm::mat4 const& P);
+
+	static light_cluster_uniforms get_uniform_locations(shader_handle& s);
+
+	// Binds the cluster textures and sets the cluster uniforms of the
+	// program in use.
+	void apply(light_cluster_uniforms const& u) const;
+
+	std::size_t get_cluster_count() const;
+	std::size_t get_light_count() const;
+	std::size_t get_light_reference_count() const;
+	std::size_t get_overflow_count() const;
+
+private:
+	void create_textures();
+	void build_cluster_bounds(::glm::mat4 const& P);
+	void bin_lights(std::size_t first_slice, std::size_t last_slice);
+	void upload();
+
+	struct light
+	{
+		::glm::vec3 position; // view space
+		float radius;
+		::glm::vec3 colour;   // colour * power
+		float padding;
+	};
+
+	// Conservative range of clusters touched by a light, [begin, end).
+	struct cluster_range
+	{
+		unsigned x_begin, x_end;
+		unsigned y_begin, y_end;
+		unsigned z_begin, z_end;
+	};
+
+	unsigned tiles_x_;
+	unsigned tiles_y_;
+	unsigned slices_;
+	float cutoff_intensity_;
+	std::size_t max_lights_per_cluster_;
+
+	::glm::mat4 projection_;
+	float near_;
+	float far_;
+	float depth_scale_;
+	float depth_bias_;
+	GLint viewport_[4];
+
+	std::vector<aabb> cluster_bounds_;
+	std::vector<float> slice_depths_;
+	std::vector<light> lights_;
+	std::vector<cluster_range> light_ranges_;
+
+	// Fixed capacity per cluster, so threads binning different slices never
+	// write to the same memory.
+	std::vector<std::uint16_t> cluster_lights_;
+	std::vector<std::uint16_t> cluster_counts_;
+	std::vector<std::size_t> overflow_;
+
+	std::vector<GLuint> grid_;
+	std::vector<std::uint16_t> indices_;
+
+	buffer grid_buffer_;
+	buffer index_buffer_;
+	buffer light_buffer_;
+	GLuint grid_texture_;
+	GLuint index_texture_;
+	GLuint light_texture_;
+};
+
+} // namespace gl
+} // namespace graphics
+} // namespace mrr
+
+#endif // #ifndef MRR_GRAPHICS_CLUSTERED_HXX__
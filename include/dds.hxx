@@ -0,0 +1,73 @@
+#ifndef MRR_GRAPHICS_DDS_HXX__
+#define MRR_GRAPHICS_DDS_HXX__
+
+#include <mrr/graphics/glew-common.hxx>
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+namespace mrr {
+namespace graphics {
+namespace gl {
+namespace dds {
+
+// Block compressed DirectDraw Surface files: BC1-BC7 through FourCC codes
+// or the DX10 extended header, 2D textures, cubemaps and arrays of either.
+// Parsing only reads the header and never needs a GL context.
+
+enum class error
+{
+	none,
+	truncated_header,
+	bad_magic,
+	bad_header_size,
+	unsupported_format,
+	unsupported_dimension,
+	partial_cubemap,
+	bad_dimensions,
+	bad_mip_count,
+	bad_array_size,
+	truncated_data
+};
+
+char const* describe(error e);
+
+struct image
+{
+	GLenum target;           // GL_TEXTURE_2D, _CUBE_MAP, _2D_ARRAY or _CUBE_MAP_ARRAY
+	GLenum internal_format;  // a GL_COMPRESSED_* format
+	std::uint32_t width;
+	std::uint32_t height;
+	std::uint32_t mip_count;
+	std::uint32_t array_size;
+	std::uint32_t faces;     // 6 for cubemaps, 1 otherwise
+	std::uint32_t block_bytes;
+
+	std::size_t data_offset; // first surface, from the start of the file
+	std::size_t data_size;   // all surfaces, validated against the file
+
+	std::uint32_t mip_width(std::uint32_t level) const;
+	std::uint32_t mip_height(std::uint32_t level) const;
+
+	// Exact size in bytes of one surface of a mip level.
+	std::size_t mip_size(std::uint32_t level) const;
+
+	// Surfaces are stored array element major, then face, then mip level.
+	std::size_t surface_offset(std::uint32_t layer, std::uint32_t face, std::uint32_t level) const;
+};
+
+error parse(unsigned char const* data, std::size_t size, image& out);
+
+// Memory maps a DDS file and uploads it through a pixel unpack buffer.
+// Returns the texture name, or 0 after printing the reason on failure.
+// out_target receives the texture target to bind it to. The texture is
+// tracked in the memory accounting under path; whoever deletes it untracks it.
+GLuint load(std::string const& path, GLenum& out_target);
+
+} // namespace dds
+} // namespace gl
+} // namespace graphics
+} // namespace mrr
+
+#endif // #ifndef MRR_GRAPHICS_DDS_HXX__
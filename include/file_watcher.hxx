@@ -0,0 +1,52 @@
+#ifndef MRR_GRAPHICS_FILE_WATCHER_HXX__
+#define MRR_GRAPHICS_FILE_WATCHER_HXX__
+
+#include <chrono>
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+
+namespace mrr {
+namespace graphics {
+
+// Reports files that were rewritten or replaced, through inotify. The
+// containing directories are watched rather than the files, so editors that
+// save by renaming a new file over the old one are noticed too. Evaluates to
+// false if inotify is unavailable.
+class file_watcher
+{
+public:
+	struct change
+	{
+		::std::string path;
+		::std::chrono::system_clock::time_point modified;
+	};
+
+	file_watcher();
+	file_watcher(file_watcher const&) = delete;
+	file_watcher& operator =(file_watcher const&) = delete;
+	~file_watcher();
+
+	bool watch(::std::string const& path);
+	bool is_watched(::std::string const& path) const;
+
+	// Never blocks. Each changed file is reported once per call, however
+	// many events it produced.
+	::std::vector<change> poll();
+
+	explicit operator bool() const;
+
+private:
+	int fd_;
+	::std::map<int, ::std::string> directories_;
+	::std::set<::std::string> files_;
+};
+
+// Absolute path without symbolic links, or path itself if it does not exist.
+::std::string canonical_path(::std::string const& path);
+
+} // namespace graphics
+} // namespace mrr
+
+#endif // #ifndef MRR_GRAPHICS_FILE_WATCHER_HXX__
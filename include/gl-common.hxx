@@ -2,9 +2,13 @@
 #define MRR_GRAPHICS_GL_COMMON_HXX__
 
 #include <mrr/graphics/glew-common.hxx>
+#include <mrr/graphics/bounds.hxx>
+#include <mrr/graphics/quantize.hxx>
+#include <mrr/graphics/pool.hxx>
 
+#include <cstdint>
+#include <memory>
 #include <string>
-#include <set>
 #include <vector>
 
 #include <glm/glm.hpp>
@@ -32,22 +36,52 @@ public:
 		::std::string const& fragment_shader_file
 	);
 
+	// Compiles both files with defines inserted after their #version line.
+	shader_handle(
+		::std::string const& vertex_shader_file,
+		::std::string const& fragment_shader_file,
+		::std::string const& defines
+	);
+
+	// Takes ownership of a program that is already linked, such as one
+	// returned by shader_batch::finish().
+	shader_handle(
+		GLuint program_id,
+		::std::string const& vertex_shader_file,
+		::std::string const& fragment_shader_file,
+		::std::string const& defines = ::std::string()
+	);
+
 	void use() const;
-	GLuint get_program_id();
+	GLuint get_program_id() const;
 	GLuint get_uniform_location(char const* var_name);
 
+	::std::string const& get_vertex_shader_file() const;
+	::std::string const& get_fragment_shader_file() const;
+	::std::string const& get_defines() const;
+
+	// Rebuilds the program from its files for every copy of this handle.
+	// The current program is kept if the new one fails to build. Uniform
+	// locations may change, see model::refresh_uniform_locations().
+	bool reload();
+
 	void set_ambient_light_colour(::glm::vec3 const& colour);
 
 private:
-	GLuint shader_program_id_;
+	// Shared between copies; the program is deleted with the last copy.
+	::std::shared_ptr<GLuint> shader_program_id_;
 	::std::string vertex_shader_file_;
 	::std::string fragment_shader_file_;
+	::std::string defines_;
 };
 
 
 shader_handle colour_shader();
 shader_handle texture_shader();
 
+// Feature key of a specialized shader program (see shader_variants.hxx).
+typedef ::std::uint32_t shader_key;
+
 
 class vertex_array
 {
@@ -73,17 +107,25 @@ class buffer
 {
 public:
 	buffer();
-	buffer(buffer const&) = default;
-	buffer(buffer&&) = default;
+	buffer(buffer const&) = delete;
+	buffer(buffer&& other) noexcept;
 
-	buffer& operator =(buffer const&) = default;
-	buffer& operator =(buffer&&) = default;
+	buffer& operator =(buffer const&) = delete;
+	buffer& operator =(buffer&& other) noexcept;
 
 	~buffer();
 
 	void create();
 	void destroy();
 	void bind(GLenum target) const;
+	void bind_base(GLenum target, GLuint index) const;
+	// Makes this buffer the storage of the bound GL_TEXTURE_BUFFER texture.
+	void bind_texture_buffer(GLenum internal_format) const;
+	// Binds this buffer to target and gives it size bytes of storage, recorded
+	// in the memory accounting (memory_accounting.hxx) under asset.
+	void set_data(GLenum target, GLsizeiptr size, void const* data, GLenum usage,
+	              ::std::string const& asset = ::std::string()) const;
+	bool is_created() const;
 
 private:
 	GLuint buffer_;
@@ -97,18 +139,48 @@ public:
 	~texture();
 
 	void load(::std::string const& filename);
+	// Loads the file again, keeping the current texture if that fails.
+	bool reload();
 	void destroy();
+	void bind() const;
 	void bind(GLenum) const;
 	bool is_loaded() const;
+	GLenum get_target() const;
+	::std::string const& get_filename() const;
 
 private:
+	::std::string filename_;
 	GLuint texture_;
+	GLenum target_;
 	bool is_loaded_;
 };
 
 
+class light_clusters;
+
+namespace impl {
+class scene_snapshot;
+}
+
+// Locations of the uniforms read by the clustered shaders (clustered.hxx).
+struct light_cluster_uniforms
+{
+	GLint grid;
+	GLint indices;
+	GLint lights;
+	GLint dimensions;
+	GLint tile_size;
+	GLint viewport_origin;
+	GLint depth_scale;
+	GLint depth_bias;
+};
+
+
 class model
 {
+	// Saves and restores models in scene snapshots (scene.hxx).
+	friend class impl::scene_snapshot;
+
 public:
 	model();
 
@@ -117,6 +189,11 @@ public:
 		::std::string const& vertex_shader_file,
 		::std::string const& fragment_shader_file
 	);
+	::mrr::graphics::gl::shader_handle const& get_shader() const;
+
+	// Fetches the uniform locations of this model and its descendants again,
+	// after their shaders were reloaded.
+	void refresh_uniform_locations();
 
 
 	template <typename Iter>
@@ -128,6 +205,8 @@ public:
 
 	void add_component(model& m);
 	void remove_component(model& m);
+	child_list const& get_components() const;
+
 	virtual void update_model(::glm::mat4 const& t);
 	virtual void apply_fp_transformation(::glm::mat4 const& t);
 	virtual void apply_fp_transformation(::glm::mat4 const& t, ::glm::vec3 const& fp);
@@ -139,7 +218,7 @@ public:
 
 	GLuint get_ambient_light_colour_id() const;
 
-	void add_point_source(::glm::vec3 const& location, ::glm::vec3 const& colour, float power);
+	virtual void add_point_source(::glm::vec3 const& location, ::glm::vec3 const& colour, float power);
 
 	GLuint get_point_source_locations_id() const;
 	GLuint get_point_source_colours_id() const;
@@ -148,11 +227,19 @@ public:
 
 	std::vector<glm::vec3> const& get_point_source_locations() const;
 	std::vector<glm::vec3> const& get_point_source_colours() const;
-	std::vector<float> get_point_source_powers() const;
+	std::vector<float> const& get_point_source_powers() const;
+
+	// Shade with the per-cluster light lists of c instead of the point source
+	// uniforms. Requires a clustered shader; nullptr switches back.
+	void set_light_clusters(light_clusters const* c);
+	light_clusters const* get_light_clusters() const;
 
 	virtual void render(::glm::mat4 const& V, ::glm::mat4 const& P) const;
 
 protected:
+	// Fetches every uniform location from shader_, after it has changed.
+	virtual void get_uniform_locations();
+
 	::mrr::graphics::gl::shader_handle shader_;
 
 	GLuint mvp_matrix_id_;
@@ -160,7 +247,7 @@ protected:
 	GLuint view_matrix_id_;
 
 	::glm::vec3 center_;
-	::std::set<model*> components_;
+	child_list components_;
 
 	GLuint ambient_light_colour_id_;
 	::glm::vec3 ambient_light_colour_;
@@ -173,18 +260,70 @@ protected:
 	::std::vector<glm::vec3> point_source_locations_;
 	::std::vector<glm::vec3> point_source_colours_;
 	::std::vector<float> point_source_powers_;
+
+	light_clusters const* light_clusters_;
+	light_cluster_uniforms light_cluster_uniforms_;
 };
 
 
+// Storage of the vertex attributes uploaded by component::load_wavefront.
+// quantized stores 14 bytes per vertex instead of 32 (see quantize.hxx); the
+// shaders decode it when the QuantizedVertices uniform is set.
+enum class vertex_format
+{
+	float32,
+	quantized
+};
+
+// What a component does with the CPU copy of its mesh (vertices, uvs,
+// normals and tangents) once load_wavefront has uploaded it. release frees it, keeping
+// the bounds, vertex count and indices, after which generate_lods,
+// generate_tangents and set_vertex_format need the mesh loaded again. Released components cannot
+// be picked (picking.hxx) or occlude (occlusion.hxx), which warn about them.
+enum class cpu_copy_policy
+{
+	keep,
+	release
+};
+
+
+class multi_view_renderer;
+class broadphase;
+
 class component : public model
 {
 private:
+	// Draws components with state shared between views.
+	friend class multi_view_renderer;
+	// Registers components, which report their moves to it.
+	friend class broadphase;
+	// Saves and restores components in scene snapshots (scene.hxx).
+	friend class impl::scene_snapshot;
+
 	void update_location();
 
 public:
 	component();
+	// Components own GL buffers and may be registered with a broadphase,
+	// which keeps their address, so they are neither copied nor moved.
+	component(component const&) = delete;
+	component& operator =(component const&) = delete;
+	// Also leaves the broadphase the component is in.
+	~component();
 
 	::glm::vec3 const& get_location() const;
+	::glm::mat4 const& get_model() const;
+	aabb const& get_bounds() const;
+	aabb get_world_bounds() const;
+
+	std::vector<glm::vec3> const& get_vertices() const;
+	std::vector<glm::vec3> const& get_normals() const;
+	std::vector<glm::vec4> const& get_tangents() const;
+	std::vector<unsigned int> const& get_indices(std::size_t lod = 0) const;
+	GLsizei get_vertex_count() const;
+	::glm::vec3 const& get_colour() const;
+	::glm::vec3 const& get_specular_colour() const;
+	bool has_texture() const;
 
 	void set_vertex_data(GLfloat const* vertex_data, int size);
 	void set_colour_data(GLfloat const* colour_data);
@@ -201,18 +340,101 @@ public:
 	void set_heading(::glm::vec3 const& heading);
 	void update_heading(::glm::mat4 const& t);
 	void load_wavefront(std::string const& path);
+
+	// Streams an OBJ file straight into the vertex buffers, chunk_triangles
+	// at a time, for meshes too large to load whole. No CPU copy is kept, so
+	// the mesh is drawn unindexed in the float32 format, without levels of
+	// detail. Keeps the current mesh on failure.
+	bool stream_wavefront(std::string const& path, std::size_t chunk_triangles = 1 << 16);
+
+	std::string const& get_wavefront_file() const;
+	std::string const& get_texture_file() const;
+
+	// Reload the OBJ file or texture from disk, keeping the current one if
+	// that fails. Levels of detail are regenerated.
+	bool reload_wavefront();
+	bool reload_texture();
+	void set_vertex_format(vertex_format format);
+	vertex_format get_vertex_format() const;
+	impl::quantization_error const& get_quantization_error() const;
+
+	// release also frees the current CPU copy. reload_wavefront keeps the
+	// copy until the levels of detail are regenerated.
+	void set_cpu_copy_policy(cpu_copy_policy policy);
+	cpu_copy_policy get_cpu_copy_policy() const;
+	bool has_cpu_copy() const;
 	void set_drawing_mode(GLenum drawing_mode);
+	GLenum get_drawing_mode() const;
+	void add_point_source(::glm::vec3 const& location, ::glm::vec3 const& colour, float power);
 	void save();
 	void reset();
 
+	// Shader variants. Once enabled, the component draws with the variant of
+	// default_shader_variants() specialized for its attributes (texture,
+	// vertex colours, normals, vertex format and light count), and switches
+	// variants whenever those change. Ignored while light clusters are set.
+	void use_shader_variants(bool enable = true);
+	shader_key get_shader_key() const;
+
+	// Level of detail. generate_lods() simplifies the mesh loaded by
+	// load_wavefront into levels of roughly halving triangle count. Level i
+	// is drawn once the projected size of the component, as a fraction of
+	// the viewport height, drops below the i-th threshold.
+	void generate_lods(std::size_t levels = 4);
+	void set_lod_thresholds(std::vector<float> const& screen_sizes);
+	void set_lod_hysteresis(float fraction);
+	std::size_t get_lod_count() const;
+	std::size_t select_lod(::glm::mat4 const& V, ::glm::mat4 const& P) const;
+
+	// Tangent space for normal mapping. generate_tangents() computes one
+	// tangent per vertex of the mesh loaded by load_wavefront, from its uvs
+	// and normals (impl::generate_tangents, tangent_space.hxx). Tangents are
+	// part of the CPU copy and are regenerated by reload_wavefront; no shader
+	// reads them, so they are not uploaded.
+	void generate_tangents();
+
 	virtual void render(::glm::mat4 const& V, ::glm::mat4 const& P) const;
 
 protected:
+	struct lod_level
+	{
+		std::vector<unsigned int> indices;
+		::mrr::graphics::gl::buffer index_buffer;
+	};
+
+	bool read_wavefront(std::string const& path);
+	// Also refreshes the bounds cached by a broadphase.
+	void set_bounds(aabb const& bounds);
+	void set_index_data(std::size_t lod, std::vector<unsigned int>&& indices);
+	void upload_vertex_data();
+	void apply_cpu_copy_policy();
+	// Records the CPU arrays in the memory accounting.
+	void account_cpu_memory() const;
+	void get_vertex_format_uniform_locations();
+	void get_uniform_locations();
+	void select_shader_variant();
+	// Uses the shader and sets every uniform of a draw: lights, matrices,
+	// texture, colours and vertex format.
+	void apply_uniforms(::glm::mat4 const& V, ::glm::mat4 const& P) const;
+	// Sets only the uniforms that depend on the view, for drawing again with
+	// another view.
+	void apply_view_uniforms(::glm::mat4 const& V, ::glm::mat4 const& P) const;
+	// Enables exactly the arrays of this component's attributes, and those
+	// with locations set in extra_arrays, which the caller points.
+	void bind_attributes(std::uint32_t extra_arrays = 0) const;
+	void draw(std::size_t lod, GLsizei instances = 1) const;
+	float projected_size(::glm::mat4 const& V, ::glm::mat4 const& P) const;
+
 	GLuint texture_sampler_id_;
 
+	std::string wavefront_file_;
+	// Chunk size of the last stream_wavefront, 0 if the mesh was loaded whole.
+	std::size_t stream_chunk_triangles_;
 	std::vector<glm::vec3> vertices_;
 	std::vector<glm::vec2> uvs_;
 	std::vector<glm::vec3> normals_;
+	std::vector<glm::vec4> tangents_;
+	cpu_copy_policy cpu_copy_policy_;
 
 	GLuint shape_colour_id_;
 	::glm::vec3 shape_colour_;
@@ -220,21 +442,34 @@ protected:
 	GLuint specular_colour_id_;
 	::glm::vec3 specular_colour_;
 
+	// Attributes are present when their buffer is created; buffers of empty
+	// attributes are destroyed.
 	::mrr::graphics::gl::buffer vertex_buffer_;
-	GLfloat const* vertex_data_;
-
 	::mrr::graphics::gl::buffer colour_buffer_;
-	GLfloat const* colour_data_;
-
 	::mrr::graphics::gl::buffer uv_buffer_;
-	GLfloat const* uv_data_;
-
 	::mrr::graphics::gl::buffer normal_buffer_;
-	GLfloat const* normal_data_;
 
 	::mrr::graphics::gl::texture texture_;
 
 	int va_size_;
+	GLsizei vertex_count_;
+	aabb bounds_;
+
+	vertex_format vertex_format_;
+	impl::quantization_error quantization_error_;
+	::glm::vec3 position_offset_;
+	::glm::vec3 position_scale_;
+	GLuint quantized_vertices_id_;
+	GLuint position_offset_id_;
+	GLuint position_scale_id_;
+
+	std::vector<lod_level> lods_;
+	std::vector<float> lod_thresholds_;
+	float lod_hysteresis_;
+	mutable std::size_t current_lod_;
+
+	bool shader_variants_;
+	shader_key shader_key_;
 
 	::glm::vec3 location_;
 	::glm::vec3 heading_;
@@ -243,6 +478,10 @@ protected:
 	::glm::mat4 model_save_;
 
 	GLenum drawing_mode_;
+
+	// The broadphase the component is in, if any, and its proxy there.
+	broadphase* broadphase_;
+	std::uint32_t broadphase_proxy_;
 };
 
 
@@ -250,6 +489,12 @@ class viewport
 {
 public:
 	viewport(GLint x, GLint y, GLsizei width, GLsizei height);
+
+	GLint get_x() const;
+	GLint get_y() const;
+	GLsizei get_width() const;
+	GLsizei get_height() const;
+
 	void render(model const& m, ::glm::mat4 const& V, ::glm::mat4 const& P) const;
 
 private:
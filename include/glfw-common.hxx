@@ -2,6 +2,9 @@
 #define MRR_GRAPHICS_GLFW_COMMON_HXX__
 
 #include <mrr/graphics/waypoint.hxx>
+#include <mrr/graphics/stats.hxx>
+#include <mrr/graphics/memory_accounting.hxx>
+#include <mrr/graphics/pool.hxx>
 #include <GLFW/glfw3.h>
 
 #include <functional>
@@ -68,6 +71,11 @@ public:
 
 	double get_ms_per_frame() const;
 
+	// Reset at the start of every frame of main_loop.
+	::mrr::graphics::gl::frame_arena& get_frame_arena();
+
+	// Runs loop_body once a frame until the window closes. The body may
+	// take the frame arena as its argument, for its transient allocations.
 	template <typename LoopBody>
 	void main_loop(LoopBody&& loop_body)
 	{
@@ -86,9 +94,12 @@ public:
 				last_time += (current_time - last_time);
 			}
 
+			::mrr::graphics::gl::next_frame_stats();
+			::mrr::graphics::gl::dump_memory_report();
+			frame_arena_.reset();
 			::glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 			process_waypoints();
-			loop_body();
+			call_loop_body(loop_body, frame_arena_, 0);
 			swap_buffers();
 			::glfwPollEvents();
 		}
@@ -97,8 +108,22 @@ public:
 	GLFWwindow* get();
 
 private:
+	template <typename LoopBody>
+	static auto call_loop_body(LoopBody& body, ::mrr::graphics::gl::frame_arena& arena, int)
+		-> decltype(body(arena), void())
+	{
+		body(arena);
+	}
+
+	template <typename LoopBody>
+	static void call_loop_body(LoopBody& body, ::mrr::graphics::gl::frame_arena&, long)
+	{
+		body();
+	}
+
 	GLFWwindow* window_;
 	::std::vector<::mrr::graphics::gl::waypoint> waypoints_;
+	::mrr::graphics::gl::frame_arena frame_arena_;
 
 	double last_time;
 	double current_time;
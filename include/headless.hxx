@@ -0,0 +1,41 @@
+#ifndef MRR_GRAPHICS_HEADLESS_HXX__
+#define MRR_GRAPHICS_HEADLESS_HXX__
+
+namespace mrr {
+namespace graphics {
+namespace egl {
+
+// An OpenGL core context without a window or display server, for batch
+// rendering on servers and in CI. It prefers Mesa's surfaceless platform,
+// which works with only a render node or none at all (llvmpipe, selected with
+// LIBGL_ALWAYS_SOFTWARE=true), and falls back to the default EGL display.
+//
+// There is no default framebuffer; render into a gl::framebuffer
+// (offscreen.hxx). The constructor makes the context current and
+// initializes GLEW.
+class headless_context
+{
+public:
+	headless_context(int major_version = 3, int minor_version = 3);
+	headless_context(headless_context const&) = delete;
+	headless_context& operator =(headless_context const&) = delete;
+	~headless_context();
+
+	void make_current();
+
+	// GL_RENDERER of the context, e.g. "llvmpipe (LLVM 15.0.7, 256 bits)".
+	char const* get_renderer() const;
+
+private:
+	// EGLDisplay, EGLContext and EGLSurface; kept opaque so that this header
+	// does not pull in the EGL (and X11) headers.
+	void* display_;
+	void* context_;
+	void* surface_;
+};
+
+} // namespace egl
+} // namespace graphics
+} // namespace mrr
+
+#endif // #ifndef MRR_GRAPHICS_HEADLESS_HXX__
@@ -0,0 +1,63 @@
+#ifndef MRR_GRAPHICS_HOT_RELOAD_HXX__
+#define MRR_GRAPHICS_HOT_RELOAD_HXX__
+
+#include <mrr/graphics/gl-common.hxx>
+#include <mrr/graphics/file_watcher.hxx>
+
+#include <functional>
+#include <string>
+#include <vector>
+
+namespace mrr {
+namespace graphics {
+namespace gl {
+
+// Rebuilds shaders, meshes and textures in place when their files change.
+// update() must be called once per frame outside of rendering, e.g. at the
+// start of the main_loop body; it only touches resources whose files were
+// written since the previous call. A resource that fails to rebuild is kept
+// as it was.
+class hot_reloader
+{
+public:
+	using callback_type = ::std::function<void (::std::string const& path)>;
+
+	hot_reloader();
+
+	// Watches the shaders, OBJ files and textures used by m and its
+	// descendants at the time of the call.
+	void watch(model& m);
+
+	// Watches a shader that no watched model uses, e.g. that of an
+	// indirect_renderer.
+	void watch(shader_handle const& s);
+
+	// Called after each successful reload, e.g. to rebuild an
+	// indirect_renderer after a mesh changed.
+	void set_reload_callback(callback_type const& callback);
+
+	// Returns the number of files reloaded.
+	::std::size_t update();
+
+	// Milliseconds from the last reloaded file's modification time until
+	// its resources were replaced, and the time spent rebuilding them.
+	double get_last_latency() const;
+	double get_last_reload_time() const;
+
+private:
+	void collect(model& m, ::std::vector<component*>& components);
+
+	file_watcher watcher_;
+	::std::vector<model*> models_;
+	::std::vector<shader_handle> shaders_;
+	callback_type reload_callback_;
+
+	double last_latency_;
+	double last_reload_time_;
+};
+
+} // namespace gl
+} // namespace graphics
+} // namespace mrr
+
+#endif // #ifndef MRR_GRAPHICS_HOT_RELOAD_HXX__
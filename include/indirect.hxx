@@ -0,0 +1,122 @@
+#ifndef MRR_GRAPHICS_INDIRECT_HXX__
+#define MRR_GRAPHICS_INDIRECT_HXX__
+
+#include <mrr/graphics/gl-common.hxx>
+
+#include <memory>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+namespace mrr {
+namespace graphics {
+namespace gl {
+
+shader_handle indirect_shader();
+
+
+// Renders every component of a model tree with a single
+// glMultiDrawElementsIndirect call. Geometry and every LOD index list of all
+// components are packed into shared buffers by build(); per-object
+// transforms and material indices are streamed through shader storage
+// buffers every frame.
+//
+// On contexts without GL 4.3 (or the equivalent ARB extensions), and for
+// textured components and those without a CPU copy of their mesh (see
+// cpu_copy_policy), render() falls back to component::render.
+class indirect_renderer
+{
+public:
+	indirect_renderer();
+	indirect_renderer(indirect_renderer const&) = delete;
+	indirect_renderer& operator =(indirect_renderer const&) = delete;
+
+	static bool is_supported();
+
+	void set_shader(shader_handle const& s);
+
+	void add(model& m);
+	void clear();
+	void build();
+
+	void render(::glm::mat4 const& V, ::glm::mat4 const& P);
+
+	std::size_t get_object_count() const;
+	std::size_t get_visible_count() const;
+
+private:
+	struct index_range
+	{
+		GLuint first;
+		GLuint count;
+	};
+
+	struct object
+	{
+		component const* target;
+		GLint base_vertex;
+		::std::vector<index_range> lods;
+		GLuint material;
+		bool indirect;
+	};
+
+	struct object_data
+	{
+		::glm::mat4 model;
+		GLuint material;
+		GLuint padding[3];
+	};
+
+	struct material_data
+	{
+		::glm::vec4 diffuse;
+		::glm::vec4 specular;
+	};
+
+	struct draw_command
+	{
+		GLuint count;
+		GLuint instance_count;
+		GLuint first_index;
+		GLint base_vertex;
+		GLuint base_instance;
+	};
+
+	void collect(model& m);
+	GLuint add_material(::glm::vec3 const& diffuse, ::glm::vec3 const& specular);
+	void set_light_uniforms(model const& lights);
+
+	bool supported_;
+	shader_handle shader_;
+	model* root_;
+
+	::std::vector<object> objects_;
+	::std::vector<material_data> materials_;
+
+	::std::vector<object_data> object_data_;
+	::std::vector<draw_command> commands_;
+	::std::size_t visible_count_;
+
+	::std::unique_ptr<vertex_array> vertex_array_;
+	buffer vertex_buffer_;
+	buffer normal_buffer_;
+	buffer index_buffer_;
+	buffer object_index_buffer_;
+	buffer object_buffer_;
+	buffer material_buffer_;
+	buffer command_buffer_;
+
+	GLuint view_matrix_id_;
+	GLuint projection_matrix_id_;
+	GLuint ambient_light_colour_id_;
+	GLuint point_source_locations_id_;
+	GLuint point_source_colours_id_;
+	GLuint point_source_powers_id_;
+	GLuint point_source_count_id_;
+};
+
+} // namespace gl
+} // namespace graphics
+} // namespace mrr
+
+#endif // #ifndef MRR_GRAPHICS_INDIRECT_HXX__
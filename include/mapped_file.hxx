@@ -0,0 +1,42 @@
+#ifndef MRR_GRAPHICS_MAPPED_FILE_HXX__
+#define MRR_GRAPHICS_MAPPED_FILE_HXX__
+
+#include <cstddef>
+#include <string>
+
+namespace mrr {
+namespace graphics {
+
+// Read-only memory mapping of a whole file. Evaluates to false if the file
+// could not be opened or mapped; an empty file maps to a null range.
+class mapped_file
+{
+public:
+	mapped_file();
+	explicit mapped_file(::std::string const& path);
+	mapped_file(mapped_file const&) = delete;
+	mapped_file(mapped_file&& other);
+
+	mapped_file& operator =(mapped_file const&) = delete;
+	mapped_file& operator =(mapped_file&& other);
+
+	~mapped_file();
+
+	bool open(::std::string const& path);
+	void close();
+
+	unsigned char const* data() const;
+	::std::size_t size() const;
+
+	explicit operator bool() const;
+
+private:
+	unsigned char const* data_;
+	::std::size_t size_;
+	bool is_open_;
+};
+
+} // namespace graphics
+} // namespace mrr
+
+#endif // #ifndef MRR_GRAPHICS_MAPPED_FILE_HXX__
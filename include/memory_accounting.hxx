@@ -0,0 +1,88 @@
+#ifndef MRR_GRAPHICS_MEMORY_ACCOUNTING_HXX__
+#define MRR_GRAPHICS_MEMORY_ACCOUNTING_HXX__
+
+#include <mrr/graphics/glew-common.hxx>
+
+#include <cstddef>
+#include <iosfwd>
+#include <string>
+#include <vector>
+
+namespace mrr {
+namespace graphics {
+namespace gl {
+
+// Where the bytes of the process's graphics data are: GPU objects by GL
+// name, and the CPU arrays that components keep of their meshes. Each
+// record belongs to an asset, the file it was loaded from, or to no asset.
+//
+// buffer::set_data, texture, framebuffer and component keep their records
+// up to date; code that allocates GL storage by itself may track it too.
+
+enum class memory_category
+{
+	vertex_buffers,
+	index_buffers,
+	other_buffers,
+	textures,
+	render_targets,
+	mesh_arrays,
+	index_arrays
+};
+
+std::size_t const memory_category_count = 7;
+
+char const* describe(memory_category c);
+bool is_gpu_memory(memory_category c);
+
+// Records the size of a GL object's storage, replacing its last record.
+void track_buffer(GLuint buffer, memory_category c, std::size_t bytes, std::string const& asset = std::string());
+void track_texture(GLuint texture, std::size_t bytes, std::string const& asset = std::string());
+void track_renderbuffer(GLuint renderbuffer, std::size_t bytes);
+void untrack_buffer(GLuint buffer);
+void untrack_texture(GLuint texture);
+void untrack_renderbuffer(GLuint renderbuffer);
+
+// Records the CPU memory of category c that owner holds; 0 bytes forgets it.
+void track_cpu_memory(void const* owner, memory_category c, std::size_t bytes, std::string const& asset = std::string());
+void untrack_cpu_memory(void const* owner);
+
+
+struct asset_memory
+{
+	asset_memory();
+
+	// Empty for data not loaded from a file.
+	std::string name;
+	std::size_t cpu_bytes;
+	std::size_t gpu_bytes;
+};
+
+struct memory_report
+{
+	memory_report();
+
+	std::size_t bytes[memory_category_count];
+	std::size_t objects[memory_category_count];
+	std::size_t cpu_bytes;
+	std::size_t gpu_bytes;
+	// Largest first.
+	std::vector<asset_memory> assets;
+};
+
+memory_report get_memory_report();
+
+// Totals per category on the first line, then one line per asset.
+::std::ostream& operator <<(::std::ostream& out, memory_report const& r);
+
+// Writes get_memory_report() to out on every interval_frames-th call of
+// dump_memory_report(), which window_handle::main_loop makes once a frame.
+// A null out or an interval of 0 stops the dumps.
+void set_memory_dump(::std::ostream* out, std::size_t interval_frames);
+void dump_memory_report();
+
+} // namespace gl
+} // namespace graphics
+} // namespace mrr
+
+#endif // #ifndef MRR_GRAPHICS_MEMORY_ACCOUNTING_HXX__
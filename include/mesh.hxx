@@ -0,0 +1,107 @@
+#ifndef MRR_GRAPHICS_MESH_HXX__
+#define MRR_GRAPHICS_MESH_HXX__
+
+#include <cstddef>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+namespace mrr {
+namespace graphics {
+namespace gl {
+namespace impl {
+
+// Merges identical (position, uv, normal) vertices of a triangle soup, as
+// produced by load_wavefront, and writes the index list that reproduces it.
+// The attribute arrays are compacted in place. uvs and normals may be empty.
+void weld_vertices(
+	std::vector<glm::vec3>& vertices,
+	std::vector<glm::vec2>& uvs,
+	std::vector<glm::vec3>& normals,
+	std::vector<unsigned int>& out_indices
+);
+
+// Quadric error edge collapse. Reduces an indexed triangle list until it has
+// at most target_index_count indices (or no collapse is possible) and
+// returns the new index list; the vertex array is left untouched, so the
+// result can be drawn from the same vertex buffer. Vertices on open borders
+// or on attribute seams are never moved. If out_error is given it receives
+// the largest error of any collapse, as a distance in model units.
+std::vector<unsigned int> simplify(
+	std::vector<glm::vec3> const& vertices,
+	std::vector<unsigned int> const& indices,
+	std::size_t target_index_count,
+	float* out_error = nullptr
+);
+
+
+// Post-transform vertex cache efficiency of an index list, simulated with a
+// FIFO cache. acmr is cache misses per triangle (0.5 is ideal for large
+// regular meshes, 3 the worst); atvr is misses per vertex (1 is ideal).
+struct vertex_cache_statistics
+{
+	float acmr;
+	float atvr;
+};
+
+vertex_cache_statistics analyze_vertex_cache(
+	std::vector<unsigned int> const& indices,
+	std::size_t vertex_count,
+	unsigned int cache_size = 16
+);
+
+// Reorders triangles for the post-transform vertex cache (Tipsify, Sander
+// et al. 2007). If out_clusters is given it receives the index of the first
+// triangle of each run the algorithm had to restart, for optimize_overdraw.
+void optimize_vertex_cache(
+	std::vector<unsigned int>& indices,
+	std::size_t vertex_count,
+	unsigned int cache_size = 16,
+	std::vector<unsigned int>* out_clusters = nullptr
+);
+
+// Reorders clusters of a cache optimized index list so that outward facing
+// clusters are drawn first, which lets early-Z reject more of the rest.
+// Clusters are split further as long as the ACMR stays within threshold of
+// the cache optimized order.
+void optimize_overdraw(
+	std::vector<unsigned int>& indices,
+	std::vector<glm::vec3> const& vertices,
+	std::vector<unsigned int> const& clusters,
+	unsigned int cache_size = 16,
+	float threshold = 1.05f
+);
+
+// Reorders the vertex arrays into the order in which the index list first
+// references them, and rewrites the indices. uvs and normals may be empty.
+void optimize_vertex_fetch(
+	std::vector<glm::vec3>& vertices,
+	std::vector<glm::vec2>& uvs,
+	std::vector<glm::vec3>& normals,
+	std::vector<unsigned int>& indices
+);
+
+
+struct mesh_optimization_report
+{
+	vertex_cache_statistics before;
+	vertex_cache_statistics after;
+};
+
+// Runs optimize_vertex_cache, optimize_overdraw and optimize_vertex_fetch on
+// a welded mesh, as component::load_wavefront does before upload.
+mesh_optimization_report optimize_mesh(
+	std::vector<glm::vec3>& vertices,
+	std::vector<glm::vec2>& uvs,
+	std::vector<glm::vec3>& normals,
+	std::vector<unsigned int>& indices,
+	unsigned int cache_size = 16
+);
+
+} // namespace impl
+} // namespace gl
+} // namespace graphics
+} // namespace mrr
+
+
+#endif // #ifndef MRR_GRAPHICS_MESH_HXX__
@@ -0,0 +1,117 @@
+#ifndef MRR_GRAPHICS_MULTIVIEW_HXX__
+#define MRR_GRAPHICS_MULTIVIEW_HXX__
+
+#include <mrr/graphics/gl-common.hxx>
+
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+namespace mrr {
+namespace graphics {
+namespace gl {
+
+struct view
+{
+	viewport area;
+	::glm::mat4 V;
+	::glm::mat4 P;
+};
+
+
+// Renders a model tree into several viewports, such as a four-view CAD
+// layout or split screen, with one traversal. Components are collected,
+// their world bounds computed and the draw list sorted by program once per
+// frame; only frustum culling is done per view.
+//
+// Components drawing with shader variants (component::use_shader_variants)
+// are drawn once for all the views that see them, as one instance per view
+// of the multi_view variant that selects its viewport with
+// gl_ViewportIndex. Where that is not supported, and for every other
+// component, the sorted draw list is replayed per view, with the
+// per-component state set once and only the view matrices updated between
+// views. Components of types derived from component are rendered with their
+// own render() per view.
+//
+// At most 32 views; instancing is used for up to max_variant_views.
+class multi_view_renderer
+{
+public:
+	multi_view_renderer();
+	multi_view_renderer(multi_view_renderer const&) = delete;
+	multi_view_renderer& operator =(multi_view_renderer const&) = delete;
+
+	// Viewport arrays and gl_ViewportIndex in vertex shaders.
+	static bool is_supported();
+
+	// Defaults to is_supported().
+	void set_instancing(bool enable);
+	bool get_instancing() const;
+
+	void render(model const& m, ::std::vector<view> const& views);
+
+	::std::size_t get_object_count() const;
+	::std::size_t get_visible_count(::std::size_t view) const;
+	::std::size_t get_instanced_count() const;
+	::std::size_t get_replayed_count() const;
+
+private:
+	struct program_uniforms
+	{
+		shader_handle shader;
+		// Program the locations were queried from; hot reloading swaps it.
+		GLuint program;
+		GLint view_matrices;
+		GLint instance_mvps;
+		GLint instance_views;
+		GLint model_matrix;
+		GLint ambient_light_colour;
+		GLint point_source_locations;
+		GLint point_source_colours;
+		GLint point_source_powers;
+		GLint shape_colour;
+		GLint specular_colour;
+		GLint texture_sampler;
+		GLint position_offset;
+		GLint position_scale;
+		// Frame of the last upload of the view matrices.
+		::std::size_t frame;
+	};
+
+	struct object
+	{
+		component const* target;
+		aabb world_bounds;
+		// Bit i is set if view i sees the component.
+		::std::uint32_t views;
+		program_uniforms* instanced;
+		GLuint program;
+	};
+
+	void collect(model const& m);
+	program_uniforms& get_program(shader_key key);
+	static void query_uniforms(program_uniforms& u);
+	static ::std::size_t select_lod(object const& o, ::std::vector<view> const& views);
+	void render_instanced(object const& o, ::std::vector<view> const& views);
+	void render_replayed(object const& o, ::std::vector<view> const& views);
+
+	bool instancing_;
+	::std::size_t frame_;
+
+	::std::vector<object> objects_;
+	::std::vector<::std::size_t> visible_counts_;
+	::std::size_t instanced_count_;
+	::std::size_t replayed_count_;
+
+	::std::unordered_map<shader_key, program_uniforms> programs_;
+	::std::vector<::glm::mat4> view_matrices_;
+	::std::vector<::glm::mat4> view_projection_matrices_;
+};
+
+} // namespace gl
+} // namespace graphics
+} // namespace mrr
+
+#endif // #ifndef MRR_GRAPHICS_MULTIVIEW_HXX__
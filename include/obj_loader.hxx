@@ -1,6 +1,8 @@
 #ifndef WAVEFRONT_OBJ_LOADER_HXX__
 #define WAVEFRONT_OBJ_LOADER_HXX__
 
+#include <cstddef>
+#include <functional>
 #include <string>
 #include <vector>
 
@@ -11,6 +13,15 @@ namespace graphics {
 namespace gl {
 namespace impl {
 
+// Faces of any number of corners are read, fan triangulated. Corners are
+// "v", "v/vt", "v//vn" or "v/vt/vn", with indices counted from 1 or, if
+// negative, back from the last element read. Corners without a uv get
+// (0, 0).
+
+// Reads the triangles of an OBJ file as a triangle soup. Corners without a
+// normal get a smooth one from generate_normals (tangent_space.hxx), within
+// the smoothing groups of "s" records; faces before the first are smoothed
+// together, and faces after "s off" or "s 0" are flat.
 bool load_wavefront(
 	std::string const& path,
 	std::vector<glm::vec3>& out_vertices,
@@ -18,6 +29,47 @@ bool load_wavefront(
 	std::vector<glm::vec3>& out_normals
 );
 
+
+// Record counts of an OBJ file.
+struct wavefront_counts
+{
+	wavefront_counts();
+
+	std::size_t positions;
+	std::size_t uvs;
+	std::size_t normals;
+	// Triangles after triangulation, and how many of them are of faces with
+	// a corner without a normal.
+	std::size_t triangles;
+	std::size_t triangles_without_normals;
+};
+
+// Counts the records of an OBJ file without parsing their values, so that
+// stream_wavefront and its consumers can allocate exactly.
+bool scan_wavefront(std::string const& path, wavefront_counts& counts);
+
+// Receives count expanded triangle vertices (three per triangle); returning
+// false stops the stream.
+using wavefront_sink = std::function<
+	bool (glm::vec3 const* vertices, glm::vec2 const* uvs, glm::vec3 const* normals, std::size_t count)
+>;
+
+// Parses an OBJ file in one pass through a fixed-size read buffer and hands
+// its triangles to sink in chunks of chunk_triangles. The position, uv and
+// normal pools the faces index into are kept whole, reserved exactly from
+// counts: memory is O(counts.positions + counts.uvs + counts.normals), 12, 8
+// and 12 bytes per record, plus the read buffer and one chunk. It does not
+// grow with the number of faces, and no expanded copy of the mesh is ever
+// built, but a file whose pools do not fit in memory cannot be streamed. For
+// the same reason, corners without a normal get their triangle's flat
+// normal.
+bool stream_wavefront(
+	std::string const& path,
+	wavefront_counts const& counts,
+	std::size_t chunk_triangles,
+	wavefront_sink const& sink
+);
+
 } // namespace impl
 } // namespace gl
 } // namespace graphics
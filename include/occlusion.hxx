@@ -0,0 +1,182 @@
+#ifndef MRR_GRAPHICS_OCCLUSION_HXX__
+#define MRR_GRAPHICS_OCCLUSION_HXX__
+
+#include <mrr/graphics/bounds.hxx>
+#include <mrr/graphics/gl-common.hxx>
+
+#include <cstddef>
+#include <iosfwd>
+#include <unordered_map>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+namespace mrr {
+namespace graphics {
+namespace gl {
+
+shader_handle occlusion_box_shader();
+
+
+// Low resolution depth buffer rasterized on the CPU, with a chain of levels
+// each holding the farthest depth of 2x2 texels of the one below. Depths
+// are window depths in [0, 1].
+//
+// Rasterization is conservative: a texel only takes the depth of a triangle
+// that covers it entirely, at the farthest depth over the texel, so the
+// pyramid never reports a box occluded that is visible at full resolution.
+class depth_pyramid
+{
+public:
+	depth_pyramid(GLsizei width, GLsizei height);
+
+	void clear();
+
+	// Rasterizes triangles of positions, transformed by mvp, into level 0.
+	// With no indices, consecutive triples of positions are triangles.
+	// Triangles crossing the near plane are skipped. Returns the number of
+	// triangles rasterized.
+	::std::size_t rasterize(
+		::glm::mat4 const& mvp,
+		::glm::vec3 const* positions, ::std::size_t position_count,
+		unsigned int const* indices = nullptr, ::std::size_t index_count = 0
+	);
+
+	// Rebuilds every level above level 0.
+	void build();
+
+	// Whether the box b, in the space mvp maps from, lies behind the depth
+	// of every texel it covers. Boxes crossing the near plane or outside
+	// the viewport are never occluded.
+	bool is_occluded(aabb const& b, ::glm::mat4 const& mvp) const;
+
+	::std::size_t get_level_count() const;
+	GLsizei get_width(::std::size_t level = 0) const;
+	GLsizei get_height(::std::size_t level = 0) const;
+	float get_depth(GLsizei x, GLsizei y, ::std::size_t level = 0) const;
+
+private:
+	struct level
+	{
+		GLsizei width;
+		GLsizei height;
+		::std::vector<float> depth;
+	};
+
+	::std::vector<level> levels_;
+	::std::vector<::glm::vec4> clip_;
+};
+
+
+enum class occlusion_backend
+{
+	// Frustum culling only.
+	none,
+	// Bounds tested against a depth_pyramid of last frame's visible
+	// components.
+	depth_pyramid,
+	// Components drawn under GL_ANY_SAMPLES_PASSED conditional rendering of
+	// their bounding boxes.
+	queries
+};
+
+// Counters of the last occlusion_culler::render().
+struct occlusion_stats
+{
+	occlusion_stats();
+
+	::std::size_t components;
+	::std::size_t frustum_culled;
+	// For queries, the results of the previous frame available by now.
+	::std::size_t occluded;
+	::std::size_t occluders;
+	::std::size_t occluder_triangles;
+	// CPU time spent culling, excluding the draws of visible components.
+	double cull_ms;
+};
+
+::std::ostream& operator <<(::std::ostream& out, occlusion_stats const& s);
+
+
+// Renders the components of a model tree, skipping those hidden behind
+// others. Components are drawn front to back, and those visible in the last
+// frame are the occluders of this one. With queries, a visible component is
+// only found hidden by the query around its draw, so it stays drawn for a
+// frame after it is hidden; either way it is drawn again once revealed.
+//
+// The queries backend keeps one query object per component; destroy the
+// culler before the GL context.
+class occlusion_culler
+{
+public:
+	occlusion_culler(
+		occlusion_backend backend = occlusion_backend::depth_pyramid,
+		GLsizei width = 256, GLsizei height = 128
+	);
+	occlusion_culler(occlusion_culler const&) = delete;
+	occlusion_culler& operator =(occlusion_culler const&) = delete;
+	~occlusion_culler();
+
+	void set_backend(occlusion_backend backend);
+	occlusion_backend get_backend() const;
+
+	// Draws the bounding boxes of the queries backend; occlusion_box_shader()
+	// unless set. Only the MVP uniform is set.
+	void set_box_shader(shader_handle const& s);
+
+	// Triangles rasterized into the depth pyramid per frame, taken from the
+	// nearest occluders first. Only components with a CPU copy of their mesh
+	// (see component::load_wavefront) drawn as triangles can occlude; those
+	// whose copy cpu_copy_policy::release freed are warned about once.
+	void set_occluder_budget(::std::size_t triangles);
+
+	void render(model const& m, ::glm::mat4 const& V, ::glm::mat4 const& P);
+
+	occlusion_stats const& get_stats() const;
+	depth_pyramid const& get_depth_pyramid() const;
+
+private:
+	struct object_state
+	{
+		object_state();
+
+		bool visible;
+		GLuint query;
+		bool query_pending;
+		::std::size_t frame;
+		bool warned_released;
+	};
+
+	struct object
+	{
+		component const* target;
+		object_state* state;
+		float distance;
+	};
+
+	void collect(model const& m, frustum const& view, ::glm::mat4 const& V);
+	void render_depth_pyramid(::glm::mat4 const& V, ::glm::mat4 const& P);
+	void render_queries(::glm::mat4 const& V, ::glm::mat4 const& P);
+	void draw_box(component const& c, ::glm::mat4 const& VP);
+	void delete_queries();
+
+	occlusion_backend backend_;
+	depth_pyramid pyramid_;
+	::std::size_t occluder_budget_;
+	::std::size_t frame_;
+	occlusion_stats stats_;
+
+	::std::vector<object> objects_;
+	::std::unordered_map<component const*, object_state> states_;
+
+	bool has_box_shader_;
+	shader_handle box_shader_;
+	GLuint box_mvp_id_;
+	buffer box_buffer_;
+};
+
+} // namespace gl
+} // namespace graphics
+} // namespace mrr
+
+#endif // #ifndef MRR_GRAPHICS_OCCLUSION_HXX__
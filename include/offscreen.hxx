@@ -0,0 +1,103 @@
+#ifndef MRR_GRAPHICS_OFFSCREEN_HXX__
+#define MRR_GRAPHICS_OFFSCREEN_HXX__
+
+#include <GL/glew.h>
+
+#include <cstddef>
+#include <functional>
+#include <string>
+#include <vector>
+
+namespace mrr {
+namespace graphics {
+namespace gl {
+
+// A framebuffer object with an RGBA8 colour and a 24 bit depth renderbuffer,
+// the render target of headless contexts (headless.hxx).
+class framebuffer
+{
+public:
+	framebuffer(GLsizei width, GLsizei height);
+	framebuffer(framebuffer const&) = delete;
+	framebuffer& operator =(framebuffer const&) = delete;
+	~framebuffer();
+
+	// Binds for drawing and reading and sets the viewport to cover it.
+	void bind() const;
+	static void bind_default();
+
+	bool is_complete() const;
+	GLsizei get_width() const;
+	GLsizei get_height() const;
+
+private:
+	GLsizei width_;
+	GLsizei height_;
+	GLuint framebuffer_id_;
+	GLuint colour_id_;
+	GLuint depth_id_;
+};
+
+
+// Reads frames back through a ring of pixel pack buffers. capture() only
+// queues a copy of the bound read framebuffer into the next buffer and
+// returns; the pixels are handed to the consumer once the ring wraps around
+// to that buffer again, by which time the copy has long finished. With two
+// buffers the CPU works on frame n - 1 while the GPU renders frame n, instead
+// of waiting on glReadPixels every frame.
+//
+// The consumer gets tightly packed RGBA rows, bottom row first, that are only
+// valid during the call.
+class async_readback
+{
+public:
+	using consumer_type = ::std::function<
+		void (unsigned char const* rgba, GLsizei width, GLsizei height, std::size_t frame)
+	>;
+
+	async_readback(
+		GLsizei width, GLsizei height, consumer_type consumer, std::size_t buffer_count = 2
+	);
+	async_readback(async_readback const&) = delete;
+	async_readback& operator =(async_readback const&) = delete;
+	~async_readback();
+
+	void capture();
+
+	// Hands every outstanding frame to the consumer, oldest first.
+	void flush();
+
+	std::size_t get_pending() const;
+	std::size_t get_frames_captured() const;
+
+private:
+	void finish(std::size_t index);
+
+	struct slot
+	{
+		GLuint buffer_id;
+		GLsync fence;
+		std::size_t frame;
+	};
+
+	GLsizei width_;
+	GLsizei height_;
+	consumer_type consumer_;
+	std::vector<slot> slots_;
+	std::size_t next_;
+	std::size_t pending_;
+	std::size_t frames_captured_;
+};
+
+
+// Writes RGBA pixels as returned by glReadPixels (bottom row first) to a
+// binary PPM file, dropping alpha.
+bool write_ppm(
+	::std::string const& path, unsigned char const* rgba, GLsizei width, GLsizei height
+);
+
+} // namespace gl
+} // namespace graphics
+} // namespace mrr
+
+#endif // #ifndef MRR_GRAPHICS_OFFSCREEN_HXX__
@@ -0,0 +1,179 @@
+#ifndef MRR_GRAPHICS_PAGING_HXX__
+#define MRR_GRAPHICS_PAGING_HXX__
+
+#include <mrr/graphics/bounds.hxx>
+#include <mrr/graphics/gl-common.hxx>
+#include <mrr/graphics/mapped_file.hxx>
+
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <iosfwd>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace mrr {
+namespace graphics {
+namespace gl {
+
+class residency_manager;
+
+
+// A mesh split into spatial chunks that are paged in and out of GPU memory
+// by a residency_manager. The chunks live in a pack file written by build()
+// and memory mapped by open(); only resident chunks are drawn. Materials,
+// lights and transforms work as for any component.
+class paged_mesh : public component
+{
+public:
+	paged_mesh();
+	paged_mesh(paged_mesh const&) = delete;
+	paged_mesh& operator =(paged_mesh const&) = delete;
+	~paged_mesh();
+
+	// Splits the triangles of an OBJ file by centroid into a grid of
+	// cells_per_axis^3 cells and writes the non-empty ones as chunks of a
+	// pack file. The OBJ file is streamed, and cells are spilled to temporary
+	// files next to the pack, so memory use is bounded by the largest chunk.
+	static bool build(
+		std::string const& obj_path, std::string const& pack_path, unsigned cells_per_axis = 8
+	);
+
+	// Maps a pack file. Removes the mesh from its residency manager first.
+	bool open(std::string const& pack_path);
+
+	std::size_t get_chunk_count() const;
+	aabb const& get_chunk_bounds(std::size_t chunk) const;
+	std::size_t get_chunk_size(std::size_t chunk) const;
+	bool is_resident(std::size_t chunk) const;
+
+	virtual void render(::glm::mat4 const& V, ::glm::mat4 const& P) const;
+
+private:
+	friend class residency_manager;
+
+	enum class chunk_state { absent, requested, loaded, resident };
+
+	struct chunk
+	{
+		aabb bounds;
+		std::uint64_t offset;
+		std::uint32_t vertex_count;
+		chunk_state state;
+		float priority;
+		bool visible;
+		::mrr::graphics::gl::buffer data;
+	};
+
+	mapped_file pack_;
+	std::vector<chunk> chunks_;
+	residency_manager* manager_;
+};
+
+
+// Residency counters. Totals count since construction; the rest describe
+// the last update().
+struct residency_stats
+{
+	residency_stats();
+
+	std::size_t chunks;
+	std::size_t visible_chunks;
+	std::size_t resident_chunks;
+	std::size_t resident_bytes;
+	std::size_t pending_loads;
+	std::size_t uploaded_bytes;
+	// Visible chunks that were not resident and are missing from the frame.
+	std::size_t missing_chunks;
+
+	std::size_t total_loads;
+	std::size_t total_evictions;
+	// Frames with missing chunks.
+	std::size_t total_stalled_frames;
+	// Frames in which loaded chunks had to wait for the upload budget.
+	std::size_t total_budget_stalls;
+	// Loaded chunks dropped because they did not fit under the memory cap.
+	std::size_t total_cap_rejections;
+};
+
+::std::ostream& operator <<(::std::ostream& out, residency_stats const& s);
+
+
+// Keeps the most important chunks of its paged meshes resident. Every
+// update() ranks all chunks by projected screen size, with chunks outside the
+// view frustum discounted to prefetch priority, then:
+//
+//  - queues the highest ranked absent chunks for a loader thread, which reads
+//    them from the mapped pack files,
+//  - uploads loaded chunks, best first, until the per-frame byte budget is
+//    spent (always at least one),
+//  - evicts the lowest ranked resident chunks whenever an upload would exceed
+//    the memory cap, but never for a chunk ranked below them.
+class residency_manager
+{
+public:
+	residency_manager(
+		std::size_t memory_cap = std::size_t(256) << 20,
+		std::size_t upload_budget = std::size_t(8) << 20
+	);
+	residency_manager(residency_manager const&) = delete;
+	residency_manager& operator =(residency_manager const&) = delete;
+	~residency_manager();
+
+	void set_memory_cap(std::size_t bytes);
+	void set_upload_budget(std::size_t bytes_per_frame);
+	// Chunks read ahead of uploading, 8 by default.
+	void set_max_pending_loads(std::size_t count);
+
+	void add(paged_mesh& m);
+	void remove(paged_mesh& m);
+
+	// Call once per frame, before rendering, with the camera of the frame.
+	void update(::glm::mat4 const& V, ::glm::mat4 const& P);
+
+	residency_stats const& get_stats() const;
+
+private:
+	struct chunk_ref
+	{
+		paged_mesh* mesh;
+		std::size_t chunk;
+	};
+
+	struct load
+	{
+		chunk_ref ref;
+		std::vector<unsigned char> data;
+	};
+
+	void prioritize(::glm::mat4 const& V, ::glm::mat4 const& P);
+	void request_loads();
+	void upload_loads();
+	bool make_room(std::size_t bytes, float priority);
+	void evict(chunk_ref const& r);
+	void loader();
+
+	std::vector<paged_mesh*> meshes_;
+	std::size_t memory_cap_;
+	std::size_t upload_budget_;
+	std::size_t max_pending_loads_;
+	residency_stats stats_;
+
+	// Shared with the loader thread. The loader holds read_mutex_ while it
+	// reads a chunk so that remove() can wait for it.
+	std::mutex mutex_;
+	std::mutex read_mutex_;
+	std::condition_variable wake_;
+	std::deque<chunk_ref> requests_;
+	std::vector<load> loaded_;
+	bool stop_;
+	std::thread thread_;
+};
+
+} // namespace gl
+} // namespace graphics
+} // namespace mrr
+
+#endif // #ifndef MRR_GRAPHICS_PAGING_HXX__
@@ -0,0 +1,61 @@
+#ifndef MRR_GRAPHICS_PARALLEL_HXX__
+#define MRR_GRAPHICS_PARALLEL_HXX__
+
+#include <algorithm>
+#include <cstddef>
+#include <thread>
+#include <vector>
+
+namespace mrr {
+namespace graphics {
+namespace gl {
+namespace impl {
+
+// Queried once, as hardware_concurrency() may read the system's CPU list on
+// every call.
+inline std::size_t worker_count()
+{
+	static std::size_t const n = std::max<std::size_t>(std::thread::hardware_concurrency(), 1);
+	return n;
+}
+
+// Splits [0, count) into at most worker_count() contiguous ranges of at least
+// grain elements and calls body(begin, end) for each, one range on the
+// calling thread and the rest on their own threads. Ranges never overlap, so
+// bodies that only write to their own range need no synchronization.
+template <typename Body>
+void parallel_for(std::size_t count, std::size_t grain, Body const& body)
+{
+	if (count == 0)
+		return;
+
+	grain = std::max<std::size_t>(grain, 1);
+	std::size_t chunks = std::min(worker_count(), (count + grain - 1) / grain);
+	if (chunks <= 1)
+	{
+		body(std::size_t(0), count);
+		return;
+	}
+
+	std::size_t per_chunk = (count + chunks - 1) / chunks;
+
+	std::vector<std::thread> workers;
+	workers.reserve(chunks - 1);
+	for (std::size_t begin = per_chunk; begin < count; begin += per_chunk)
+	{
+		std::size_t end = std::min(count, begin + per_chunk);
+		workers.emplace_back([&body, begin, end]() { body(begin, end); });
+	}
+
+	body(std::size_t(0), std::min(count, per_chunk));
+
+	for (auto& w : workers)
+		w.join();
+}
+
+} // namespace impl
+} // namespace gl
+} // namespace graphics
+} // namespace mrr
+
+#endif // #ifndef MRR_GRAPHICS_PARALLEL_HXX__
@@ -0,0 +1,188 @@
+#ifndef MRR_GRAPHICS_PICKING_HXX__
+#define MRR_GRAPHICS_PICKING_HXX__
+
+#include <mrr/graphics/bounds.hxx>
+#include <mrr/graphics/gl-common.hxx>
+
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+namespace mrr {
+namespace graphics {
+namespace gl {
+
+// The points origin + t * direction for t in [t_min, t_max]; a segment when
+// t_max is finite. The direction need not be normalized.
+struct ray
+{
+	ray();
+	ray(::glm::vec3 const& origin, ::glm::vec3 const& direction,
+		float t_min = 0.0f, float t_max = ::std::numeric_limits<float>::infinity());
+
+	::glm::vec3 origin;
+	::glm::vec3 direction;
+	float t_min;
+	float t_max;
+};
+
+// The segment from the near to the far plane through window position (x, y)
+// of a width by height window, with the origin at its top left as in
+// window_handle::get_cursor_position. t runs from 0 at the near plane to 1
+// at the far plane.
+ray pick_ray(float x, float y, float width, float height, ::glm::mat4 const& V, ::glm::mat4 const& P);
+
+
+// The closest intersection along a ray. triangle indexes the triangles of
+// the component's level 0 indices, or its consecutive vertex triples if
+// unindexed; the point hit is (1 - u - v) * v0 + u * v1 + v * v2 for the
+// barycentrics (u, v).
+struct ray_hit
+{
+	ray_hit();
+
+	component const* target;
+	::std::uint32_t triangle;
+	float t;
+	::glm::vec2 barycentrics;
+};
+
+
+namespace impl {
+
+// Node of a bounding volume hierarchy, laid out depth first. Leaves hold
+// count primitives from offset in the primitive order; interior nodes have
+// count 0, their first child next to them and their second at offset. axis
+// is the axis they were split on.
+struct bvh_node
+{
+	::glm::vec3 lower;
+	::std::uint32_t offset;
+	::glm::vec3 upper;
+	::std::uint16_t count;
+	::std::uint16_t axis;
+};
+
+// Builds a hierarchy over primitives with the given bounds, splitting by the
+// surface area heuristic evaluated over 16 bins of centroids per axis.
+// Large nodes are binned and their subtrees built on several threads. order
+// receives the primitives in the order the leaves refer to them.
+void build_bvh(
+	::std::vector<aabb> const& bounds, ::std::size_t leaf_size,
+	::std::vector<bvh_node>& nodes, ::std::vector<::std::uint32_t>& order
+);
+
+// Up to four rays traced together, one per lane, in world or model space.
+struct ray_packet;
+
+} // namespace impl
+
+
+// Hierarchy over the triangles of a mesh, in model space.
+class mesh_bvh
+{
+public:
+	mesh_bvh();
+
+	// With no indices, consecutive triples of vertices are triangles.
+	void build(::std::vector<::glm::vec3> const& vertices, ::std::vector<unsigned int> const& indices);
+
+	// Whether r hits a triangle closer than hit.t, which is then updated with
+	// it. hit.target is left alone.
+	bool intersect(ray const& r, ray_hit& hit) const;
+
+	::std::size_t get_triangle_count() const;
+	::std::size_t get_node_count() const;
+	::std::size_t get_depth() const;
+
+private:
+	friend class picker;
+
+	// Vertex 0 and the edges to vertices 1 and 2.
+	struct triangle
+	{
+		::glm::vec3 v0;
+		::glm::vec3 e1;
+		::glm::vec3 e2;
+	};
+
+	// Lanes of active hit a triangle closer than their hit; returns the
+	// lanes hit.
+	int intersect(impl::ray_packet& packet, int active, ray_hit* hits) const;
+
+	::std::vector<impl::bvh_node> nodes_;
+	// In leaf order, with the index of each in the mesh.
+	::std::vector<triangle> triangles_;
+	::std::vector<::std::uint32_t> ids_;
+};
+
+
+// Finds the component and triangle under a ray. update() collects the
+// components of a model, builds a mesh_bvh for each new mesh, in parallel,
+// and a top-level hierarchy over the world bounds of all of them, which
+// queries then traverse before the meshes of the components they reach.
+//
+// Meshes are read from component::get_vertices and get_indices, so
+// components without a CPU copy (stream_wavefront) or not drawn as
+// GL_TRIANGLES are skipped; so are those whose copy cpu_copy_policy::release
+// freed, with a warning the first time. A mesh_bvh is rebuilt when the component's
+// vertex or index storage changes, as on reload_wavefront; call update()
+// again whenever components move.
+class picker
+{
+public:
+	picker();
+	picker(picker const&) = delete;
+	picker& operator =(picker const&) = delete;
+
+	void update(model const& m);
+
+	// The closest hit, with a null target on a miss.
+	ray_hit intersect(ray const& r) const;
+
+	// Traces rays in packets of four, which share the traversal; rays close
+	// to one another, such as those of neighbouring pixels, trace fastest.
+	void intersect(ray const* rays, ray_hit* hits, ::std::size_t count) const;
+
+	::std::size_t get_component_count() const;
+	// Null if c was not collected by the last update().
+	mesh_bvh const* get_mesh_bvh(component const& c) const;
+
+private:
+	struct cached_mesh
+	{
+		mesh_bvh bvh;
+		void const* vertices;
+		::std::size_t vertex_count;
+		void const* indices;
+		::std::size_t index_count;
+		bool used;
+	};
+
+	struct instance
+	{
+		component const* target;
+		mesh_bvh const* bvh;
+		::glm::mat4 world_to_model;
+	};
+
+	void collect(model const& m);
+	void intersect_packet(impl::ray_packet& packet, int active, ray_hit* hits) const;
+
+	::std::unordered_map<component const*, cached_mesh> meshes_;
+	// Components skipped for a released CPU copy, already warned about.
+	::std::unordered_set<component const*> released_;
+	::std::vector<instance> instances_;
+	::std::vector<impl::bvh_node> nodes_;
+};
+
+} // namespace gl
+} // namespace graphics
+} // namespace mrr
+
+#endif // #ifndef MRR_GRAPHICS_PICKING_HXX__
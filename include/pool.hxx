@@ -0,0 +1,265 @@
+#ifndef MRR_GRAPHICS_POOL_HXX__
+#define MRR_GRAPHICS_POOL_HXX__
+
+#include <cstddef>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace mrr {
+namespace graphics {
+namespace gl {
+
+class model;
+
+namespace impl {
+
+// Blocks of power of two size classes, from 16 bytes to 64 KiB, carved
+// from 64 KiB slabs. Freed blocks go back to their class and never to the
+// heap, so containers that have stopped growing stop allocating; only new
+// slabs and larger blocks count as render_stats::heap_allocations.
+void* pool_allocate(std::size_t bytes);
+void pool_deallocate(void* p, std::size_t bytes);
+
+// Counts an allocation from the heap in the current frame's render_stats.
+void count_heap_allocation();
+
+// Standard allocator over pool_allocate.
+template <typename T>
+class pool_allocator
+{
+public:
+	using value_type = T;
+
+	pool_allocator() = default;
+	template <typename U>
+	pool_allocator(pool_allocator<U> const&) {}
+
+	T* allocate(std::size_t n)
+	{
+		return static_cast<T*>(pool_allocate(n * sizeof(T)));
+	}
+
+	void deallocate(T* p, std::size_t n)
+	{
+		pool_deallocate(p, n * sizeof(T));
+	}
+};
+
+template <typename T, typename U>
+bool operator ==(pool_allocator<T> const&, pool_allocator<U> const&) { return true; }
+template <typename T, typename U>
+bool operator !=(pool_allocator<T> const&, pool_allocator<U> const&) { return false; }
+
+} // namespace impl
+
+
+//m=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-
+// The children of a model: distinct pointers, kept in address order in one
+// pooled array, so that iterating them reads contiguous memory.
+class child_list
+{
+public:
+	using const_iterator = model* const*;
+
+	const_iterator begin() const;
+	const_iterator end() const;
+	std::size_t size() const;
+	bool empty() const;
+	bool contains(model* m) const;
+
+	// Return whether the list changed.
+	bool insert(model* m);
+	bool erase(model* m);
+
+private:
+	std::vector<model*, impl::pool_allocator<model*>> models_;
+};
+
+
+//m=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-
+// Storage for many objects of one type, such as the components of a scene,
+// in slabs of SlabSize, so that objects created together sit together in
+// memory and creating them rarely touches the heap. Destroyed objects'
+// slots are reused first. The pool destroys whatever is left with it.
+template <typename T, std::size_t SlabSize = 64>
+class node_pool
+{
+public:
+	node_pool()
+		: free_(nullptr),
+		  size_(0)
+	{
+	}
+
+	~node_pool()
+	{
+		for (auto& slab : slabs_)
+			for (std::size_t i = 0; i < SlabSize; ++i)
+				if (slab[i].live)
+					reinterpret_cast<T*>(&slab[i].storage)->~T();
+	}
+
+	node_pool(node_pool const&) = delete;
+	node_pool& operator =(node_pool const&) = delete;
+
+	template <typename... Args>
+	T* create(Args&&... args)
+	{
+		if (free_ == nullptr)
+			grow();
+
+		slot* s = free_;
+		T* object = new (&s->storage) T(std::forward<Args>(args)...);
+		free_ = s->next;
+		s->live = true;
+		++size_;
+		return object;
+	}
+
+	void destroy(T* object)
+	{
+		if (object == nullptr)
+			return;
+
+		object->~T();
+		slot* s = reinterpret_cast<slot*>(object);
+		s->live = false;
+		s->next = free_;
+		free_ = s;
+		--size_;
+	}
+
+	std::size_t size() const { return size_; }
+	std::size_t capacity() const { return slabs_.size() * SlabSize; }
+
+private:
+	// The storage comes first, so an object's address is its slot's.
+	struct slot
+	{
+		typename std::aligned_storage<sizeof(T), alignof(T)>::type storage;
+		slot* next;
+		bool live;
+	};
+
+	void grow()
+	{
+		impl::count_heap_allocation();
+		slabs_.emplace_back(new slot[SlabSize]);
+		slot* slab = slabs_.back().get();
+		for (std::size_t i = SlabSize; i-- > 0; )
+		{
+			slab[i].live = false;
+			slab[i].next = free_;
+			free_ = &slab[i];
+		}
+	}
+
+	std::vector<std::unique_ptr<slot[]>> slabs_;
+	slot* free_;
+	std::size_t size_;
+};
+
+
+//m=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-
+// Memory for the temporaries of one frame, handed out by bumping an offset
+// and released all at once by reset(), which window_handle::main_loop calls
+// before every frame. A frame that outgrows the first block continues in
+// further ones; reset() then replaces them with one block that fits the
+// whole frame, so that a steady state needs no heap allocation at all.
+//
+// Nothing allocated from the arena is destroyed; create() only accepts
+// trivially destructible types, and containers using arena_allocator must
+// be gone by the reset.
+class frame_arena
+{
+public:
+	explicit frame_arena(std::size_t block_size = std::size_t(1) << 20);
+
+	frame_arena(frame_arena const&) = delete;
+	frame_arena& operator =(frame_arena const&) = delete;
+
+	void* allocate(std::size_t bytes, std::size_t alignment = alignof(std::max_align_t));
+
+	template <typename T, typename... Args>
+	T* create(Args&&... args)
+	{
+		static_assert(std::is_trivially_destructible<T>::value, "frame_arena never runs destructors");
+		return new (allocate(sizeof(T), alignof(T))) T(std::forward<Args>(args)...);
+	}
+
+	template <typename T>
+	T* allocate_array(std::size_t count)
+	{
+		static_assert(std::is_trivially_destructible<T>::value, "frame_arena never runs destructors");
+		return static_cast<T*>(allocate(count * sizeof(T), alignof(T)));
+	}
+
+	void reset();
+
+	// Bytes handed out since the last reset, and the most in any frame.
+	std::size_t get_used() const;
+	std::size_t get_high_water() const;
+	std::size_t get_capacity() const;
+
+private:
+	struct block
+	{
+		std::unique_ptr<unsigned char[]> data;
+		std::size_t size;
+	};
+
+	void add_block(std::size_t size);
+
+	std::size_t block_size_;
+	std::vector<block> blocks_;
+	std::size_t current_;
+	std::size_t offset_;
+	std::size_t used_;
+	std::size_t high_water_;
+};
+
+// Standard allocator over a frame_arena, for per-frame containers.
+// Deallocation is a no-op; the memory returns at the next reset.
+template <typename T>
+class arena_allocator
+{
+public:
+	using value_type = T;
+
+	explicit arena_allocator(frame_arena& arena) : arena_(&arena) {}
+	template <typename U>
+	arena_allocator(arena_allocator<U> const& other) : arena_(other.get_arena()) {}
+
+	T* allocate(std::size_t n)
+	{
+		return static_cast<T*>(arena_->allocate(n * sizeof(T), alignof(T)));
+	}
+
+	void deallocate(T*, std::size_t) {}
+
+	frame_arena* get_arena() const { return arena_; }
+
+private:
+	frame_arena* arena_;
+};
+
+template <typename T, typename U>
+bool operator ==(arena_allocator<T> const& a, arena_allocator<U> const& b)
+{
+	return a.get_arena() == b.get_arena();
+}
+
+template <typename T, typename U>
+bool operator !=(arena_allocator<T> const& a, arena_allocator<U> const& b)
+{
+	return !(a == b);
+}
+
+} // namespace gl
+} // namespace graphics
+} // namespace mrr
+
+#endif // #ifndef MRR_GRAPHICS_POOL_HXX__
@@ -0,0 +1,94 @@
+#ifndef MRR_GRAPHICS_QUANTIZE_HXX__
+#define MRR_GRAPHICS_QUANTIZE_HXX__
+
+#include <cstdint>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+namespace mrr {
+namespace graphics {
+namespace gl {
+namespace impl {
+
+// Compact vertex attribute encodings.
+//
+//   position  3 x unorm16, relative to the mesh bounds
+//   normal    2 x snorm16, octahedral encoding
+//   uv        2 x half float
+//
+// 14 bytes per vertex instead of 32 with glm::vec3/vec2/vec3 attributes, less
+// than half the vertex bandwidth. Positions are tightly packed, a 6 byte
+// stride.
+
+struct quantized_position
+{
+	std::uint16_t x, y, z;
+};
+
+static_assert(sizeof(quantized_position) == 6, "positions are uploaded with a 6 byte stride");
+
+struct quantized_normal
+{
+	std::int16_t x, y;
+};
+
+struct quantized_uv
+{
+	std::uint16_t u, v;
+};
+
+// Precision lost by quantizing one mesh.
+struct quantization_error
+{
+	float max_position;
+	float mean_position;
+	float max_normal_degrees;
+	float max_uv;
+};
+
+std::uint16_t float_to_half(float f);
+float half_to_float(std::uint16_t h);
+
+glm::vec2 encode_octahedral(glm::vec3 const& n);
+glm::vec3 decode_octahedral(glm::vec2 const& e);
+
+// Quantizes positions relative to the box [offset, offset + scale]; the
+// shader reconstructs offset + scale * unorm.
+void quantize_positions(
+	std::vector<glm::vec3> const& positions,
+	glm::vec3 const& offset,
+	glm::vec3 const& scale,
+	std::vector<quantized_position>& out
+);
+
+void quantize_normals(
+	std::vector<glm::vec3> const& normals,
+	std::vector<quantized_normal>& out
+);
+
+void quantize_uvs(
+	std::vector<glm::vec2> const& uvs,
+	std::vector<quantized_uv>& out
+);
+
+// Decodes the quantized attributes again and measures the difference to the
+// originals. Empty attribute arrays are skipped.
+quantization_error measure_quantization_error(
+	std::vector<glm::vec3> const& positions,
+	std::vector<glm::vec3> const& normals,
+	std::vector<glm::vec2> const& uvs,
+	glm::vec3 const& offset,
+	glm::vec3 const& scale,
+	std::vector<quantized_position> const& qpositions,
+	std::vector<quantized_normal> const& qnormals,
+	std::vector<quantized_uv> const& quvs
+);
+
+} // namespace impl
+} // namespace gl
+} // namespace graphics
+} // namespace mrr
+
+
+#endif // #ifndef MRR_GRAPHICS_QUANTIZE_HXX__
@@ -0,0 +1,146 @@
+#ifndef MRR_GRAPHICS_SCENE_HXX__
+#define MRR_GRAPHICS_SCENE_HXX__
+
+#include <mrr/graphics/gl-common.hxx>
+#include <mrr/graphics/pool.hxx>
+#include <mrr/graphics/waypoint.hxx>
+
+#include <cstddef>
+#include <iosfwd>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace mrr {
+namespace graphics {
+namespace gl {
+
+// Binary scene snapshots: a model tree with its transforms, lights,
+// shaders, materials and meshes, and the waypoints acting on it, saved from
+// a live tree and loaded again without any of the calls that built it.
+//
+// The file is a header and tables of fixed size records, referring to each
+// other by index and to their data by offset from the start of the file, so
+// that it is used where it is mapped. Meshes are the contents of the GPU
+// buffers of each component, read back at save time and stored once however
+// many components share them; loading uploads them from the mapping as they
+// are, with no OBJ parsing, welding, optimization or quantization. Only
+// shader programs are compiled again, all at once with a shader_batch.
+//
+// Not saved: light clusters, broadphases, occlusion state and anything else
+// that refers to objects outside the tree. Nodes are saved as model or
+// component; other subclasses load as their base.
+
+
+// Names for waypoint actions, which cannot be saved themselves. Actions from
+// get() remember their name and are saved by it; other actions are skipped
+// with a warning. Loading looks the names up again in the table it is given.
+class scene_actions
+{
+public:
+	void add(::std::string const& name, waypoint::action_type const& action);
+
+	// The named action, or an empty function if there is none.
+	waypoint::action_type get(::std::string const& name) const;
+
+	// The name of an action returned by get(), or nullptr.
+	static ::std::string const* name_of(waypoint::action_type const& action);
+
+private:
+	::std::map<::std::string, waypoint::action_type> actions_;
+};
+
+
+// Owns the nodes and waypoints of a loaded snapshot.
+class scene
+{
+public:
+	scene();
+	scene(scene const&) = delete;
+	scene& operator =(scene const&) = delete;
+
+	// nullptr until a snapshot is loaded.
+	model* get_root() const;
+	::std::vector<waypoint>& get_waypoints();
+	::std::vector<waypoint> const& get_waypoints() const;
+
+	::std::size_t get_model_count() const;
+	::std::size_t get_component_count() const;
+
+	void swap(scene& other);
+
+private:
+	friend class impl::scene_snapshot;
+
+	::std::unique_ptr<node_pool<model>> models_;
+	::std::unique_ptr<node_pool<component>> components_;
+	model* root_;
+	::std::vector<waypoint> waypoints_;
+};
+
+
+struct scene_save_report
+{
+	scene_save_report();
+
+	::std::size_t models;
+	::std::size_t components;
+	// Distinct meshes stored, of one per component with a mesh.
+	::std::size_t meshes;
+	::std::size_t shared_meshes;
+	::std::size_t waypoints;
+	::std::size_t skipped_actions;
+	::std::size_t bytes;
+	double save_ms;
+};
+
+::std::ostream& operator <<(::std::ostream& out, scene_save_report const& r);
+
+struct scene_load_report
+{
+	scene_load_report();
+
+	::std::size_t models;
+	::std::size_t components;
+	::std::size_t meshes;
+	::std::size_t waypoints;
+	::std::size_t bytes;
+	// Fraction of the file in the page cache before loading: near 0 for a
+	// cold load, 1 for a warm one.
+	double resident;
+	// Mapping and validating the file.
+	double map_ms;
+	double shader_ms;
+	// Creating the nodes and uploading their meshes.
+	double upload_ms;
+	double texture_ms;
+	double total_ms;
+};
+
+::std::ostream& operator <<(::std::ostream& out, scene_load_report const& r);
+
+// Saves root, everything under it and the waypoints. The GL context of the
+// tree must be current. Prints the reason and returns false on failure.
+bool save_scene(
+	::std::string const& path,
+	model const& root,
+	::std::vector<waypoint> const& waypoints,
+	scene_save_report* out_report = nullptr
+);
+
+// Loads a snapshot into out, which keeps its current contents on failure.
+// Waypoint actions are looked up by name in actions; unknown names are
+// skipped with a warning. Prints the reason and returns false on failure.
+bool load_scene(
+	::std::string const& path,
+	scene& out,
+	scene_actions const& actions,
+	scene_load_report* out_report = nullptr
+);
+
+} // namespace gl
+} // namespace graphics
+} // namespace mrr
+
+#endif // #ifndef MRR_GRAPHICS_SCENE_HXX__
@@ -3,9 +3,67 @@
 
 #include <GL/glew.h>
 
+#include <string>
+#include <vector>
+
 GLuint load_shaders(
 	char const* vertex_file_path,
 	char const* fragment_file_path
 );
 
+// As above, with defines (lines of "#define NAME VALUE") inserted into both
+// sources right after their #version directive.
+GLuint load_shaders(
+	char const* vertex_file_path,
+	char const* fragment_file_path,
+	char const* defines
+);
+
+
+// Compiles many programs without a driver stall per program. submit() reads
+// and preprocesses every file on worker threads, then issues every compile
+// and every link before any status is queried, so drivers that compile in
+// the background (GL_KHR_parallel_shader_compile, which is enabled when
+// present) work on all of them at once. finish() waits, reports errors and
+// returns the programs, 0 for those that failed.
+class shader_batch
+{
+public:
+	shader_batch();
+	shader_batch(shader_batch const&) = delete;
+	shader_batch& operator =(shader_batch const&) = delete;
+	~shader_batch();
+
+	// Returns the index of the program in the result of finish().
+	std::size_t add(
+		std::string const& vertex_file_path,
+		std::string const& fragment_file_path,
+		std::string const& defines = std::string()
+	);
+
+	std::size_t size() const;
+
+	void submit();
+
+	// Whether finish() would return without blocking. Always true without
+	// parallel shader compile support.
+	bool is_ready() const;
+
+	std::vector<GLuint> finish();
+
+private:
+	struct program
+	{
+		std::string vertex_file_path;
+		std::string fragment_file_path;
+		std::string defines;
+		GLuint vertex_shader_id;
+		GLuint fragment_shader_id;
+		GLuint program_id;
+	};
+
+	std::vector<program> programs_;
+	bool submitted_;
+};
+
 #endif // #ifndef MRR_GRAPHICS_SHADER_HXX__
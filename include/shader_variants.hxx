@@ -0,0 +1,79 @@
+#ifndef MRR_GRAPHICS_SHADER_VARIANTS_HXX__
+#define MRR_GRAPHICS_SHADER_VARIANTS_HXX__
+
+#include <mrr/graphics/gl-common.hxx>
+
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace mrr {
+namespace graphics {
+namespace gl {
+
+// A shader_key (gl-common.hxx) holds feature bits in the low byte and the
+// number of point sources above them. Lighting only appears in keys with at
+// least one light, so equivalent programs always share a key.
+namespace shader_feature {
+
+shader_key const textured      = 1 << 0;
+shader_key const vertex_colour = 1 << 1;
+shader_key const lit           = 1 << 2;
+shader_key const quantized     = 1 << 3;
+// One instance per view, each drawn into its own viewport (multiview.hxx).
+shader_key const multi_view    = 1 << 4;
+
+} // namespace shader_feature
+
+// The uniform arrays of the lit variants are sized exactly; scenes with more
+// lights should use clustered lighting (clustered.hxx).
+unsigned const max_variant_lights = 8;
+
+// Size of the per-view uniform arrays of the multi_view variants.
+unsigned const max_variant_views = 16;
+
+shader_key make_shader_key(
+	bool textured, bool vertex_colour, bool normals, bool quantized, std::size_t light_count
+);
+unsigned get_light_count(shader_key key);
+
+// The #define block that specializes the variant shaders for key.
+std::string get_shader_defines(shader_key key);
+
+
+// Compiles variants of one vertex/fragment shader pair on first use and
+// keeps them by key.
+class shader_variants
+{
+public:
+	shader_variants(
+		::std::string const& vertex_shader_file,
+		::std::string const& fragment_shader_file
+	);
+
+	shader_handle const& get(shader_key key);
+
+	// Compiles every missing variant of keys in one shader_batch, so that
+	// later get() calls never compile.
+	void preload(std::vector<shader_key> const& keys);
+
+	std::size_t size() const;
+	void clear();
+
+private:
+	::std::string vertex_shader_file_;
+	::std::string fragment_shader_file_;
+	::std::unordered_map<shader_key, shader_handle> programs_;
+};
+
+// Variants of shaders/variant-*-shader.glsl, used by
+// component::use_shader_variants. Call clear() before the GL context is
+// destroyed.
+shader_variants& default_shader_variants();
+
+} // namespace gl
+} // namespace graphics
+} // namespace mrr
+
+#endif // #ifndef MRR_GRAPHICS_SHADER_VARIANTS_HXX__
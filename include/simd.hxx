@@ -0,0 +1,152 @@
+#ifndef MRR_GRAPHICS_SIMD_HXX__
+#define MRR_GRAPHICS_SIMD_HXX__
+
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define MRR_GRAPHICS_SIMD_SSE2
+#endif
+
+namespace mrr {
+namespace graphics {
+namespace gl {
+namespace impl {
+
+// Four lane floats, with SSE2 where available and plain loops elsewhere.
+// Comparisons give masks with every bit of a lane set where they hold.
+#ifdef MRR_GRAPHICS_SIMD_SSE2
+
+struct float4
+{
+	__m128 v;
+};
+
+inline float4 splat(float f) { return float4{ ::_mm_set1_ps(f) }; }
+inline float4 load(float const* p) { return float4{ ::_mm_loadu_ps(p) }; }
+inline void store(float* p, float4 a) { ::_mm_storeu_ps(p, a.v); }
+
+inline float4 operator +(float4 a, float4 b) { return float4{ ::_mm_add_ps(a.v, b.v) }; }
+inline float4 operator -(float4 a, float4 b) { return float4{ ::_mm_sub_ps(a.v, b.v) }; }
+inline float4 operator *(float4 a, float4 b) { return float4{ ::_mm_mul_ps(a.v, b.v) }; }
+inline float4 operator /(float4 a, float4 b) { return float4{ ::_mm_div_ps(a.v, b.v) }; }
+inline float4 min(float4 a, float4 b) { return float4{ ::_mm_min_ps(a.v, b.v) }; }
+inline float4 max(float4 a, float4 b) { return float4{ ::_mm_max_ps(a.v, b.v) }; }
+inline float4 sqrt(float4 a) { return float4{ ::_mm_sqrt_ps(a.v) }; }
+inline float4 abs(float4 a) { return float4{ ::_mm_andnot_ps(::_mm_set1_ps(-0.0f), a.v) }; }
+
+inline float4 less(float4 a, float4 b) { return float4{ ::_mm_cmplt_ps(a.v, b.v) }; }
+inline float4 less_equal(float4 a, float4 b) { return float4{ ::_mm_cmple_ps(a.v, b.v) }; }
+inline float4 operator &(float4 a, float4 b) { return float4{ ::_mm_and_ps(a.v, b.v) }; }
+inline int lanes(float4 mask) { return ::_mm_movemask_ps(mask.v); }
+
+inline float4 mask(int lanes)
+{
+	__m128i bits = ::_mm_set_epi32(8, 4, 2, 1);
+	return float4{ ::_mm_castsi128_ps(
+		::_mm_cmpeq_epi32(::_mm_and_si128(::_mm_set1_epi32(lanes), bits), bits)
+	) };
+}
+
+inline float4 select(float4 mask, float4 a, float4 b)
+{
+	return float4{ ::_mm_or_ps(::_mm_and_ps(mask.v, a.v), ::_mm_andnot_ps(mask.v, b.v)) };
+}
+
+#else
+
+struct float4
+{
+	float v[4];
+};
+
+inline float4 splat(float f) { return float4{ { f, f, f, f } }; }
+inline float4 load(float const* p) { return float4{ { p[0], p[1], p[2], p[3] } }; }
+inline void store(float* p, float4 a) { std::memcpy(p, a.v, sizeof a.v); }
+
+#define MRR_GRAPHICS_FLOAT4_OP(name, expression) \
+	inline float4 name(float4 a, float4 b) \
+	{ \
+		float4 r; \
+		for (int i = 0; i < 4; ++i) \
+			r.v[i] = expression; \
+		return r; \
+	}
+
+inline float from_mask(bool b)
+{
+	std::uint32_t bits = b ? 0xffffffffu : 0u;
+	float f;
+	std::memcpy(&f, &bits, sizeof f);
+	return f;
+}
+
+inline bool to_mask(float f)
+{
+	std::uint32_t bits;
+	std::memcpy(&bits, &f, sizeof bits);
+	return bits != 0;
+}
+
+MRR_GRAPHICS_FLOAT4_OP(operator +, a.v[i] + b.v[i])
+MRR_GRAPHICS_FLOAT4_OP(operator -, a.v[i] - b.v[i])
+MRR_GRAPHICS_FLOAT4_OP(operator *, a.v[i] * b.v[i])
+MRR_GRAPHICS_FLOAT4_OP(operator /, a.v[i] / b.v[i])
+MRR_GRAPHICS_FLOAT4_OP(min, b.v[i] < a.v[i] ? b.v[i] : a.v[i])
+MRR_GRAPHICS_FLOAT4_OP(max, b.v[i] > a.v[i] ? b.v[i] : a.v[i])
+MRR_GRAPHICS_FLOAT4_OP(less, from_mask(a.v[i] < b.v[i]))
+MRR_GRAPHICS_FLOAT4_OP(less_equal, from_mask(a.v[i] <= b.v[i]))
+MRR_GRAPHICS_FLOAT4_OP(operator &, from_mask(to_mask(a.v[i]) && to_mask(b.v[i])))
+
+#undef MRR_GRAPHICS_FLOAT4_OP
+
+inline float4 sqrt(float4 a)
+{
+	float4 r;
+	for (int i = 0; i < 4; ++i)
+		r.v[i] = std::sqrt(a.v[i]);
+	return r;
+}
+
+inline float4 abs(float4 a)
+{
+	float4 r;
+	for (int i = 0; i < 4; ++i)
+		r.v[i] = std::fabs(a.v[i]);
+	return r;
+}
+
+inline int lanes(float4 mask)
+{
+	int r = 0;
+	for (int i = 0; i < 4; ++i)
+		r |= to_mask(mask.v[i]) << i;
+	return r;
+}
+
+inline float4 mask(int lanes)
+{
+	float4 r;
+	for (int i = 0; i < 4; ++i)
+		r.v[i] = from_mask((lanes >> i) & 1);
+	return r;
+}
+
+inline float4 select(float4 mask, float4 a, float4 b)
+{
+	float4 r;
+	for (int i = 0; i < 4; ++i)
+		r.v[i] = to_mask(mask.v[i]) ? a.v[i] : b.v[i];
+	return r;
+}
+
+#endif
+
+} // namespace impl
+} // namespace gl
+} // namespace graphics
+} // namespace mrr
+
+#endif // #ifndef MRR_GRAPHICS_SIMD_HXX__
@@ -0,0 +1,70 @@
+#ifndef MRR_GRAPHICS_STATE_CACHE_HXX__
+#define MRR_GRAPHICS_STATE_CACHE_HXX__
+
+#include <mrr/graphics/glew-common.hxx>
+
+#include <cstdint>
+
+namespace mrr {
+namespace graphics {
+namespace gl {
+namespace state {
+
+// A shadow of the GL state that the wrappers set: program, vertex array,
+// buffer, texture and framebuffer bindings, enabled capabilities and vertex
+// attribute arrays, and the viewport. Each function issues its GL call only
+// if the value differs from the shadow, and counts the call in
+// frame_stats().state_changes if issued or state_changes_elided if not.
+//
+// The shadow is of the current context. It starts unknown, so the first call
+// of each kind is always issued, and is forgotten by invalidate(), which
+// headless_context and window_handle call when they make a context current.
+// Code that changes this state with GL directly must call invalidate() too.
+
+void use_program(GLuint program);
+void bind_vertex_array(GLuint vertex_array);
+// The current vertex array, queried from GL if unknown.
+GLuint get_vertex_array();
+
+// GL_ELEMENT_ARRAY_BUFFER is tracked per vertex array, as GL stores it.
+void bind_buffer(GLenum target, GLuint buffer);
+void bind_buffer_base(GLenum target, GLuint index, GLuint buffer);
+
+void active_texture(GLenum unit);
+// Binds to the active unit.
+void bind_texture(GLenum target, GLuint texture);
+void bind_texture(GLenum unit, GLenum target, GLuint texture);
+
+void bind_framebuffer(GLenum target, GLuint framebuffer);
+
+void enable(GLenum capability);
+void disable(GLenum capability);
+bool is_enabled(GLenum capability);
+
+// Enables the attribute arrays of the bound vertex array whose locations are
+// set in mask, and disables the others. Renderers declare every array they
+// read this way rather than disabling theirs after drawing, so that
+// consecutive draws of the same layout make no calls.
+void set_vertex_attrib_arrays(std::uint32_t mask);
+
+void viewport(GLint x, GLint y, GLsizei width, GLsizei height);
+void viewport_indexed(GLuint index, GLfloat x, GLfloat y, GLfloat width, GLfloat height);
+// The current viewport, queried from GL if unknown.
+void get_viewport(GLint out[4]);
+
+// To be called when an object is deleted, as GL unbinds it and may reuse its
+// name.
+void deleted_program(GLuint program);
+void deleted_vertex_array(GLuint vertex_array);
+void deleted_buffer(GLuint buffer);
+void deleted_texture(GLuint texture);
+void deleted_framebuffer(GLuint framebuffer);
+
+void invalidate();
+
+} // namespace state
+} // namespace gl
+} // namespace graphics
+} // namespace mrr
+
+#endif // #ifndef MRR_GRAPHICS_STATE_CACHE_HXX__
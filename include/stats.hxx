@@ -0,0 +1,46 @@
+#ifndef MRR_GRAPHICS_STATS_HXX__
+#define MRR_GRAPHICS_STATS_HXX__
+
+#include <cstddef>
+#include <iosfwd>
+
+namespace mrr {
+namespace graphics {
+namespace gl {
+
+// Counters accumulated by the render path over one frame.
+struct render_stats
+{
+	render_stats();
+
+	::std::size_t draw_calls;
+	::std::size_t triangles_submitted;
+	// Triangles that would have been submitted with every component at full
+	// detail; the difference to triangles_submitted is the saving from LOD.
+	::std::size_t triangles_full_detail;
+	// GL state calls issued through the state cache (see state_cache.hxx):
+	// bindings, enables and viewports.
+	::std::size_t state_changes;
+	// State calls the cache skipped, as they would have set what was set.
+	::std::size_t state_changes_elided;
+	// Allocations the node pools and frame arena had to make from the heap;
+	// none once a scene and its per-frame work have reached a steady state.
+	::std::size_t heap_allocations;
+	// Bytes handed out by frame arenas.
+	::std::size_t arena_bytes;
+};
+
+render_stats& frame_stats();
+render_stats const& previous_frame_stats();
+
+// Ends the current frame: its counters become previous_frame_stats() and
+// the current ones are reset. Called by window_handle::main_loop.
+void next_frame_stats();
+
+::std::ostream& operator <<(::std::ostream& out, render_stats const& s);
+
+} // namespace gl
+} // namespace graphics
+} // namespace mrr
+
+#endif // #ifndef MRR_GRAPHICS_STATS_HXX__
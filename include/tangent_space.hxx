@@ -0,0 +1,52 @@
+#ifndef MRR_GRAPHICS_TANGENT_SPACE_HXX__
+#define MRR_GRAPHICS_TANGENT_SPACE_HXX__
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+namespace mrr {
+namespace graphics {
+namespace gl {
+namespace impl {
+
+// Both generators run their per-triangle pass four triangles at a time with
+// SSE2 (scalar elsewhere) and every pass over more than a few thousand
+// elements on parallel_for's workers.
+
+// Angle weighted smooth normals of a triangle list, one per corner: each
+// corner gets the normalized sum of the normals of the triangles around its
+// position that are in its smoothing group, weighted by their angles there.
+// groups holds one smoothing group per triangle, as OBJ "s" records number
+// them, or is empty to smooth every triangle together; triangles in group 0
+// are flat. Corners with no normal at all, of degenerate triangles alone,
+// get +z.
+void generate_normals(
+	std::vector<glm::vec3> const& positions,
+	std::vector<unsigned int> const& indices,
+	std::vector<std::uint32_t> const& groups,
+	std::vector<glm::vec3>& out_normals
+);
+
+// Tangents of an indexed mesh for normal mapping (Lengyel 2001), one per
+// vertex: xyz is the direction of increasing u made orthogonal to the
+// normal, and w the handedness of the bitangent, cross(normal, tangent) * w.
+// Where the uvs are empty or degenerate the tangent is any unit vector
+// orthogonal to the normal.
+void generate_tangents(
+	std::vector<glm::vec3> const& vertices,
+	std::vector<glm::vec2> const& uvs,
+	std::vector<glm::vec3> const& normals,
+	std::vector<unsigned int> const& indices,
+	std::vector<glm::vec4>& out_tangents
+);
+
+} // namespace impl
+} // namespace gl
+} // namespace graphics
+} // namespace mrr
+
+
+#endif // #ifndef MRR_GRAPHICS_TANGENT_SPACE_HXX__
@@ -0,0 +1,123 @@
+#ifndef MRR_GRAPHICS_TEXTURE_COMPRESS_HXX__
+#define MRR_GRAPHICS_TEXTURE_COMPRESS_HXX__
+
+#include <cstddef>
+#include <cstdint>
+#include <iosfwd>
+#include <string>
+#include <vector>
+
+namespace mrr {
+namespace graphics {
+namespace gl {
+
+// Offline conversion of PNG and TGA images into block compressed DDS files
+// that texture::load reads. Nothing here needs a GL context.
+
+// 8 bit RGBA pixels, rows top to bottom.
+struct rgba_image
+{
+	rgba_image();
+	rgba_image(std::uint32_t width, std::uint32_t height);
+
+	std::uint32_t width;
+	std::uint32_t height;
+	std::vector<std::uint8_t> pixels;
+};
+
+// Reads a PNG, or an uncompressed or run length encoded TGA, by its
+// contents. Prints the reason and returns false on failure.
+bool load_image(std::string const& path, rgba_image& out);
+
+// The full mip chain down to 1x1, starting with a copy of the image. Each
+// level is a box filter of the one above; with srgb the colour channels are
+// averaged as linear light, so that dark and bright texels mix as they do
+// when the texture is sampled, and weighted by alpha, so that the colour of
+// transparent texels does not show at the edges of cutouts.
+std::vector<rgba_image> generate_mips(rgba_image const& image, bool srgb);
+
+
+enum class block_format
+{
+	bc1,
+	bc3,
+	bc7
+};
+
+char const* describe(block_format format);
+std::size_t block_bytes(block_format format);
+
+// Encodes an image as 4x4 blocks, row by row, on several threads for large
+// images. Partial blocks at the right and bottom edges repeat their last
+// column and row. BC1 uses its transparent colour for texels with alpha
+// below 128. BC7 blocks all use mode 6, a single subset with RGBA
+// endpoints.
+std::vector<std::uint8_t> encode_image(rgba_image const& image, block_format format);
+
+// Decodes blocks written by encode_image, for measuring the error.
+rgba_image decode_image(
+	std::vector<std::uint8_t> const& blocks,
+	std::uint32_t width, std::uint32_t height,
+	block_format format
+);
+
+// Peak signal to noise ratio over all four channels, in dB; infinite for
+// identical images.
+double psnr(rgba_image const& a, rgba_image const& b);
+
+// Writes the encoded mip levels of a 2D texture, with the DX10 header for
+// BC7 and sRGB formats and the legacy DXT1/DXT5 codes otherwise. Prints the
+// reason and returns false on failure.
+bool write_dds(
+	std::string const& path,
+	std::uint32_t width, std::uint32_t height,
+	block_format format, bool srgb,
+	std::vector<std::vector<std::uint8_t>> const& levels
+);
+
+
+struct texture_compress_options
+{
+	texture_compress_options();
+
+	block_format format;
+	// Colour channels are sRGB encoded; true for albedo, false for normal
+	// maps and other data.
+	bool srgb;
+	bool mips;
+	// Decode every level again for texture_compress_report::psnr.
+	bool measure;
+};
+
+struct texture_compress_report
+{
+	texture_compress_report();
+
+	std::uint32_t width;
+	std::uint32_t height;
+	std::size_t levels;
+	std::size_t texels;
+	std::size_t bytes;
+	double decode_ms;
+	double mip_ms;
+	double encode_ms;
+	// Over the top level; 0 unless measured.
+	double psnr;
+};
+
+::std::ostream& operator <<(::std::ostream& out, texture_compress_report const& r);
+
+// Loads a source image, builds its mips, encodes them and writes the DDS.
+// Prints the reason and returns false on failure.
+bool compress_texture(
+	std::string const& source,
+	std::string const& destination,
+	texture_compress_options const& options,
+	texture_compress_report* out_report = nullptr
+);
+
+} // namespace gl
+} // namespace graphics
+} // namespace mrr
+
+#endif // #ifndef MRR_GRAPHICS_TEXTURE_COMPRESS_HXX__
@@ -0,0 +1,23 @@
+#ifndef MRR_GRAPHICS_TIMING_HXX__
+#define MRR_GRAPHICS_TIMING_HXX__
+
+#include <chrono>
+
+namespace mrr {
+namespace graphics {
+namespace gl {
+namespace impl {
+
+// Milliseconds since start, for the timings the statistics report.
+inline double elapsed_ms(std::chrono::steady_clock::time_point start)
+{
+	auto end = std::chrono::steady_clock::now();
+	return std::chrono::duration<double, std::milli>(end - start).count();
+}
+
+} // namespace impl
+} // namespace gl
+} // namespace graphics
+} // namespace mrr
+
+#endif // #ifndef MRR_GRAPHICS_TIMING_HXX__
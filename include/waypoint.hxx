@@ -5,7 +5,7 @@
 
 #include <glm/glm.hpp>
 #include <functional>
-#include <map>
+#include <utility>
 #include <vector>
 
 namespace mrr {
@@ -16,6 +16,10 @@ class waypoint
 {
 public:
 	using action_type = ::std::function<void(component&)>;
+	// Actions grouped by target, in target address order, in one array
+	// that process_waypoints walks without chasing tree nodes.
+	using action_list_type = ::std::vector<::std::pair<model*, ::std::vector<action_type> > >;
+
 	waypoint() = default;
 	waypoint(waypoint const&) = default;
 	waypoint(waypoint&&) = default;
@@ -34,13 +38,17 @@ public:
 	double get_radius() const;
 
 	void add_action(model& m, action_type const& action);
-	::std::map<model*, std::vector<action_type> > const& get_actions() const;
+	action_list_type const& get_actions() const;
 
 	::glm::vec3 location_;
 	double radius_;
-	::std::map<model*, std::vector<action_type> > actions_;
+	action_list_type actions_;
 };
 
+// Runs the actions of every waypoint on those of its targets, which must be
+// components, that are within its radius.
+void process_waypoints(::std::vector<waypoint> const& waypoints);
+
 // bool match_waypoint(waypoint const& wp, mrr::graphics::gl::component const& m)
 // {
 //	return (fabs(wp.location.x - m.getLocation().x) < 0.03)
@@ -0,0 +1,83 @@
+#version 330 core
+
+in vec2 UV;
+in vec3 Position_cameraspace;
+in vec3 Normal_cameraspace;
+
+out vec3 color;
+
+uniform sampler2D texture_sampler;
+uniform vec3 specular_colour;
+uniform vec3 AmbientLightColour;
+
+// Light lists binned per froxel by mrr::graphics::gl::light_clusters.
+//  - ClusterGrid: (first index, light count) per cluster
+//  - ClusterLightIndices: the concatenated light lists
+//  - ClusterLights: two texels per light, (position_cameraspace, range) and
+//    (colour * power, 0)
+uniform usamplerBuffer ClusterGrid;
+uniform usamplerBuffer ClusterLightIndices;
+uniform samplerBuffer ClusterLights;
+
+uniform ivec3 ClusterDimensions;
+uniform vec2 ClusterTileSize;
+uniform vec2 ViewportOrigin;
+uniform float ClusterDepthScale;
+uniform float ClusterDepthBias;
+
+uvec2 cluster_lights()
+{
+	ivec3 cluster;
+	cluster.xy = ivec2((gl_FragCoord.xy - ViewportOrigin) / ClusterTileSize);
+	cluster.z = int(log(-Position_cameraspace.z) * ClusterDepthScale + ClusterDepthBias);
+	cluster = clamp(cluster, ivec3(0), ClusterDimensions - 1);
+
+	int index = cluster.x + ClusterDimensions.x * (cluster.y + ClusterDimensions.y * cluster.z);
+	return texelFetch(ClusterGrid, index).xy;
+}
+
+void main()
+{
+	// Material properties
+	vec3 MaterialDiffuseColour = texture(texture_sampler, UV).rgb;
+	vec3 MaterialAmbientColour = AmbientLightColour * MaterialDiffuseColour;
+	vec3 MaterialSpecularColour = specular_colour;
+
+	color = MaterialAmbientColour;
+
+	// Normal of the computed fragment, in camera space
+	vec3 n = normalize(Normal_cameraspace);
+
+	// Eye vector (towards the camera)
+	vec3 E = normalize(-Position_cameraspace);
+
+	uvec2 lights = cluster_lights();
+	for (uint i = 0u; i < lights.y; ++i)
+	{
+		int light = int(texelFetch(ClusterLightIndices, int(lights.x + i)).x);
+		vec4 LightPosition_range = texelFetch(ClusterLights, 2 * light);
+		vec3 LightColourPower = texelFetch(ClusterLights, 2 * light + 1).xyz;
+
+		vec3 LightDirection_cameraspace = LightPosition_range.xyz - Position_cameraspace;
+		float distance2 = dot(LightDirection_cameraspace, LightDirection_cameraspace);
+
+		// Outside the range the CPU binned the light with.
+		if (distance2 > LightPosition_range.w * LightPosition_range.w)
+			continue;
+
+		// Direction of the light (from the fragment to the light)
+		vec3 l = LightDirection_cameraspace * inversesqrt(distance2);
+
+		float cosTheta = clamp(dot(n,l), 0,1);
+
+		// Direction in which the triangle reflects the light
+		vec3 R = reflect(-l,n);
+		float cosAlpha = clamp(dot(E,R), 0, 1);
+
+		color +=
+			// Diffuse : "color" of the object
+			MaterialDiffuseColour * LightColourPower * cosTheta / distance2 +
+			// Specular : reflective highlight, like a mirror
+			MaterialSpecularColour * LightColourPower * pow(cosAlpha,5) / distance2;
+	}
+}
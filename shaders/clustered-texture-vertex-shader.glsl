@@ -0,0 +1,49 @@
+#version 330 core
+
+layout(location = 0) in vec3 vertexPosition;
+layout(location = 1) in vec2 vertexUV;
+layout(location = 2) in vec3 vertexNormal;
+
+out vec2 UV;
+out vec3 Position_cameraspace;
+out vec3 Normal_cameraspace;
+
+uniform mat4 MVP;
+uniform mat4 V;
+uniform mat4 M;
+
+// Compact vertex format: positions are unorm16 relative to the mesh bounds
+// and normals are octahedral encoded in two snorm16 components.
+uniform bool QuantizedVertices;
+uniform vec3 PositionOffset;
+uniform vec3 PositionScale;
+
+vec3 decode_octahedral(vec2 e)
+{
+	vec3 n = vec3(e.xy, 1.0 - abs(e.x) - abs(e.y));
+	float t = max(-n.z, 0.0);
+	n.x += n.x >= 0.0 ? -t : t;
+	n.y += n.y >= 0.0 ? -t : t;
+	return normalize(n);
+}
+
+void main()
+{
+	vec3 vertexPosition_modelspace = vertexPosition;
+	vec3 vertexNormal_modelspace = vertexNormal;
+	if (QuantizedVertices)
+	{
+		vertexPosition_modelspace = PositionOffset + PositionScale * vertexPosition;
+		vertexNormal_modelspace = decode_octahedral(vertexNormal.xy);
+	}
+
+	gl_Position =  MVP * vec4(vertexPosition_modelspace, 1);
+
+	// Lights are binned in camera space, so all lighting happens there.
+	Position_cameraspace = (V * M * vec4(vertexPosition_modelspace, 1)).xyz;
+
+	// Only correct if ModelMatrix does not scale the model! Use its inverse transpose if not.
+	Normal_cameraspace = (V * M * vec4(vertexNormal_modelspace, 0)).xyz;
+
+	UV = vertexUV;
+}
@@ -1,7 +1,7 @@
 #version 330 core
 
-layout(location = 0) in vec3 vertexPosition_modelspace;
-layout(location = 2) in vec3 vertexNormal_modelspace;
+layout(location = 0) in vec3 vertexPosition;
+layout(location = 2) in vec3 vertexNormal;
 
 out vec3 Position_worldspace;
 out vec3 Normal_cameraspace;
@@ -14,8 +14,31 @@ uniform mat4 M;
 uniform vec3 LightPosition_worldspace[8];
 uniform int PointSourceCount;
 
+// Compact vertex format: positions are unorm16 relative to the mesh bounds
+// and normals are octahedral encoded in two snorm16 components.
+uniform bool QuantizedVertices;
+uniform vec3 PositionOffset;
+uniform vec3 PositionScale;
+
+vec3 decode_octahedral(vec2 e)
+{
+	vec3 n = vec3(e.xy, 1.0 - abs(e.x) - abs(e.y));
+	float t = max(-n.z, 0.0);
+	n.x += n.x >= 0.0 ? -t : t;
+	n.y += n.y >= 0.0 ? -t : t;
+	return normalize(n);
+}
+
 void main()
 {
+	vec3 vertexPosition_modelspace = vertexPosition;
+	vec3 vertexNormal_modelspace = vertexNormal;
+	if (QuantizedVertices)
+	{
+		vertexPosition_modelspace = PositionOffset + PositionScale * vertexPosition;
+		vertexNormal_modelspace = decode_octahedral(vertexNormal.xy);
+	}
+
 	// Output position of the vertex, in clip space : MVP * position
 	gl_Position =  MVP * vec4(vertexPosition_modelspace, 1);
 
@@ -0,0 +1,56 @@
+#version 430 core
+
+layout(location = 0) in vec3 vertexPosition_modelspace;
+layout(location = 2) in vec3 vertexNormal_modelspace;
+layout(location = 3) in uint objectIndex;
+
+struct object_data
+{
+	mat4 M;
+	uint material;
+};
+
+layout(std430, binding = 0) readonly buffer ObjectBuffer
+{
+	object_data objects[];
+};
+
+out vec3 Position_worldspace;
+out vec3 Normal_cameraspace;
+out vec3 EyeDirection_cameraspace;
+out vec3 LightDirection_cameraspace[8];
+flat out uint Material;
+
+uniform mat4 V;
+uniform mat4 P;
+uniform vec3 LightPosition_worldspace[8];
+uniform int PointSourceCount;
+
+void main()
+{
+	// Per-object transform, selected by the draw command's baseInstance.
+	mat4 M = objects[objectIndex].M;
+	Material = objects[objectIndex].material;
+
+	// Position of the vertex, in worldspace : M * position
+	Position_worldspace = (M * vec4(vertexPosition_modelspace, 1)).xyz;
+
+	// Output position of the vertex, in clip space : P * V * M * position
+	vec3 vertexPosition_cameraspace = (V * vec4(Position_worldspace, 1)).xyz;
+	gl_Position = P * vec4(vertexPosition_cameraspace, 1);
+
+	// Vector that goes from the vertex to the camera, in camera space.
+	// In camera space, the camera is at the origin (0,0,0).
+	EyeDirection_cameraspace = vec3(0,0,0) - vertexPosition_cameraspace;
+
+	for (int i = 0; i < PointSourceCount; ++i)
+	{
+		// Vector that goes from the vertex to the light, in camera space.
+		vec3 LightPosition_cameraspace = (V * vec4(LightPosition_worldspace[i], 1)).xyz;
+		LightDirection_cameraspace[i] = LightPosition_cameraspace + EyeDirection_cameraspace;
+	}
+
+	// Normal of the the vertex, in camera space
+	// Only correct if ModelMatrix does not scale the model! Use its inverse transpose if not.
+	Normal_cameraspace = (V * M * vec4(vertexNormal_modelspace, 0)).xyz;
+}
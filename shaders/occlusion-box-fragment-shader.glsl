@@ -0,0 +1,9 @@
+#version 330 core
+
+// Colour and depth writes are masked; only the samples passed count.
+out vec3 color;
+
+void main()
+{
+	color = vec3(1, 1, 1);
+}
@@ -0,0 +1,11 @@
+#version 330 core
+
+layout(location = 0) in vec3 vertexPosition;
+
+// Maps the unit cube onto the bounding box of a component.
+uniform mat4 MVP;
+
+void main()
+{
+	gl_Position = MVP * vec4(vertexPosition, 1);
+}
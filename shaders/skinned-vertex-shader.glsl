@@ -0,0 +1,79 @@
+#version 330 core
+
+layout(location = 0) in vec3 vertexPosition;
+layout(location = 2) in vec3 vertexNormal;
+layout(location = 3) in uvec4 boneIndices;
+layout(location = 4) in vec4 boneWeights;
+
+out vec3 Position_worldspace;
+out vec3 Normal_cameraspace;
+out vec3 EyeDirection_cameraspace;
+out vec3 LightDirection_cameraspace[8];
+
+uniform mat4 MVP;
+uniform mat4 V;
+uniform mat4 M;
+uniform vec3 LightPosition_worldspace[8];
+uniform int PointSourceCount;
+
+// Compact vertex format: positions are unorm16 relative to the mesh bounds
+// and normals are octahedral encoded in two snorm16 components.
+uniform bool QuantizedVertices;
+uniform vec3 PositionOffset;
+uniform vec3 PositionScale;
+
+// Bone matrices of a skinned mesh, from the bind pose to the current pose.
+// Meshes without skin data set BoneCount to 0.
+uniform mat4 BonePalette[64];
+uniform int BoneCount;
+
+vec3 decode_octahedral(vec2 e)
+{
+	vec3 n = vec3(e.xy, 1.0 - abs(e.x) - abs(e.y));
+	float t = max(-n.z, 0.0);
+	n.x += n.x >= 0.0 ? -t : t;
+	n.y += n.y >= 0.0 ? -t : t;
+	return normalize(n);
+}
+
+void main()
+{
+	vec3 vertexPosition_modelspace = vertexPosition;
+	vec3 vertexNormal_modelspace = vertexNormal;
+	if (QuantizedVertices)
+	{
+		vertexPosition_modelspace = PositionOffset + PositionScale * vertexPosition;
+		vertexNormal_modelspace = decode_octahedral(vertexNormal.xy);
+	}
+	if (BoneCount > 0)
+	{
+		mat4 skin = boneWeights.x * BonePalette[boneIndices.x]
+		          + boneWeights.y * BonePalette[boneIndices.y]
+		          + boneWeights.z * BonePalette[boneIndices.z]
+		          + boneWeights.w * BonePalette[boneIndices.w];
+		vertexPosition_modelspace = (skin * vec4(vertexPosition_modelspace, 1)).xyz;
+		vertexNormal_modelspace = (skin * vec4(vertexNormal_modelspace, 0)).xyz;
+	}
+
+	// Output position of the vertex, in clip space : MVP * position
+	gl_Position =  MVP * vec4(vertexPosition_modelspace, 1);
+
+	// Position of the vertex, in worldspace : M * position
+	Position_worldspace = (M * vec4(vertexPosition_modelspace, 1)).xyz;
+
+	// Vector that goes from the vertex to the camera, in camera space.
+	// In camera space, the camera is at the origin (0,0,0).
+	vec3 vertexPosition_cameraspace = (V * M * vec4(vertexPosition_modelspace, 1)).xyz;
+	EyeDirection_cameraspace = vec3(0,0,0) - vertexPosition_cameraspace;
+
+	for (int i = 0; i < PointSourceCount; ++i)
+	{
+		// Vector that goes from the vertex to the light, in camera space. M is ommited because it's identity.
+		vec3 LightPosition_cameraspace = (V * vec4(LightPosition_worldspace[i], 1)).xyz;
+		LightDirection_cameraspace[i] = LightPosition_cameraspace + EyeDirection_cameraspace;
+	}
+
+	// Normal of the the vertex, in camera space
+	// Only correct if ModelMatrix does not scale the model! Use its inverse transpose if not.
+	Normal_cameraspace = (V * M * vec4(vertexNormal_modelspace, 0)).xyz;
+}
@@ -0,0 +1,80 @@
+#version 330 core
+
+// See variant-vertex-shader.glsl for the feature flags.
+#ifndef LIGHT_COUNT
+#define LIGHT_COUNT 0
+#endif
+
+out vec3 color;
+
+#if defined(TEXTURED)
+in vec2 UV;
+uniform sampler2D texture_sampler;
+#elif defined(VERTEX_COLOUR)
+in vec3 Colour;
+#else
+uniform vec3 shape_colour;
+#endif
+
+uniform vec3 AmbientLightColour;
+
+#ifdef LIT
+in vec3 Position_worldspace;
+in vec3 Normal_cameraspace;
+in vec3 EyeDirection_cameraspace;
+in vec3 LightDirection_cameraspace[LIGHT_COUNT];
+
+uniform vec3 specular_colour;
+
+uniform vec3 LightPosition_worldspace[LIGHT_COUNT];
+uniform vec3 LightColour[LIGHT_COUNT];
+uniform float LightPower[LIGHT_COUNT];
+#endif
+
+void main()
+{
+	// Material properties
+#if defined(TEXTURED)
+	vec3 MaterialDiffuseColour = texture(texture_sampler, UV).rgb;
+#elif defined(VERTEX_COLOUR)
+	vec3 MaterialDiffuseColour = Colour;
+#else
+	vec3 MaterialDiffuseColour = shape_colour;
+#endif
+	vec3 MaterialAmbientColour = AmbientLightColour * MaterialDiffuseColour;
+
+	// Ambient : simulates indirect lighting
+	color = MaterialAmbientColour;
+
+#ifdef LIT
+	vec3 MaterialSpecularColour = specular_colour;
+
+	// Normal of the computed fragment, in camera space
+	vec3 n = normalize(Normal_cameraspace);
+
+	// Eye vector (towards the camera)
+	vec3 E = normalize(EyeDirection_cameraspace);
+
+	// LIGHT_COUNT is a constant, so the compiler can unroll this loop.
+	for (int i = 0; i < LIGHT_COUNT; ++i)
+	{
+		// Distance to the light
+		float distance = length(LightPosition_worldspace[i] - Position_worldspace);
+
+		// Direction of the light (from the fragment to the light)
+		vec3 l = normalize(LightDirection_cameraspace[i]);
+
+		float cosTheta = clamp(dot(n,l), 0,1);
+
+		// Direction in which the triangle reflects the light
+		vec3 R = reflect(-l,n);
+		float cosAlpha = clamp(dot(E,R), 0, 1);
+
+		color +=
+			// Diffuse : "color" of the object
+			MaterialDiffuseColour * LightColour[i] * LightPower[i] * cosTheta / (distance*distance) +
+			// Specular : reflective highlight, like a mirror
+			MaterialSpecularColour * LightColour[i] * LightPower[i] * pow(cosAlpha,5) / (distance*distance);
+	}
+#endif
+}
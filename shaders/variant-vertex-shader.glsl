@@ -0,0 +1,112 @@
+#version 330 core
+
+// Specialized by mrr::graphics::gl::shader_variants with:
+//  - TEXTURED: per-vertex UVs and a diffuse texture
+//  - VERTEX_COLOUR: per-vertex diffuse colour
+//  - LIT: normals and LIGHT_COUNT point sources
+//  - QUANTIZED: the compact vertex format of component::set_vertex_format
+//  - MULTI_VIEW: one instance per view, each into its own viewport
+#ifndef LIGHT_COUNT
+#define LIGHT_COUNT 0
+#endif
+
+#ifdef MULTI_VIEW
+#extension GL_ARB_shader_viewport_layer_array : require
+#endif
+
+layout(location = 0) in vec3 vertexPosition;
+
+#if defined(TEXTURED)
+layout(location = 1) in vec2 vertexUV;
+out vec2 UV;
+#elif defined(VERTEX_COLOUR)
+layout(location = 1) in vec3 vertexColour;
+out vec3 Colour;
+#endif
+
+#ifdef MULTI_VIEW
+// Instance i draws the view InstanceViews[i] with InstanceMVPs[i].
+uniform mat4 ViewMatrices[MAX_VIEWS];
+uniform mat4 InstanceMVPs[MAX_VIEWS];
+uniform int InstanceViews[MAX_VIEWS];
+uniform mat4 M;
+#else
+uniform mat4 MVP;
+#endif
+
+#ifdef LIT
+layout(location = 2) in vec3 vertexNormal;
+
+out vec3 Position_worldspace;
+out vec3 Normal_cameraspace;
+out vec3 EyeDirection_cameraspace;
+out vec3 LightDirection_cameraspace[LIGHT_COUNT];
+
+#ifndef MULTI_VIEW
+uniform mat4 V;
+uniform mat4 M;
+#endif
+uniform vec3 LightPosition_worldspace[LIGHT_COUNT];
+#endif
+
+#ifdef QUANTIZED
+// Positions are unorm16 relative to the mesh bounds and normals are
+// octahedral encoded in two snorm16 components.
+uniform vec3 PositionOffset;
+uniform vec3 PositionScale;
+
+vec3 decode_octahedral(vec2 e)
+{
+	vec3 n = vec3(e.xy, 1.0 - abs(e.x) - abs(e.y));
+	float t = max(-n.z, 0.0);
+	n.x += n.x >= 0.0 ? -t : t;
+	n.y += n.y >= 0.0 ? -t : t;
+	return normalize(n);
+}
+#endif
+
+void main()
+{
+#ifdef QUANTIZED
+	vec3 vertexPosition_modelspace = PositionOffset + PositionScale * vertexPosition;
+#else
+	vec3 vertexPosition_modelspace = vertexPosition;
+#endif
+
+#ifdef MULTI_VIEW
+	int view = InstanceViews[gl_InstanceID];
+	mat4 V = ViewMatrices[view];
+	gl_ViewportIndex = view;
+	gl_Position = InstanceMVPs[gl_InstanceID] * vec4(vertexPosition_modelspace, 1);
+#else
+	gl_Position =  MVP * vec4(vertexPosition_modelspace, 1);
+#endif
+
+#if defined(TEXTURED)
+	UV = vertexUV;
+#elif defined(VERTEX_COLOUR)
+	Colour = vertexColour;
+#endif
+
+#ifdef LIT
+#ifdef QUANTIZED
+	vec3 vertexNormal_modelspace = decode_octahedral(vertexNormal.xy);
+#else
+	vec3 vertexNormal_modelspace = vertexNormal;
+#endif
+
+	Position_worldspace = (M * vec4(vertexPosition_modelspace, 1)).xyz;
+
+	vec3 vertexPosition_cameraspace = (V * M * vec4(vertexPosition_modelspace, 1)).xyz;
+	EyeDirection_cameraspace = vec3(0,0,0) - vertexPosition_cameraspace;
+
+	for (int i = 0; i < LIGHT_COUNT; ++i)
+	{
+		vec3 LightPosition_cameraspace = (V * vec4(LightPosition_worldspace[i], 1)).xyz;
+		LightDirection_cameraspace[i] = LightPosition_cameraspace + EyeDirection_cameraspace;
+	}
+
+	// Only correct if ModelMatrix does not scale the model! Use its inverse transpose if not.
+	Normal_cameraspace = (V * M * vec4(vertexNormal_modelspace, 0)).xyz;
+#endif
+}
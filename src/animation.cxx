@@ -0,0 +1,622 @@
+#include <mrr/graphics/animation.hxx>
+#include <mrr/graphics/parallel.hxx>
+#include <mrr/graphics/state_cache.hxx>
+#include <mrr/graphics/timing.hxx>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <iostream>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define MRR_GRAPHICS_ANIMATION_SSE2 1
+#endif
+
+namespace mrr {
+namespace graphics {
+namespace gl {
+
+namespace {
+
+// Finds the keys around t and the weight of the second, starting from the
+// key found last time, which is usually the right one or just before it.
+void locate(
+	std::vector<float> const& times, float t, std::uint32_t& cursor,
+	std::uint32_t& a, std::uint32_t& b, float& weight
+)
+{
+	std::uint32_t const n = times.size();
+	weight = 0.0f;
+	if (n == 1 || t <= times[0])
+	{
+		a = b = cursor = 0;
+		return;
+	}
+	if (t >= times[n - 1])
+	{
+		a = b = cursor = n - 1;
+		return;
+	}
+
+	std::uint32_t k = std::min(cursor, n - 2);
+	if (times[k] > t || (k + 4 < n && times[k + 4] <= t))
+		k = std::upper_bound(times.begin(), times.end(), t) - times.begin() - 1;
+	else
+		while (times[k + 1] <= t)
+			++k;
+
+	cursor = a = k;
+	b = k + 1;
+	float span = times[b] - times[a];
+	weight = span > 0.0f ? (t - times[a]) / span : 0.0f;
+}
+
+// The keys of four tracks, component by component.
+struct lanes
+{
+	float t0[3][4], t1[3][4], tw[4];
+	float q0[4][4], q1[4][4], qw[4];
+	float s0[3][4], s1[3][4], sw[4];
+};
+
+template <int N, typename Vec>
+void gather(
+	keyframe_track<Vec> const* track, float t, std::uint32_t& cursor,
+	float (&k0)[N][4], float (&k1)[N][4], float (&w)[4], int lane, Vec const& identity
+)
+{
+	if (track == nullptr || track->times.empty())
+	{
+		for (int c = 0; c < N; ++c)
+			k0[c][lane] = k1[c][lane] = identity[c];
+		w[lane] = 0.0f;
+		return;
+	}
+
+	std::uint32_t a, b;
+	locate(track->times, t, cursor, a, b, w[lane]);
+	for (int c = 0; c < N; ++c)
+	{
+		k0[c][lane] = track->values[a][c];
+		k1[c][lane] = track->values[b][c];
+	}
+}
+
+// Interpolates the keys of four tracks and writes their local matrices.
+#ifdef MRR_GRAPHICS_ANIMATION_SSE2
+void evaluate_lanes(lanes const& l, float* out[4])
+{
+	__m128 const zero = _mm_setzero_ps();
+	__m128 const one = _mm_set1_ps(1.0f);
+	__m128 const two = _mm_set1_ps(2.0f);
+	__m128 const sign = _mm_set1_ps(-0.0f);
+
+	__m128 w = _mm_loadu_ps(l.tw);
+	__m128 t[3];
+	for (int c = 0; c < 3; ++c)
+	{
+		__m128 a = _mm_loadu_ps(l.t0[c]);
+		t[c] = _mm_add_ps(a, _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(l.t1[c]), a), w));
+	}
+
+	w = _mm_loadu_ps(l.sw);
+	__m128 s[3];
+	for (int c = 0; c < 3; ++c)
+	{
+		__m128 a = _mm_loadu_ps(l.s0[c]);
+		s[c] = _mm_add_ps(a, _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(l.s1[c]), a), w));
+	}
+
+	// Normalized lerp along the shorter arc.
+	__m128 q0[4], q1[4];
+	for (int c = 0; c < 4; ++c)
+	{
+		q0[c] = _mm_loadu_ps(l.q0[c]);
+		q1[c] = _mm_loadu_ps(l.q1[c]);
+	}
+	__m128 d = _mm_add_ps(
+		_mm_add_ps(_mm_mul_ps(q0[0], q1[0]), _mm_mul_ps(q0[1], q1[1])),
+		_mm_add_ps(_mm_mul_ps(q0[2], q1[2]), _mm_mul_ps(q0[3], q1[3]))
+	);
+	__m128 flip = _mm_and_ps(_mm_cmplt_ps(d, zero), sign);
+	w = _mm_loadu_ps(l.qw);
+	__m128 q[4];
+	for (int c = 0; c < 4; ++c)
+		q[c] = _mm_add_ps(q0[c], _mm_mul_ps(_mm_sub_ps(_mm_xor_ps(q1[c], flip), q0[c]), w));
+	__m128 length = _mm_sqrt_ps(_mm_add_ps(
+		_mm_add_ps(_mm_mul_ps(q[0], q[0]), _mm_mul_ps(q[1], q[1])),
+		_mm_add_ps(_mm_mul_ps(q[2], q[2]), _mm_mul_ps(q[3], q[3]))
+	));
+	for (int c = 0; c < 4; ++c)
+		q[c] = _mm_div_ps(q[c], length);
+
+	__m128 xx = _mm_mul_ps(q[0], q[0]), yy = _mm_mul_ps(q[1], q[1]), zz = _mm_mul_ps(q[2], q[2]);
+	__m128 xy = _mm_mul_ps(q[0], q[1]), xz = _mm_mul_ps(q[0], q[2]), yz = _mm_mul_ps(q[1], q[2]);
+	__m128 wx = _mm_mul_ps(q[3], q[0]), wy = _mm_mul_ps(q[3], q[1]), wz = _mm_mul_ps(q[3], q[2]);
+
+	__m128 m[4][4];
+	m[0][0] = _mm_mul_ps(_mm_sub_ps(one, _mm_mul_ps(two, _mm_add_ps(yy, zz))), s[0]);
+	m[0][1] = _mm_mul_ps(_mm_mul_ps(two, _mm_add_ps(xy, wz)), s[0]);
+	m[0][2] = _mm_mul_ps(_mm_mul_ps(two, _mm_sub_ps(xz, wy)), s[0]);
+	m[0][3] = zero;
+	m[1][0] = _mm_mul_ps(_mm_mul_ps(two, _mm_sub_ps(xy, wz)), s[1]);
+	m[1][1] = _mm_mul_ps(_mm_sub_ps(one, _mm_mul_ps(two, _mm_add_ps(xx, zz))), s[1]);
+	m[1][2] = _mm_mul_ps(_mm_mul_ps(two, _mm_add_ps(yz, wx)), s[1]);
+	m[1][3] = zero;
+	m[2][0] = _mm_mul_ps(_mm_mul_ps(two, _mm_add_ps(xz, wy)), s[2]);
+	m[2][1] = _mm_mul_ps(_mm_mul_ps(two, _mm_sub_ps(yz, wx)), s[2]);
+	m[2][2] = _mm_mul_ps(_mm_sub_ps(one, _mm_mul_ps(two, _mm_add_ps(xx, yy))), s[2]);
+	m[2][3] = zero;
+	m[3][0] = t[0];
+	m[3][1] = t[1];
+	m[3][2] = t[2];
+	m[3][3] = one;
+
+	// From one register per matrix element to one column per lane.
+	for (int column = 0; column < 4; ++column)
+	{
+		__m128 r0 = m[column][0], r1 = m[column][1], r2 = m[column][2], r3 = m[column][3];
+		_MM_TRANSPOSE4_PS(r0, r1, r2, r3);
+		__m128 const columns[4] = { r0, r1, r2, r3 };
+		for (int lane = 0; lane < 4; ++lane)
+			if (out[lane] != nullptr)
+				_mm_storeu_ps(out[lane] + 4 * column, columns[lane]);
+	}
+}
+#else
+void evaluate_lanes(lanes const& l, float* out[4])
+{
+	for (int lane = 0; lane < 4; ++lane)
+	{
+		if (out[lane] == nullptr)
+			continue;
+
+		float t[3], s[3], q[4];
+		for (int c = 0; c < 3; ++c)
+		{
+			t[c] = l.t0[c][lane] + (l.t1[c][lane] - l.t0[c][lane]) * l.tw[lane];
+			s[c] = l.s0[c][lane] + (l.s1[c][lane] - l.s0[c][lane]) * l.sw[lane];
+		}
+
+		float d = (l.q0[0][lane] * l.q1[0][lane] + l.q0[1][lane] * l.q1[1][lane])
+			+ (l.q0[2][lane] * l.q1[2][lane] + l.q0[3][lane] * l.q1[3][lane]);
+		float flip = d < 0.0f ? -1.0f : 1.0f;
+		for (int c = 0; c < 4; ++c)
+			q[c] = l.q0[c][lane] + (l.q1[c][lane] * flip - l.q0[c][lane]) * l.qw[lane];
+		float length = std::sqrt((q[0] * q[0] + q[1] * q[1]) + (q[2] * q[2] + q[3] * q[3]));
+		for (int c = 0; c < 4; ++c)
+			q[c] /= length;
+
+		float xx = q[0] * q[0], yy = q[1] * q[1], zz = q[2] * q[2];
+		float xy = q[0] * q[1], xz = q[0] * q[2], yz = q[1] * q[2];
+		float wx = q[3] * q[0], wy = q[3] * q[1], wz = q[3] * q[2];
+
+		float* m = out[lane];
+		m[0] = (1.0f - 2.0f * (yy + zz)) * s[0];
+		m[1] = (2.0f * (xy + wz)) * s[0];
+		m[2] = (2.0f * (xz - wy)) * s[0];
+		m[3] = 0.0f;
+		m[4] = (2.0f * (xy - wz)) * s[1];
+		m[5] = (1.0f - 2.0f * (xx + zz)) * s[1];
+		m[6] = (2.0f * (yz + wx)) * s[1];
+		m[7] = 0.0f;
+		m[8] = (2.0f * (xz + wy)) * s[2];
+		m[9] = (2.0f * (yz - wx)) * s[2];
+		m[10] = (1.0f - 2.0f * (xx + yy)) * s[2];
+		m[11] = 0.0f;
+		m[12] = t[0];
+		m[13] = t[1];
+		m[14] = t[2];
+		m[15] = 1.0f;
+	}
+}
+#endif
+
+} // namespace
+
+
+//m=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-
+animation_clip::animation_clip(float duration)
+	: duration_(std::max(duration, 0.0f))
+{
+}
+
+std::size_t animation_clip::add_track(trs_track const& track)
+{
+	tracks_.push_back(track);
+	return tracks_.size() - 1;
+}
+
+float animation_clip::get_duration() const
+{
+	return duration_;
+}
+
+std::size_t animation_clip::get_track_count() const
+{
+	return tracks_.size();
+}
+
+trs_track const& animation_clip::get_track(std::size_t i) const
+{
+	return tracks_[i];
+}
+
+
+//m=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-
+skinned_mesh::skinned_mesh()
+	: palette_id_(0),
+	  bone_count_id_(0)
+{
+}
+
+bool skinned_mesh::set_skeleton(::std::shared_ptr<skeleton const> const& s)
+{
+	if (s != nullptr)
+	{
+		bool valid = s->parents.size() == s->inverse_bind.size() && s->parents.size() <= max_skin_bones;
+		for (std::size_t i = 0; valid && i < s->parents.size(); ++i)
+			valid = s->parents[i] < int(i);
+		if (!valid)
+		{
+			std::cerr << "ERROR: Cannot use skeleton...\tbones: " << s->parents.size()
+			          << " (at most " << max_skin_bones << ", parents first)" << std::endl;
+			return false;
+		}
+	}
+
+	skeleton_ = s;
+	palette_.assign(s != nullptr ? s->parents.size() : 0, glm::mat4(1.0f));
+	return true;
+}
+
+skeleton const* skinned_mesh::get_skeleton() const
+{
+	return skeleton_.get();
+}
+
+void skinned_mesh::set_skin_data(std::vector<skin_weights> const& skin)
+{
+	if (skin.empty())
+	{
+		skin_buffer_.destroy();
+		return;
+	}
+
+	skin_buffer_.create();
+	skin_buffer_.set_data(GL_ARRAY_BUFFER, skin.size() * sizeof(skin_weights), skin.data(), GL_STATIC_DRAW);
+}
+
+std::vector<::glm::mat4> const& skinned_mesh::get_palette() const
+{
+	return palette_;
+}
+
+void skinned_mesh::get_uniform_locations()
+{
+	component::get_uniform_locations();
+	palette_id_ = shader_.get_uniform_location("BonePalette");
+	bone_count_id_ = shader_.get_uniform_location("BoneCount");
+}
+
+void skinned_mesh::render(::glm::mat4 const& V, ::glm::mat4 const& P) const
+{
+	apply_uniforms(V, P);
+
+	bool const skinned = skin_buffer_.is_created() && !palette_.empty();
+	::glUniform1i(bone_count_id_, skinned ? palette_.size() : 0);
+	bind_attributes(skinned ? (1 << 3) | (1 << 4) : 0);
+	if (skinned)
+	{
+		::glUniformMatrix4fv(palette_id_, palette_.size(), GL_FALSE, &palette_[0][0][0]);
+		skin_buffer_.bind(GL_ARRAY_BUFFER);
+		::glVertexAttribIPointer(3, 4, GL_UNSIGNED_BYTE, sizeof(skin_weights), (void*)0);
+		::glVertexAttribPointer(4, 4, GL_UNSIGNED_BYTE, GL_TRUE, sizeof(skin_weights), (void*)4);
+	}
+
+	draw(select_lod(V, P));
+}
+
+
+//m=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-
+animation_playback::animation_playback()
+	: time(0.0f),
+	  speed(1.0f),
+	  loop(true)
+{
+}
+
+animation_stats::animation_stats()
+	: nodes(0),
+	  skeletons(0),
+	  tracks(0),
+	  evaluate_ms(0.0),
+	  apply_ms(0.0)
+{
+}
+
+::std::ostream& operator <<(::std::ostream& out, animation_stats const& s)
+{
+	return out
+		<< "nodes: " << s.nodes
+		<< ", skeletons: " << s.skeletons
+		<< ", tracks: " << s.tracks
+		<< ", evaluate time: " << s.evaluate_ms << " ms"
+		<< ", apply time: " << s.apply_ms << " ms";
+}
+
+
+//m=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-
+animator::animator()
+	: pending_(false)
+{
+}
+
+animator::~animator()
+{
+	if (worker_.joinable())
+		worker_.join();
+}
+
+void animator::bind(
+	component& c,
+	::std::shared_ptr<animation_clip const> const& clip,
+	std::size_t track,
+	animation_playback const& playback
+)
+{
+	binding b;
+	b.target = &c;
+	b.skin = nullptr;
+	b.clip = clip;
+	b.playback = playback;
+	b.base = c.get_model();
+	b.track = track;
+	b.first_sampler = 0;
+	b.sampler_count = 1;
+	add(std::move(b));
+}
+
+void animator::bind_skeleton(
+	skinned_mesh& m,
+	::std::shared_ptr<animation_clip const> const& clip,
+	animation_playback const& playback
+)
+{
+	binding b;
+	b.target = &m;
+	b.skin = &m;
+	b.clip = clip;
+	b.playback = playback;
+	b.base = ::glm::mat4(1.0f);
+	b.track = 0;
+	b.first_sampler = 0;
+	b.sampler_count = m.get_skeleton() != nullptr ? m.get_skeleton()->parents.size() : 0;
+	add(std::move(b));
+}
+
+void animator::add(binding&& b)
+{
+	finish();
+
+	auto it = index_.find(b.target);
+	if (it != index_.end())
+	{
+		bindings_[it->second] = std::move(b);
+	}
+	else
+	{
+		index_[b.target] = bindings_.size();
+		bindings_.push_back(std::move(b));
+	}
+	rebuild_samplers();
+}
+
+void animator::unbind(component& c)
+{
+	finish();
+
+	auto it = index_.find(&c);
+	if (it == index_.end())
+		return;
+
+	std::size_t i = it->second;
+	index_.erase(it);
+	if (i + 1 != bindings_.size())
+	{
+		bindings_[i] = std::move(bindings_.back());
+		index_[bindings_[i].target] = i;
+	}
+	bindings_.pop_back();
+	rebuild_samplers();
+}
+
+std::size_t animator::size() const
+{
+	return bindings_.size();
+}
+
+auto animator::find(component& c)
+	-> binding*
+{
+	finish();
+	auto it = index_.find(&c);
+	return it != index_.end() ? &bindings_[it->second] : nullptr;
+}
+
+void animator::set_time(component& c, float time)
+{
+	if (binding* b = find(c))
+		b->playback.time = time;
+}
+
+void animator::set_speed(component& c, float speed)
+{
+	if (binding* b = find(c))
+		b->playback.speed = speed;
+}
+
+// Lays out the tracks of all bindings in one array, nodes then bones in
+// binding order, and restarts every key search.
+void animator::rebuild_samplers()
+{
+	std::vector<sampler> samplers;
+	for (std::size_t i = 0; i < bindings_.size(); ++i)
+	{
+		binding& b = bindings_[i];
+		std::size_t first = samplers.size();
+		std::size_t track = b.track;
+		for (std::size_t k = 0; k < b.sampler_count; ++k, ++track)
+		{
+			sampler s;
+			s.track = b.clip != nullptr && track < b.clip->get_track_count() ? &b.clip->get_track(track) : nullptr;
+			s.binding = i;
+			s.cursor[0] = s.cursor[1] = s.cursor[2] = 0;
+			samplers.push_back(s);
+		}
+		b.first_sampler = first;
+	}
+
+	samplers_.swap(samplers);
+	local_.resize(samplers_.size());
+	palettes_.resize(samplers_.size());
+	models_.resize(bindings_.size());
+}
+
+void animator::start(float dt)
+{
+	finish();
+	pending_ = true;
+	worker_ = std::thread([this, dt]() { evaluate(dt); });
+}
+
+void animator::finish()
+{
+	if (!pending_)
+		return;
+
+	worker_.join();
+	pending_ = false;
+
+	auto start = std::chrono::steady_clock::now();
+	for (std::size_t i = 0; i < bindings_.size(); ++i)
+	{
+		binding const& b = bindings_[i];
+		if (b.skin != nullptr)
+			b.skin->palette_.assign(
+				palettes_.begin() + b.first_sampler, palettes_.begin() + b.first_sampler + b.sampler_count
+			);
+		else
+			b.target->set_model(models_[i]);
+	}
+	stats_.apply_ms = impl::elapsed_ms(start);
+}
+
+void animator::advance(float dt)
+{
+	start(dt);
+	finish();
+}
+
+animation_stats const& animator::get_stats() const
+{
+	return stats_;
+}
+
+void animator::evaluate(float dt)
+{
+	auto start = std::chrono::steady_clock::now();
+
+	for (binding& b : bindings_)
+	{
+		float duration = b.clip != nullptr ? b.clip->get_duration() : 0.0f;
+		float& t = b.playback.time;
+		t += b.playback.speed * dt;
+		if (duration <= 0.0f)
+			t = 0.0f;
+		else if (b.playback.loop)
+			t -= duration * std::floor(t / duration);
+		else
+			t = std::min(std::max(t, 0.0f), duration);
+	}
+
+	// Chunks of samplers are multiples of four, so only the last has
+	// partial lanes.
+	impl::parallel_for((samplers_.size() + 3) / 4, 256, [this](std::size_t begin, std::size_t end) {
+		sample(4 * begin, std::min(4 * end, samplers_.size()));
+	});
+	impl::parallel_for(bindings_.size(), 256, [this](std::size_t begin, std::size_t end) {
+		compose(begin, end);
+	});
+
+	stats_.nodes = bindings_.size() - std::count_if(
+		bindings_.begin(), bindings_.end(), [](binding const& b) { return b.skin != nullptr; }
+	);
+	stats_.skeletons = bindings_.size() - stats_.nodes;
+	stats_.tracks = samplers_.size();
+	stats_.evaluate_ms = impl::elapsed_ms(start);
+}
+
+void animator::sample(std::size_t begin, std::size_t end)
+{
+	glm::vec3 const zero(0.0f), one(1.0f);
+	glm::vec4 const identity(0.0f, 0.0f, 0.0f, 1.0f);
+
+	lanes l;
+	for (std::size_t first = begin; first < end; first += 4)
+	{
+		float* out[4] = { nullptr, nullptr, nullptr, nullptr };
+		for (int lane = 0; lane < 4; ++lane)
+		{
+			std::size_t i = first + lane;
+			if (i >= end)
+			{
+				// Identities in the unused lanes, which are not stored.
+				std::uint32_t unused = 0;
+				gather<3>(static_cast<keyframe_track<glm::vec3> const*>(nullptr), 0.0f, unused, l.t0, l.t1, l.tw, lane, zero);
+				gather<4>(static_cast<keyframe_track<glm::vec4> const*>(nullptr), 0.0f, unused, l.q0, l.q1, l.qw, lane, identity);
+				gather<3>(static_cast<keyframe_track<glm::vec3> const*>(nullptr), 0.0f, unused, l.s0, l.s1, l.sw, lane, one);
+				continue;
+			}
+
+			sampler& s = samplers_[i];
+			float t = bindings_[s.binding].playback.time;
+			trs_track const* track = s.track;
+			gather<3>(track != nullptr ? &track->translation : nullptr, t, s.cursor[0], l.t0, l.t1, l.tw, lane, zero);
+			gather<4>(track != nullptr ? &track->rotation : nullptr, t, s.cursor[1], l.q0, l.q1, l.qw, lane, identity);
+			gather<3>(track != nullptr ? &track->scale : nullptr, t, s.cursor[2], l.s0, l.s1, l.sw, lane, one);
+			out[lane] = &local_[i][0][0];
+		}
+		evaluate_lanes(l, out);
+	}
+}
+
+void animator::compose(std::size_t begin, std::size_t end)
+{
+	for (std::size_t i = begin; i < end; ++i)
+	{
+		binding const& b = bindings_[i];
+		if (b.skin == nullptr)
+		{
+			models_[i] = b.base * local_[b.first_sampler];
+			continue;
+		}
+
+		// Bone to mesh space, parents first, then from the bind pose.
+		skeleton const* s = b.skin->get_skeleton();
+		if (s == nullptr || s->parents.size() != b.sampler_count)
+			continue;
+		skeleton const& bones = *s;
+		::glm::mat4* global = &palettes_[b.first_sampler];
+		::glm::mat4 const* local = &local_[b.first_sampler];
+		for (std::size_t k = 0; k < b.sampler_count; ++k)
+			global[k] = bones.parents[k] < 0 ? local[k] : global[bones.parents[k]] * local[k];
+		for (std::size_t k = 0; k < b.sampler_count; ++k)
+			global[k] = global[k] * bones.inverse_bind[k];
+	}
+}
+
+} // namespace gl
+} // namespace graphics
+} // namespace mrr
@@ -0,0 +1,124 @@
+#include <mrr/graphics/bounds.hxx>
+
+#include <limits>
+
+namespace mrr {
+namespace graphics {
+namespace gl {
+
+//m=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-
+aabb::aabb()
+	: lower(::std::numeric_limits<float>::max()),
+	  upper(-::std::numeric_limits<float>::max())
+{
+}
+
+aabb::aabb(::glm::vec3 const& lower, ::glm::vec3 const& upper)
+	: lower(lower), upper(upper)
+{
+}
+
+void aabb::expand(::glm::vec3 const& p)
+{
+	lower = ::glm::min(lower, p);
+	upper = ::glm::max(upper, p);
+}
+
+void aabb::expand(aabb const& b)
+{
+	if (b.is_empty())
+		return;
+
+	lower = ::glm::min(lower, b.lower);
+	upper = ::glm::max(upper, b.upper);
+}
+
+bool aabb::is_empty() const
+{
+	return lower.x > upper.x || lower.y > upper.y || lower.z > upper.z;
+}
+
+::glm::vec3 aabb::center() const
+{
+	return (lower + upper) * 0.5f;
+}
+
+::glm::vec3 aabb::extent() const
+{
+	return (upper - lower) * 0.5f;
+}
+
+float aabb::radius() const
+{
+	return is_empty() ? 0.0f : ::glm::length(extent());
+}
+
+aabb aabb::transformed(::glm::mat4 const& m) const
+{
+	if (is_empty())
+		return *this;
+
+	// Arvo's method: transform the center and accumulate the absolute
+	// contribution of each axis to the new half extents.
+	::glm::vec3 c = ::glm::vec3(m * ::glm::vec4(center(), 1.0f));
+	::glm::vec3 e = extent();
+	::glm::vec3 new_extent(0.0f);
+
+	for (int col = 0; col < 3; ++col)
+		for (int row = 0; row < 3; ++row)
+			new_extent[row] += ::glm::abs(m[col][row]) * e[col];
+
+	return aabb(c - new_extent, c + new_extent);
+}
+
+aabb compute_bounds(::glm::vec3 const* points, ::std::size_t count)
+{
+	aabb b;
+	for (::std::size_t i = 0; i < count; ++i)
+		b.expand(points[i]);
+	return b;
+}
+
+aabb compute_bounds(::std::vector<::glm::vec3> const& points)
+{
+	return compute_bounds(points.data(), points.size());
+}
+
+
+//m=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-
+frustum::frustum(::glm::mat4 const& vp)
+{
+	// Gribb/Hartmann plane extraction; rows of the matrix are combined.
+	for (int i = 0; i < 4; ++i)
+	{
+		planes_[0][i] = vp[i][3] + vp[i][0]; // left
+		planes_[1][i] = vp[i][3] - vp[i][0]; // right
+		planes_[2][i] = vp[i][3] + vp[i][1]; // bottom
+		planes_[3][i] = vp[i][3] - vp[i][1]; // top
+		planes_[4][i] = vp[i][3] + vp[i][2]; // near
+		planes_[5][i] = vp[i][3] - vp[i][2]; // far
+	}
+}
+
+bool frustum::intersects(aabb const& b) const
+{
+	if (b.is_empty())
+		return false;
+
+	::glm::vec3 c = b.center();
+	::glm::vec3 e = b.extent();
+
+	for (auto const& p : planes_)
+	{
+		float r = e.x * ::glm::abs(p.x) + e.y * ::glm::abs(p.y) + e.z * ::glm::abs(p.z);
+		float d = p.x * c.x + p.y * c.y + p.z * c.z + p.w;
+		if (d + r < 0.0f)
+			return false;
+	}
+
+	return true;
+}
+
+} // namespace gl
+} // namespace graphics
+} // namespace mrr
@@ -0,0 +1,375 @@
+#include <mrr/graphics/broadphase.hxx>
+#include <mrr/graphics/parallel.hxx>
+#include <mrr/graphics/timing.hxx>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <ostream>
+
+namespace mrr {
+namespace graphics {
+namespace gl {
+
+namespace {
+
+// Endpoints refreshed, and swept, per thread.
+std::size_t const parallel_grain = 4096;
+// The axis changes once another's spread of centers is this many times
+// wider, so that bodies moving about do not resort every frame.
+float const axis_hysteresis = 2.0f;
+// Beyond this many exchanges per endpoint the insertion sort gives way to a
+// full sort, as when many components teleport.
+std::size_t const max_swaps_per_endpoint = 16;
+
+std::uint64_t make_key(std::uint32_t a, std::uint32_t b)
+{
+	if (a > b)
+		std::swap(a, b);
+	return (std::uint64_t(a) << 32) | b;
+}
+
+} // namespace
+
+
+//m=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-
+broadphase_stats::broadphase_stats()
+	: components(0),
+	  moved(0),
+	  swaps(0),
+	  pairs(0),
+	  begun(0),
+	  ended(0),
+	  update_ms(0.0)
+{
+}
+
+::std::ostream& operator <<(::std::ostream& out, broadphase_stats const& s)
+{
+	return out
+		<< "components: " << s.components
+		<< ", moved: " << s.moved
+		<< ", swaps: " << s.swaps
+		<< ", pairs: " << s.pairs
+		<< " (" << s.begun << " begun, " << s.ended << " ended)"
+		<< ", update time: " << s.update_ms << " ms";
+}
+
+
+//m=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-
+broadphase::broadphase()
+	: added_(0),
+	  axis_(0)
+{
+}
+
+broadphase::~broadphase()
+{
+	for (proxy& p : proxies_)
+		if (p.target != nullptr)
+			p.target->broadphase_ = nullptr;
+}
+
+void broadphase::add(model& m)
+{
+	if (auto c = dynamic_cast<component*>(&m))
+	{
+		if (c->broadphase_ == this)
+			return;
+		if (c->broadphase_ != nullptr)
+			c->broadphase_->remove(*c);
+
+		std::uint32_t id;
+		if (!free_.empty())
+		{
+			id = free_.back();
+			free_.pop_back();
+		}
+		else
+		{
+			id = std::uint32_t(proxies_.size());
+			proxies_.push_back(proxy());
+		}
+
+		proxy& p = proxies_[id];
+		p.bounds = c->get_world_bounds();
+		p.target = c;
+		p.moved = false;
+		c->broadphase_ = this;
+		c->broadphase_proxy_ = id;
+
+		endpoints_.push_back(endpoint{ p.bounds.lower, id, p.bounds.upper, 0.0f });
+		++added_;
+		return;
+	}
+
+	for (model* child : m.get_components())
+		add(*child);
+}
+
+void broadphase::remove(model& m)
+{
+	if (auto c = dynamic_cast<component*>(&m))
+	{
+		if (c->broadphase_ != this)
+			return;
+
+		// The proxy is only reused once update() has dropped its endpoint.
+		proxies_[c->broadphase_proxy_].target = nullptr;
+		removed_.push_back(c->broadphase_proxy_);
+		c->broadphase_ = nullptr;
+		return;
+	}
+
+	for (model* child : m.get_components())
+		remove(*child);
+}
+
+void broadphase::move(std::uint32_t id, aabb const& bounds)
+{
+	proxies_[id].bounds = bounds;
+	proxies_[id].moved = true;
+}
+
+void broadphase::set_begin_callback(callback_type const& callback)
+{
+	begin_callback_ = callback;
+}
+
+void broadphase::set_overlap_callback(callback_type const& callback)
+{
+	overlap_callback_ = callback;
+}
+
+void broadphase::set_end_callback(callback_type const& callback)
+{
+	end_callback_ = callback;
+}
+
+std::vector<broadphase::pair_type> const& broadphase::get_pairs() const
+{
+	return pairs_;
+}
+
+broadphase_stats const& broadphase::get_stats() const
+{
+	return stats_;
+}
+
+int broadphase::get_axis() const
+{
+	return axis_;
+}
+
+void broadphase::update()
+{
+	auto start = std::chrono::steady_clock::now();
+	stats_ = broadphase_stats();
+
+	if (!removed_.empty())
+	{
+		endpoints_.erase(
+			std::remove_if(endpoints_.begin(), endpoints_.end(), [this](endpoint const& e) {
+				return proxies_[e.id].target == nullptr;
+			}),
+			endpoints_.end()
+		);
+	}
+
+	std::atomic<std::size_t> moved(0);
+	impl::parallel_for(endpoints_.size(), parallel_grain, [&](std::size_t begin, std::size_t end) {
+		std::size_t local = 0;
+		for (std::size_t i = begin; i < end; ++i)
+		{
+			proxy& p = proxies_[endpoints_[i].id];
+			if (!p.moved)
+				continue;
+			endpoints_[i].lower = p.bounds.lower;
+			endpoints_[i].upper = p.bounds.upper;
+			p.moved = false;
+			++local;
+		}
+		moved += local;
+	});
+
+	bool resort = choose_axis();
+	sort(resort);
+
+	std::vector<std::uint64_t> keys;
+	sweep(keys);
+	std::sort(keys.begin(), keys.end());
+	report(keys);
+
+	// Removed proxies are free now that nothing refers to them.
+	free_.insert(free_.end(), removed_.begin(), removed_.end());
+	removed_.clear();
+	added_ = 0;
+
+	stats_.components = endpoints_.size();
+	stats_.moved = moved;
+	stats_.pairs = keys_.size();
+	stats_.update_ms = impl::elapsed_ms(start);
+}
+
+bool broadphase::choose_axis()
+{
+	// Spread of the centers along each axis, as the sum of their squared
+	// distances from the mean.
+	double sum[3] = { 0.0, 0.0, 0.0 }, sum_squares[3] = { 0.0, 0.0, 0.0 };
+	std::size_t count = 0;
+	std::mutex merge;
+	impl::parallel_for(endpoints_.size(), parallel_grain, [&](std::size_t begin, std::size_t end) {
+		double local_sum[3] = { 0.0, 0.0, 0.0 }, local_squares[3] = { 0.0, 0.0, 0.0 };
+		std::size_t local_count = 0;
+		for (std::size_t i = begin; i < end; ++i)
+		{
+			endpoint const& e = endpoints_[i];
+			if (e.lower.x > e.upper.x)
+				continue;
+			++local_count;
+			for (int axis = 0; axis < 3; ++axis)
+			{
+				double c = 0.5 * (double(e.lower[axis]) + e.upper[axis]);
+				local_sum[axis] += c;
+				local_squares[axis] += c * c;
+			}
+		}
+
+		std::lock_guard<std::mutex> lock(merge);
+		count += local_count;
+		for (int axis = 0; axis < 3; ++axis)
+		{
+			sum[axis] += local_sum[axis];
+			sum_squares[axis] += local_squares[axis];
+		}
+	});
+
+	if (count == 0)
+		return false;
+
+	double spread[3];
+	for (int axis = 0; axis < 3; ++axis)
+		spread[axis] = sum_squares[axis] - sum[axis] * sum[axis] / count;
+
+	int widest = 0;
+	for (int axis = 1; axis < 3; ++axis)
+		if (spread[axis] > spread[widest])
+			widest = axis;
+
+	if (widest == axis_ || spread[widest] <= axis_hysteresis * spread[axis_])
+		return false;
+
+	axis_ = widest;
+	return true;
+}
+
+void broadphase::sort(bool resort)
+{
+	int const axis = axis_;
+	auto less = [axis](endpoint const& a, endpoint const& b) {
+		return a.lower[axis] < b.lower[axis];
+	};
+
+	// Endpoints added since the last update are at the end, in no order.
+	if (resort || added_ * 8 > endpoints_.size())
+	{
+		std::sort(endpoints_.begin(), endpoints_.end(), less);
+		return;
+	}
+
+	std::size_t const max_swaps = max_swaps_per_endpoint * endpoints_.size();
+	std::size_t swaps = 0;
+	for (std::size_t i = 1; i < endpoints_.size(); ++i)
+	{
+		endpoint e = endpoints_[i];
+		std::size_t j = i;
+		for (; j > 0 && less(e, endpoints_[j - 1]); --j)
+			endpoints_[j] = endpoints_[j - 1];
+		endpoints_[j] = e;
+
+		swaps += i - j;
+		if (swaps > max_swaps)
+		{
+			std::sort(endpoints_.begin(), endpoints_.end(), less);
+			break;
+		}
+	}
+	stats_.swaps = swaps;
+}
+
+void broadphase::sweep(std::vector<std::uint64_t>& keys) const
+{
+	int const a = axis_, b = (axis_ + 1) % 3, c = (axis_ + 2) % 3;
+	std::size_t const count = endpoints_.size();
+
+	std::mutex merge;
+	impl::parallel_for(count, parallel_grain, [&](std::size_t begin, std::size_t end) {
+		std::vector<std::uint64_t> local;
+		for (std::size_t i = begin; i < end; ++i)
+		{
+			endpoint const& e = endpoints_[i];
+			for (std::size_t j = i + 1; j < count && endpoints_[j].lower[a] <= e.upper[a]; ++j)
+			{
+				endpoint const& o = endpoints_[j];
+				if (o.lower[b] <= e.upper[b] && e.lower[b] <= o.upper[b]
+				    && o.lower[c] <= e.upper[c] && e.lower[c] <= o.upper[c])
+					local.push_back(make_key(e.id, o.id));
+			}
+		}
+
+		std::lock_guard<std::mutex> lock(merge);
+		keys.insert(keys.end(), local.begin(), local.end());
+	});
+}
+
+void broadphase::report(std::vector<std::uint64_t> const& keys)
+{
+	auto first = [this](std::uint64_t key) { return proxies_[key >> 32].target; };
+	auto second = [this](std::uint64_t key) { return proxies_[key & 0xffffffffu].target; };
+
+	// Both lists are sorted, so one walk finds the pairs that ended and
+	// those that began. Pairs of removed components end silently.
+	std::vector<std::uint64_t> begun;
+	std::size_t i = 0, j = 0;
+	while (i < keys_.size() || j < keys.size())
+	{
+		if (j == keys.size() || (i < keys_.size() && keys_[i] < keys[j]))
+		{
+			std::uint64_t key = keys_[i++];
+			if (first(key) == nullptr || second(key) == nullptr)
+				continue;
+			++stats_.ended;
+			if (end_callback_)
+				end_callback_(*first(key), *second(key));
+		}
+		else if (i == keys_.size() || keys[j] < keys_[i])
+		{
+			begun.push_back(keys[j++]);
+		}
+		else
+		{
+			++i;
+			++j;
+		}
+	}
+
+	stats_.begun = begun.size();
+	if (begin_callback_)
+		for (std::uint64_t key : begun)
+			begin_callback_(*first(key), *second(key));
+
+	keys_ = keys;
+	pairs_.clear();
+	pairs_.reserve(keys_.size());
+	for (std::uint64_t key : keys_)
+		pairs_.push_back(pair_type(first(key), second(key)));
+
+	if (overlap_callback_)
+		for (pair_type const& p : pairs_)
+			overlap_callback_(*p.first, *p.second);
+}
+
+} // namespace gl
+} // namespace graphics
+} // namespace mrr
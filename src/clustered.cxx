@@ -0,0 +1,408 @@
+#include <mrr/graphics/clustered.hxx>
+#include <mrr/graphics/parallel.hxx>
+#include <mrr/graphics/state_cache.hxx>
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <limits>
+
+namespace mrr {
+namespace graphics {
+namespace gl {
+
+shader_handle clustered_colour_shader()
+{
+	return shader_handle(
+		"/usr/local/share/mrr/graphics/shaders/clustered-colour-vertex-shader.glsl",
+		"/usr/local/share/mrr/graphics/shaders/clustered-colour-fragment-shader.glsl"
+	);
+}
+
+shader_handle clustered_texture_shader()
+{
+	return shader_handle(
+		"/usr/local/share/mrr/graphics/shaders/clustered-texture-vertex-shader.glsl",
+		"/usr/local/share/mrr/graphics/shaders/clustered-texture-fragment-shader.glsl"
+	);
+}
+
+
+namespace {
+
+// Light indices are uploaded as GL_R16UI.
+std::size_t const max_light_count = std::numeric_limits<std::uint16_t>::max() + 1;
+
+// Below this many lights binning is cheaper than starting threads.
+std::size_t const parallel_light_threshold = 64;
+
+::glm::vec3 unproject(::glm::mat4 const& inverse_P, float x, float y, float z)
+{
+	::glm::vec4 p = inverse_P * ::glm::vec4(x, y, z, 1.0f);
+	return ::glm::vec3(p) / p.w;
+}
+
+// The point on the line through a and b at view space distance depth.
+::glm::vec3 at_depth(::glm::vec3 const& a, ::glm::vec3 const& b, float depth)
+{
+	float t = (depth + a.z) / (a.z - b.z);
+	return a + t * (b - a);
+}
+
+bool sphere_intersects(aabb const& box, ::glm::vec3 const& center, float radius)
+{
+	::glm::vec3 closest = ::glm::clamp(center, box.lower, box.upper);
+	::glm::vec3 d = closest - center;
+	return ::glm::dot(d, d) <= radius * radius;
+}
+
+unsigned clamp_index(float f, unsigned count)
+{
+	if (!(f > 0.0f))
+		return 0;
+	return std::min(static_cast<unsigned>(f), count - 1);
+}
+
+} // namespace
+
+
+//m=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-
+light_clusters::light_clusters(unsigned tiles_x, unsigned tiles_y, unsigned slices)
+	: tiles_x_(std::max(tiles_x, 1u)),
+	  tiles_y_(std::max(tiles_y, 1u)),
+	  slices_(std::max(slices, 1u)),
+	  cutoff_intensity_(1.0f / 512.0f),
+	  max_lights_per_cluster_(128),
+	  projection_(0.0f),
+	  near_(0.0f),
+	  far_(0.0f),
+	  depth_scale_(0.0f),
+	  depth_bias_(0.0f),
+	  grid_texture_(0),
+	  index_texture_(0),
+	  light_texture_(0)
+{
+	std::fill(viewport_, viewport_ + 4, 0);
+}
+
+light_clusters::~light_clusters()
+{
+	GLuint textures[] = { grid_texture_, index_texture_, light_texture_ };
+	if (grid_texture_ != 0)
+	{
+		::glDeleteTextures(3, textures);
+		for (GLuint t : textures)
+			state::deleted_texture(t);
+	}
+}
+
+void light_clusters::set_cutoff_intensity(float intensity)
+{
+	cutoff_intensity_ = intensity;
+}
+
+void light_clusters::set_max_lights_per_cluster(std::size_t count)
+{
+	max_lights_per_cluster_ = std::min<std::size_t>(
+		std::max<std::size_t>(count, 1), std::numeric_limits<std::uint16_t>::max()
+	);
+	cluster_lights_.clear();
+}
+
+void light_clusters::create_textures()
+{
+	grid_buffer_.create();
+	index_buffer_.create();
+	light_buffer_.create();
+
+	GLuint textures[3];
+	::glGenTextures(3, textures);
+	grid_texture_ = textures[0];
+	index_texture_ = textures[1];
+	light_texture_ = textures[2];
+
+	// Buffers are orphaned with glBufferData every frame; the texture keeps
+	// referring to the buffer object, so this association is made once.
+	grid_buffer_.set_data(GL_TEXTURE_BUFFER, 2 * sizeof(GLuint), nullptr, GL_STREAM_DRAW);
+	index_buffer_.set_data(GL_TEXTURE_BUFFER, sizeof(std::uint16_t), nullptr, GL_STREAM_DRAW);
+	light_buffer_.set_data(GL_TEXTURE_BUFFER, sizeof(light), nullptr, GL_STREAM_DRAW);
+	state::bind_buffer(GL_TEXTURE_BUFFER, 0);
+
+	// Each texture on the unit apply() binds it to.
+	state::bind_texture(GL_TEXTURE0 + grid_texture_unit, GL_TEXTURE_BUFFER, grid_texture_);
+	grid_buffer_.bind_texture_buffer(GL_RG32UI);
+	state::bind_texture(GL_TEXTURE0 + index_texture_unit, GL_TEXTURE_BUFFER, index_texture_);
+	index_buffer_.bind_texture_buffer(GL_R16UI);
+	state::bind_texture(GL_TEXTURE0 + light_texture_unit, GL_TEXTURE_BUFFER, light_texture_);
+	light_buffer_.bind_texture_buffer(GL_RGBA32F);
+}
+
+void light_clusters::build_cluster_bounds(::glm::mat4 const& P)
+{
+	projection_ = P;
+	::glm::mat4 inverse_P = ::glm::inverse(P);
+
+	near_ = -unproject(inverse_P, 0.0f, 0.0f, -1.0f).z;
+	far_ = -unproject(inverse_P, 0.0f, 0.0f, 1.0f).z;
+	near_ = std::max(near_, std::numeric_limits<float>::epsilon());
+	far_ = std::max(far_, near_ * 1.001f);
+
+	// Slice k covers view depths [near (far/near)^(k/n), near (far/near)^((k+1)/n)),
+	// so the slice of depth d is log(d) * depth_scale_ + depth_bias_.
+	float log_ratio = std::log(far_ / near_);
+	depth_scale_ = slices_ / log_ratio;
+	depth_bias_ = -slices_ * std::log(near_) / log_ratio;
+
+	slice_depths_.resize(slices_ + 1);
+	for (unsigned k = 0; k <= slices_; ++k)
+		slice_depths_[k] = near_ * std::pow(far_ / near_, float(k) / slices_);
+
+	// The near and far plane points of every tile corner.
+	unsigned const corners_x = tiles_x_ + 1;
+	std::vector<::glm::vec3> near_corners(corners_x * (tiles_y_ + 1));
+	std::vector<::glm::vec3> far_corners(near_corners.size());
+	for (unsigned j = 0; j <= tiles_y_; ++j)
+	{
+		for (unsigned i = 0; i <= tiles_x_; ++i)
+		{
+			float x = -1.0f + 2.0f * i / tiles_x_;
+			float y = -1.0f + 2.0f * j / tiles_y_;
+			near_corners[i + corners_x * j] = unproject(inverse_P, x, y, -1.0f);
+			far_corners[i + corners_x * j] = unproject(inverse_P, x, y, 1.0f);
+		}
+	}
+
+	cluster_bounds_.resize(get_cluster_count());
+	for (unsigned k = 0; k < slices_; ++k)
+	{
+		for (unsigned j = 0; j < tiles_y_; ++j)
+		{
+			for (unsigned i = 0; i < tiles_x_; ++i)
+			{
+				aabb& box = cluster_bounds_[i + tiles_x_ * (j + tiles_y_ * k)];
+				box = aabb();
+				for (unsigned c = 0; c < 4; ++c)
+				{
+					std::size_t corner = (i + (c & 1)) + corners_x * (j + (c >> 1));
+					box.expand(at_depth(near_corners[corner], far_corners[corner], slice_depths_[k]));
+					box.expand(at_depth(near_corners[corner], far_corners[corner], slice_depths_[k + 1]));
+				}
+			}
+		}
+	}
+}
+
+void light_clusters::update(model const& lights, ::glm::mat4 const& V, ::glm::mat4 const& P)
+{
+	if (grid_texture_ == 0)
+		create_textures();
+
+	state::get_viewport(viewport_);
+
+	if (P != projection_ || cluster_bounds_.size() != get_cluster_count())
+		build_cluster_bounds(P);
+
+	std::vector<::glm::vec3> const& locations = lights.get_point_source_locations();
+	std::vector<::glm::vec3> const& colours = lights.get_point_source_colours();
+	std::vector<float> const& powers = lights.get_point_source_powers();
+
+	std::size_t light_count = locations.size();
+	if (light_count > max_light_count)
+	{
+		std::cerr << "WARNING: Only the first " << max_light_count << " of "
+		          << light_count << " point sources are clustered.\n";
+		light_count = max_light_count;
+	}
+
+	lights_.resize(light_count);
+	light_ranges_.resize(light_count);
+	for (std::size_t i = 0; i < light_count; ++i)
+	{
+		light& l = lights_[i];
+		l.position = ::glm::vec3(V * ::glm::vec4(locations[i], 1.0f));
+		l.colour = colours[i] * powers[i];
+		l.padding = 0.0f;
+
+		// Distance at which colour * power / d^2 drops below the cutoff.
+		float peak = std::max(l.colour.x, std::max(l.colour.y, l.colour.z));
+		l.radius = peak > 0.0f ? std::sqrt(peak / cutoff_intensity_) : 0.0f;
+
+		// Slices from the depth range of the sphere, tiles from the screen
+		// rectangle of its bounding box, or every tile if it crosses the
+		// camera plane.
+		cluster_range& r = light_ranges_[i];
+		float depth = -l.position.z;
+		if (l.radius == 0.0f || depth + l.radius < near_ || depth - l.radius > far_)
+		{
+			r.x_begin = r.x_end = r.y_begin = r.y_end = r.z_begin = r.z_end = 0;
+			continue;
+		}
+
+		r.z_begin = clamp_index(std::log(std::max(depth - l.radius, near_)) * depth_scale_ + depth_bias_, slices_);
+		r.z_end = clamp_index(std::log(std::min(depth + l.radius, far_)) * depth_scale_ + depth_bias_, slices_) + 1;
+
+		r.x_begin = r.y_begin = 0;
+		r.x_end = tiles_x_;
+		r.y_end = tiles_y_;
+
+		if (depth - l.radius > near_)
+		{
+			::glm::vec2 lower(std::numeric_limits<float>::max());
+			::glm::vec2 upper(-std::numeric_limits<float>::max());
+			for (unsigned c = 0; c < 8; ++c)
+			{
+				::glm::vec3 corner = l.position + l.radius * ::glm::vec3(
+					(c & 1) ? 1.0f : -1.0f, (c & 2) ? 1.0f : -1.0f, (c & 4) ? 1.0f : -1.0f
+				);
+				::glm::vec4 clip = P * ::glm::vec4(corner, 1.0f);
+				::glm::vec2 ndc = ::glm::vec2(clip.x, clip.y) / clip.w;
+				lower = ::glm::min(lower, ndc);
+				upper = ::glm::max(upper, ndc);
+			}
+
+			r.x_begin = clamp_index((lower.x + 1.0f) * 0.5f * tiles_x_, tiles_x_);
+			r.x_end = clamp_index((upper.x + 1.0f) * 0.5f * tiles_x_, tiles_x_) + 1;
+			r.y_begin = clamp_index((lower.y + 1.0f) * 0.5f * tiles_y_, tiles_y_);
+			r.y_end = clamp_index((upper.y + 1.0f) * 0.5f * tiles_y_, tiles_y_) + 1;
+		}
+	}
+
+	std::size_t capacity = get_cluster_count() * max_lights_per_cluster_;
+	if (cluster_lights_.size() != capacity)
+		cluster_lights_.resize(capacity);
+	cluster_counts_.assign(get_cluster_count(), 0);
+	overflow_.assign(slices_, 0);
+
+	impl::parallel_for(
+		slices_, light_count < parallel_light_threshold ? slices_ : 1,
+		[this](std::size_t first, std::size_t last) { bin_lights(first, last); }
+	);
+
+	upload();
+}
+
+void light_clusters::bin_lights(std::size_t first_slice, std::size_t last_slice)
+{
+	for (std::size_t i = 0; i < lights_.size(); ++i)
+	{
+		light const& l = lights_[i];
+		cluster_range const& r = light_ranges_[i];
+
+		std::size_t z_begin = std::max<std::size_t>(r.z_begin, first_slice);
+		std::size_t z_end = std::min<std::size_t>(r.z_end, last_slice);
+
+		for (std::size_t k = z_begin; k < z_end; ++k)
+		{
+			for (unsigned j = r.y_begin; j < r.y_end; ++j)
+			{
+				for (unsigned c = r.x_begin; c < r.x_end; ++c)
+				{
+					std::size_t cluster = c + tiles_x_ * (j + tiles_y_ * k);
+					if (!sphere_intersects(cluster_bounds_[cluster], l.position, l.radius))
+						continue;
+
+					std::uint16_t& count = cluster_counts_[cluster];
+					if (count == max_lights_per_cluster_)
+					{
+						++overflow_[k];
+						continue;
+					}
+
+					cluster_lights_[cluster * max_lights_per_cluster_ + count] = i;
+					++count;
+				}
+			}
+		}
+	}
+}
+
+void light_clusters::upload()
+{
+	std::size_t cluster_count = get_cluster_count();
+
+	grid_.resize(2 * cluster_count);
+	indices_.clear();
+	for (std::size_t c = 0; c < cluster_count; ++c)
+	{
+		grid_[2 * c] = indices_.size();
+		grid_[2 * c + 1] = cluster_counts_[c];
+
+		std::uint16_t const* first = &cluster_lights_[c * max_lights_per_cluster_];
+		indices_.insert(indices_.end(), first, first + cluster_counts_[c]);
+	}
+
+	// Empty texture buffers are not allowed; a zero count never reads these.
+	if (indices_.empty())
+		indices_.push_back(0);
+	if (lights_.empty())
+		lights_.push_back(light());
+
+	grid_buffer_.set_data(GL_TEXTURE_BUFFER, grid_.size() * sizeof(GLuint), grid_.data(), GL_STREAM_DRAW);
+	index_buffer_.set_data(GL_TEXTURE_BUFFER, indices_.size() * sizeof(std::uint16_t), indices_.data(), GL_STREAM_DRAW);
+	light_buffer_.set_data(GL_TEXTURE_BUFFER, lights_.size() * sizeof(light), lights_.data(), GL_STREAM_DRAW);
+	state::bind_buffer(GL_TEXTURE_BUFFER, 0);
+}
+
+light_cluster_uniforms light_clusters::get_uniform_locations(shader_handle& s)
+{
+	light_cluster_uniforms u;
+	u.grid = s.get_uniform_location("ClusterGrid");
+	u.indices = s.get_uniform_location("ClusterLightIndices");
+	u.lights = s.get_uniform_location("ClusterLights");
+	u.dimensions = s.get_uniform_location("ClusterDimensions");
+	u.tile_size = s.get_uniform_location("ClusterTileSize");
+	u.viewport_origin = s.get_uniform_location("ViewportOrigin");
+	u.depth_scale = s.get_uniform_location("ClusterDepthScale");
+	u.depth_bias = s.get_uniform_location("ClusterDepthBias");
+	return u;
+}
+
+void light_clusters::apply(light_cluster_uniforms const& u) const
+{
+	state::bind_texture(GL_TEXTURE0 + grid_texture_unit, GL_TEXTURE_BUFFER, grid_texture_);
+	state::bind_texture(GL_TEXTURE0 + index_texture_unit, GL_TEXTURE_BUFFER, index_texture_);
+	state::bind_texture(GL_TEXTURE0 + light_texture_unit, GL_TEXTURE_BUFFER, light_texture_);
+
+	::glUniform1i(u.grid, grid_texture_unit);
+	::glUniform1i(u.indices, index_texture_unit);
+	::glUniform1i(u.lights, light_texture_unit);
+	::glUniform3i(u.dimensions, tiles_x_, tiles_y_, slices_);
+	::glUniform2f(
+		u.tile_size,
+		float(viewport_[2]) / tiles_x_,
+		float(viewport_[3]) / tiles_y_
+	);
+	::glUniform2f(u.viewport_origin, viewport_[0], viewport_[1]);
+	::glUniform1f(u.depth_scale, depth_scale_);
+	::glUniform1f(u.depth_bias, depth_bias_);
+}
+
+std::size_t light_clusters::get_cluster_count() const
+{
+	return std::size_t(tiles_x_) * tiles_y_ * slices_;
+}
+
+std::size_t light_clusters::get_light_count() const
+{
+	return light_ranges_.size();
+}
+
+std::size_t light_clusters::get_light_reference_count() const
+{
+	std::size_t total = 0;
+	for (std::uint16_t count : cluster_counts_)
+		total += count;
+	return total;
+}
+
+std::size_t light_clusters::get_overflow_count() const
+{
+	std::size_t total = 0;
+	for (std::size_t count : overflow_)
+		total += count;
+	return total;
+}
+
+} // namespace gl
+} // namespace graphics
+} // namespace mrr
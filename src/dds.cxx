@@ -0,0 +1,388 @@
+#include <mrr/graphics/dds.hxx>
+#include <mrr/graphics/mapped_file.hxx>
+#include <mrr/graphics/state_cache.hxx>
+#include <mrr/graphics/memory_accounting.hxx>
+
+#include <cstring>
+#include <iostream>
+
+namespace mrr {
+namespace graphics {
+namespace gl {
+namespace dds {
+
+namespace {
+
+std::size_t const magic_size = 4;
+std::size_t const header_size = 124;
+std::size_t const dx10_header_size = 20;
+std::size_t const pixel_format_size = 32;
+
+// Header field offsets, relative to the end of the magic number.
+std::size_t const header_flags = 4;
+std::size_t const header_height = 8;
+std::size_t const header_width = 12;
+std::size_t const header_depth = 20;
+std::size_t const header_mip_count = 24;
+std::size_t const header_pixel_format = 72;
+std::size_t const header_caps2 = 108;
+
+std::size_t const pixel_format_flags = 4;
+std::size_t const pixel_format_fourcc = 8;
+
+std::uint32_t const flag_mip_count = 0x20000;
+std::uint32_t const flag_depth = 0x800000;
+std::uint32_t const pixel_format_has_fourcc = 0x4;
+std::uint32_t const caps2_cubemap = 0x200;
+std::uint32_t const caps2_all_faces = 0xFC00;
+std::uint32_t const caps2_volume = 0x200000;
+
+std::uint32_t const dx10_dimension_texture2d = 3;
+std::uint32_t const dx10_misc_texturecube = 0x4;
+
+std::uint32_t const max_dimension = 1u << 16;
+std::uint32_t const max_array_size = 1u << 11;
+
+constexpr std::uint32_t fourcc(char a, char b, char c, char d)
+{
+	return std::uint32_t(std::uint8_t(a))
+		| (std::uint32_t(std::uint8_t(b)) << 8)
+		| (std::uint32_t(std::uint8_t(c)) << 16)
+		| (std::uint32_t(std::uint8_t(d)) << 24);
+}
+
+// Unaligned little endian read, without type punning.
+inline std::uint32_t read_u32(unsigned char const* p)
+{
+	return std::uint32_t(p[0])
+		| (std::uint32_t(p[1]) << 8)
+		| (std::uint32_t(p[2]) << 16)
+		| (std::uint32_t(p[3]) << 24);
+}
+
+bool format_from_fourcc(std::uint32_t code, GLenum& format, std::uint32_t& block_bytes)
+{
+	switch (code)
+	{
+	case fourcc('D', 'X', 'T', '1'):
+		format = GL_COMPRESSED_RGBA_S3TC_DXT1_EXT; block_bytes = 8; return true;
+	case fourcc('D', 'X', 'T', '2'):
+	case fourcc('D', 'X', 'T', '3'):
+		format = GL_COMPRESSED_RGBA_S3TC_DXT3_EXT; block_bytes = 16; return true;
+	case fourcc('D', 'X', 'T', '4'):
+	case fourcc('D', 'X', 'T', '5'):
+		format = GL_COMPRESSED_RGBA_S3TC_DXT5_EXT; block_bytes = 16; return true;
+	case fourcc('A', 'T', 'I', '1'):
+	case fourcc('B', 'C', '4', 'U'):
+		format = GL_COMPRESSED_RED_RGTC1; block_bytes = 8; return true;
+	case fourcc('B', 'C', '4', 'S'):
+		format = GL_COMPRESSED_SIGNED_RED_RGTC1; block_bytes = 8; return true;
+	case fourcc('A', 'T', 'I', '2'):
+	case fourcc('B', 'C', '5', 'U'):
+		format = GL_COMPRESSED_RG_RGTC2; block_bytes = 16; return true;
+	case fourcc('B', 'C', '5', 'S'):
+		format = GL_COMPRESSED_SIGNED_RG_RGTC2; block_bytes = 16; return true;
+	default:
+		return false;
+	}
+}
+
+bool format_from_dxgi(std::uint32_t dxgi, GLenum& format, std::uint32_t& block_bytes)
+{
+	switch (dxgi)
+	{
+	case 70: // BC1_TYPELESS
+	case 71: // BC1_UNORM
+		format = GL_COMPRESSED_RGBA_S3TC_DXT1_EXT; block_bytes = 8; return true;
+	case 72: // BC1_UNORM_SRGB
+		format = GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT1_EXT; block_bytes = 8; return true;
+	case 73: // BC2_TYPELESS
+	case 74: // BC2_UNORM
+		format = GL_COMPRESSED_RGBA_S3TC_DXT3_EXT; block_bytes = 16; return true;
+	case 75: // BC2_UNORM_SRGB
+		format = GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT3_EXT; block_bytes = 16; return true;
+	case 76: // BC3_TYPELESS
+	case 77: // BC3_UNORM
+		format = GL_COMPRESSED_RGBA_S3TC_DXT5_EXT; block_bytes = 16; return true;
+	case 78: // BC3_UNORM_SRGB
+		format = GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT5_EXT; block_bytes = 16; return true;
+	case 79: // BC4_TYPELESS
+	case 80: // BC4_UNORM
+		format = GL_COMPRESSED_RED_RGTC1; block_bytes = 8; return true;
+	case 81: // BC4_SNORM
+		format = GL_COMPRESSED_SIGNED_RED_RGTC1; block_bytes = 8; return true;
+	case 82: // BC5_TYPELESS
+	case 83: // BC5_UNORM
+		format = GL_COMPRESSED_RG_RGTC2; block_bytes = 16; return true;
+	case 84: // BC5_SNORM
+		format = GL_COMPRESSED_SIGNED_RG_RGTC2; block_bytes = 16; return true;
+	case 94: // BC6H_TYPELESS
+	case 95: // BC6H_UF16
+		format = GL_COMPRESSED_RGB_BPTC_UNSIGNED_FLOAT; block_bytes = 16; return true;
+	case 96: // BC6H_SF16
+		format = GL_COMPRESSED_RGB_BPTC_SIGNED_FLOAT; block_bytes = 16; return true;
+	case 97: // BC7_TYPELESS
+	case 98: // BC7_UNORM
+		format = GL_COMPRESSED_RGBA_BPTC_UNORM; block_bytes = 16; return true;
+	case 99: // BC7_UNORM_SRGB
+		format = GL_COMPRESSED_SRGB_ALPHA_BPTC_UNORM; block_bytes = 16; return true;
+	default:
+		return false;
+	}
+}
+
+std::uint32_t full_mip_count(std::uint32_t width, std::uint32_t height)
+{
+	std::uint32_t levels = 1;
+	std::uint32_t size = width > height ? width : height;
+	while (size > 1)
+	{
+		size >>= 1;
+		++levels;
+	}
+	return levels;
+}
+
+} // namespace
+
+
+//m=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-
+char const* describe(error e)
+{
+	switch (e)
+	{
+	case error::none:                  return "no error";
+	case error::truncated_header:      return "file is too short for a DDS header";
+	case error::bad_magic:             return "not a DDS file";
+	case error::bad_header_size:       return "invalid header size";
+	case error::unsupported_format:    return "unsupported pixel format (only BC1-BC7 are supported)";
+	case error::unsupported_dimension: return "volume and 1D textures are not supported";
+	case error::partial_cubemap:       return "cubemaps must have all six faces";
+	case error::bad_dimensions:        return "invalid width or height";
+	case error::bad_mip_count:         return "invalid mip map count";
+	case error::bad_array_size:        return "invalid array size";
+	case error::truncated_data:        return "file is shorter than its surfaces";
+	}
+	return "unknown error";
+}
+
+std::uint32_t image::mip_width(std::uint32_t level) const
+{
+	std::uint32_t w = width >> level;
+	return w > 0 ? w : 1;
+}
+
+std::uint32_t image::mip_height(std::uint32_t level) const
+{
+	std::uint32_t h = height >> level;
+	return h > 0 ? h : 1;
+}
+
+std::size_t image::mip_size(std::uint32_t level) const
+{
+	std::size_t blocks_x = (mip_width(level) + 3) / 4;
+	std::size_t blocks_y = (mip_height(level) + 3) / 4;
+	return blocks_x * blocks_y * block_bytes;
+}
+
+std::size_t image::surface_offset(std::uint32_t layer, std::uint32_t face, std::uint32_t level) const
+{
+	std::size_t chain = 0;
+	for (std::uint32_t l = 0; l < mip_count; ++l)
+		chain += mip_size(l);
+
+	std::size_t offset = data_offset + (std::size_t(layer) * faces + face) * chain;
+	for (std::uint32_t l = 0; l < level; ++l)
+		offset += mip_size(l);
+
+	return offset;
+}
+
+error parse(unsigned char const* data, std::size_t size, image& out)
+{
+	if (data == nullptr || size < magic_size + header_size)
+		return error::truncated_header;
+
+	if (std::memcmp(data, "DDS ", magic_size) != 0)
+		return error::bad_magic;
+
+	unsigned char const* header = data + magic_size;
+	unsigned char const* pixel_format = header + header_pixel_format;
+
+	if (read_u32(header) != header_size
+	    || read_u32(pixel_format) != pixel_format_size)
+		return error::bad_header_size;
+
+	std::uint32_t flags = read_u32(header + header_flags);
+	std::uint32_t caps2 = read_u32(header + header_caps2);
+
+	out.width = read_u32(header + header_width);
+	out.height = read_u32(header + header_height);
+	out.mip_count = (flags & flag_mip_count) ? read_u32(header + header_mip_count) : 1;
+	out.array_size = 1;
+	out.faces = 1;
+	out.data_offset = magic_size + header_size;
+
+	if ((caps2 & caps2_volume)
+	    || ((flags & flag_depth) && read_u32(header + header_depth) > 1))
+		return error::unsupported_dimension;
+
+	if (caps2 & caps2_cubemap)
+	{
+		if ((caps2 & caps2_all_faces) != caps2_all_faces)
+			return error::partial_cubemap;
+		out.faces = 6;
+	}
+
+	if (!(read_u32(pixel_format + pixel_format_flags) & pixel_format_has_fourcc))
+		return error::unsupported_format;
+
+	std::uint32_t code = read_u32(pixel_format + pixel_format_fourcc);
+	if (code == fourcc('D', 'X', '1', '0'))
+	{
+		if (size < out.data_offset + dx10_header_size)
+			return error::truncated_header;
+
+		unsigned char const* dx10 = data + out.data_offset;
+		out.data_offset += dx10_header_size;
+
+		if (!format_from_dxgi(read_u32(dx10), out.internal_format, out.block_bytes))
+			return error::unsupported_format;
+
+		if (read_u32(dx10 + 4) != dx10_dimension_texture2d)
+			return error::unsupported_dimension;
+
+		if (read_u32(dx10 + 8) & dx10_misc_texturecube)
+			out.faces = 6;
+
+		out.array_size = read_u32(dx10 + 12);
+		if (out.array_size == 0 || out.array_size > max_array_size)
+			return error::bad_array_size;
+	}
+	else if (!format_from_fourcc(code, out.internal_format, out.block_bytes))
+	{
+		return error::unsupported_format;
+	}
+
+	if (out.width == 0 || out.height == 0
+	    || out.width > max_dimension || out.height > max_dimension)
+		return error::bad_dimensions;
+
+	if (out.faces == 6 && out.width != out.height)
+		return error::bad_dimensions;
+
+	if (out.mip_count == 0)
+		out.mip_count = 1;
+	if (out.mip_count > full_mip_count(out.width, out.height))
+		return error::bad_mip_count;
+
+	if (out.faces == 6)
+		out.target = out.array_size > 1 ? GL_TEXTURE_CUBE_MAP_ARRAY : GL_TEXTURE_CUBE_MAP;
+	else
+		out.target = out.array_size > 1 ? GL_TEXTURE_2D_ARRAY : GL_TEXTURE_2D;
+
+	// The limits above keep this well inside 64 bits.
+	std::uint64_t chain = 0;
+	for (std::uint32_t level = 0; level < out.mip_count; ++level)
+		chain += out.mip_size(level);
+
+	std::uint64_t total = chain * out.faces * out.array_size;
+	if (total > size - out.data_offset)
+		return error::truncated_data;
+
+	out.data_size = static_cast<std::size_t>(total);
+	return error::none;
+}
+
+
+//m=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-
+GLuint load(std::string const& path, GLenum& out_target)
+{
+	mapped_file file(path);
+	if (!file)
+	{
+		std::cerr << "ERROR: Cannot open DDS texture...\tpath: " << path << std::endl;
+		return 0;
+	}
+
+	image img;
+	error e = parse(file.data(), file.size(), img);
+	if (e != error::none)
+	{
+		std::cerr << "ERROR: " << describe(e) << "...\tpath: " << path << std::endl;
+		return 0;
+	}
+
+	// The driver copies straight from the mapping into the unpack buffer;
+	// the surface uploads below then source from it by offset.
+	GLuint unpack_buffer;
+	::glGenBuffers(1, &unpack_buffer);
+	state::bind_buffer(GL_PIXEL_UNPACK_BUFFER, unpack_buffer);
+	::glBufferData(GL_PIXEL_UNPACK_BUFFER, img.data_size, file.data() + img.data_offset, GL_STREAM_DRAW);
+
+	GLuint texture_id;
+	::glGenTextures(1, &texture_id);
+	state::bind_texture(img.target, texture_id);
+
+	auto pbo_offset = [&](std::uint32_t layer, std::uint32_t face, std::uint32_t level)
+	{
+		return reinterpret_cast<void const*>(img.surface_offset(layer, face, level) - img.data_offset);
+	};
+
+	for (std::uint32_t level = 0; level < img.mip_count; ++level)
+	{
+		GLsizei w = img.mip_width(level);
+		GLsizei h = img.mip_height(level);
+		GLsizei size = img.mip_size(level);
+
+		switch (img.target)
+		{
+		case GL_TEXTURE_2D:
+			::glCompressedTexImage2D(GL_TEXTURE_2D, level, img.internal_format, w, h, 0, size, pbo_offset(0, 0, level));
+			break;
+
+		case GL_TEXTURE_CUBE_MAP:
+			for (std::uint32_t face = 0; face < 6; ++face)
+				::glCompressedTexImage2D(
+					GL_TEXTURE_CUBE_MAP_POSITIVE_X + face, level, img.internal_format,
+					w, h, 0, size, pbo_offset(0, face, level)
+				);
+			break;
+
+		default:
+		{
+			// Array layers are not contiguous per level in a DDS file, so
+			// allocate the level and fill it one layer-face at a time.
+			GLsizei layers = img.array_size * img.faces;
+			state::bind_buffer(GL_PIXEL_UNPACK_BUFFER, 0);
+			::glCompressedTexImage3D(img.target, level, img.internal_format, w, h, layers, 0, size * layers, nullptr);
+			state::bind_buffer(GL_PIXEL_UNPACK_BUFFER, unpack_buffer);
+
+			for (std::uint32_t layer = 0; layer < img.array_size; ++layer)
+				for (std::uint32_t face = 0; face < img.faces; ++face)
+					::glCompressedTexSubImage3D(
+						img.target, level, 0, 0, layer * img.faces + face, w, h, 1,
+						img.internal_format, size, pbo_offset(layer, face, level)
+					);
+			break;
+		}
+		}
+	}
+
+	// Files without a full chain are still complete textures.
+	::glTexParameteri(img.target, GL_TEXTURE_BASE_LEVEL, 0);
+	::glTexParameteri(img.target, GL_TEXTURE_MAX_LEVEL, img.mip_count - 1);
+
+	state::bind_buffer(GL_PIXEL_UNPACK_BUFFER, 0);
+	::glDeleteBuffers(1, &unpack_buffer);
+	state::deleted_buffer(unpack_buffer);
+
+	track_texture(texture_id, img.data_size, path);
+	out_target = img.target;
+	return texture_id;
+}
+
+} // namespace dds
+} // namespace gl
+} // namespace graphics
+} // namespace mrr
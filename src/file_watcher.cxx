@@ -0,0 +1,138 @@
+#include <mrr/graphics/file_watcher.hxx>
+
+#include <cerrno>
+#include <climits>
+#include <cstdlib>
+#include <iostream>
+
+#include <sys/inotify.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace mrr {
+namespace graphics {
+
+::std::string canonical_path(::std::string const& path)
+{
+	char resolved[PATH_MAX];
+	if (::realpath(path.c_str(), resolved) == nullptr)
+		return path;
+	return resolved;
+}
+
+
+//m=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-
+file_watcher::file_watcher()
+	: fd_(::inotify_init1(IN_NONBLOCK | IN_CLOEXEC))
+{
+	if (fd_ < 0)
+		std::cerr << "ERROR: Cannot initialize inotify, files will not be watched.\n";
+}
+
+file_watcher::~file_watcher()
+{
+	if (fd_ >= 0)
+		::close(fd_);
+}
+
+bool file_watcher::watch(::std::string const& path)
+{
+	if (fd_ < 0)
+		return false;
+
+	::std::string file = canonical_path(path);
+	::std::string::size_type slash = file.rfind('/');
+	if (slash == ::std::string::npos)
+		return false;
+
+	if (files_.count(file) != 0)
+		return true;
+
+	::std::string directory = slash == 0 ? "/" : file.substr(0, slash);
+
+	bool directory_watched = false;
+	for (auto const& wd_directory : directories_)
+		directory_watched = directory_watched || wd_directory.second == directory;
+
+	if (!directory_watched)
+	{
+		int wd = ::inotify_add_watch(fd_, directory.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO);
+		if (wd < 0)
+		{
+			std::cerr << "ERROR: Cannot watch directory...\tpath: " << directory << std::endl;
+			return false;
+		}
+		directories_[wd] = directory;
+	}
+
+	files_.insert(file);
+	return true;
+}
+
+bool file_watcher::is_watched(::std::string const& path) const
+{
+	return files_.count(canonical_path(path)) != 0;
+}
+
+::std::vector<file_watcher::change> file_watcher::poll()
+{
+	::std::vector<change> changes;
+	if (fd_ < 0)
+		return changes;
+
+	::std::set<::std::string> changed;
+
+	alignas(inotify_event) char buffer[4096];
+	for (;;)
+	{
+		ssize_t length = ::read(fd_, buffer, sizeof(buffer));
+		if (length <= 0)
+			break;
+
+		for (char const* p = buffer; p < buffer + length; )
+		{
+			inotify_event const* event = reinterpret_cast<inotify_event const*>(p);
+			p += sizeof(inotify_event) + event->len;
+
+			auto directory = directories_.find(event->wd);
+			if (event->len == 0 || directory == directories_.end())
+				continue;
+
+			::std::string file = directory->second;
+			if (file != "/")
+				file += '/';
+			file += event->name;
+
+			if (files_.count(file) != 0)
+				changed.insert(file);
+		}
+	}
+
+	for (auto const& file : changed)
+	{
+		change c;
+		c.path = file;
+		c.modified = ::std::chrono::system_clock::now();
+
+		struct stat status;
+		if (::stat(file.c_str(), &status) == 0)
+			c.modified = ::std::chrono::system_clock::time_point(
+				::std::chrono::duration_cast<::std::chrono::system_clock::duration>(
+					::std::chrono::seconds(status.st_mtim.tv_sec)
+					+ ::std::chrono::nanoseconds(status.st_mtim.tv_nsec)
+				)
+			);
+
+		changes.push_back(c);
+	}
+
+	return changes;
+}
+
+file_watcher::operator bool() const
+{
+	return fd_ >= 0;
+}
+
+} // namespace graphics
+} // namespace mrr
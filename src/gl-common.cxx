@@ -1,21 +1,25 @@
 #include <mrr/graphics/gl-common.hxx>
 #include <mrr/graphics/shader.hxx>
 #include <mrr/graphics/obj_loader.hxx>
-
+#include <mrr/graphics/mesh.hxx>
+#include <mrr/graphics/stats.hxx>
+#include <mrr/graphics/state_cache.hxx>
+#include <mrr/graphics/memory_accounting.hxx>
+#include <mrr/graphics/dds.hxx>
+#include <mrr/graphics/clustered.hxx>
+#include <mrr/graphics/shader_variants.hxx>
+#include <mrr/graphics/broadphase.hxx>
+#include <mrr/graphics/tangent_space.hxx>
+
+#include <algorithm>
 #include <iostream>
-#include <string.h>
+#include <limits>
 
 #define GLM_FORCE_RADIANS
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
 #include <glm/gtx/transform.hpp>
 
-#define FOURCC_DXT1  0x31545844
-#define FOURCC_DXT2  0x32545844
-#define FOURCC_DXT3  0x33545844
-#define FOURCC_DXT4  0x34545844
-#define FOURCC_DXT5  0x35545844
-
 namespace mrr {
 namespace graphics {
 namespace gl {
@@ -23,7 +27,7 @@ namespace gl {
 void init(float r, float g, float b, float a)
 {
 	::glClearColor(r, g, b, a);
-	::glEnable(GL_DEPTH_TEST);
+	state::enable(GL_DEPTH_TEST);
 	::glDepthFunc(GL_LESS);
 }
 
@@ -45,116 +49,66 @@ shader_handle texture_shader()
 }
 
 
-static GLuint loadDDS(const char * imagepath)
+//m=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-
+shader_handle::shader_handle(
+	::std::string const& vertex_shader_file,
+	::std::string const& fragment_shader_file
+)
+	: shader_handle(vertex_shader_file, fragment_shader_file, ::std::string())
 {
-	unsigned char header[124];
-
-	FILE *fp;
-
-	/* try to open the file */
-	fp = fopen(imagepath, "rb");
-	if (fp == NULL)
-		return 0;
-
-	/* verify the type of file */
-	char filecode[4];
-	fread(filecode, 1, 4, fp);
-	if (strncmp(filecode, "DDS ", 4) != 0) {
-		fclose(fp);
-		return 0;
-	}
-
-	/* get the surface desc */
-	fread(&header, 124, 1, fp);
-
-	unsigned int height      = *(unsigned int*)&(header[8 ]);
-	unsigned int width         = *(unsigned int*)&(header[12]);
-	unsigned int linearSize     = *(unsigned int*)&(header[16]);
-	unsigned int mipMapCount = *(unsigned int*)&(header[24]);
-	unsigned int fourCC      = *(unsigned int*)&(header[80]);
-
-	unsigned char * buffer;
-	unsigned int bufsize;
-	/* how big is it going to be including all mipmaps? */
-	bufsize = mipMapCount > 1 ? linearSize * 2 : linearSize;
-	buffer = (unsigned char*)malloc(bufsize * sizeof(unsigned char));
-	fread(buffer, 1, bufsize, fp);
-	/* close the file pointer */
-	fclose(fp);
-
-	unsigned int components  = (fourCC == FOURCC_DXT1) ? 3 : 4;
-	unsigned int format;
-	switch(fourCC)
-	{
-	case FOURCC_DXT1:
-		format = GL_COMPRESSED_RGBA_S3TC_DXT1_EXT;
-		break;
-	case FOURCC_DXT3:
-		format = GL_COMPRESSED_RGBA_S3TC_DXT3_EXT;
-		break;
-	case FOURCC_DXT5:
-		format = GL_COMPRESSED_RGBA_S3TC_DXT5_EXT;
-		break;
-	default:
-		free(buffer);
-		return 0;
-	}
-
-	// Create one OpenGL texture
-	GLuint textureID;
-	glGenTextures(1, &textureID);
-
-	// "Bind" the newly created texture : all future texture functions will modify this texture
-	glBindTexture(GL_TEXTURE_2D, textureID);
-
-	unsigned int blockSize = (format == GL_COMPRESSED_RGBA_S3TC_DXT1_EXT) ? 8 : 16;
-	unsigned int offset = 0;
+}
 
-	/* load the mipmaps */
-	for (unsigned int level = 0; level < mipMapCount && (width || height); ++level)
-	{
-		unsigned int size = ((width+3)/4)*((height+3)/4)*blockSize;
-		glCompressedTexImage2D(GL_TEXTURE_2D, level, format, width, height,
-		                       0, size, buffer + offset);
+shader_handle::shader_handle(
+	::std::string const& vertex_shader_file,
+	::std::string const& fragment_shader_file,
+	::std::string const& defines
+)
+	: vertex_shader_file_(vertex_shader_file),
+	  fragment_shader_file_(fragment_shader_file),
+	  defines_(defines)
+{
+	GLuint program_id = ::load_shaders(
+		vertex_shader_file.c_str(), fragment_shader_file.c_str(), defines.c_str()
+	);
 
-		offset += size;
-		width  /= 2;
-		height /= 2;
-	}
-	free(buffer);
+	if (program_id == 0)
+		std::exit(1);
 
-	return textureID;
+	shader_program_id_.reset(
+		new GLuint(program_id),
+		[](GLuint* id) { ::glDeleteProgram(*id); state::deleted_program(*id); delete id; }
+	);
 }
 
-
-//m=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-
 shader_handle::shader_handle(
+	GLuint program_id,
 	::std::string const& vertex_shader_file,
-	::std::string const& fragment_shader_file
+	::std::string const& fragment_shader_file,
+	::std::string const& defines
 )
 	: vertex_shader_file_(vertex_shader_file),
 	  fragment_shader_file_(fragment_shader_file),
-	  shader_program_id_(
-		  ::load_shaders(vertex_shader_file.c_str(), fragment_shader_file.c_str())
-	  )
+	  defines_(defines)
 {
-	if (shader_program_id_ == 0)
-		std::exit(1);
+	if (program_id != 0)
+		shader_program_id_.reset(
+			new GLuint(program_id),
+			[](GLuint* id) { ::glDeleteProgram(*id); state::deleted_program(*id); delete id; }
+		);
 }
 
 shader_handle::~shader_handle()
 {
-	::glDeleteProgram(shader_program_id_);
 }
 
 void shader_handle::use() const
 {
-	::glUseProgram(shader_program_id_);
+	state::use_program(shader_program_id_ ? *shader_program_id_ : 0);
 }
 
-GLuint shader_handle::get_program_id()
+GLuint shader_handle::get_program_id() const
 {
-	return shader_program_id_;
+	return shader_program_id_ ? *shader_program_id_ : 0;
 }
 
 GLuint shader_handle::get_uniform_location(char const* var_name)
@@ -162,6 +116,39 @@ GLuint shader_handle::get_uniform_location(char const* var_name)
 	return ::glGetUniformLocation(get_program_id(), var_name);
 }
 
+::std::string const& shader_handle::get_vertex_shader_file() const
+{
+	return vertex_shader_file_;
+}
+
+::std::string const& shader_handle::get_fragment_shader_file() const
+{
+	return fragment_shader_file_;
+}
+
+::std::string const& shader_handle::get_defines() const
+{
+	return defines_;
+}
+
+bool shader_handle::reload()
+{
+	if (!shader_program_id_)
+		return false;
+
+	GLuint program_id = ::load_shaders(
+		vertex_shader_file_.c_str(), fragment_shader_file_.c_str(), defines_.c_str()
+	);
+	if (program_id == 0)
+		return false;
+
+	// Every copy shares this id, so they all switch to the new program.
+	::glDeleteProgram(*shader_program_id_);
+	state::deleted_program(*shader_program_id_);
+	*shader_program_id_ = program_id;
+	return true;
+}
+
 //m=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-
 vertex_array::vertex_array()
 {
@@ -172,11 +159,12 @@ vertex_array::vertex_array()
 vertex_array::~vertex_array()
 {
 	::glDeleteVertexArrays(1, &vertex_array_id_);
+	state::deleted_vertex_array(vertex_array_id_);
 }
 
 void vertex_array::bind()
 {
-	::glBindVertexArray(vertex_array_id_);
+	state::bind_vertex_array(vertex_array_id_);
 }
 
 
@@ -186,6 +174,23 @@ buffer::buffer()
 {
 }
 
+buffer::buffer(buffer&& other) noexcept
+	: buffer_(other.buffer_)
+{
+	other.buffer_ = 0;
+}
+
+buffer& buffer::operator =(buffer&& other) noexcept
+{
+	if (this != &other)
+	{
+		destroy();
+		buffer_ = other.buffer_;
+		other.buffer_ = 0;
+	}
+	return *this;
+}
+
 buffer::~buffer()
 {
 	destroy();
@@ -200,18 +205,52 @@ void buffer::create()
 void buffer::destroy()
 {
 	if (buffer_ != 0)
+	{
 		::glDeleteBuffers(1, &buffer_);
+		state::deleted_buffer(buffer_);
+		untrack_buffer(buffer_);
+	}
+	buffer_ = 0;
 }
 
 void buffer::bind(GLenum target = GL_ARRAY_BUFFER) const
 {
-	::glBindBuffer(target, buffer_);
+	state::bind_buffer(target, buffer_);
+}
+
+void buffer::bind_base(GLenum target, GLuint index) const
+{
+	state::bind_buffer_base(target, index, buffer_);
+}
+
+void buffer::bind_texture_buffer(GLenum internal_format) const
+{
+	::glTexBuffer(GL_TEXTURE_BUFFER, internal_format, buffer_);
+}
+
+void buffer::set_data(GLenum target, GLsizeiptr size, void const* data, GLenum usage, ::std::string const& asset) const
+{
+	memory_category c = memory_category::other_buffers;
+	if (target == GL_ARRAY_BUFFER)
+		c = memory_category::vertex_buffers;
+	else if (target == GL_ELEMENT_ARRAY_BUFFER)
+		c = memory_category::index_buffers;
+
+	state::bind_buffer(target, buffer_);
+	::glBufferData(target, size, data, usage);
+	track_buffer(buffer_, c, std::size_t(size), asset);
+}
+
+bool buffer::is_created() const
+{
+	return buffer_ != 0;
 }
 
 
 //m=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-
 texture::texture()
 	: texture_(0),
+	  target_(GL_TEXTURE_2D),
 	  is_loaded_(false)
 {
 }
@@ -223,20 +262,46 @@ texture::~texture()
 
 void texture::load(::std::string const& filename)
 {
-	texture_ = loadDDS(filename.c_str());
+	destroy();
+	filename_ = filename;
+	texture_ = dds::load(filename, target_);
+	is_loaded_ = texture_ != 0;
+}
+
+bool texture::reload()
+{
+	GLenum target;
+	GLuint texture_id = dds::load(filename_, target);
+	if (texture_id == 0)
+		return false;
+
+	destroy();
+	texture_ = texture_id;
+	target_ = target;
 	is_loaded_ = true;
+	return true;
 }
 
 void texture::destroy()
 {
 	if (texture_ != 0)
+	{
 		::glDeleteTextures(1, &texture_);
+		state::deleted_texture(texture_);
+		untrack_texture(texture_);
+	}
+	texture_ = 0;
+	is_loaded_ = false;
 }
 
-void texture::bind(GLenum target = GL_TEXTURE_2D) const
+void texture::bind() const
 {
-	::glActiveTexture(GL_TEXTURE0);
-	::glBindTexture(target, texture_);
+	bind(target_);
+}
+
+void texture::bind(GLenum target) const
+{
+	state::bind_texture(GL_TEXTURE0, target, texture_);
 }
 
 bool texture::is_loaded() const
@@ -244,6 +309,16 @@ bool texture::is_loaded() const
 	return is_loaded_;
 }
 
+GLenum texture::get_target() const
+{
+	return target_;
+}
+
+::std::string const& texture::get_filename() const
+{
+	return filename_;
+}
+
 
 //m=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-
 model::model()
@@ -252,16 +327,31 @@ model::model()
 	  ambient_light_colour_id_(0),
 	  point_source_locations_id_(0),
 	  point_source_colours_id_(0),
-	  point_source_powers_id_(0)
+	  point_source_powers_id_(0),
+	  light_clusters_(nullptr)
 {
 }
 
 void model::set_shader(::mrr::graphics::gl::shader_handle const& s)
 {
 	shader_ = s;
+	get_uniform_locations();
+}
+
+void model::get_uniform_locations()
+{
 	mvp_matrix_id_ = shader_.get_uniform_location("MVP");
 	view_matrix_id_ = shader_.get_uniform_location("V");
 	model_matrix_id_ = shader_.get_uniform_location("M");
+	ambient_light_colour_id_ = shader_.get_uniform_location("AmbientLightColour");
+
+	point_source_locations_id_ = shader_.get_uniform_location("LightPosition_worldspace");
+	point_source_colours_id_ = shader_.get_uniform_location("LightColour");
+	point_source_powers_id_ = shader_.get_uniform_location("LightPower");
+	point_source_count_id_ = shader_.get_uniform_location("PointSourceCount");
+
+	if (light_clusters_ != nullptr)
+		light_cluster_uniforms_ = light_clusters::get_uniform_locations(shader_);
 }
 
 void model::set_shader(
@@ -272,6 +362,18 @@ void model::set_shader(
 	set_shader(shader_handle(vertex_shader_file, fragment_shader_file));
 }
 
+::mrr::graphics::gl::shader_handle const& model::get_shader() const
+{
+	return shader_;
+}
+
+void model::refresh_uniform_locations()
+{
+	get_uniform_locations();
+	for (model* m : components_)
+		m->refresh_uniform_locations();
+}
+
 void model::add_component(model& m)
 {
 	components_.insert(&m);
@@ -282,6 +384,8 @@ void model::add_component(model& m)
 			point_source_colours_[i],
 			point_source_powers_[i]
 		);
+	if (light_clusters_ != nullptr)
+		m.set_light_clusters(light_clusters_);
 }
 
 void model::remove_component(model& m)
@@ -289,6 +393,11 @@ void model::remove_component(model& m)
 	components_.erase(&m);
 }
 
+child_list const& model::get_components() const
+{
+	return components_;
+}
+
 void model::update_model(::glm::mat4 const& t)
 {
 	for (model* m : components_)
@@ -371,11 +480,26 @@ std::vector<glm::vec3> const& model::get_point_source_colours() const
 	return point_source_colours_;
 }
 
-std::vector<float> model::get_point_source_powers() const
+std::vector<float> const& model::get_point_source_powers() const
 {
 	return point_source_powers_;
 }
 
+void model::set_light_clusters(light_clusters const* c)
+{
+	light_clusters_ = c;
+	if (light_clusters_ != nullptr)
+		light_cluster_uniforms_ = light_clusters::get_uniform_locations(shader_);
+
+	for (model* m : components_)
+		m->set_light_clusters(c);
+}
+
+light_clusters const* model::get_light_clusters() const
+{
+	return light_clusters_;
+}
+
 void model::save()
 {
 	for (model* m : components_)
@@ -400,18 +524,38 @@ void model::render(::glm::mat4 const& V, ::glm::mat4 const& P) const
 //m=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-
 component::component()
 	:	texture_sampler_id_(0),
+	  stream_chunk_triangles_(0),
+	  cpu_copy_policy_(cpu_copy_policy::keep),
 	  shape_colour_id_(0),
-	  vertex_data_(nullptr),
-	  colour_data_(nullptr),
-	  uv_data_(nullptr),
-	  normal_data_(nullptr),
+	  specular_colour_id_(0),
 	  va_size_(-1),
+	  vertex_count_(0),
+	  vertex_format_(vertex_format::float32),
+	  quantization_error_(),
+	  position_scale_(1.0f),
+	  quantized_vertices_id_(0),
+	  position_offset_id_(0),
+	  position_scale_id_(0),
+	  lod_thresholds_({ 1.0f, 0.5f, 0.25f, 0.125f }),
+	  lod_hysteresis_(0.1f),
+	  current_lod_(0),
+	  shader_variants_(false),
+	  shader_key_(0),
 	  model_(::glm::mat4(1.0f)),
 		model_save_(::glm::mat4(1.0f)),
-		drawing_mode_(GL_TRIANGLES)
+		drawing_mode_(GL_TRIANGLES),
+	  broadphase_(nullptr),
+	  broadphase_proxy_(0)
 {
 }
 
+component::~component()
+{
+	if (broadphase_ != nullptr)
+		broadphase_->remove(*this);
+	untrack_cpu_memory(this);
+}
+
 ::glm::vec3 const& component::get_location() const
 {
 	return location_;
@@ -420,16 +564,84 @@ component::component()
 void component::update_location()
 {
 	location_ = glm::vec3(model_ * glm::vec4(0, 0, 0, 1));
+	if (broadphase_ != nullptr)
+		broadphase_->move(broadphase_proxy_, get_world_bounds());
+}
+
+::glm::mat4 const& component::get_model() const
+{
+	return model_;
+}
+
+aabb const& component::get_bounds() const
+{
+	return bounds_;
+}
+
+aabb component::get_world_bounds() const
+{
+	return bounds_.transformed(model_);
+}
+
+void component::set_bounds(aabb const& bounds)
+{
+	bounds_ = bounds;
+	if (broadphase_ != nullptr)
+		broadphase_->move(broadphase_proxy_, get_world_bounds());
+}
+
+std::vector<glm::vec3> const& component::get_vertices() const
+{
+	return vertices_;
+}
+
+std::vector<glm::vec3> const& component::get_normals() const
+{
+	return normals_;
+}
+
+std::vector<glm::vec4> const& component::get_tangents() const
+{
+	return tangents_;
+}
+
+std::vector<unsigned int> const& component::get_indices(std::size_t lod) const
+{
+	static std::vector<unsigned int> const no_indices;
+	return lod < lods_.size() ? lods_[lod].indices : no_indices;
+}
+
+GLsizei component::get_vertex_count() const
+{
+	return vertex_count_;
+}
+
+::glm::vec3 const& component::get_colour() const
+{
+	return shape_colour_;
+}
+
+::glm::vec3 const& component::get_specular_colour() const
+{
+	return specular_colour_;
+}
+
+bool component::has_texture() const
+{
+	return texture_.is_loaded();
 }
 
 void component::set_vertex_data(GLfloat const* vertex_data, int size)
 {
 	va_size_ = size;
-	vertex_data_ = vertex_data;
+	vertex_count_ = size / (3 * sizeof(GLfloat));
+	set_bounds(compute_bounds(
+		reinterpret_cast<glm::vec3 const*>(vertex_data), size / sizeof(glm::vec3)
+	));
+	get_vertex_format_uniform_locations();
 
 	vertex_buffer_.create();
-	vertex_buffer_.bind(GL_ARRAY_BUFFER);
-	::glBufferData(GL_ARRAY_BUFFER, va_size_, vertex_data_, GL_STATIC_DRAW);
+	vertex_buffer_.set_data(GL_ARRAY_BUFFER, va_size_, vertex_data, GL_STATIC_DRAW, wavefront_file_);
 }
 
 void component::set_colour(::glm::vec3 const& shape_colour)
@@ -447,34 +659,56 @@ void component::set_specular_colour(::glm::vec3 const& specular_colour)
 void component::set_colour_data(GLfloat const* colour_data)
 {
 	texture_sampler_id_ = shader_.get_uniform_location("texture_sampler");
-	colour_data_ = colour_data;
 
-	colour_buffer_.create();
-	colour_buffer_.bind(GL_ARRAY_BUFFER);
-	::glBufferData(GL_ARRAY_BUFFER, va_size_, colour_data_, GL_STATIC_DRAW);
+	// Colours are always three floats per vertex, whatever the vertex
+	// format, so va_size_ is only their size for unquantized positions.
+	if (vertex_count_ > 0)
+	{
+		colour_buffer_.create();
+		colour_buffer_.set_data(GL_ARRAY_BUFFER, vertex_count_ * 3 * sizeof(GLfloat), colour_data, GL_STATIC_DRAW, wavefront_file_);
+	}
+	else
+	{
+		colour_buffer_.destroy();
+	}
+
+	select_shader_variant();
 }
 
 void component::set_uv_data(GLfloat const* uv_data, int size)
 {
-	uv_data_ = uv_data;
+	if (size > 0)
+	{
+		uv_buffer_.create();
+		uv_buffer_.set_data(GL_ARRAY_BUFFER, size, uv_data, GL_STATIC_DRAW, wavefront_file_);
+	}
+	else
+	{
+		uv_buffer_.destroy();
+	}
 
-	uv_buffer_.create();
-	uv_buffer_.bind(GL_ARRAY_BUFFER);
-	::glBufferData(GL_ARRAY_BUFFER, size, uv_data_, GL_STATIC_DRAW);
+	select_shader_variant();
 }
 
 void component::set_normal_data(GLfloat const* normal_data, int size)
 {
-	normal_data_ = normal_data;
+	if (size > 0)
+	{
+		normal_buffer_.create();
+		normal_buffer_.set_data(GL_ARRAY_BUFFER, size, normal_data, GL_STATIC_DRAW, wavefront_file_);
+	}
+	else
+	{
+		normal_buffer_.destroy();
+	}
 
-	normal_buffer_.create();
-	normal_buffer_.bind(GL_ARRAY_BUFFER);
-	::glBufferData(GL_ARRAY_BUFFER, size, normal_data_, GL_STATIC_DRAW);
+	select_shader_variant();
 }
 
 void component::load_texture(::std::string const& filename)
 {
 	texture_.load(filename);
+	select_shader_variant();
 }
 
 void component::set_init_model(::glm::mat4 const& m)
@@ -522,16 +756,450 @@ void component::update_heading(::glm::mat4 const& t)
 
 void component::load_wavefront(std::string const& model_file)
 {
-	bool successful = impl::load_wavefront(model_file, vertices_, uvs_, normals_);
-	if (!successful)
+	if (!read_wavefront(model_file))
 	{
 		std::cerr << "Failed to load Wavefront OBJ file.\n";
 		std::exit(1);
 	}
+	apply_cpu_copy_policy();
+}
+
+bool component::reload_wavefront()
+{
+	if (stream_chunk_triangles_ != 0)
+		return stream_wavefront(wavefront_file_, stream_chunk_triangles_);
+
+	std::size_t lod_count = lods_.size();
+	bool tangents = !tangents_.empty();
+	if (wavefront_file_.empty() || !read_wavefront(wavefront_file_))
+		return false;
+
+	if (lod_count > 1)
+		generate_lods(lod_count);
+	if (tangents)
+		generate_tangents();
+	apply_cpu_copy_policy();
+	return true;
+}
+
+bool component::stream_wavefront(std::string const& model_file, std::size_t chunk_triangles)
+{
+	impl::wavefront_counts counts;
+	if (!impl::scan_wavefront(model_file, counts))
+		return false;
+
+	std::clog << "Streaming OBJ file " << model_file << " (" << counts.triangles << " triangles)...\n";
+
+	std::size_t const count = 3 * counts.triangles;
+	buffer vertex_buffer, uv_buffer, normal_buffer;
+	vertex_buffer.create();
+	vertex_buffer.set_data(GL_ARRAY_BUFFER, count * sizeof(glm::vec3), nullptr, GL_STATIC_DRAW, model_file);
+	uv_buffer.create();
+	uv_buffer.set_data(GL_ARRAY_BUFFER, count * sizeof(glm::vec2), nullptr, GL_STATIC_DRAW, model_file);
+	normal_buffer.create();
+	normal_buffer.set_data(GL_ARRAY_BUFFER, count * sizeof(glm::vec3), nullptr, GL_STATIC_DRAW, model_file);
+
+	aabb bounds;
+	std::size_t offset = 0;
+	bool streamed = impl::stream_wavefront(model_file, counts, chunk_triangles,
+		[&](glm::vec3 const* vertices, glm::vec2 const* uvs, glm::vec3 const* normals, std::size_t n) {
+			// The file grew between the two passes.
+			if (offset + n > count)
+				return false;
+
+			vertex_buffer.bind(GL_ARRAY_BUFFER);
+			::glBufferSubData(GL_ARRAY_BUFFER, offset * sizeof(glm::vec3), n * sizeof(glm::vec3), vertices);
+			uv_buffer.bind(GL_ARRAY_BUFFER);
+			::glBufferSubData(GL_ARRAY_BUFFER, offset * sizeof(glm::vec2), n * sizeof(glm::vec2), uvs);
+			normal_buffer.bind(GL_ARRAY_BUFFER);
+			::glBufferSubData(GL_ARRAY_BUFFER, offset * sizeof(glm::vec3), n * sizeof(glm::vec3), normals);
+
+			bounds.expand(compute_bounds(vertices, n));
+			offset += n;
+			return true;
+		}
+	);
+
+	if (!streamed || offset != count)
+	{
+		std::cerr << "ERROR: Cannot stream OBJ file...\tpath: " << model_file << std::endl;
+		return false;
+	}
+
+	wavefront_file_ = model_file;
+	stream_chunk_triangles_ = chunk_triangles;
+	std::vector<glm::vec3>().swap(vertices_);
+	std::vector<glm::vec2>().swap(uvs_);
+	std::vector<glm::vec3>().swap(normals_);
+	std::vector<glm::vec4>().swap(tangents_);
+
+	vertex_format_ = vertex_format::float32;
+	vertex_buffer_ = std::move(vertex_buffer);
+	uv_buffer_ = std::move(uv_buffer);
+	normal_buffer_ = std::move(normal_buffer);
+	va_size_ = count * sizeof(glm::vec3);
+	vertex_count_ = count;
+	set_bounds(bounds);
+
+	lods_.clear();
+	current_lod_ = 0;
+	account_cpu_memory();
+
+	get_vertex_format_uniform_locations();
+	select_shader_variant();
+	return true;
+}
+
+bool component::reload_texture()
+{
+	return texture_.is_loaded() && texture_.reload();
+}
+
+std::string const& component::get_wavefront_file() const
+{
+	return wavefront_file_;
+}
+
+std::string const& component::get_texture_file() const
+{
+	return texture_.get_filename();
+}
+
+// Parses into temporaries, so the current mesh survives a failure.
+bool component::read_wavefront(std::string const& model_file)
+{
+	std::vector<glm::vec3> vertices;
+	std::vector<glm::vec2> uvs;
+	std::vector<glm::vec3> normals;
+	if (!impl::load_wavefront(model_file, vertices, uvs, normals))
+		return false;
+
+	// Share identical vertices between triangles and draw indexed, in an
+	// order that suits the vertex cache and early-Z.
+	std::vector<unsigned int> indices;
+	impl::weld_vertices(vertices, uvs, normals, indices);
+
+	impl::mesh_optimization_report report
+		= impl::optimize_mesh(vertices, uvs, normals, indices);
+	std::clog << "  Vertex cache: ACMR " << report.before.acmr << " -> " << report.after.acmr
+	          << ", ATVR " << report.before.atvr << " -> " << report.after.atvr << '\n';
+
+	wavefront_file_ = model_file;
+	stream_chunk_triangles_ = 0;
+	vertices_.swap(vertices);
+	uvs_.swap(uvs);
+	normals_.swap(normals);
+	std::vector<glm::vec4>().swap(tangents_);
+
+	upload_vertex_data();
+
+	lods_.clear();
+	current_lod_ = 0;
+	set_index_data(0, std::move(indices));
+	return true;
+}
+
+void component::set_vertex_format(vertex_format format)
+{
+	// Streamed meshes have no CPU copy to convert and stay float32.
+	if (stream_chunk_triangles_ != 0)
+		return;
+
+	if (!has_cpu_copy() && vertex_count_ > 0)
+	{
+		std::cerr << "WARNING: Cannot convert the vertex format of a mesh without its CPU copy...\tpath: "
+		          << wavefront_file_ << std::endl;
+		return;
+	}
+
+	vertex_format_ = format;
+	if (!vertices_.empty())
+		upload_vertex_data();
+
+	select_shader_variant();
+}
+
+vertex_format component::get_vertex_format() const
+{
+	return vertex_format_;
+}
+
+impl::quantization_error const& component::get_quantization_error() const
+{
+	return quantization_error_;
+}
+
+void component::set_cpu_copy_policy(cpu_copy_policy policy)
+{
+	cpu_copy_policy_ = policy;
+	apply_cpu_copy_policy();
+}
+
+cpu_copy_policy component::get_cpu_copy_policy() const
+{
+	return cpu_copy_policy_;
+}
+
+bool component::has_cpu_copy() const
+{
+	return !vertices_.empty();
+}
+
+void component::apply_cpu_copy_policy()
+{
+	if (cpu_copy_policy_ == cpu_copy_policy::release)
+	{
+		std::vector<glm::vec3>().swap(vertices_);
+		std::vector<glm::vec2>().swap(uvs_);
+		std::vector<glm::vec3>().swap(normals_);
+		std::vector<glm::vec4>().swap(tangents_);
+	}
+	account_cpu_memory();
+}
+
+void component::account_cpu_memory() const
+{
+	std::size_t mesh_bytes = vertices_.capacity() * sizeof(glm::vec3)
+		+ uvs_.capacity() * sizeof(glm::vec2) + normals_.capacity() * sizeof(glm::vec3)
+		+ tangents_.capacity() * sizeof(glm::vec4);
+	std::size_t index_bytes = 0;
+	for (lod_level const& level : lods_)
+		index_bytes += level.indices.capacity() * sizeof(unsigned int);
+
+	track_cpu_memory(this, memory_category::mesh_arrays, mesh_bytes, wavefront_file_);
+	track_cpu_memory(this, memory_category::index_arrays, index_bytes, wavefront_file_);
+}
+
+void component::get_vertex_format_uniform_locations()
+{
+	quantized_vertices_id_ = shader_.get_uniform_location("QuantizedVertices");
+	position_offset_id_ = shader_.get_uniform_location("PositionOffset");
+	position_scale_id_ = shader_.get_uniform_location("PositionScale");
+}
+
+void component::get_uniform_locations()
+{
+	model::get_uniform_locations();
+
+	// Colours that were never set keep their id at 0, which render() relies on.
+	if (shape_colour_id_ != 0)
+		shape_colour_id_ = shader_.get_uniform_location("shape_colour");
+	if (specular_colour_id_ != 0)
+		specular_colour_id_ = shader_.get_uniform_location("specular_colour");
+
+	texture_sampler_id_ = shader_.get_uniform_location("texture_sampler");
+	get_vertex_format_uniform_locations();
+}
+
+void component::add_point_source(::glm::vec3 const& location, ::glm::vec3 const& colour, float power)
+{
+	model::add_point_source(location, colour, power);
+	select_shader_variant();
+}
+
+void component::use_shader_variants(bool enable)
+{
+	shader_variants_ = enable;
+	select_shader_variant();
+}
+
+shader_key component::get_shader_key() const
+{
+	return make_shader_key(
+		uv_buffer_.is_created() && texture_.is_loaded(),
+		colour_buffer_.is_created(),
+		normal_buffer_.is_created(),
+		vertex_format_ == vertex_format::quantized,
+		point_source_locations_.size()
+	);
+}
+
+void component::select_shader_variant()
+{
+	if (!shader_variants_ || light_clusters_ != nullptr)
+		return;
+
+	shader_key key = get_shader_key();
+	if (key == shader_key_ && shader_.get_program_id() != 0)
+		return;
+
+	shader_key_ = key;
+	set_shader(default_shader_variants().get(key));
+}
+
+void component::upload_vertex_data()
+{
+	if (vertex_format_ == vertex_format::float32)
+	{
+		set_vertex_data(&vertices_[0].x, vertices_.size() * sizeof(glm::vec3));
+		set_uv_data(&uvs_[0].x, uvs_.size() * sizeof(glm::vec2));
+		set_normal_data(&normals_[0].x, normals_.size() * sizeof(glm::vec3));
+		return;
+	}
+
+	set_bounds(compute_bounds(vertices_));
+	position_offset_ = bounds_.lower;
+	position_scale_ = bounds_.upper - bounds_.lower;
+
+	std::vector<impl::quantized_position> positions;
+	std::vector<impl::quantized_normal> normals;
+	std::vector<impl::quantized_uv> uvs;
+	impl::quantize_positions(vertices_, position_offset_, position_scale_, positions);
+	impl::quantize_normals(normals_, normals);
+	impl::quantize_uvs(uvs_, uvs);
+
+	quantization_error_ = impl::measure_quantization_error(
+		vertices_, normals_, uvs_, position_offset_, position_scale_, positions, normals, uvs
+	);
+
+	va_size_ = positions.size() * sizeof(impl::quantized_position);
+	vertex_count_ = positions.size();
+	vertex_buffer_.create();
+	vertex_buffer_.set_data(GL_ARRAY_BUFFER, va_size_, positions.data(), GL_STATIC_DRAW, wavefront_file_);
+
+	if (!uvs.empty())
+	{
+		uv_buffer_.create();
+		uv_buffer_.set_data(GL_ARRAY_BUFFER, uvs.size() * sizeof(impl::quantized_uv), uvs.data(), GL_STATIC_DRAW, wavefront_file_);
+	}
+	else
+	{
+		uv_buffer_.destroy();
+	}
+
+	if (!normals.empty())
+	{
+		normal_buffer_.create();
+		normal_buffer_.set_data(GL_ARRAY_BUFFER, normals.size() * sizeof(impl::quantized_normal), normals.data(), GL_STATIC_DRAW, wavefront_file_);
+	}
+	else
+	{
+		normal_buffer_.destroy();
+	}
+
+	get_vertex_format_uniform_locations();
+}
+
+void component::set_index_data(std::size_t lod, std::vector<unsigned int>&& indices)
+{
+	if (lods_.size() <= lod)
+		lods_.resize(lod + 1);
+
+	lod_level& level = lods_[lod];
+	level.indices = std::move(indices);
+	level.index_buffer.create();
+	level.index_buffer.set_data(
+		GL_ELEMENT_ARRAY_BUFFER, level.indices.size() * sizeof(unsigned int),
+		level.indices.data(), GL_STATIC_DRAW, wavefront_file_
+	);
+	account_cpu_memory();
+}
+
+void component::generate_lods(std::size_t levels)
+{
+	if (lods_.empty())
+		return;
+
+	if (!has_cpu_copy())
+	{
+		std::cerr << "WARNING: Cannot generate levels of detail without the CPU copy of the mesh...\tpath: "
+		          << wavefront_file_ << std::endl;
+		return;
+	}
+
+	lods_.resize(1);
+	lods_.reserve(levels);
+	current_lod_ = 0;
+
+	for (std::size_t lod = 1; lod < levels; ++lod)
+	{
+		std::vector<unsigned int> const& previous = lods_[lod - 1].indices;
+
+		float error = 0.0f;
+		std::vector<unsigned int> indices
+			= impl::simplify(vertices_, previous, (previous.size() / 6) * 3, &error);
+
+		// Stop once the mesh can no longer be reduced meaningfully.
+		if (indices.size() * 10 > previous.size() * 9)
+			break;
+
+		impl::optimize_vertex_cache(indices, vertices_.size());
+
+		std::clog << "  LOD " << lod << ": " << indices.size() / 3
+		          << " triangles, error " << error << '\n';
+
+		set_index_data(lod, std::move(indices));
+	}
+	account_cpu_memory();
+}
+
+void component::generate_tangents()
+{
+	if (lods_.empty())
+		return;
+
+	if (!has_cpu_copy())
+	{
+		std::cerr << "WARNING: Cannot generate tangents without the CPU copy of the mesh...\tpath: "
+		          << wavefront_file_ << std::endl;
+		return;
+	}
+
+	impl::generate_tangents(vertices_, uvs_, normals_, lods_[0].indices, tangents_);
+	account_cpu_memory();
+}
+
+void component::set_lod_thresholds(std::vector<float> const& screen_sizes)
+{
+	lod_thresholds_ = screen_sizes;
+}
+
+void component::set_lod_hysteresis(float fraction)
+{
+	lod_hysteresis_ = fraction;
+}
+
+std::size_t component::get_lod_count() const
+{
+	return lods_.size();
+}
+
+float component::projected_size(::glm::mat4 const& V, ::glm::mat4 const& P) const
+{
+	float scale = std::max(
+		::glm::length(::glm::vec3(model_[0])),
+		std::max(::glm::length(::glm::vec3(model_[1])), ::glm::length(::glm::vec3(model_[2])))
+	);
+	float radius = bounds_.radius() * scale;
+
+	::glm::vec4 center = V * model_ * ::glm::vec4(bounds_.center(), 1.0f);
+	float distance = -center.z - radius;
+
+	if (distance <= 0.0f)
+		return std::numeric_limits<float>::max();
+
+	// Fraction of the viewport height covered by the bounding sphere.
+	return radius * P[1][1] / distance;
+}
 
-	set_vertex_data(&vertices_[0].x, vertices_.size() * sizeof(glm::vec3));
-	set_uv_data(&uvs_[0].x, uvs_.size() * sizeof(glm::vec2));
-	set_normal_data(&normals_[0].x, normals_.size() * sizeof(glm::vec3));
+std::size_t component::select_lod(::glm::mat4 const& V, ::glm::mat4 const& P) const
+{
+	std::size_t levels = std::min(lods_.size(), lod_thresholds_.size());
+	if (levels <= 1)
+		return 0;
+
+	float size = projected_size(V, P);
+	std::size_t lod = std::min(current_lod_, levels - 1);
+
+	// Only switch once the size is clearly past a threshold, so components
+	// near a boundary do not flip between levels every frame.
+	while (lod + 1 < levels && size < lod_thresholds_[lod + 1] * (1.0f - lod_hysteresis_))
+		++lod;
+	while (lod > 0 && size > lod_thresholds_[lod] * (1.0f + lod_hysteresis_))
+		--lod;
+
+	current_lod_ = lod;
+	return lod;
 }
 
 void component::set_drawing_mode(GLenum drawing_mode)
@@ -539,23 +1207,40 @@ void component::set_drawing_mode(GLenum drawing_mode)
 	drawing_mode_ = drawing_mode;
 }
 
-void component::render(::glm::mat4 const& V, ::glm::mat4 const& P) const
+GLenum component::get_drawing_mode() const
+{
+	return drawing_mode_;
+}
+
+void component::apply_view_uniforms(::glm::mat4 const& V, ::glm::mat4 const& P) const
 {
 	::glm::mat4 MVP = P * V * model_;
+	::glUniformMatrix4fv(mvp_matrix_id_, 1, GL_FALSE, &MVP[0][0]);
+	::glUniformMatrix4fv(view_matrix_id_, 1, GL_FALSE, &V[0][0]);
+}
+
+void component::apply_uniforms(::glm::mat4 const& V, ::glm::mat4 const& P) const
+{
 	shader_.use();
 
-	int ps_count = get_point_source_locations().size();
+	if (light_clusters_ != nullptr)
+	{
+		light_clusters_->apply(light_cluster_uniforms_);
+	}
+	else
+	{
+		int ps_count = get_point_source_locations().size();
 
-	::glUniform3fv(get_point_source_locations_id(), ps_count, &get_point_source_locations()[0].x);
-	::glUniform3fv(get_point_source_colours_id(),   ps_count, &get_point_source_colours()[0].x);
-	::glUniform1fv(get_point_source_powers_id(),    ps_count, &get_point_source_powers()[0]);
-	::glUniform1i(get_point_source_count_id(), ps_count);
+		::glUniform3fv(get_point_source_locations_id(), ps_count, &get_point_source_locations()[0].x);
+		::glUniform3fv(get_point_source_colours_id(),   ps_count, &get_point_source_colours()[0].x);
+		::glUniform1fv(get_point_source_powers_id(),    ps_count, &get_point_source_powers()[0]);
+		::glUniform1i(get_point_source_count_id(), ps_count);
+	}
 
 	::glUniform3fv(get_ambient_light_colour_id(), 1, &get_ambient_light_colour()[0]);
 
-	::glUniformMatrix4fv(mvp_matrix_id_, 1, GL_FALSE, &MVP[0][0]);
 	::glUniformMatrix4fv(model_matrix_id_, 1, GL_FALSE, &model_[0][0]);
-	::glUniformMatrix4fv(view_matrix_id_, 1, GL_FALSE, &V[0][0]);
+	apply_view_uniforms(V, P);
 
 	if (texture_.is_loaded())
 	{
@@ -563,24 +1248,12 @@ void component::render(::glm::mat4 const& V, ::glm::mat4 const& P) const
 		::glUniform1i(texture_sampler_id_, 0);
 	}
 
-	// Bind vertex attribute buffer...
-	::glEnableVertexAttribArray(0);
-	vertex_buffer_.bind();
-	::glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 0, (void*)0);
-
-	if (uv_data_ != nullptr)
-	{
-		::glEnableVertexAttribArray(1);
-		uv_buffer_.bind();
-		::glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 0, (void*)0);
-	}
-
-	// NOTE: Colour data and normal/texture data must be mutually exclusize.
-	if (colour_data_ != nullptr)
+	bool const quantized = vertex_format_ == vertex_format::quantized;
+	::glUniform1i(quantized_vertices_id_, quantized);
+	if (quantized)
 	{
-		::glEnableVertexAttribArray(1);
-		colour_buffer_.bind();
-		::glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 0, (void*)0);
+		::glUniform3fv(position_offset_id_, 1, &position_offset_[0]);
+		::glUniform3fv(position_scale_id_, 1, &position_scale_[0]);
 	}
 
 	if (shape_colour_id_ != 0)
@@ -597,19 +1270,86 @@ void component::render(::glm::mat4 const& V, ::glm::mat4 const& P) const
 		glm::vec3 specular_colour(0.3f, 0.3f, 0.3f);
 		::glUniform3fv(specular_colour_id_, 1, &specular_colour[0]);
 	}
+}
 
-	if (normal_data_ != nullptr)
+void component::bind_attributes(std::uint32_t extra_arrays) const
+{
+	bool const quantized = vertex_format_ == vertex_format::quantized;
+
+	std::uint32_t arrays = 1 | extra_arrays;
+	if (uv_buffer_.is_created() || colour_buffer_.is_created())
+		arrays |= 1 << 1;
+	if (normal_buffer_.is_created())
+		arrays |= 1 << 2;
+	state::set_vertex_attrib_arrays(arrays);
+
+	// Bind vertex attribute buffer...
+	vertex_buffer_.bind();
+	if (quantized)
+		::glVertexAttribPointer(0, 3, GL_UNSIGNED_SHORT, GL_TRUE, sizeof(impl::quantized_position), (void*)0);
+	else
+		::glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 0, (void*)0);
+
+	if (uv_buffer_.is_created())
+	{
+		uv_buffer_.bind();
+		if (quantized)
+			::glVertexAttribPointer(1, 2, GL_HALF_FLOAT, GL_FALSE, 0, (void*)0);
+		else
+			::glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 0, (void*)0);
+	}
+
+	// NOTE: Colour data and normal/texture data must be mutually exclusize.
+	if (colour_buffer_.is_created())
+	{
+		colour_buffer_.bind();
+		::glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 0, (void*)0);
+	}
+
+	if (normal_buffer_.is_created())
 	{
-		::glEnableVertexAttribArray(2);
 		normal_buffer_.bind();
-		::glVertexAttribPointer(2, 3, GL_FLOAT, GL_FALSE, 0, (void*)0);
+		if (quantized)
+			::glVertexAttribPointer(2, 2, GL_SHORT, GL_TRUE, 0, (void*)0);
+		else
+			::glVertexAttribPointer(2, 3, GL_FLOAT, GL_FALSE, 0, (void*)0);
+	}
+}
+
+void component::draw(std::size_t lod, GLsizei instances) const
+{
+	render_stats& stats = frame_stats();
+	++stats.draw_calls;
+
+	if (!lods_.empty())
+	{
+		lod_level const& level = lods_[lod];
+		level.index_buffer.bind(GL_ELEMENT_ARRAY_BUFFER);
+		if (instances == 1)
+			::glDrawElements(drawing_mode_, level.indices.size(), GL_UNSIGNED_INT, (void*)0);
+		else
+			::glDrawElementsInstanced(drawing_mode_, level.indices.size(), GL_UNSIGNED_INT, (void*)0, instances);
+
+		stats.triangles_submitted += level.indices.size() / 3 * instances;
+		stats.triangles_full_detail += lods_[0].indices.size() / 3 * instances;
 	}
+	else
+	{
+		if (instances == 1)
+			::glDrawArrays(drawing_mode_, 0, vertex_count_);
+		else
+			::glDrawArraysInstanced(drawing_mode_, 0, vertex_count_, instances);
 
-	::glDrawArrays(drawing_mode_, 0, vertices_.size());
+		stats.triangles_submitted += vertex_count_ / 3 * instances;
+		stats.triangles_full_detail += vertex_count_ / 3 * instances;
+	}
+}
 
-	::glDisableVertexAttribArray(0);
-	::glDisableVertexAttribArray(1);
-	::glDisableVertexAttribArray(2);
+void component::render(::glm::mat4 const& V, ::glm::mat4 const& P) const
+{
+	apply_uniforms(V, P);
+	bind_attributes();
+	draw(select_lod(V, P));
 }
 
 void component::save()
@@ -620,6 +1360,7 @@ void component::save()
 void component::reset()
 {
 	model_ = model_save_;
+	update_location();
 }
 
 
@@ -629,9 +1370,29 @@ viewport::viewport(GLint x, GLint y, GLsizei width, GLsizei height)
 {
 }
 
+GLint viewport::get_x() const
+{
+	return x_;
+}
+
+GLint viewport::get_y() const
+{
+	return y_;
+}
+
+GLsizei viewport::get_width() const
+{
+	return width_;
+}
+
+GLsizei viewport::get_height() const
+{
+	return height_;
+}
+
 void viewport::render(model const& m, ::glm::mat4 const& V, ::glm::mat4 const& P) const
 {
-	::glViewport(x_, y_, width_, height_);
+	state::viewport(x_, y_, width_, height_);
 	m.render(V, P);
 }
 
@@ -640,9 +1401,3 @@ void viewport::render(model const& m, ::glm::mat4 const& V, ::glm::mat4 const& P
 } // namespace graphics
 } // namespace mrr
 
-
-#undef FOURCC_DXT1
-#undef FOURCC_DXT2
-#undef FOURCC_DXT3
-#undef FOURCC_DXT4
-#undef FOURCC_DXT5
@@ -9,7 +9,16 @@ namespace glew {
 void init()
 {
 	::glewExperimental = GL_TRUE;
-	if (::glewInit() != GLEW_OK) {
+	GLenum status = ::glewInit();
+
+	// A GLX build of GLEW loads the GL entry points before it looks for an X
+	// display, so a headless EGL context only fails the GLX part.
+#ifdef GLEW_ERROR_NO_GLX_DISPLAY
+	if (status == GLEW_ERROR_NO_GLX_DISPLAY)
+		status = GLEW_OK;
+#endif
+
+	if (status != GLEW_OK) {
 		::std::cerr << "Failed to initialize GLEW\n";
 		::exit(2);
 	}
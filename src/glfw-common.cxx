@@ -1,4 +1,5 @@
 #include <mrr/graphics/glfw-common.hxx>
+#include <mrr/graphics/state_cache.hxx>
 
 #include <iostream>
 
@@ -41,6 +42,7 @@ void window_handle::close()
 void window_handle::make_current()
 {
 	::glfwMakeContextCurrent(window_);
+	::mrr::graphics::gl::state::invalidate();
 }
 
 void window_handle::set_key_callback(GLFWkeyfun callback)
@@ -72,24 +74,7 @@ void window_handle::add_waypoint(::mrr::graphics::gl::waypoint const& wp)
 
 void window_handle::process_waypoints() const
 {
-	for (auto const& wp : waypoints_)
-	{
-		for (auto& target_action_list_pair : wp.get_actions())
-		{
-			auto& target
-				=	dynamic_cast<::mrr::graphics::gl::component&>(*target_action_list_pair.first);
-
-			double distance = glm::length(target.get_location() - wp.get_location());
-
-			if (distance < wp.get_radius())
-			{
-				for (auto const& action : target_action_list_pair.second)
-				{
-					action(target);
-				}
-			}
-		}
-	}
+	::mrr::graphics::gl::process_waypoints(waypoints_);
 }
 
 void window_handle::swap_buffers()
@@ -126,6 +111,11 @@ double window_handle::get_ms_per_frame() const
 	return ms_per_frame;
 }
 
+::mrr::graphics::gl::frame_arena& window_handle::get_frame_arena()
+{
+	return frame_arena_;
+}
+
 //m=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-
 void init()
 {
@@ -151,7 +141,7 @@ void default_error_callback(int error, const char* description)
 
 void framebuffer_size_callback(GLFWwindow* window, int width, int height)
 {
-	::glViewport(0, 0, width, height);
+	::mrr::graphics::gl::state::viewport(0, 0, width, height);
 }
 
 
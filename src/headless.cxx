@@ -0,0 +1,139 @@
+#include <mrr/graphics/headless.hxx>
+#include <mrr/graphics/glew-common.hxx>
+#include <mrr/graphics/state_cache.hxx>
+
+#define EGL_NO_X11
+#define MESA_EGL_NO_X11_HEADERS
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+
+namespace mrr {
+namespace graphics {
+namespace egl {
+
+namespace {
+
+bool has_extension(char const* extensions, char const* name)
+{
+	if (extensions == nullptr)
+		return false;
+
+	std::size_t length = std::strlen(name);
+	for (char const* p = std::strstr(extensions, name); p; p = std::strstr(p + length, name))
+		if ((p == extensions || p[-1] == ' ') && (p[length] == ' ' || p[length] == '\0'))
+			return true;
+	return false;
+}
+
+EGLDisplay get_display()
+{
+	char const* client_extensions = ::eglQueryString(EGL_NO_DISPLAY, EGL_EXTENSIONS);
+	auto get_platform_display = reinterpret_cast<PFNEGLGETPLATFORMDISPLAYEXTPROC>(
+		::eglGetProcAddress("eglGetPlatformDisplayEXT")
+	);
+
+	if (get_platform_display
+	    && has_extension(client_extensions, "EGL_MESA_platform_surfaceless"))
+	{
+		EGLDisplay display
+			= get_platform_display(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, nullptr);
+		if (display != EGL_NO_DISPLAY)
+			return display;
+	}
+
+	return ::eglGetDisplay(EGL_DEFAULT_DISPLAY);
+}
+
+void fail(char const* what)
+{
+	::std::cerr << "Failed to create headless context: " << what
+	            << " (EGL error 0x" << std::hex << ::eglGetError() << std::dec << ")\n";
+	::exit(3);
+}
+
+} // namespace
+
+
+//m=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-
+headless_context::headless_context(int major_version, int minor_version)
+	: display_(nullptr), context_(nullptr), surface_(nullptr)
+{
+	EGLDisplay display = get_display();
+	EGLint egl_major, egl_minor;
+	if (display == EGL_NO_DISPLAY || !::eglInitialize(display, &egl_major, &egl_minor))
+		fail("no EGL display");
+	display_ = display;
+
+	if (!::eglBindAPI(EGL_OPENGL_API))
+		fail("desktop OpenGL is not supported");
+
+	EGLint const config_attributes[] = {
+		EGL_SURFACE_TYPE, EGL_PBUFFER_BIT,
+		EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT,
+		EGL_RED_SIZE, 8, EGL_GREEN_SIZE, 8, EGL_BLUE_SIZE, 8, EGL_ALPHA_SIZE, 8,
+		EGL_DEPTH_SIZE, 24,
+		EGL_NONE
+	};
+	EGLConfig config;
+	EGLint config_count = 0;
+	if (!::eglChooseConfig(display, config_attributes, &config, 1, &config_count)
+	    || config_count == 0)
+		fail("no suitable EGL config");
+
+	EGLint const context_attributes[] = {
+		EGL_CONTEXT_MAJOR_VERSION, major_version,
+		EGL_CONTEXT_MINOR_VERSION, minor_version,
+		EGL_CONTEXT_OPENGL_PROFILE_MASK, EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT,
+		EGL_NONE
+	};
+	EGLContext context = ::eglCreateContext(display, config, EGL_NO_CONTEXT, context_attributes);
+	if (context == EGL_NO_CONTEXT)
+		fail("OpenGL context creation failed");
+	context_ = context;
+
+	// Everything is drawn into framebuffer objects, so a surface is only
+	// created for implementations that cannot make a context current without
+	// one.
+	EGLSurface surface = EGL_NO_SURFACE;
+	if (!has_extension(::eglQueryString(display, EGL_EXTENSIONS), "EGL_KHR_surfaceless_context"))
+	{
+		EGLint const surface_attributes[] = { EGL_WIDTH, 1, EGL_HEIGHT, 1, EGL_NONE };
+		surface = ::eglCreatePbufferSurface(display, config, surface_attributes);
+		if (surface == EGL_NO_SURFACE)
+			fail("pbuffer creation failed");
+	}
+	surface_ = surface;
+
+	make_current();
+	::mrr::graphics::glew::init();
+}
+
+headless_context::~headless_context()
+{
+	::eglMakeCurrent(display_, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+	::mrr::graphics::gl::state::invalidate();
+	if (surface_ != EGL_NO_SURFACE)
+		::eglDestroySurface(display_, surface_);
+	::eglDestroyContext(display_, context_);
+	::eglTerminate(display_);
+}
+
+void headless_context::make_current()
+{
+	if (!::eglMakeCurrent(display_, surface_, surface_, context_))
+		fail("eglMakeCurrent failed");
+	::mrr::graphics::gl::state::invalidate();
+}
+
+char const* headless_context::get_renderer() const
+{
+	return reinterpret_cast<char const*>(::glGetString(GL_RENDERER));
+}
+
+} // namespace egl
+} // namespace graphics
+} // namespace mrr
@@ -0,0 +1,180 @@
+#include <mrr/graphics/hot_reload.hxx>
+
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+
+namespace mrr {
+namespace graphics {
+namespace gl {
+
+hot_reloader::hot_reloader()
+	: last_latency_(0.0),
+	  last_reload_time_(0.0)
+{
+}
+
+void hot_reloader::collect(model& m, ::std::vector<component*>& components)
+{
+	if (auto c = dynamic_cast<component*>(&m))
+		components.push_back(c);
+
+	for (model* child : m.get_components())
+		collect(*child, components);
+}
+
+void hot_reloader::watch(model& m)
+{
+	if (::std::find(models_.begin(), models_.end(), &m) == models_.end())
+		models_.push_back(&m);
+
+	::std::vector<component*> components;
+	collect(m, components);
+
+	shader_handle const& s = m.get_shader();
+	if (!s.get_vertex_shader_file().empty())
+	{
+		watcher_.watch(s.get_vertex_shader_file());
+		watcher_.watch(s.get_fragment_shader_file());
+	}
+
+	for (component* c : components)
+	{
+		shader_handle const& cs = c->get_shader();
+		if (!cs.get_vertex_shader_file().empty())
+		{
+			watcher_.watch(cs.get_vertex_shader_file());
+			watcher_.watch(cs.get_fragment_shader_file());
+		}
+		if (!c->get_wavefront_file().empty())
+			watcher_.watch(c->get_wavefront_file());
+		if (!c->get_texture_file().empty())
+			watcher_.watch(c->get_texture_file());
+	}
+}
+
+void hot_reloader::watch(shader_handle const& s)
+{
+	shaders_.push_back(s);
+	watcher_.watch(s.get_vertex_shader_file());
+	watcher_.watch(s.get_fragment_shader_file());
+}
+
+void hot_reloader::set_reload_callback(callback_type const& callback)
+{
+	reload_callback_ = callback;
+}
+
+::std::size_t hot_reloader::update()
+{
+	::std::vector<file_watcher::change> changes = watcher_.poll();
+	if (changes.empty())
+		return 0;
+
+	// Models reached through the watched roots, rather than pointers kept
+	// from watch(), so components removed since are never touched.
+	::std::vector<component*> components;
+	::std::vector<shader_handle> shaders = shaders_;
+	for (model* m : models_)
+	{
+		collect(*m, components);
+		shaders.push_back(m->get_shader());
+	}
+	for (component* c : components)
+		shaders.push_back(c->get_shader());
+
+	::std::size_t reloaded = 0;
+	for (auto const& change : changes)
+	{
+		auto start = ::std::chrono::steady_clock::now();
+		bool found = false;
+		bool ok = true;
+
+		// Copies of a handle share their program, so each program is rebuilt
+		// once; its ids before and after the rebuild are both skipped.
+		::std::vector<GLuint> rebuilt;
+		bool shader_reloaded = false;
+		for (auto& s : shaders)
+		{
+			GLuint program_id = s.get_program_id();
+			if (program_id == 0
+			    || ::std::find(rebuilt.begin(), rebuilt.end(), program_id) != rebuilt.end()
+			    || (canonical_path(s.get_vertex_shader_file()) != change.path
+			        && canonical_path(s.get_fragment_shader_file()) != change.path))
+				continue;
+
+			found = true;
+			rebuilt.push_back(program_id);
+			if (s.reload())
+			{
+				rebuilt.push_back(s.get_program_id());
+				shader_reloaded = true;
+			}
+			else
+			{
+				ok = false;
+			}
+		}
+
+		if (shader_reloaded)
+			for (model* m : models_)
+				m->refresh_uniform_locations();
+
+		for (component* c : components)
+		{
+			if (!c->get_wavefront_file().empty()
+			    && canonical_path(c->get_wavefront_file()) == change.path)
+			{
+				found = true;
+				ok = c->reload_wavefront() && ok;
+			}
+
+			if (!c->get_texture_file().empty()
+			    && canonical_path(c->get_texture_file()) == change.path)
+			{
+				found = true;
+				ok = c->reload_texture() && ok;
+			}
+		}
+
+		if (!found)
+			continue;
+
+		if (!ok)
+		{
+			::std::cerr << "ERROR: Reloading " << change.path
+			            << " failed, keeping the previous version.\n";
+			continue;
+		}
+
+		last_reload_time_ = ::std::chrono::duration<double, ::std::milli>(
+			::std::chrono::steady_clock::now() - start
+		).count();
+		last_latency_ = ::std::chrono::duration<double, ::std::milli>(
+			::std::chrono::system_clock::now() - change.modified
+		).count();
+		++reloaded;
+
+		::std::clog << "Reloaded " << change.path << " in " << last_reload_time_ << " ms, "
+		            << last_latency_ << " ms after it was written.\n";
+
+		if (reload_callback_)
+			reload_callback_(change.path);
+	}
+
+	return reloaded;
+}
+
+double hot_reloader::get_last_latency() const
+{
+	return last_latency_;
+}
+
+double hot_reloader::get_last_reload_time() const
+{
+	return last_reload_time_;
+}
+
+} // namespace gl
+} // namespace graphics
+} // namespace mrr
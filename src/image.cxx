@@ -0,0 +1,307 @@
+#include <mrr/graphics/texture_compress.hxx>
+#include <mrr/graphics/parallel.hxx>
+
+#include <png.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+
+namespace mrr {
+namespace graphics {
+namespace gl {
+
+namespace {
+
+// Texels filtered per thread when building mips.
+std::size_t const mip_grain = 1 << 16;
+
+std::uint8_t const png_signature[8] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n' };
+
+std::size_t const tga_header_size = 18;
+std::uint8_t const tga_truecolour = 2;
+std::uint8_t const tga_greyscale = 3;
+std::uint8_t const tga_rle = 8;
+std::uint8_t const tga_right_to_left = 0x10;
+std::uint8_t const tga_top_to_bottom = 0x20;
+
+inline std::uint16_t read_u16(std::uint8_t const* p)
+{
+	return std::uint16_t(p[0] | (p[1] << 8));
+}
+
+bool read_file(std::string const& path, std::vector<std::uint8_t>& out)
+{
+	std::ifstream in(path, std::ios::binary);
+	if (!in)
+		return false;
+	out.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+	return true;
+}
+
+bool decode_png(std::vector<std::uint8_t> const& file, rgba_image& out, std::string& reason)
+{
+	png_image png;
+	std::memset(&png, 0, sizeof(png));
+	png.version = PNG_IMAGE_VERSION;
+
+	if (!::png_image_begin_read_from_memory(&png, file.data(), file.size()))
+	{
+		reason = png.message;
+		return false;
+	}
+
+	// Converts palettes, greyscale and 16 bit channels, and leaves the
+	// colour channels sRGB encoded and not premultiplied.
+	png.format = PNG_FORMAT_RGBA;
+	out = rgba_image(png.width, png.height);
+	if (!::png_image_finish_read(&png, nullptr, out.pixels.data(), 0, nullptr))
+	{
+		reason = png.message;
+		::png_image_free(&png);
+		return false;
+	}
+	return true;
+}
+
+bool decode_tga(std::vector<std::uint8_t> const& file, rgba_image& out, std::string& reason)
+{
+	if (file.size() < tga_header_size)
+	{
+		reason = "file is too short for a TGA header";
+		return false;
+	}
+
+	std::uint8_t const* header = file.data();
+	std::uint8_t const id_length = header[0];
+	std::uint8_t const colour_map = header[1];
+	std::uint8_t const type = header[2];
+	std::uint32_t const width = read_u16(header + 12);
+	std::uint32_t const height = read_u16(header + 14);
+	std::uint32_t const bits = header[16];
+	std::uint8_t const descriptor = header[17];
+
+	std::uint8_t const base_type = type & ~tga_rle;
+	if (colour_map != 0 || (base_type != tga_truecolour && base_type != tga_greyscale))
+	{
+		reason = "unsupported TGA image type (only truecolour and greyscale are supported)";
+		return false;
+	}
+	if ((base_type == tga_truecolour && bits != 24 && bits != 32)
+	    || (base_type == tga_greyscale && bits != 8))
+	{
+		reason = "unsupported TGA pixel depth";
+		return false;
+	}
+	if (width == 0 || height == 0)
+	{
+		reason = "invalid width or height";
+		return false;
+	}
+
+	std::size_t const pixel_bytes = bits / 8;
+	std::size_t const count = std::size_t(width) * height;
+	std::uint8_t const* p = file.data() + tga_header_size + id_length;
+	std::uint8_t const* const end = file.data() + file.size();
+
+	// Texels in file order, which is bottom to top unless flagged.
+	out = rgba_image(width, height);
+	auto put = [&](std::size_t i, std::uint8_t const* texel) {
+		std::size_t x = i % width, y = i / width;
+		if (descriptor & tga_right_to_left)
+			x = width - 1 - x;
+		if (!(descriptor & tga_top_to_bottom))
+			y = height - 1 - y;
+
+		std::uint8_t* rgba = &out.pixels[4 * (y * width + x)];
+		if (pixel_bytes == 1)
+		{
+			rgba[0] = rgba[1] = rgba[2] = texel[0];
+			rgba[3] = 255;
+		}
+		else
+		{
+			rgba[0] = texel[2];
+			rgba[1] = texel[1];
+			rgba[2] = texel[0];
+			rgba[3] = pixel_bytes == 4 ? texel[3] : 255;
+		}
+	};
+
+	if (!(type & tga_rle))
+	{
+		if (std::size_t(end - p) < count * pixel_bytes)
+		{
+			reason = "file is shorter than its pixels";
+			return false;
+		}
+		for (std::size_t i = 0; i < count; ++i, p += pixel_bytes)
+			put(i, p);
+		return true;
+	}
+
+	// Packets of up to 128 texels, either one texel repeated or literals.
+	for (std::size_t i = 0; i < count; )
+	{
+		if (p == end)
+		{
+			reason = "file is shorter than its pixels";
+			return false;
+		}
+		std::uint8_t packet = *p++;
+		std::size_t run = std::min<std::size_t>((packet & 0x7F) + 1, count - i);
+		bool repeat = (packet & 0x80) != 0;
+		if (std::size_t(end - p) < (repeat ? 1 : run) * pixel_bytes)
+		{
+			reason = "file is shorter than its pixels";
+			return false;
+		}
+
+		for (std::size_t k = 0; k < run; ++k, ++i)
+		{
+			put(i, p);
+			if (!repeat)
+				p += pixel_bytes;
+		}
+		if (repeat)
+			p += pixel_bytes;
+	}
+	return true;
+}
+
+// sRGB transfer functions. Encoding looks up linear values quantized
+// finely enough that every 8 bit code is reachable.
+std::size_t const linear_steps = 4096;
+
+float const* srgb_to_linear_table()
+{
+	static std::vector<float> const table = []() {
+		std::vector<float> t(256);
+		for (int i = 0; i < 256; ++i)
+		{
+			float c = i / 255.0f;
+			t[i] = c <= 0.04045f ? c / 12.92f : std::pow((c + 0.055f) / 1.055f, 2.4f);
+		}
+		return t;
+	}();
+	return table.data();
+}
+
+std::uint8_t const* linear_to_srgb_table()
+{
+	static std::vector<std::uint8_t> const table = []() {
+		std::vector<std::uint8_t> t(linear_steps + 1);
+		for (std::size_t i = 0; i <= linear_steps; ++i)
+		{
+			float l = float(i) / linear_steps;
+			float c = l <= 0.0031308f ? l * 12.92f : 1.055f * std::pow(l, 1.0f / 2.4f) - 0.055f;
+			t[i] = std::uint8_t(std::min(255.0f, c * 255.0f + 0.5f));
+		}
+		return t;
+	}();
+	return table.data();
+}
+
+rgba_image downsample(rgba_image const& src, bool srgb)
+{
+	rgba_image dst(std::max(src.width / 2, 1u), std::max(src.height / 2, 1u));
+	float const* to_linear = srgb_to_linear_table();
+	std::uint8_t const* to_srgb = linear_to_srgb_table();
+
+	std::size_t rows_per_chunk = std::max<std::size_t>(mip_grain / dst.width, 1);
+	impl::parallel_for(dst.height, rows_per_chunk, [&](std::size_t begin, std::size_t end) {
+		for (std::size_t y = begin; y < end; ++y)
+		{
+			std::size_t y0 = std::min<std::size_t>(2 * y, src.height - 1);
+			std::size_t y1 = std::min<std::size_t>(2 * y + 1, src.height - 1);
+			for (std::size_t x = 0; x < dst.width; ++x)
+			{
+				std::size_t x0 = std::min<std::size_t>(2 * x, src.width - 1);
+				std::size_t x1 = std::min<std::size_t>(2 * x + 1, src.width - 1);
+				std::uint8_t const* texels[4] = {
+					&src.pixels[4 * (y0 * src.width + x0)], &src.pixels[4 * (y0 * src.width + x1)],
+					&src.pixels[4 * (y1 * src.width + x0)], &src.pixels[4 * (y1 * src.width + x1)]
+				};
+				std::uint8_t* out = &dst.pixels[4 * (y * dst.width + x)];
+
+				unsigned alpha = texels[0][3] + texels[1][3] + texels[2][3] + texels[3][3];
+				out[3] = std::uint8_t((alpha + 2) / 4);
+
+				if (!srgb)
+				{
+					for (int c = 0; c < 3; ++c)
+						out[c] = std::uint8_t(
+							(texels[0][c] + texels[1][c] + texels[2][c] + texels[3][c] + 2) / 4
+						);
+					continue;
+				}
+
+				// Colours weighted by coverage, so that the colour of fully
+				// transparent texels never bleeds into their neighbours.
+				float weights[4], total = 0.0f;
+				for (int i = 0; i < 4; ++i)
+					total += weights[i] = alpha != 0 ? texels[i][3] : 1.0f;
+				for (int c = 0; c < 3; ++c)
+				{
+					float sum = 0.0f;
+					for (int i = 0; i < 4; ++i)
+						sum += weights[i] * to_linear[texels[i][c]];
+					out[c] = to_srgb[std::size_t(sum / total * linear_steps + 0.5f)];
+				}
+			}
+		}
+	});
+
+	return dst;
+}
+
+} // namespace
+
+
+//m=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-
+rgba_image::rgba_image()
+	: width(0),
+	  height(0)
+{
+}
+
+rgba_image::rgba_image(std::uint32_t width, std::uint32_t height)
+	: width(width),
+	  height(height),
+	  pixels(std::size_t(width) * height * 4)
+{
+}
+
+bool load_image(std::string const& path, rgba_image& out)
+{
+	std::vector<std::uint8_t> file;
+	if (!read_file(path, file))
+	{
+		std::cerr << "ERROR: Cannot open image...\tpath: " << path << std::endl;
+		return false;
+	}
+
+	std::string reason;
+	bool is_png = file.size() >= sizeof(png_signature)
+		&& std::memcmp(file.data(), png_signature, sizeof(png_signature)) == 0;
+	if (is_png ? decode_png(file, out, reason) : decode_tga(file, out, reason))
+		return true;
+
+	std::cerr << "ERROR: Cannot decode image: " << reason << "...\tpath: " << path << std::endl;
+	return false;
+}
+
+std::vector<rgba_image> generate_mips(rgba_image const& image, bool srgb)
+{
+	std::vector<rgba_image> levels(1, image);
+	while (levels.back().width > 1 || levels.back().height > 1)
+		levels.push_back(downsample(levels.back(), srgb));
+	return levels;
+}
+
+} // namespace gl
+} // namespace graphics
+} // namespace mrr
@@ -0,0 +1,297 @@
+#include <mrr/graphics/indirect.hxx>
+#include <mrr/graphics/stats.hxx>
+#include <mrr/graphics/state_cache.hxx>
+
+#include <algorithm>
+
+namespace mrr {
+namespace graphics {
+namespace gl {
+
+shader_handle indirect_shader()
+{
+	return shader_handle(
+		"/usr/local/share/mrr/graphics/shaders/indirect-vertex-shader.glsl",
+		"/usr/local/share/mrr/graphics/shaders/indirect-fragment-shader.glsl"
+	);
+}
+
+
+//m=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-
+indirect_renderer::indirect_renderer()
+	: supported_(is_supported()),
+	  root_(nullptr),
+	  visible_count_(0),
+	  view_matrix_id_(0),
+	  projection_matrix_id_(0),
+	  ambient_light_colour_id_(0),
+	  point_source_locations_id_(0),
+	  point_source_colours_id_(0),
+	  point_source_powers_id_(0),
+	  point_source_count_id_(0)
+{
+}
+
+bool indirect_renderer::is_supported()
+{
+	// glMultiDrawElementsIndirect, shader storage buffers and the baseInstance
+	// field of the draw command are all required.
+	return GLEW_VERSION_4_3
+		|| (GLEW_ARB_multi_draw_indirect
+		    && GLEW_ARB_shader_storage_buffer_object
+		    && GLEW_ARB_base_instance);
+}
+
+void indirect_renderer::set_shader(shader_handle const& s)
+{
+	shader_ = s;
+	view_matrix_id_ = shader_.get_uniform_location("V");
+	projection_matrix_id_ = shader_.get_uniform_location("P");
+	ambient_light_colour_id_ = shader_.get_uniform_location("AmbientLightColour");
+	point_source_locations_id_ = shader_.get_uniform_location("LightPosition_worldspace");
+	point_source_colours_id_ = shader_.get_uniform_location("LightColour");
+	point_source_powers_id_ = shader_.get_uniform_location("LightPower");
+	point_source_count_id_ = shader_.get_uniform_location("PointSourceCount");
+}
+
+void indirect_renderer::add(model& m)
+{
+	if (root_ == nullptr)
+		root_ = &m;
+
+	collect(m);
+}
+
+void indirect_renderer::clear()
+{
+	root_ = nullptr;
+	objects_.clear();
+	materials_.clear();
+}
+
+void indirect_renderer::collect(model& m)
+{
+	// Components do not render their children, so neither do we.
+	if (auto c = dynamic_cast<component const*>(&m))
+	{
+		object o;
+		o.target = c;
+		o.base_vertex = 0;
+		o.material = 0;
+		o.indirect = supported_
+			&& !c->has_texture()
+			&& c->get_lod_count() > 0
+			&& !c->get_vertices().empty()
+			&& c->get_normals().size() == c->get_vertices().size();
+
+		if (o.indirect)
+			o.material = add_material(c->get_colour(), c->get_specular_colour());
+
+		objects_.push_back(o);
+		return;
+	}
+
+	for (model* child : m.get_components())
+		collect(*child);
+}
+
+GLuint indirect_renderer::add_material(::glm::vec3 const& diffuse, ::glm::vec3 const& specular)
+{
+	for (std::size_t i = 0; i < materials_.size(); ++i)
+	{
+		if (::glm::vec3(materials_[i].diffuse) == diffuse
+		    && ::glm::vec3(materials_[i].specular) == specular)
+			return i;
+	}
+
+	material_data md;
+	md.diffuse = ::glm::vec4(diffuse, 1.0f);
+	md.specular = ::glm::vec4(specular, 1.0f);
+	materials_.push_back(md);
+
+	return materials_.size() - 1;
+}
+
+void indirect_renderer::build()
+{
+	if (!supported_)
+		return;
+
+	if (shader_.get_program_id() == 0)
+		set_shader(indirect_shader());
+
+	// Pack the geometry of every indirect object into shared buffers. Index
+	// lists stay relative to their object; baseVertex offsets them.
+	std::size_t total_vertices = 0;
+	std::size_t total_indices = 0;
+	for (auto const& o : objects_)
+	{
+		if (!o.indirect)
+			continue;
+
+		total_vertices += o.target->get_vertices().size();
+		for (std::size_t lod = 0; lod < o.target->get_lod_count(); ++lod)
+			total_indices += o.target->get_indices(lod).size();
+	}
+
+	::std::vector<::glm::vec3> vertices;
+	::std::vector<::glm::vec3> normals;
+	::std::vector<GLuint> indices;
+	::std::vector<GLuint> object_indices;
+	vertices.reserve(total_vertices);
+	normals.reserve(total_vertices);
+	indices.reserve(total_indices);
+	object_indices.reserve(objects_.size());
+
+	for (auto& o : objects_)
+	{
+		object_indices.push_back(object_indices.size());
+		if (!o.indirect)
+			continue;
+
+		component const& c = *o.target;
+		o.base_vertex = vertices.size();
+		vertices.insert(vertices.end(), c.get_vertices().begin(), c.get_vertices().end());
+		normals.insert(normals.end(), c.get_normals().begin(), c.get_normals().end());
+
+		o.lods.clear();
+		for (std::size_t lod = 0; lod < c.get_lod_count(); ++lod)
+		{
+			index_range r;
+			r.first = indices.size();
+			r.count = c.get_indices(lod).size();
+			indices.insert(indices.end(), c.get_indices(lod).begin(), c.get_indices(lod).end());
+			o.lods.push_back(r);
+		}
+	}
+
+	GLuint previous_vertex_array = state::get_vertex_array();
+
+	vertex_array_.reset(new vertex_array());
+	state::set_vertex_attrib_arrays((1 << 0) | (1 << 2) | (1 << 3));
+
+	vertex_buffer_.create();
+	vertex_buffer_.set_data(GL_ARRAY_BUFFER, vertices.size() * sizeof(::glm::vec3), vertices.data(), GL_STATIC_DRAW);
+	::glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 0, (void*)0);
+
+	normal_buffer_.create();
+	normal_buffer_.set_data(GL_ARRAY_BUFFER, normals.size() * sizeof(::glm::vec3), normals.data(), GL_STATIC_DRAW);
+	::glVertexAttribPointer(2, 3, GL_FLOAT, GL_FALSE, 0, (void*)0);
+
+	index_buffer_.create();
+	index_buffer_.set_data(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(GLuint), indices.data(), GL_STATIC_DRAW);
+
+	// Each draw command's baseInstance selects its entry in this per-instance
+	// attribute, which the shader uses to index the object buffer.
+	object_index_buffer_.create();
+	object_index_buffer_.set_data(GL_ARRAY_BUFFER, object_indices.size() * sizeof(GLuint), object_indices.data(), GL_STATIC_DRAW);
+	::glVertexAttribIPointer(3, 1, GL_UNSIGNED_INT, 0, (void*)0);
+	::glVertexAttribDivisor(3, 1);
+
+	state::bind_vertex_array(previous_vertex_array);
+
+	material_buffer_.create();
+	material_buffer_.set_data(GL_SHADER_STORAGE_BUFFER, materials_.size() * sizeof(material_data), materials_.data(), GL_STATIC_DRAW);
+
+	object_buffer_.create();
+	command_buffer_.create();
+
+	object_data_.resize(objects_.size());
+	commands_.reserve(objects_.size());
+}
+
+void indirect_renderer::set_light_uniforms(model const& lights)
+{
+	int ps_count = lights.get_point_source_locations().size();
+	if (ps_count > 0)
+	{
+		::glUniform3fv(point_source_locations_id_, ps_count, &lights.get_point_source_locations()[0].x);
+		::glUniform3fv(point_source_colours_id_,   ps_count, &lights.get_point_source_colours()[0].x);
+		::glUniform1fv(point_source_powers_id_,    ps_count, &lights.get_point_source_powers()[0]);
+	}
+	::glUniform1i(point_source_count_id_, ps_count);
+	::glUniform3fv(ambient_light_colour_id_, 1, &lights.get_ambient_light_colour()[0]);
+}
+
+void indirect_renderer::render(::glm::mat4 const& V, ::glm::mat4 const& P)
+{
+	frustum view_frustum(P * V);
+
+	commands_.clear();
+	visible_count_ = 0;
+
+	for (std::size_t i = 0; i < objects_.size(); ++i)
+	{
+		object const& o = objects_[i];
+		if (!view_frustum.intersects(o.target->get_world_bounds()))
+			continue;
+
+		++visible_count_;
+
+		if (!o.indirect || vertex_array_ == nullptr)
+		{
+			o.target->render(V, P);
+			continue;
+		}
+
+		object_data od;
+		od.model = o.target->get_model();
+		od.material = o.material;
+
+		// LODs generated since build() are not in the shared index buffer.
+		std::size_t lod = std::min(o.target->select_lod(V, P), o.lods.size() - 1);
+		index_range const& r = o.lods[lod];
+
+		draw_command cmd;
+		cmd.count = r.count;
+		cmd.instance_count = 1;
+		cmd.first_index = r.first;
+		cmd.base_vertex = o.base_vertex;
+		cmd.base_instance = i;
+
+		render_stats& stats = frame_stats();
+		stats.triangles_submitted += r.count / 3;
+		stats.triangles_full_detail += o.lods[0].count / 3;
+
+		// The object buffer is indexed by object, not by visible object, so
+		// slots of culled objects are simply left stale.
+		object_data_[i] = od;
+		commands_.push_back(cmd);
+	}
+
+	if (commands_.empty())
+		return;
+
+	shader_.use();
+	::glUniformMatrix4fv(view_matrix_id_, 1, GL_FALSE, &V[0][0]);
+	::glUniformMatrix4fv(projection_matrix_id_, 1, GL_FALSE, &P[0][0]);
+	set_light_uniforms(*root_);
+
+	// Orphan and refill the per-frame buffers.
+	object_buffer_.set_data(GL_SHADER_STORAGE_BUFFER, object_data_.size() * sizeof(object_data), object_data_.data(), GL_STREAM_DRAW);
+	object_buffer_.bind_base(GL_SHADER_STORAGE_BUFFER, 0);
+	material_buffer_.bind_base(GL_SHADER_STORAGE_BUFFER, 1);
+
+	command_buffer_.set_data(GL_DRAW_INDIRECT_BUFFER, commands_.size() * sizeof(draw_command), commands_.data(), GL_STREAM_DRAW);
+
+	GLuint previous_vertex_array = state::get_vertex_array();
+
+	vertex_array_->bind();
+	::glMultiDrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_INT, (void*)0, commands_.size(), 0);
+	++frame_stats().draw_calls;
+	state::bind_vertex_array(previous_vertex_array);
+}
+
+std::size_t indirect_renderer::get_object_count() const
+{
+	return objects_.size();
+}
+
+std::size_t indirect_renderer::get_visible_count() const
+{
+	return visible_count_;
+}
+
+} // namespace gl
+} // namespace graphics
+} // namespace mrr
@@ -0,0 +1,110 @@
+#include <mrr/graphics/mapped_file.hxx>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace mrr {
+namespace graphics {
+
+mapped_file::mapped_file()
+	: data_(nullptr), size_(0), is_open_(false)
+{
+}
+
+mapped_file::mapped_file(::std::string const& path)
+	: mapped_file()
+{
+	open(path);
+}
+
+mapped_file::mapped_file(mapped_file&& other)
+	: data_(other.data_), size_(other.size_), is_open_(other.is_open_)
+{
+	other.data_ = nullptr;
+	other.size_ = 0;
+	other.is_open_ = false;
+}
+
+mapped_file& mapped_file::operator =(mapped_file&& other)
+{
+	if (this != &other)
+	{
+		close();
+		data_ = other.data_;
+		size_ = other.size_;
+		is_open_ = other.is_open_;
+		other.data_ = nullptr;
+		other.size_ = 0;
+		other.is_open_ = false;
+	}
+	return *this;
+}
+
+mapped_file::~mapped_file()
+{
+	close();
+}
+
+bool mapped_file::open(::std::string const& path)
+{
+	close();
+
+	int fd = ::open(path.c_str(), O_RDONLY);
+	if (fd < 0)
+		return false;
+
+	struct stat st;
+	if (::fstat(fd, &st) != 0 || !S_ISREG(st.st_mode))
+	{
+		::close(fd);
+		return false;
+	}
+
+	size_ = static_cast<::std::size_t>(st.st_size);
+	if (size_ > 0)
+	{
+		void* p = ::mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+		if (p == MAP_FAILED)
+		{
+			::close(fd);
+			size_ = 0;
+			return false;
+		}
+		data_ = static_cast<unsigned char const*>(p);
+	}
+
+	// The mapping stays valid after the descriptor is closed.
+	::close(fd);
+	is_open_ = true;
+	return true;
+}
+
+void mapped_file::close()
+{
+	if (data_ != nullptr)
+		::munmap(const_cast<unsigned char*>(data_), size_);
+
+	data_ = nullptr;
+	size_ = 0;
+	is_open_ = false;
+}
+
+unsigned char const* mapped_file::data() const
+{
+	return data_;
+}
+
+::std::size_t mapped_file::size() const
+{
+	return size_;
+}
+
+mapped_file::operator bool() const
+{
+	return is_open_;
+}
+
+} // namespace graphics
+} // namespace mrr
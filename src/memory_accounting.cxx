@@ -0,0 +1,261 @@
+#include <mrr/graphics/memory_accounting.hxx>
+
+#include <algorithm>
+#include <cstdint>
+#include <mutex>
+#include <ostream>
+#include <unordered_map>
+
+namespace mrr {
+namespace graphics {
+namespace gl {
+
+namespace {
+
+// GL objects are keyed by kind and name, CPU memory by owner and category.
+enum class record_kind : std::uint32_t
+{
+	buffer,
+	texture,
+	renderbuffer,
+	cpu
+};
+
+struct record_key
+{
+	record_kind kind;
+	std::uint32_t category;
+	std::uintptr_t id;
+
+	bool operator ==(record_key const& other) const
+	{
+		return kind == other.kind && category == other.category && id == other.id;
+	}
+};
+
+struct record_key_hash
+{
+	std::size_t operator ()(record_key const& k) const
+	{
+		return std::hash<std::uintptr_t>()(k.id) ^ (std::size_t(k.kind) << 3 | k.category) * 0x9e3779b97f4a7c15ull;
+	}
+};
+
+struct record
+{
+	memory_category category;
+	std::size_t bytes;
+	std::string asset;
+};
+
+// Never destroyed: buffers and textures in static models release their
+// records after the ledger would otherwise have gone.
+struct ledger
+{
+	std::mutex mutex;
+	std::unordered_map<record_key, record, record_key_hash> records;
+
+	std::ostream* dump_out = nullptr;
+	std::size_t dump_interval = 0;
+	std::size_t dump_frame = 0;
+};
+
+ledger& get_ledger()
+{
+	static ledger* l = new ledger();
+	return *l;
+}
+
+void set_record(record_key const& key, memory_category c, std::size_t bytes, std::string const& asset)
+{
+	ledger& l = get_ledger();
+	std::lock_guard<std::mutex> lock(l.mutex);
+
+	if (bytes == 0 && key.kind == record_kind::cpu)
+	{
+		l.records.erase(key);
+		return;
+	}
+
+	record& r = l.records[key];
+	r.category = c;
+	r.bytes = bytes;
+	// Buffers orphaned every frame keep their asset, without reallocating.
+	if (r.asset != asset)
+		r.asset = asset;
+}
+
+void erase_record(record_key const& key)
+{
+	ledger& l = get_ledger();
+	std::lock_guard<std::mutex> lock(l.mutex);
+	l.records.erase(key);
+}
+
+record_key gl_key(record_kind kind, GLuint name)
+{
+	record_key k = { kind, 0, name };
+	return k;
+}
+
+} // namespace
+
+
+char const* describe(memory_category c)
+{
+	switch (c)
+	{
+	case memory_category::vertex_buffers: return "vertex buffers";
+	case memory_category::index_buffers:  return "index buffers";
+	case memory_category::other_buffers:  return "other buffers";
+	case memory_category::textures:       return "textures";
+	case memory_category::render_targets: return "render targets";
+	case memory_category::mesh_arrays:    return "mesh arrays";
+	case memory_category::index_arrays:   return "index arrays";
+	}
+	return "unknown";
+}
+
+bool is_gpu_memory(memory_category c)
+{
+	return c != memory_category::mesh_arrays && c != memory_category::index_arrays;
+}
+
+void track_buffer(GLuint buffer, memory_category c, std::size_t bytes, std::string const& asset)
+{
+	set_record(gl_key(record_kind::buffer, buffer), c, bytes, asset);
+}
+
+void track_texture(GLuint texture, std::size_t bytes, std::string const& asset)
+{
+	set_record(gl_key(record_kind::texture, texture), memory_category::textures, bytes, asset);
+}
+
+void track_renderbuffer(GLuint renderbuffer, std::size_t bytes)
+{
+	set_record(gl_key(record_kind::renderbuffer, renderbuffer), memory_category::render_targets, bytes, std::string());
+}
+
+void untrack_buffer(GLuint buffer)
+{
+	erase_record(gl_key(record_kind::buffer, buffer));
+}
+
+void untrack_texture(GLuint texture)
+{
+	erase_record(gl_key(record_kind::texture, texture));
+}
+
+void untrack_renderbuffer(GLuint renderbuffer)
+{
+	erase_record(gl_key(record_kind::renderbuffer, renderbuffer));
+}
+
+void track_cpu_memory(void const* owner, memory_category c, std::size_t bytes, std::string const& asset)
+{
+	record_key k = { record_kind::cpu, std::uint32_t(c), reinterpret_cast<std::uintptr_t>(owner) };
+	set_record(k, c, bytes, asset);
+}
+
+void untrack_cpu_memory(void const* owner)
+{
+	for (std::size_t c = 0; c < memory_category_count; ++c)
+		if (!is_gpu_memory(memory_category(c)))
+			track_cpu_memory(owner, memory_category(c), 0);
+}
+
+
+//m=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-
+asset_memory::asset_memory()
+	: cpu_bytes(0),
+	  gpu_bytes(0)
+{
+}
+
+memory_report::memory_report()
+	: cpu_bytes(0),
+	  gpu_bytes(0)
+{
+	std::fill(bytes, bytes + memory_category_count, 0);
+	std::fill(objects, objects + memory_category_count, 0);
+}
+
+memory_report get_memory_report()
+{
+	memory_report report;
+	std::unordered_map<std::string, asset_memory> assets;
+
+	ledger& l = get_ledger();
+	{
+		std::lock_guard<std::mutex> lock(l.mutex);
+		for (auto const& entry : l.records)
+		{
+			record const& r = entry.second;
+			std::size_t c = std::size_t(r.category);
+			report.bytes[c] += r.bytes;
+			++report.objects[c];
+
+			asset_memory& a = assets[r.asset];
+			if (is_gpu_memory(r.category))
+			{
+				report.gpu_bytes += r.bytes;
+				a.gpu_bytes += r.bytes;
+			}
+			else
+			{
+				report.cpu_bytes += r.bytes;
+				a.cpu_bytes += r.bytes;
+			}
+		}
+	}
+
+	for (auto& entry : assets)
+	{
+		entry.second.name = entry.first;
+		report.assets.push_back(std::move(entry.second));
+	}
+	std::sort(report.assets.begin(), report.assets.end(), [](asset_memory const& a, asset_memory const& b) {
+		std::size_t at = a.cpu_bytes + a.gpu_bytes, bt = b.cpu_bytes + b.gpu_bytes;
+		return at != bt ? at > bt : a.name < b.name;
+	});
+	return report;
+}
+
+::std::ostream& operator <<(::std::ostream& out, memory_report const& r)
+{
+	out << "cpu: " << r.cpu_bytes << " bytes, gpu: " << r.gpu_bytes << " bytes";
+	for (std::size_t c = 0; c < memory_category_count; ++c)
+		out << ", " << describe(memory_category(c)) << ": " << r.bytes[c] << " (" << r.objects[c] << ")";
+
+	for (asset_memory const& a : r.assets)
+		out << "\n  " << (a.name.empty() ? "(no asset)" : a.name.c_str())
+		    << ": cpu " << a.cpu_bytes << " bytes, gpu " << a.gpu_bytes << " bytes";
+	return out;
+}
+
+void set_memory_dump(::std::ostream* out, std::size_t interval_frames)
+{
+	ledger& l = get_ledger();
+	std::lock_guard<std::mutex> lock(l.mutex);
+	l.dump_out = out;
+	l.dump_interval = interval_frames;
+	l.dump_frame = 0;
+}
+
+void dump_memory_report()
+{
+	ledger& l = get_ledger();
+	std::ostream* out;
+	{
+		std::lock_guard<std::mutex> lock(l.mutex);
+		if (l.dump_out == nullptr || l.dump_interval == 0 || ++l.dump_frame < l.dump_interval)
+			return;
+		l.dump_frame = 0;
+		out = l.dump_out;
+	}
+	*out << "Memory: " << get_memory_report() << std::endl;
+}
+
+} // namespace gl
+} // namespace graphics
+} // namespace mrr
@@ -0,0 +1,750 @@
+#include <mrr/graphics/mesh.hxx>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <iterator>
+#include <queue>
+#include <unordered_map>
+
+namespace mrr {
+namespace graphics {
+namespace gl {
+namespace impl {
+
+namespace {
+
+struct vertex_key
+{
+	float data[8];
+
+	bool operator ==(vertex_key const& other) const
+	{
+		return std::memcmp(data, other.data, sizeof(data)) == 0;
+	}
+};
+
+struct vertex_key_hash
+{
+	std::size_t operator ()(vertex_key const& k) const
+	{
+		std::uint32_t bits[8];
+		std::memcpy(bits, k.data, sizeof(bits));
+
+		std::size_t h = 2166136261u;
+		for (std::uint32_t b : bits)
+			h = (h ^ b) * 16777619u;
+		return h;
+	}
+};
+
+
+// Symmetric 4x4 error quadric (Garland & Heckbert), upper triangle only.
+struct quadric
+{
+	double a[10];
+
+	quadric()
+	{
+		std::fill(a, a + 10, 0.0);
+	}
+
+	quadric(double x, double y, double z, double w)
+	{
+		a[0] = x*x; a[1] = x*y; a[2] = x*z; a[3] = x*w;
+		            a[4] = y*y; a[5] = y*z; a[6] = y*w;
+		                        a[7] = z*z; a[8] = z*w;
+		                                    a[9] = w*w;
+	}
+
+	quadric& operator +=(quadric const& q)
+	{
+		for (int i = 0; i < 10; ++i)
+			a[i] += q.a[i];
+		return *this;
+	}
+
+	double error(glm::vec3 const& v) const
+	{
+		double x = v.x, y = v.y, z = v.z;
+		return a[0]*x*x + 2*a[1]*x*y + 2*a[2]*x*z + 2*a[3]*x
+		     + a[4]*y*y + 2*a[5]*y*z + 2*a[6]*y
+		     + a[7]*z*z + 2*a[8]*z
+		     + a[9];
+	}
+};
+
+struct collapse
+{
+	double cost;
+	unsigned int from;
+	unsigned int to;
+	unsigned int from_stamp;
+	unsigned int to_stamp;
+
+	bool operator >(collapse const& other) const
+	{
+		return cost > other.cost;
+	}
+};
+
+inline std::uint64_t edge_key(unsigned int a, unsigned int b)
+{
+	if (a > b)
+		std::swap(a, b);
+	return (static_cast<std::uint64_t>(a) << 32) | b;
+}
+
+} // namespace
+
+
+//m=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-
+void weld_vertices(
+	std::vector<glm::vec3>& vertices,
+	std::vector<glm::vec2>& uvs,
+	std::vector<glm::vec3>& normals,
+	std::vector<unsigned int>& out_indices
+)
+{
+	bool const has_uvs = uvs.size() == vertices.size();
+	bool const has_normals = normals.size() == vertices.size();
+
+	std::unordered_map<vertex_key, unsigned int, vertex_key_hash> unique;
+	unique.reserve(vertices.size());
+
+	out_indices.clear();
+	out_indices.reserve(vertices.size());
+
+	std::size_t count = 0;
+	for (std::size_t i = 0; i < vertices.size(); ++i)
+	{
+		vertex_key k;
+		std::fill(k.data, k.data + 8, 0.0f);
+		k.data[0] = vertices[i].x;
+		k.data[1] = vertices[i].y;
+		k.data[2] = vertices[i].z;
+		if (has_uvs)
+		{
+			k.data[3] = uvs[i].x;
+			k.data[4] = uvs[i].y;
+		}
+		if (has_normals)
+		{
+			k.data[5] = normals[i].x;
+			k.data[6] = normals[i].y;
+			k.data[7] = normals[i].z;
+		}
+
+		auto inserted = unique.insert(std::make_pair(k, static_cast<unsigned int>(count)));
+		if (inserted.second)
+		{
+			// Compact in place; count never overtakes i.
+			vertices[count] = vertices[i];
+			if (has_uvs)
+				uvs[count] = uvs[i];
+			if (has_normals)
+				normals[count] = normals[i];
+			++count;
+		}
+
+		out_indices.push_back(inserted.first->second);
+	}
+
+	vertices.resize(count);
+	vertices.shrink_to_fit();
+	if (has_uvs)
+	{
+		uvs.resize(count);
+		uvs.shrink_to_fit();
+	}
+	if (has_normals)
+	{
+		normals.resize(count);
+		normals.shrink_to_fit();
+	}
+}
+
+
+//m=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-
+std::vector<unsigned int> simplify(
+	std::vector<glm::vec3> const& vertices,
+	std::vector<unsigned int> const& indices,
+	std::size_t target_index_count,
+	float* out_error
+)
+{
+	std::size_t const vertex_count = vertices.size();
+	std::size_t const triangle_count = indices.size() / 3;
+
+	std::vector<unsigned int> tris(indices.begin(), indices.begin() + triangle_count * 3);
+	std::vector<bool> dead(triangle_count, false);
+	std::vector<quadric> quadrics(vertex_count);
+	std::vector<std::vector<unsigned int> > vertex_tris(vertex_count);
+	std::vector<bool> locked(vertex_count, false);
+	std::vector<unsigned int> stamps(vertex_count, 0);
+
+	// Accumulate plane quadrics and triangle adjacency. The quadrics are not
+	// area weighted so that the error stays a squared distance.
+	std::unordered_map<std::uint64_t, int> edge_use;
+	edge_use.reserve(triangle_count * 3);
+
+	for (std::size_t t = 0; t < triangle_count; ++t)
+	{
+		unsigned int const* tri = &tris[t * 3];
+		glm::vec3 const& p0 = vertices[tri[0]];
+		glm::vec3 const& p1 = vertices[tri[1]];
+		glm::vec3 const& p2 = vertices[tri[2]];
+
+		glm::vec3 n = glm::cross(p1 - p0, p2 - p0);
+		float area2 = glm::length(n);
+		if (area2 > 0.0f)
+			n /= area2;
+
+		quadric q(n.x, n.y, n.z, -glm::dot(n, p0));
+
+		for (int k = 0; k < 3; ++k)
+		{
+			quadrics[tri[k]] += q;
+			vertex_tris[tri[k]].push_back(t);
+			++edge_use[edge_key(tri[k], tri[(k + 1) % 3])];
+		}
+	}
+
+	// Open borders, which include attribute seams once vertices are welded,
+	// must stay where they are or the mesh would tear.
+	for (auto const& e : edge_use)
+	{
+		if (e.second != 2)
+		{
+			locked[static_cast<unsigned int>(e.first >> 32)] = true;
+			locked[static_cast<unsigned int>(e.first & 0xFFFFFFFFu)] = true;
+		}
+	}
+
+	std::priority_queue<collapse, std::vector<collapse>, std::greater<collapse> > heap;
+
+	auto push_edge = [&](unsigned int from, unsigned int to)
+	{
+		if (locked[from] || from == to)
+			return;
+
+		quadric q = quadrics[from];
+		q += quadrics[to];
+
+		collapse c;
+		c.cost = std::max(0.0, q.error(vertices[to]));
+		c.from = from;
+		c.to = to;
+		c.from_stamp = stamps[from];
+		c.to_stamp = stamps[to];
+		heap.push(c);
+	};
+
+	for (std::size_t t = 0; t < triangle_count; ++t)
+	{
+		for (int k = 0; k < 3; ++k)
+		{
+			unsigned int a = tris[t * 3 + k];
+			unsigned int b = tris[t * 3 + (k + 1) % 3];
+			push_edge(a, b);
+			push_edge(b, a);
+		}
+	}
+
+	std::size_t live_triangles = triangle_count;
+	double max_error = 0.0;
+
+	std::vector<unsigned int> neighbours_a, neighbours_b, common;
+
+	auto collect_neighbours = [&](unsigned int v, std::vector<unsigned int>& out)
+	{
+		out.clear();
+		for (unsigned int t : vertex_tris[v])
+			for (int k = 0; k < 3; ++k)
+				if (tris[t * 3 + k] != v)
+					out.push_back(tris[t * 3 + k]);
+		std::sort(out.begin(), out.end());
+		out.erase(std::unique(out.begin(), out.end()), out.end());
+	};
+
+	while (live_triangles * 3 > target_index_count && !heap.empty())
+	{
+		collapse c = heap.top();
+		heap.pop();
+
+		if (c.from_stamp != stamps[c.from] || c.to_stamp != stamps[c.to])
+			continue;
+
+		unsigned int a = c.from;
+		unsigned int b = c.to;
+
+		// Link condition: an interior edge shares exactly two neighbours,
+		// otherwise collapsing it would create non-manifold geometry.
+		collect_neighbours(a, neighbours_a);
+		collect_neighbours(b, neighbours_b);
+
+		if (!std::binary_search(neighbours_a.begin(), neighbours_a.end(), b))
+			continue;
+
+		common.clear();
+		std::set_intersection(
+			neighbours_a.begin(), neighbours_a.end(),
+			neighbours_b.begin(), neighbours_b.end(),
+			std::back_inserter(common)
+		);
+		if (common.size() != 2)
+			continue;
+
+		// Reject collapses that would flip or degenerate a triangle.
+		bool flips = false;
+		for (unsigned int t : vertex_tris[a])
+		{
+			unsigned int const* tri = &tris[t * 3];
+			if (tri[0] == b || tri[1] == b || tri[2] == b)
+				continue;
+
+			glm::vec3 p[3], q[3];
+			for (int k = 0; k < 3; ++k)
+			{
+				p[k] = vertices[tri[k]];
+				q[k] = tri[k] == a ? vertices[b] : p[k];
+			}
+
+			glm::vec3 n0 = glm::cross(p[1] - p[0], p[2] - p[0]);
+			glm::vec3 n1 = glm::cross(q[1] - q[0], q[2] - q[0]);
+			float l0 = glm::length(n0);
+			float l1 = glm::length(n1);
+
+			if (l1 <= 1e-12f || glm::dot(n0, n1) < 0.25f * l0 * l1)
+			{
+				flips = true;
+				break;
+			}
+		}
+		if (flips)
+			continue;
+
+		// Collapse a onto b.
+		for (unsigned int t : vertex_tris[a])
+		{
+			unsigned int* tri = &tris[t * 3];
+			if (tri[0] == b || tri[1] == b || tri[2] == b)
+			{
+				if (!dead[t])
+				{
+					dead[t] = true;
+					--live_triangles;
+				}
+				continue;
+			}
+
+			for (int k = 0; k < 3; ++k)
+				if (tri[k] == a)
+					tri[k] = b;
+			vertex_tris[b].push_back(t);
+		}
+
+		vertex_tris[a].clear();
+		auto& bt = vertex_tris[b];
+		bt.erase(
+			std::remove_if(bt.begin(), bt.end(), [&](unsigned int t) { return dead[t]; }),
+			bt.end()
+		);
+
+		for (unsigned int n : neighbours_a)
+			if (n != b)
+				vertex_tris[n].erase(
+					std::remove_if(
+						vertex_tris[n].begin(), vertex_tris[n].end(),
+						[&](unsigned int t) { return dead[t]; }
+					),
+					vertex_tris[n].end()
+				);
+
+		quadrics[b] += quadrics[a];
+		max_error = std::max(max_error, c.cost);
+
+		++stamps[a];
+		++stamps[b];
+
+		// Only the costs of edges touching b changed.
+		collect_neighbours(b, neighbours_b);
+		for (unsigned int n : neighbours_b)
+		{
+			push_edge(b, n);
+			push_edge(n, b);
+		}
+	}
+
+	std::vector<unsigned int> result;
+	result.reserve(live_triangles * 3);
+	for (std::size_t t = 0; t < triangle_count; ++t)
+		if (!dead[t])
+			result.insert(result.end(), &tris[t * 3], &tris[t * 3] + 3);
+
+	if (out_error != nullptr)
+		*out_error = static_cast<float>(std::sqrt(max_error));
+
+	return result;
+}
+
+
+//m=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-
+vertex_cache_statistics analyze_vertex_cache(
+	std::vector<unsigned int> const& indices,
+	std::size_t vertex_count,
+	unsigned int cache_size
+)
+{
+	// Time stamps emulate the FIFO: a vertex is cached while fewer than
+	// cache_size misses happened since it was loaded.
+	std::vector<std::size_t> loaded_at(vertex_count, 0);
+	std::size_t misses = 0;
+
+	for (unsigned int v : indices)
+	{
+		if (loaded_at[v] == 0 || misses - loaded_at[v] >= cache_size)
+		{
+			++misses;
+			loaded_at[v] = misses;
+		}
+	}
+
+	vertex_cache_statistics s;
+	s.acmr = indices.empty() ? 0.0f : float(misses) / float(indices.size() / 3);
+	s.atvr = vertex_count == 0 ? 0.0f : float(misses) / float(vertex_count);
+	return s;
+}
+
+
+//m=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-
+void optimize_vertex_cache(
+	std::vector<unsigned int>& indices,
+	std::size_t vertex_count,
+	unsigned int cache_size,
+	std::vector<unsigned int>* out_clusters
+)
+{
+	std::size_t const triangle_count = indices.size() / 3;
+	if (triangle_count == 0)
+		return;
+
+	// Vertex to triangle adjacency in compressed rows.
+	std::vector<unsigned int> live(vertex_count, 0);
+	for (std::size_t i = 0; i < triangle_count * 3; ++i)
+		++live[indices[i]];
+
+	std::vector<unsigned int> offsets(vertex_count + 1, 0);
+	for (std::size_t v = 0; v < vertex_count; ++v)
+		offsets[v + 1] = offsets[v] + live[v];
+
+	std::vector<unsigned int> adjacency(triangle_count * 3);
+	{
+		std::vector<unsigned int> fill(offsets.begin(), offsets.end() - 1);
+		for (std::size_t t = 0; t < triangle_count; ++t)
+			for (int k = 0; k < 3; ++k)
+				adjacency[fill[indices[t * 3 + k]]++] = t;
+	}
+
+	std::vector<unsigned int> cache_time(vertex_count, 0);
+	std::vector<bool> emitted(triangle_count, false);
+	std::vector<unsigned int> dead_end;
+	std::vector<unsigned int> candidates;
+	std::vector<unsigned int> result;
+	result.reserve(triangle_count * 3);
+
+	if (out_clusters != nullptr)
+	{
+		out_clusters->clear();
+		out_clusters->push_back(0);
+	}
+
+	unsigned int timestamp = cache_size + 1;
+	std::size_t cursor = 0;
+	long fanning = indices[0];
+
+	while (fanning >= 0)
+	{
+		candidates.clear();
+
+		unsigned int f = static_cast<unsigned int>(fanning);
+		for (unsigned int a = offsets[f]; a < offsets[f + 1]; ++a)
+		{
+			unsigned int t = adjacency[a];
+			if (emitted[t])
+				continue;
+
+			for (int k = 0; k < 3; ++k)
+			{
+				unsigned int v = indices[t * 3 + k];
+				result.push_back(v);
+				dead_end.push_back(v);
+				candidates.push_back(v);
+				--live[v];
+
+				if (timestamp - cache_time[v] > cache_size)
+					cache_time[v] = timestamp++;
+			}
+			emitted[t] = true;
+		}
+
+		// Prefer the candidate that stays in the cache longest while it
+		// still has triangles left.
+		long best = -1;
+		long best_priority = -1;
+		for (unsigned int v : candidates)
+		{
+			if (live[v] == 0)
+				continue;
+
+			long priority = 0;
+			if (timestamp - cache_time[v] + 2 * live[v] <= cache_size)
+				priority = timestamp - cache_time[v];
+
+			if (priority > best_priority)
+			{
+				best = v;
+				best_priority = priority;
+			}
+		}
+
+		if (best < 0)
+		{
+			// Dead end: back track through recently used vertices, then scan.
+			while (!dead_end.empty() && best < 0)
+			{
+				unsigned int d = dead_end.back();
+				dead_end.pop_back();
+				if (live[d] > 0)
+					best = d;
+			}
+
+			while (best < 0 && cursor < vertex_count)
+			{
+				if (live[cursor] > 0)
+					best = cursor;
+				++cursor;
+			}
+
+			if (best >= 0 && out_clusters != nullptr)
+				out_clusters->push_back(result.size() / 3);
+		}
+
+		fanning = best;
+	}
+
+	indices.swap(result);
+}
+
+
+//m=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-
+void optimize_overdraw(
+	std::vector<unsigned int>& indices,
+	std::vector<glm::vec3> const& vertices,
+	std::vector<unsigned int> const& clusters,
+	unsigned int cache_size,
+	float threshold
+)
+{
+	std::size_t const triangle_count = indices.size() / 3;
+	if (triangle_count == 0 || clusters.empty())
+		return;
+
+	std::vector<unsigned int> hard(clusters);
+	hard.push_back(triangle_count);
+
+	// Split the hard clusters where the running ACMR is already close to the
+	// cluster's; restarting there costs few extra cache misses.
+	std::vector<unsigned int> soft;
+	std::vector<std::size_t> loaded_at(vertices.size(), 0);
+	std::size_t misses = 0;
+
+	auto simulate = [&](std::size_t t) -> unsigned int
+	{
+		unsigned int m = 0;
+		for (int k = 0; k < 3; ++k)
+		{
+			unsigned int v = indices[t * 3 + k];
+			if (loaded_at[v] == 0 || misses - loaded_at[v] >= cache_size)
+			{
+				++misses;
+				++m;
+				loaded_at[v] = misses;
+			}
+		}
+		return m;
+	};
+
+	auto flush = [&]()
+	{
+		// Advancing past the cache size evicts everything.
+		misses += cache_size;
+	};
+
+	for (std::size_t c = 0; c + 1 < hard.size(); ++c)
+	{
+		std::size_t begin = hard[c];
+		std::size_t end = hard[c + 1];
+		if (begin >= end)
+			continue;
+
+		flush();
+		unsigned int cluster_misses = 0;
+		for (std::size_t t = begin; t < end; ++t)
+			cluster_misses += simulate(t);
+		float cluster_acmr = float(cluster_misses) / float(end - begin);
+
+		soft.push_back(begin);
+		flush();
+		unsigned int run_misses = 0;
+		std::size_t run_begin = begin;
+		for (std::size_t t = begin; t < end; ++t)
+		{
+			run_misses += simulate(t);
+
+			float run_acmr = float(run_misses) / float(t + 1 - run_begin);
+			if (t + 1 < end && t + 1 - run_begin >= 8 && run_acmr <= cluster_acmr * threshold)
+			{
+				soft.push_back(t + 1);
+				run_begin = t + 1;
+				run_misses = 0;
+				flush();
+			}
+		}
+	}
+	soft.push_back(triangle_count);
+
+	// Mesh centroid, area weighted.
+	glm::vec3 mesh_centroid(0.0f);
+	float mesh_area = 0.0f;
+	for (std::size_t t = 0; t < triangle_count; ++t)
+	{
+		glm::vec3 const& p0 = vertices[indices[t * 3 + 0]];
+		glm::vec3 const& p1 = vertices[indices[t * 3 + 1]];
+		glm::vec3 const& p2 = vertices[indices[t * 3 + 2]];
+		float area = glm::length(glm::cross(p1 - p0, p2 - p0));
+		mesh_centroid += (p0 + p1 + p2) * (area / 3.0f);
+		mesh_area += area;
+	}
+	if (mesh_area > 0.0f)
+		mesh_centroid /= mesh_area;
+
+	// Clusters facing away from the center are likely to occlude the rest.
+	std::size_t const cluster_count = soft.size() - 1;
+	std::vector<float> sort_key(cluster_count, 0.0f);
+	for (std::size_t c = 0; c < cluster_count; ++c)
+	{
+		glm::vec3 centroid(0.0f);
+		glm::vec3 normal(0.0f);
+		float area = 0.0f;
+
+		for (std::size_t t = soft[c]; t < soft[c + 1]; ++t)
+		{
+			glm::vec3 const& p0 = vertices[indices[t * 3 + 0]];
+			glm::vec3 const& p1 = vertices[indices[t * 3 + 1]];
+			glm::vec3 const& p2 = vertices[indices[t * 3 + 2]];
+			glm::vec3 n = glm::cross(p1 - p0, p2 - p0);
+			float a = glm::length(n);
+			centroid += (p0 + p1 + p2) * (a / 3.0f);
+			normal += n;
+			area += a;
+		}
+
+		if (area > 0.0f)
+			centroid /= area;
+		float l = glm::length(normal);
+		if (l > 0.0f)
+			normal /= l;
+
+		sort_key[c] = glm::dot(centroid - mesh_centroid, normal);
+	}
+
+	std::vector<unsigned int> order(cluster_count);
+	for (std::size_t c = 0; c < cluster_count; ++c)
+		order[c] = c;
+	std::stable_sort(
+		order.begin(), order.end(),
+		[&](unsigned int a, unsigned int b) { return sort_key[a] > sort_key[b]; }
+	);
+
+	std::vector<unsigned int> result;
+	result.reserve(indices.size());
+	for (unsigned int c : order)
+		result.insert(result.end(), indices.begin() + soft[c] * 3, indices.begin() + soft[c + 1] * 3);
+
+	indices.swap(result);
+}
+
+
+//m=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-
+void optimize_vertex_fetch(
+	std::vector<glm::vec3>& vertices,
+	std::vector<glm::vec2>& uvs,
+	std::vector<glm::vec3>& normals,
+	std::vector<unsigned int>& indices
+)
+{
+	unsigned int const unused = ~0u;
+	std::vector<unsigned int> remap(vertices.size(), unused);
+	unsigned int next = 0;
+
+	for (unsigned int& i : indices)
+	{
+		if (remap[i] == unused)
+			remap[i] = next++;
+		i = remap[i];
+	}
+
+	// Vertices no index refers to are dropped.
+	bool const has_uvs = uvs.size() == vertices.size();
+	bool const has_normals = normals.size() == vertices.size();
+
+	std::vector<glm::vec3> new_vertices(next);
+	std::vector<glm::vec2> new_uvs(has_uvs ? next : 0);
+	std::vector<glm::vec3> new_normals(has_normals ? next : 0);
+
+	for (std::size_t v = 0; v < vertices.size(); ++v)
+	{
+		if (remap[v] == unused)
+			continue;
+
+		new_vertices[remap[v]] = vertices[v];
+		if (has_uvs)
+			new_uvs[remap[v]] = uvs[v];
+		if (has_normals)
+			new_normals[remap[v]] = normals[v];
+	}
+
+	vertices.swap(new_vertices);
+	if (has_uvs)
+		uvs.swap(new_uvs);
+	if (has_normals)
+		normals.swap(new_normals);
+}
+
+mesh_optimization_report optimize_mesh(
+	std::vector<glm::vec3>& vertices,
+	std::vector<glm::vec2>& uvs,
+	std::vector<glm::vec3>& normals,
+	std::vector<unsigned int>& indices,
+	unsigned int cache_size
+)
+{
+	mesh_optimization_report report;
+	report.before = analyze_vertex_cache(indices, vertices.size(), cache_size);
+
+	std::vector<unsigned int> clusters;
+	optimize_vertex_cache(indices, vertices.size(), cache_size, &clusters);
+	optimize_overdraw(indices, vertices, clusters, cache_size);
+	optimize_vertex_fetch(vertices, uvs, normals, indices);
+
+	report.after = analyze_vertex_cache(indices, vertices.size(), cache_size);
+	return report;
+}
+
+} // namespace impl
+} // namespace gl
+} // namespace graphics
+} // namespace mrr
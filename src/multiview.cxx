@@ -0,0 +1,330 @@
+#include <mrr/graphics/multiview.hxx>
+#include <mrr/graphics/shader_variants.hxx>
+#include <mrr/graphics/state_cache.hxx>
+
+#include <algorithm>
+#include <typeinfo>
+
+namespace mrr {
+namespace graphics {
+namespace gl {
+
+namespace {
+
+std::size_t const max_views = 32;
+
+void set_viewport(view const& v)
+{
+	state::viewport(v.area.get_x(), v.area.get_y(), v.area.get_width(), v.area.get_height());
+}
+
+} // namespace
+
+
+multi_view_renderer::multi_view_renderer()
+	: instancing_(is_supported()),
+	  frame_(0),
+	  instanced_count_(0),
+	  replayed_count_(0)
+{
+}
+
+bool multi_view_renderer::is_supported()
+{
+	return (GLEW_VERSION_4_1 || GLEW_ARB_viewport_array)
+		&& GLEW_ARB_shader_viewport_layer_array;
+}
+
+void multi_view_renderer::set_instancing(bool enable)
+{
+	instancing_ = enable;
+}
+
+bool multi_view_renderer::get_instancing() const
+{
+	return instancing_;
+}
+
+std::size_t multi_view_renderer::get_object_count() const
+{
+	return objects_.size();
+}
+
+std::size_t multi_view_renderer::get_visible_count(std::size_t view) const
+{
+	return view < visible_counts_.size() ? visible_counts_[view] : 0;
+}
+
+std::size_t multi_view_renderer::get_instanced_count() const
+{
+	return instanced_count_;
+}
+
+std::size_t multi_view_renderer::get_replayed_count() const
+{
+	return replayed_count_;
+}
+
+void multi_view_renderer::collect(model const& m)
+{
+	// Components do not render their children, so neither do we.
+	if (auto c = dynamic_cast<component const*>(&m))
+	{
+		object o;
+		o.target = c;
+		o.world_bounds = c->get_world_bounds();
+		o.views = 0;
+		o.instanced = nullptr;
+		o.program = 0;
+		objects_.push_back(o);
+		return;
+	}
+
+	for (model* child : m.get_components())
+		collect(*child);
+}
+
+multi_view_renderer::program_uniforms& multi_view_renderer::get_program(shader_key key)
+{
+	auto it = programs_.find(key);
+	if (it != programs_.end())
+	{
+		if (it->second.shader.get_program_id() != it->second.program)
+			query_uniforms(it->second);
+		return it->second;
+	}
+
+	program_uniforms u;
+	u.shader = default_shader_variants().get(key);
+	query_uniforms(u);
+
+	return programs_.emplace(key, u).first->second;
+}
+
+void multi_view_renderer::query_uniforms(program_uniforms& u)
+{
+	u.program = u.shader.get_program_id();
+	u.view_matrices = u.shader.get_uniform_location("ViewMatrices");
+	u.instance_mvps = u.shader.get_uniform_location("InstanceMVPs");
+	u.instance_views = u.shader.get_uniform_location("InstanceViews");
+	u.model_matrix = u.shader.get_uniform_location("M");
+	u.ambient_light_colour = u.shader.get_uniform_location("AmbientLightColour");
+	u.point_source_locations = u.shader.get_uniform_location("LightPosition_worldspace");
+	u.point_source_colours = u.shader.get_uniform_location("LightColour");
+	u.point_source_powers = u.shader.get_uniform_location("LightPower");
+	u.shape_colour = u.shader.get_uniform_location("shape_colour");
+	u.specular_colour = u.shader.get_uniform_location("specular_colour");
+	u.texture_sampler = u.shader.get_uniform_location("texture_sampler");
+	u.position_offset = u.shader.get_uniform_location("PositionOffset");
+	u.position_scale = u.shader.get_uniform_location("PositionScale");
+	// A new program has none of the view matrices uploaded.
+	u.frame = 0;
+}
+
+void multi_view_renderer::render(model const& m, std::vector<view> const& views)
+{
+	std::size_t const count = std::min(views.size(), max_views);
+
+	++frame_;
+	objects_.clear();
+	visible_counts_.assign(count, 0);
+	instanced_count_ = 0;
+	replayed_count_ = 0;
+
+	if (count == 0)
+		return;
+
+	collect(m);
+
+	std::vector<frustum> frusta;
+	view_matrices_.clear();
+	view_projection_matrices_.clear();
+	for (std::size_t i = 0; i < count; ++i)
+	{
+		frusta.push_back(frustum(views[i].P * views[i].V));
+		view_matrices_.push_back(views[i].V);
+		view_projection_matrices_.push_back(views[i].P * views[i].V);
+	}
+
+	bool const instanced = instancing_ && count <= max_variant_views;
+
+	for (object& o : objects_)
+	{
+		for (std::size_t i = 0; i < count; ++i)
+			if (frusta[i].intersects(o.world_bounds))
+			{
+				o.views |= std::uint32_t(1) << i;
+				++visible_counts_[i];
+			}
+
+		component const& c = *o.target;
+		if (o.views != 0 && instanced && c.shader_variants_ && c.light_clusters_ == nullptr
+		    && typeid(c) == typeid(component))
+			o.instanced = &get_program(c.shader_key_ | shader_feature::multi_view);
+
+		o.program = o.instanced ? o.instanced->shader.get_program_id() : c.get_shader().get_program_id();
+	}
+
+	objects_.erase(
+		std::remove_if(objects_.begin(), objects_.end(),
+			[](object const& o) { return o.views == 0; }),
+		objects_.end()
+	);
+
+	// Instanced draws first, as the replayed ones reset the viewport array;
+	// then by program, so that consecutive draws share it.
+	std::stable_sort(objects_.begin(), objects_.end(), [](object const& a, object const& b) {
+		if ((a.instanced != nullptr) != (b.instanced != nullptr))
+			return a.instanced != nullptr;
+		return a.program < b.program;
+	});
+
+	GLint previous_viewport[4];
+	state::get_viewport(previous_viewport);
+
+	if (instanced)
+		for (std::size_t i = 0; i < count; ++i)
+			state::viewport_indexed(
+				i, views[i].area.get_x(), views[i].area.get_y(),
+				views[i].area.get_width(), views[i].area.get_height()
+			);
+
+	for (object const& o : objects_)
+	{
+		if (o.instanced)
+			render_instanced(o, views);
+		else
+			render_replayed(o, views);
+	}
+
+	state::viewport(previous_viewport[0], previous_viewport[1], previous_viewport[2], previous_viewport[3]);
+}
+
+std::size_t multi_view_renderer::select_lod(object const& o, std::vector<view> const& views)
+{
+	// The view the component is largest in selects its level of detail, so
+	// that its hysteresis follows a single view.
+	std::size_t largest = 0;
+	float largest_size = -1.0f;
+	for (std::size_t i = 0; i < views.size() && i < max_views; ++i)
+		if (o.views & (std::uint32_t(1) << i))
+		{
+			float size = o.target->projected_size(views[i].V, views[i].P);
+			if (size > largest_size)
+			{
+				largest = i;
+				largest_size = size;
+			}
+		}
+	return o.target->select_lod(views[largest].V, views[largest].P);
+}
+
+void multi_view_renderer::render_instanced(object const& o, std::vector<view> const& views)
+{
+	component const& c = *o.target;
+	program_uniforms& u = *o.instanced;
+	std::size_t const count = view_matrices_.size();
+
+	u.shader.use();
+	if (u.frame != frame_)
+	{
+		::glUniformMatrix4fv(u.view_matrices, count, GL_FALSE, &view_matrices_[0][0][0]);
+		u.frame = frame_;
+	}
+
+	// The MVPs are multiplied here, in the same order as
+	// component::apply_view_uniforms, so that both paths rasterize alike.
+	GLint instance_views[max_views];
+	::glm::mat4 instance_mvps[max_views];
+	GLsizei instances = 0;
+	for (std::size_t i = 0; i < count; ++i)
+		if (o.views & (std::uint32_t(1) << i))
+		{
+			instance_views[instances] = i;
+			instance_mvps[instances] = view_projection_matrices_[i] * c.get_model();
+			++instances;
+		}
+	::glUniform1iv(u.instance_views, instances, instance_views);
+	::glUniformMatrix4fv(u.instance_mvps, instances, GL_FALSE, &instance_mvps[0][0][0]);
+
+	::glUniformMatrix4fv(u.model_matrix, 1, GL_FALSE, &c.get_model()[0][0]);
+	::glUniform3fv(u.ambient_light_colour, 1, &c.get_ambient_light_colour()[0]);
+
+	std::size_t lights = std::min<std::size_t>(
+		c.get_point_source_locations().size(), get_light_count(c.shader_key_)
+	);
+	if (lights > 0)
+	{
+		::glUniform3fv(u.point_source_locations, lights, &c.get_point_source_locations()[0].x);
+		::glUniform3fv(u.point_source_colours, lights, &c.get_point_source_colours()[0].x);
+		::glUniform1fv(u.point_source_powers, lights, &c.get_point_source_powers()[0]);
+	}
+
+	// As in component::apply_uniforms: colours that were never set are left
+	// alone.
+	if (c.shape_colour_id_ != 0)
+		::glUniform3fv(u.shape_colour, 1, &c.shape_colour_[0]);
+	if (c.specular_colour_id_ != 0)
+		::glUniform3fv(u.specular_colour, 1, &c.specular_colour_[0]);
+
+	if (c.texture_.is_loaded())
+	{
+		c.texture_.bind();
+		::glUniform1i(u.texture_sampler, 0);
+	}
+
+	if (c.vertex_format_ == vertex_format::quantized)
+	{
+		::glUniform3fv(u.position_offset, 1, &c.position_offset_[0]);
+		::glUniform3fv(u.position_scale, 1, &c.position_scale_[0]);
+	}
+
+	c.bind_attributes();
+	c.draw(select_lod(o, views), instances);
+
+	++instanced_count_;
+}
+
+void multi_view_renderer::render_replayed(object const& o, std::vector<view> const& views)
+{
+	component const& c = *o.target;
+	std::size_t const count = view_matrices_.size();
+	++replayed_count_;
+
+	if (typeid(c) != typeid(component))
+	{
+		for (std::size_t i = 0; i < count; ++i)
+			if (o.views & (std::uint32_t(1) << i))
+			{
+				set_viewport(views[i]);
+				c.render(views[i].V, views[i].P);
+			}
+		return;
+	}
+
+	std::size_t lod = select_lod(o, views);
+
+	bool first = true;
+	for (std::size_t i = 0; i < count; ++i)
+	{
+		if (!(o.views & (std::uint32_t(1) << i)))
+			continue;
+
+		set_viewport(views[i]);
+		if (first)
+		{
+			c.apply_uniforms(views[i].V, views[i].P);
+			c.bind_attributes();
+			first = false;
+		}
+		else
+		{
+			c.apply_view_uniforms(views[i].V, views[i].P);
+		}
+		c.draw(lod);
+	}
+}
+
+} // namespace gl
+} // namespace graphics
+} // namespace mrr
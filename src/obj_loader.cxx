@@ -1,100 +1,456 @@
 #include <mrr/graphics/obj_loader.hxx>
+#include <mrr/graphics/tangent_space.hxx>
 
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
 #include <iostream>
-#include <fstream>
 
 namespace mrr {
 namespace graphics {
 namespace gl {
 namespace impl {
 
-bool load_wavefront(
-	std::string const& path,
-	std::vector<glm::vec3>& out_vertices,
-	std::vector<glm::vec2>& out_uvs,
-	std::vector<glm::vec3>& out_normals
+namespace {
+
+// Reads a file line by line through a fixed buffer, which only grows for
+// lines longer than it.
+class line_reader
+{
+public:
+	explicit line_reader(std::string const& path)
+		: file_(std::fopen(path.c_str(), "rb")), buffer_(1 << 20), begin_(0), end_(0), eof_(false)
+	{
+	}
+
+	line_reader(line_reader const&) = delete;
+	line_reader& operator =(line_reader const&) = delete;
+
+	~line_reader()
+	{
+		if (file_)
+			std::fclose(file_);
+	}
+
+	explicit operator bool() const
+	{
+		return file_ != nullptr;
+	}
+
+	// The next line, without its line break and null terminated, or null at
+	// the end of the file.
+	char* next()
+	{
+		for (;;)
+		{
+			char* line = &buffer_[begin_];
+			char* newline = static_cast<char*>(std::memchr(line, '\n', end_ - begin_));
+			if (newline)
+			{
+				*newline = '\0';
+				begin_ = newline + 1 - &buffer_[0];
+				return line;
+			}
+
+			if (eof_)
+			{
+				if (begin_ == end_)
+					return nullptr;
+				buffer_[end_] = '\0';
+				begin_ = end_;
+				return line;
+			}
+
+			fill();
+		}
+	}
+
+private:
+	void fill()
+	{
+		// Keep the partial line at the front and read behind it, leaving room
+		// for the terminator.
+		std::size_t partial = end_ - begin_;
+		std::memmove(&buffer_[0], &buffer_[begin_], partial);
+		begin_ = 0;
+		end_ = partial;
+
+		if (buffer_.size() - end_ < buffer_.size() / 2)
+			buffer_.resize(buffer_.size() * 2);
+
+		std::size_t read = std::fread(&buffer_[end_], 1, buffer_.size() - end_ - 1, file_);
+		end_ += read;
+		eof_ = read == 0;
+	}
+
+	std::FILE* file_;
+	std::vector<char> buffer_;
+	std::size_t begin_;
+	std::size_t end_;
+	bool eof_;
+};
+
+bool is_record(char const* line, char const* keyword)
+{
+	std::size_t length = std::strlen(keyword);
+	return std::strncmp(line, keyword, length) == 0 && (line[length] == ' ' || line[length] == '\t');
+}
+
+bool is_space(char c)
+{
+	return c == ' ' || c == '\t' || c == '\r';
+}
+
+char* skip_space(char* p)
+{
+	while (is_space(*p))
+		++p;
+	return p;
+}
+
+std::size_t const no_index = ~std::size_t(0);
+
+// Offsets of a face corner's attributes in the pools, no_index for those it
+// does not have.
+struct face_corner
+{
+	std::size_t position;
+	std::size_t uv;
+	std::size_t normal;
+};
+
+// Parses "v", "v/vt", "v//vn" or "v/vt/vn", advancing p past it. Absent
+// indices are 0.
+bool parse_face_vertex(char*& p, long index[3])
+{
+	index[1] = index[2] = 0;
+	for (int i = 0; i < 3; ++i)
+	{
+		if (i > 0)
+		{
+			if (*p != '/')
+				break;
+			++p;
+			if (i == 1 && *p == '/')
+				continue;
+		}
+
+		char* end;
+		index[i] = std::strtol(p, &end, 10);
+		if (end == p)
+			return false;
+		p = end;
+	}
+	return *p == '\0' || is_space(*p);
+}
+
+// Turns an index, 1-based or negative from the end of the size elements
+// read so far, into an offset. 0 is absent.
+bool resolve_index(long index, std::size_t size, std::size_t& out)
+{
+	if (index == 0)
+		out = no_index;
+	else if (index > 0 && std::size_t(index) <= size)
+		out = std::size_t(index) - 1;
+	else if (index < 0 && std::size_t(-index) <= size)
+		out = size - std::size_t(-index);
+	else
+		return false;
+	return true;
+}
+
+// Whether a face corner, not yet parsed, has a normal index: "v//vn" or
+// "v/vt/vn".
+bool has_normal(char const* token)
+{
+	int slashes = 0;
+	for (; *token != '\0' && !is_space(*token); ++token)
+		if (*token == '/' && ++slashes == 2)
+			return token[1] != '\0' && !is_space(token[1]);
+	return false;
+}
+
+glm::vec3 face_normal(glm::vec3 const& a, glm::vec3 const& b, glm::vec3 const& c)
+{
+	glm::vec3 n = glm::cross(b - a, c - a);
+	float length = glm::length(n);
+	return length > 1e-30f ? n / length : glm::vec3(0, 0, 1);
+}
+
+struct wavefront_pools
+{
+	std::vector<glm::vec3> positions;
+	std::vector<glm::vec2> uvs;
+	std::vector<glm::vec3> normals;
+};
+
+// Parses an OBJ file into pools, reserved from counts, and calls
+// triangle(corners, group) with the three corners of every triangle as the
+// faces are fan triangulated, and the smoothing group of their face.
+// Returning false from triangle stops the parse.
+template <typename Triangle>
+bool parse_wavefront(
+	std::string const& path, wavefront_counts const& counts, wavefront_pools& pools, Triangle const& triangle
 )
 {
-	std::clog << "Loading OBJ file " << path << "...\n";
+	line_reader reader(path);
+	if (!reader)
+	{
+		std::cerr << "ERROR: Cannot open OBJ file...\tpath: " << path << std::endl;
+		return false;
+	}
 
-	std::vector<unsigned int> vertix_indices, uv_indices, normal_indices;
-	std::vector<glm::vec3> temp_vertices;
-	std::vector<glm::vec2> temp_uvs;
-	std::vector<glm::vec3> temp_normals;
+	pools.positions.reserve(counts.positions);
+	pools.uvs.reserve(counts.uvs);
+	pools.normals.reserve(counts.normals);
 
-	std::ifstream obj_file(path);
+	// Faces before the first "s" record are smoothed together.
+	std::uint32_t group = 1;
+	std::vector<face_corner> corners;
 
-	std::string first_word;
-	while(obj_file >> first_word)
+	while (char* line = reader.next())
 	{
-		if (first_word ==  "v")
+		char* p = line;
+		if (is_record(line, "v"))
 		{
 			glm::vec3 vertex;
-			obj_file >> vertex.x >> vertex.y >> vertex.z;
-			temp_vertices.push_back(vertex);
+			vertex.x = std::strtof(p + 2, &p);
+			vertex.y = std::strtof(p, &p);
+			vertex.z = std::strtof(p, &p);
+			pools.positions.push_back(vertex);
 		}
-		else if (first_word == "vt")
+		else if (is_record(line, "vt"))
 		{
 			glm::vec2 uv;
-			obj_file >> uv.x >> uv.y;
+			uv.x = std::strtof(p + 3, &p);
+			uv.y = std::strtof(p, &p);
 
 			// Invert V coordinate since we will only use DDS texture, which are inverted.
 			// Remove if you want to use TGA or BMP loaders.
 			uv.y = -uv.y;
-			temp_uvs.push_back(uv);
+			pools.uvs.push_back(uv);
 		}
-		else if (first_word == "vn")
+		else if (is_record(line, "vn"))
 		{
 			glm::vec3 normal;
-			obj_file >> normal.x >> normal.y >> normal.z;
-			temp_normals.push_back(normal);
+			normal.x = std::strtof(p + 3, &p);
+			normal.y = std::strtof(p, &p);
+			normal.z = std::strtof(p, &p);
+			pools.normals.push_back(normal);
 		}
-		else if (first_word == "f")
+		else if (is_record(line, "s"))
 		{
-			char slash;
-			std::string vertex1, vertex2, vertex3;
-			unsigned int vertex_index[3], uv_index[3], normal_index[3];
+			p = skip_space(p + 2);
+			group = std::strncmp(p, "off", 3) == 0 ? 0 : std::uint32_t(std::strtoul(p, nullptr, 10));
+		}
+		else if (is_record(line, "f"))
+		{
+			corners.clear();
+			for (p = skip_space(p + 2); *p != '\0' && *p != '#'; p = skip_space(p))
+			{
+				long index[3];
+				if (!parse_face_vertex(p, index))
+				{
+					std::cerr << "ERROR: Cannot parse face...\tpath: " << path << std::endl;
+					return false;
+				}
 
-			obj_file >> vertex_index[0] >> slash >> uv_index[0] >> slash >> normal_index[0]
-			         >> vertex_index[1] >> slash >> uv_index[1] >> slash >> normal_index[1]
-			         >> vertex_index[2] >> slash >> uv_index[2] >> slash >> normal_index[2];
+				face_corner c;
+				if (!resolve_index(index[0], pools.positions.size(), c.position) || c.position == no_index
+				    || !resolve_index(index[1], pools.uvs.size(), c.uv)
+				    || !resolve_index(index[2], pools.normals.size(), c.normal))
+				{
+					std::cerr << "ERROR: Face refers to a missing vertex...\tpath: " << path << std::endl;
+					return false;
+				}
+				corners.push_back(c);
+			}
 
-			if (!obj_file)
+			if (corners.size() < 3)
 			{
-				std::cerr << "Parse error. Try exporting with other options\n";
+				std::cerr << "ERROR: Face with fewer than three vertices...\tpath: " << path << std::endl;
 				return false;
 			}
 
-			vertix_indices.push_back(vertex_index[0]);
-			vertix_indices.push_back(vertex_index[1]);
-			vertix_indices.push_back(vertex_index[2]);
-			uv_indices    .push_back(uv_index[0]);
-			uv_indices    .push_back(uv_index[1]);
-			uv_indices    .push_back(uv_index[2]);
-			normal_indices.push_back(normal_index[0]);
-			normal_indices.push_back(normal_index[1]);
-			normal_indices.push_back(normal_index[2]);
+			for (std::size_t i = 1; i + 1 < corners.size(); ++i)
+			{
+				face_corner const fan[3] = { corners[0], corners[i], corners[i + 1] };
+				if (!triangle(fan, group))
+					return false;
+			}
 		}
-		else
+	}
+	return true;
+}
+
+} // namespace
+
+
+wavefront_counts::wavefront_counts()
+	: positions(0), uvs(0), normals(0), triangles(0), triangles_without_normals(0)
+{
+}
+
+bool scan_wavefront(std::string const& path, wavefront_counts& counts)
+{
+	line_reader reader(path);
+	if (!reader)
+	{
+		std::cerr << "ERROR: Cannot open OBJ file...\tpath: " << path << std::endl;
+		return false;
+	}
+
+	counts = wavefront_counts();
+	while (char* line = reader.next())
+	{
+		if (is_record(line, "v"))
+			++counts.positions;
+		else if (is_record(line, "vt"))
+			++counts.uvs;
+		else if (is_record(line, "vn"))
+			++counts.normals;
+		else if (is_record(line, "f"))
 		{
-			std::string garbage;
-			std::getline(obj_file, garbage);
+			std::size_t corners = 0;
+			bool normals = true;
+			for (char* p = skip_space(line + 2); *p != '\0' && *p != '#'; p = skip_space(p))
+			{
+				++corners;
+				normals = normals && has_normal(p);
+				while (*p != '\0' && !is_space(*p))
+					++p;
+			}
+
+			if (corners >= 3)
+			{
+				counts.triangles += corners - 2;
+				if (!normals)
+					counts.triangles_without_normals += corners - 2;
+			}
 		}
 	}
+	return true;
+}
+
+bool stream_wavefront(
+	std::string const& path,
+	wavefront_counts const& counts,
+	std::size_t chunk_triangles,
+	wavefront_sink const& sink
+)
+{
+	std::size_t const chunk_size = 3 * (chunk_triangles > 0 ? chunk_triangles : 1);
+	std::vector<glm::vec3> vertices(chunk_size);
+	std::vector<glm::vec2> uvs(chunk_size);
+	std::vector<glm::vec3> normals(chunk_size);
+	std::size_t count = 0;
 
-	// For each vertex of each triangle
-	for(unsigned int i = 0; i < vertix_indices.size(); i++)
+	wavefront_pools pools;
+	bool parsed = parse_wavefront(path, counts, pools, [&](face_corner const* corners, std::uint32_t) {
+		bool flat = false;
+		glm::vec3 flat_normal(0.0f);
+		for (int i = 0; i < 3; ++i)
+		{
+			face_corner const& c = corners[i];
+			vertices[count + i] = pools.positions[c.position];
+			uvs[count + i] = c.uv != no_index ? pools.uvs[c.uv] : glm::vec2(0.0f);
+			if (c.normal != no_index)
+			{
+				normals[count + i] = pools.normals[c.normal];
+				continue;
+			}
+
+			if (!flat)
+				flat_normal = face_normal(
+					pools.positions[corners[0].position], pools.positions[corners[1].position],
+					pools.positions[corners[2].position]
+				);
+			flat = true;
+			normals[count + i] = flat_normal;
+		}
+		count += 3;
+
+		if (count == chunk_size)
+		{
+			if (!sink(vertices.data(), uvs.data(), normals.data(), count))
+				return false;
+			count = 0;
+		}
+		return true;
+	});
+
+	if (!parsed)
+		return false;
+	if (count > 0)
+		return sink(vertices.data(), uvs.data(), normals.data(), count);
+	return true;
+}
+
+bool load_wavefront(
+	std::string const& path,
+	std::vector<glm::vec3>& out_vertices,
+	std::vector<glm::vec2>& out_uvs,
+	std::vector<glm::vec3>& out_normals
+)
+{
+	std::clog << "Loading OBJ file " << path << "...\n";
+
+	wavefront_counts counts;
+	if (!scan_wavefront(path, counts))
+		return false;
+
+	std::size_t const first = out_vertices.size();
+	out_vertices.reserve(out_vertices.size() + 3 * counts.triangles);
+	out_uvs     .reserve(out_uvs.size() + 3 * counts.triangles);
+	out_normals .reserve(out_normals.size() + 3 * counts.triangles);
+
+	// What generate_normals needs, kept only if some corners lack normals:
+	// the position of every corner and the smoothing group of every triangle.
+	bool const generate = counts.triangles_without_normals > 0;
+	std::vector<unsigned int> indices;
+	std::vector<std::uint32_t> groups;
+	std::vector<bool> missing;
+	if (generate)
 	{
-		// Retrieve the attribute by index.
-		glm::vec3 vertex = temp_vertices[vertix_indices[i]-1];
-		glm::vec2 uv = temp_uvs[uv_indices[i]-1];
-		glm::vec3 normal = temp_normals[normal_indices[i]-1];
-
-		out_vertices.push_back(vertex);
-		out_uvs     .push_back(uv);
-		out_normals .push_back(normal);
+		indices.reserve(3 * counts.triangles);
+		groups.reserve(counts.triangles);
+		missing.reserve(3 * counts.triangles);
 	}
 
+	wavefront_pools pools;
+	bool parsed = parse_wavefront(path, counts, pools, [&](face_corner const* corners, std::uint32_t group) {
+		for (int i = 0; i < 3; ++i)
+		{
+			face_corner const& c = corners[i];
+			out_vertices.push_back(pools.positions[c.position]);
+			out_uvs     .push_back(c.uv != no_index ? pools.uvs[c.uv] : glm::vec2(0.0f));
+			out_normals .push_back(c.normal != no_index ? pools.normals[c.normal] : glm::vec3(0.0f));
+
+			if (generate)
+			{
+				indices.push_back(unsigned(c.position));
+				missing.push_back(c.normal == no_index);
+			}
+		}
+		if (generate)
+			groups.push_back(group);
+		return true;
+	});
+
+	if (!parsed)
+		return false;
+
+	if (generate)
+	{
+		std::vector<glm::vec3> generated;
+		generate_normals(pools.positions, indices, groups, generated);
+		for (std::size_t c = 0; c < generated.size(); ++c)
+			if (missing[c])
+				out_normals[first + c] = generated[c];
+
+		std::clog << "  Generated normals for " << counts.triangles_without_normals << " triangles\n";
+	}
 	return true;
 }
 
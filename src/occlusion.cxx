@@ -0,0 +1,630 @@
+#include <mrr/graphics/occlusion.hxx>
+#include <mrr/graphics/stats.hxx>
+#include <mrr/graphics/state_cache.hxx>
+#include <mrr/graphics/timing.hxx>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <iostream>
+#include <limits>
+#include <ostream>
+
+namespace mrr {
+namespace graphics {
+namespace gl {
+
+shader_handle occlusion_box_shader()
+{
+	return shader_handle(
+		"/usr/local/share/mrr/graphics/shaders/occlusion-box-vertex-shader.glsl",
+		"/usr/local/share/mrr/graphics/shaders/occlusion-box-fragment-shader.glsl"
+	);
+}
+
+
+namespace {
+
+// Triangles of the unit cube, drawn scaled to the bounds of a component for
+// its occlusion query.
+GLfloat const unit_cube[] = {
+	0,0,0, 1,1,0, 1,0,0,  0,0,0, 0,1,0, 1,1,0,
+	0,0,1, 1,0,1, 1,1,1,  0,0,1, 1,1,1, 0,1,1,
+	0,0,0, 0,0,1, 0,1,1,  0,0,0, 0,1,1, 0,1,0,
+	1,0,0, 1,1,0, 1,1,1,  1,0,0, 1,1,1, 1,0,1,
+	0,0,0, 1,0,0, 1,0,1,  0,0,0, 1,0,1, 0,0,1,
+	0,1,0, 0,1,1, 1,1,1,  0,1,0, 1,1,1, 1,1,0,
+};
+
+bool in_front_of_near_plane(::glm::vec4 const& clip)
+{
+	return clip.w > 0.0f && clip.z >= -clip.w;
+}
+
+// The normalized device coordinate bounds of b under mvp. False if b
+// crosses the near plane, where its projection is unbounded.
+bool project_box(aabb const& b, ::glm::mat4 const& mvp, ::glm::vec3& lower, ::glm::vec3& upper)
+{
+	float const inf = std::numeric_limits<float>::infinity();
+	lower = ::glm::vec3(inf, inf, inf);
+	upper = ::glm::vec3(-inf, -inf, -inf);
+
+	for (int i = 0; i < 8; ++i)
+	{
+		::glm::vec4 clip = mvp * ::glm::vec4(
+			i & 1 ? b.upper.x : b.lower.x,
+			i & 2 ? b.upper.y : b.lower.y,
+			i & 4 ? b.upper.z : b.lower.z,
+			1.0f
+		);
+		if (!in_front_of_near_plane(clip))
+			return false;
+
+		::glm::vec3 ndc = ::glm::vec3(clip) / clip.w;
+		for (int axis = 0; axis < 3; ++axis)
+		{
+			lower[axis] = std::min(lower[axis], ndc[axis]);
+			upper[axis] = std::max(upper[axis], ndc[axis]);
+		}
+	}
+	return true;
+}
+
+// Edge function a*x + b*y + c, positive inside a counter-clockwise triangle.
+struct edge_function
+{
+	edge_function(::glm::vec3 const& from, ::glm::vec3 const& to)
+		: a(from.y - to.y),
+		  b(to.x - from.x),
+		  c(-(a * from.x + b * from.y)),
+		  // Half the variation of the function over a texel.
+		  texel_spread(0.5f * (std::abs(a) + std::abs(b)))
+	{
+	}
+
+	float operator ()(float x, float y) const
+	{
+		return a * x + b * y + c;
+	}
+
+	float a, b, c, texel_spread;
+};
+
+// Rasterizes one triangle in window coordinates (x, y in texels, z depth).
+// Texels entirely inside take the farthest depth of the triangle over them.
+void rasterize_triangle(
+	std::vector<float>& depth, GLsizei width, GLsizei height,
+	::glm::vec3 v0, ::glm::vec3 v1, ::glm::vec3 v2
+)
+{
+	float area = (v1.x - v0.x) * (v2.y - v0.y) - (v1.y - v0.y) * (v2.x - v0.x);
+	if (std::abs(area) < 1e-6f)
+		return;
+	if (area < 0.0f)
+	{
+		std::swap(v1, v2);
+		area = -area;
+	}
+
+	float min_x = std::min(v0.x, std::min(v1.x, v2.x));
+	float max_x = std::max(v0.x, std::max(v1.x, v2.x));
+	float min_y = std::min(v0.y, std::min(v1.y, v2.y));
+	float max_y = std::max(v0.y, std::max(v1.y, v2.y));
+
+	GLsizei x0 = std::max(GLsizei(std::floor(min_x)), 0);
+	GLsizei x1 = std::min(GLsizei(std::ceil(max_x)), width);
+	GLsizei y0 = std::max(GLsizei(std::floor(min_y)), 0);
+	GLsizei y1 = std::min(GLsizei(std::ceil(max_y)), height);
+	if (x0 >= x1 || y0 >= y1)
+		return;
+
+	// The edge opposite each vertex weighs its depth.
+	edge_function const e0(v1, v2), e1(v2, v0), e2(v0, v1);
+	float const dz_dx = (e0.a * v0.z + e1.a * v1.z + e2.a * v2.z) / area;
+	float const dz_dy = (e0.b * v0.z + e1.b * v1.z + e2.b * v2.z) / area;
+	float const z0 = (e0.c * v0.z + e1.c * v1.z + e2.c * v2.z) / area;
+	float const z_spread = 0.5f * (std::abs(dz_dx) + std::abs(dz_dy));
+
+	for (GLsizei y = y0; y < y1; ++y)
+	{
+		float cy = y + 0.5f;
+		float* row = &depth[std::size_t(y) * width];
+		for (GLsizei x = x0; x < x1; ++x)
+		{
+			float cx = x + 0.5f;
+			if (e0(cx, cy) < e0.texel_spread || e1(cx, cy) < e1.texel_spread
+			    || e2(cx, cy) < e2.texel_spread)
+				continue;
+
+			float z = dz_dx * cx + dz_dy * cy + z0 + z_spread;
+			row[x] = std::min(row[x], z);
+		}
+	}
+}
+
+} // namespace
+
+
+//m=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-
+depth_pyramid::depth_pyramid(GLsizei width, GLsizei height)
+{
+	width = std::max(width, 1);
+	height = std::max(height, 1);
+	for (;;)
+	{
+		levels_.push_back(level{ width, height, std::vector<float>(std::size_t(width) * height, 1.0f) });
+		if (width == 1 && height == 1)
+			break;
+		width = (width + 1) / 2;
+		height = (height + 1) / 2;
+	}
+}
+
+void depth_pyramid::clear()
+{
+	for (level& l : levels_)
+		std::fill(l.depth.begin(), l.depth.end(), 1.0f);
+}
+
+std::size_t depth_pyramid::rasterize(
+	::glm::mat4 const& mvp,
+	::glm::vec3 const* positions, std::size_t position_count,
+	unsigned int const* indices, std::size_t index_count
+)
+{
+	level& target = levels_[0];
+
+	clip_.resize(position_count);
+	for (std::size_t i = 0; i < position_count; ++i)
+		clip_[i] = mvp * ::glm::vec4(positions[i], 1.0f);
+
+	auto window = [&](::glm::vec4 const& clip) {
+		::glm::vec3 ndc = ::glm::vec3(clip) / clip.w;
+		return ::glm::vec3(
+			(ndc.x * 0.5f + 0.5f) * target.width,
+			(ndc.y * 0.5f + 0.5f) * target.height,
+			ndc.z * 0.5f + 0.5f
+		);
+	};
+
+	std::size_t triangles = indices ? index_count / 3 : position_count / 3;
+	std::size_t rasterized = 0;
+	for (std::size_t t = 0; t < triangles; ++t)
+	{
+		std::size_t i0 = indices ? indices[3 * t] : 3 * t;
+		std::size_t i1 = indices ? indices[3 * t + 1] : 3 * t + 1;
+		std::size_t i2 = indices ? indices[3 * t + 2] : 3 * t + 2;
+		if (i0 >= position_count || i1 >= position_count || i2 >= position_count)
+			continue;
+
+		::glm::vec4 const& c0 = clip_[i0];
+		::glm::vec4 const& c1 = clip_[i1];
+		::glm::vec4 const& c2 = clip_[i2];
+		if (!in_front_of_near_plane(c0) || !in_front_of_near_plane(c1) || !in_front_of_near_plane(c2))
+			continue;
+
+		rasterize_triangle(target.depth, target.width, target.height, window(c0), window(c1), window(c2));
+		++rasterized;
+	}
+	return rasterized;
+}
+
+void depth_pyramid::build()
+{
+	for (std::size_t i = 1; i < levels_.size(); ++i)
+	{
+		level const& below = levels_[i - 1];
+		level& l = levels_[i];
+
+		for (GLsizei y = 0; y < l.height; ++y)
+		{
+			std::size_t row0 = std::size_t(2 * y) * below.width;
+			std::size_t row1 = std::size_t(std::min(2 * y + 1, below.height - 1)) * below.width;
+			for (GLsizei x = 0; x < l.width; ++x)
+			{
+				GLsizei bx0 = 2 * x;
+				GLsizei bx1 = std::min(2 * x + 1, below.width - 1);
+				l.depth[std::size_t(y) * l.width + x] = std::max(
+					std::max(below.depth[row0 + bx0], below.depth[row0 + bx1]),
+					std::max(below.depth[row1 + bx0], below.depth[row1 + bx1])
+				);
+			}
+		}
+	}
+}
+
+bool depth_pyramid::is_occluded(aabb const& b, ::glm::mat4 const& mvp) const
+{
+	::glm::vec3 lower, upper;
+	if (b.is_empty() || !project_box(b, mvp, lower, upper))
+		return false;
+
+	level const& base = levels_[0];
+	float x0 = (lower.x * 0.5f + 0.5f) * base.width;
+	float x1 = (upper.x * 0.5f + 0.5f) * base.width;
+	float y0 = (lower.y * 0.5f + 0.5f) * base.height;
+	float y1 = (upper.y * 0.5f + 0.5f) * base.height;
+	if (x1 < 0.0f || y1 < 0.0f || x0 > base.width || y0 > base.height)
+		return false;
+
+	x0 = std::max(x0, 0.0f);
+	y0 = std::max(y0, 0.0f);
+	x1 = std::min(x1, float(base.width));
+	y1 = std::min(y1, float(base.height));
+
+	// The lowest level at which the box spans at most 2x2 texels.
+	float size = std::max(x1 - x0, y1 - y0);
+	std::size_t i = 0;
+	while (i + 1 < levels_.size() && float(1 << i) < size)
+		++i;
+	level const& l = levels_[i];
+
+	GLsizei tx0 = GLsizei(x0) >> i;
+	GLsizei ty0 = GLsizei(y0) >> i;
+	GLsizei tx1 = std::min(GLsizei(x1) >> i, l.width - 1);
+	GLsizei ty1 = std::min(GLsizei(y1) >> i, l.height - 1);
+
+	float nearest = lower.z * 0.5f + 0.5f;
+	for (GLsizei y = ty0; y <= ty1; ++y)
+		for (GLsizei x = tx0; x <= tx1; ++x)
+			if (l.depth[std::size_t(y) * l.width + x] >= nearest)
+				return false;
+	return true;
+}
+
+std::size_t depth_pyramid::get_level_count() const
+{
+	return levels_.size();
+}
+
+GLsizei depth_pyramid::get_width(std::size_t level) const
+{
+	return levels_[level].width;
+}
+
+GLsizei depth_pyramid::get_height(std::size_t level) const
+{
+	return levels_[level].height;
+}
+
+float depth_pyramid::get_depth(GLsizei x, GLsizei y, std::size_t level) const
+{
+	return levels_[level].depth[std::size_t(y) * levels_[level].width + x];
+}
+
+
+//m=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-
+occlusion_stats::occlusion_stats()
+	: components(0),
+	  frustum_culled(0),
+	  occluded(0),
+	  occluders(0),
+	  occluder_triangles(0),
+	  cull_ms(0.0)
+{
+}
+
+::std::ostream& operator <<(::std::ostream& out, occlusion_stats const& s)
+{
+	return out
+		<< "components: " << s.components
+		<< ", frustum culled: " << s.frustum_culled
+		<< ", occluded: " << s.occluded
+		<< ", occluders: " << s.occluders
+		<< " (" << s.occluder_triangles << " triangles)"
+		<< ", cull time: " << s.cull_ms << " ms";
+}
+
+
+//m=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-
+occlusion_culler::object_state::object_state()
+	: visible(true),
+	  query(0),
+	  query_pending(false),
+	  frame(0),
+	  warned_released(false)
+{
+}
+
+occlusion_culler::occlusion_culler(occlusion_backend backend, GLsizei width, GLsizei height)
+	: backend_(backend),
+	  pyramid_(width, height),
+	  occluder_budget_(1 << 16),
+	  frame_(0),
+	  has_box_shader_(false),
+	  box_mvp_id_(0)
+{
+}
+
+occlusion_culler::~occlusion_culler()
+{
+	delete_queries();
+}
+
+void occlusion_culler::set_backend(occlusion_backend backend)
+{
+	if (backend == backend_)
+		return;
+
+	delete_queries();
+	states_.clear();
+	backend_ = backend;
+}
+
+occlusion_backend occlusion_culler::get_backend() const
+{
+	return backend_;
+}
+
+void occlusion_culler::set_box_shader(shader_handle const& s)
+{
+	box_shader_ = s;
+	box_mvp_id_ = box_shader_.get_uniform_location("MVP");
+	has_box_shader_ = true;
+}
+
+void occlusion_culler::set_occluder_budget(std::size_t triangles)
+{
+	occluder_budget_ = triangles;
+}
+
+occlusion_stats const& occlusion_culler::get_stats() const
+{
+	return stats_;
+}
+
+depth_pyramid const& occlusion_culler::get_depth_pyramid() const
+{
+	return pyramid_;
+}
+
+void occlusion_culler::collect(model const& m, frustum const& view, ::glm::mat4 const& V)
+{
+	// Components do not render their children, so neither do we.
+	if (auto c = dynamic_cast<component const*>(&m))
+	{
+		++stats_.components;
+
+		object_state& state = states_[c];
+		state.frame = frame_;
+
+		if (!state.warned_released && backend_ == occlusion_backend::depth_pyramid
+		    && c->get_cpu_copy_policy() == cpu_copy_policy::release && c->get_vertex_count() > 0)
+		{
+			std::cerr << "WARNING: Cannot occlude with a component whose CPU copy of the mesh is released...\tpath: "
+			          << c->get_wavefront_file() << std::endl;
+			state.warned_released = true;
+		}
+
+		aabb world = c->get_world_bounds();
+		if (!view.intersects(world))
+		{
+			++stats_.frustum_culled;
+			state.visible = false;
+			state.query_pending = false;
+			return;
+		}
+
+		object o;
+		o.target = c;
+		o.state = &state;
+		o.distance = ::glm::length(::glm::vec3(V * ::glm::vec4(world.center(), 1.0f)));
+		objects_.push_back(o);
+		return;
+	}
+
+	for (model* child : m.get_components())
+		collect(*child, view, V);
+}
+
+void occlusion_culler::render(model const& m, ::glm::mat4 const& V, ::glm::mat4 const& P)
+{
+	auto start = std::chrono::steady_clock::now();
+
+	stats_ = occlusion_stats();
+	objects_.clear();
+	++frame_;
+
+	collect(m, frustum(P * V), V);
+
+	// Front to back, so that near occluders are drawn and rasterized first.
+	std::sort(objects_.begin(), objects_.end(), [](object const& a, object const& b) {
+		return a.distance < b.distance;
+	});
+
+	double collect_ms = impl::elapsed_ms(start);
+
+	switch (backend_)
+	{
+	case occlusion_backend::none:
+		for (object const& o : objects_)
+			o.target->render(V, P);
+		break;
+
+	case occlusion_backend::depth_pyramid:
+		render_depth_pyramid(V, P);
+		break;
+
+	case occlusion_backend::queries:
+		render_queries(V, P);
+		break;
+	}
+
+	// Forget components that have left the tree.
+	for (auto it = states_.begin(); it != states_.end(); )
+	{
+		if (it->second.frame == frame_)
+		{
+			++it;
+			continue;
+		}
+		if (it->second.query != 0)
+			::glDeleteQueries(1, &it->second.query);
+		it = states_.erase(it);
+	}
+
+	stats_.cull_ms += collect_ms;
+}
+
+void occlusion_culler::render_depth_pyramid(::glm::mat4 const& V, ::glm::mat4 const& P)
+{
+	auto start = std::chrono::steady_clock::now();
+	::glm::mat4 const VP = P * V;
+
+	pyramid_.clear();
+
+	std::size_t budget = occluder_budget_;
+	for (object const& o : objects_)
+	{
+		component const& c = *o.target;
+		std::vector<::glm::vec3> const& vertices = c.get_vertices();
+		std::vector<unsigned int> const& indices = c.get_indices(0);
+		if (!o.state->visible || vertices.empty() || c.get_drawing_mode() != GL_TRIANGLES)
+			continue;
+
+		std::size_t triangles = (indices.empty() ? vertices.size() : indices.size()) / 3;
+		if (triangles > budget)
+			continue;
+		budget -= triangles;
+
+		stats_.occluder_triangles += pyramid_.rasterize(
+			VP * c.get_model(), vertices.data(), vertices.size(),
+			indices.empty() ? nullptr : indices.data(), indices.size()
+		);
+		++stats_.occluders;
+	}
+
+	pyramid_.build();
+
+	// Occluders are tested too: those hidden by nearer ones stop occluding.
+	for (object const& o : objects_)
+	{
+		bool occluded = pyramid_.is_occluded(o.target->get_bounds(), VP * o.target->get_model());
+		o.state->visible = !occluded;
+		stats_.occluded += occluded;
+	}
+
+	stats_.cull_ms = impl::elapsed_ms(start);
+
+	for (object const& o : objects_)
+		if (o.state->visible)
+			o.target->render(V, P);
+}
+
+void occlusion_culler::render_queries(::glm::mat4 const& V, ::glm::mat4 const& P)
+{
+	::glm::mat4 const VP = P * V;
+	double cull_ms = 0.0;
+
+	for (object const& o : objects_)
+	{
+		auto start = std::chrono::steady_clock::now();
+		object_state& state = *o.state;
+
+		// Results not yet available are skipped rather than waited for; the
+		// component keeps its last known visibility.
+		if (state.query_pending)
+		{
+			GLuint available = 0;
+			::glGetQueryObjectuiv(state.query, GL_QUERY_RESULT_AVAILABLE, &available);
+			if (available)
+			{
+				GLuint passed = 0;
+				::glGetQueryObjectuiv(state.query, GL_QUERY_RESULT, &passed);
+				state.visible = passed != 0;
+				stats_.occluded += !state.visible;
+			}
+			state.query_pending = false;
+		}
+
+		if (state.query == 0)
+			::glGenQueries(1, &state.query);
+
+		// The near plane would clip the box of a component the camera is in.
+		::glm::vec3 lower, upper;
+		bool near = !project_box(o.target->get_bounds(), VP * o.target->get_model(), lower, upper);
+
+		if (state.visible || near)
+		{
+			cull_ms += impl::elapsed_ms(start);
+
+			// Queried for whether it is still visible next frame.
+			::glBeginQuery(GL_ANY_SAMPLES_PASSED, state.query);
+			o.target->render(V, P);
+			::glEndQuery(GL_ANY_SAMPLES_PASSED);
+		}
+		else
+		{
+			::glBeginQuery(GL_ANY_SAMPLES_PASSED, state.query);
+			draw_box(*o.target, VP);
+			::glEndQuery(GL_ANY_SAMPLES_PASSED);
+
+			cull_ms += impl::elapsed_ms(start);
+
+			::glBeginConditionalRender(state.query, GL_QUERY_NO_WAIT);
+			o.target->render(V, P);
+			::glEndConditionalRender();
+		}
+
+		state.query_pending = true;
+	}
+
+	stats_.cull_ms = cull_ms;
+}
+
+void occlusion_culler::draw_box(component const& c, ::glm::mat4 const& VP)
+{
+	if (!has_box_shader_)
+		set_box_shader(occlusion_box_shader());
+
+	if (!box_buffer_.is_created())
+	{
+		box_buffer_.create();
+		box_buffer_.set_data(GL_ARRAY_BUFFER, sizeof(unit_cube), unit_cube, GL_STATIC_DRAW);
+	}
+
+	// The unit cube scaled onto the bounds, kept from collapsing to a plane.
+	aabb const& b = c.get_bounds();
+	::glm::mat4 box(1.0f);
+	for (int axis = 0; axis < 3; ++axis)
+		box[axis][axis] = std::max(b.upper[axis] - b.lower[axis], 1e-4f);
+	box[3] = ::glm::vec4(b.lower, 1.0f);
+
+	::glm::mat4 mvp = VP * c.get_model() * box;
+
+	box_shader_.use();
+	::glUniformMatrix4fv(box_mvp_id_, 1, GL_FALSE, &mvp[0][0]);
+
+	bool cull_face = state::is_enabled(GL_CULL_FACE);
+	if (cull_face)
+		state::disable(GL_CULL_FACE);
+	::glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+	::glDepthMask(GL_FALSE);
+
+	state::set_vertex_attrib_arrays(1 << 0);
+	box_buffer_.bind(GL_ARRAY_BUFFER);
+	::glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 0, (void*)0);
+	::glDrawArrays(GL_TRIANGLES, 0, 36);
+
+	::glDepthMask(GL_TRUE);
+	::glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+	if (cull_face)
+		state::enable(GL_CULL_FACE);
+
+	++frame_stats().draw_calls;
+}
+
+void occlusion_culler::delete_queries()
+{
+	for (auto& entry : states_)
+		if (entry.second.query != 0)
+		{
+			::glDeleteQueries(1, &entry.second.query);
+			entry.second.query = 0;
+			entry.second.query_pending = false;
+		}
+}
+
+} // namespace gl
+} // namespace graphics
+} // namespace mrr
@@ -0,0 +1,220 @@
+#include <mrr/graphics/offscreen.hxx>
+#include <mrr/graphics/state_cache.hxx>
+#include <mrr/graphics/memory_accounting.hxx>
+
+#include <cstdio>
+#include <iostream>
+#include <limits>
+#include <utility>
+
+namespace mrr {
+namespace graphics {
+namespace gl {
+
+framebuffer::framebuffer(GLsizei width, GLsizei height)
+	: width_(width), height_(height), framebuffer_id_(0), colour_id_(0), depth_id_(0)
+{
+	::glGenRenderbuffers(1, &colour_id_);
+	::glBindRenderbuffer(GL_RENDERBUFFER, colour_id_);
+	::glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, width, height);
+
+	::glGenRenderbuffers(1, &depth_id_);
+	::glBindRenderbuffer(GL_RENDERBUFFER, depth_id_);
+	::glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, width, height);
+	::glBindRenderbuffer(GL_RENDERBUFFER, 0);
+
+	// Both formats take four bytes a pixel.
+	std::size_t bytes = std::size_t(width) * height * 4;
+	track_renderbuffer(colour_id_, bytes);
+	track_renderbuffer(depth_id_, bytes);
+
+	::glGenFramebuffers(1, &framebuffer_id_);
+	state::bind_framebuffer(GL_FRAMEBUFFER, framebuffer_id_);
+	::glFramebufferRenderbuffer(
+		GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, colour_id_
+	);
+	::glFramebufferRenderbuffer(
+		GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, depth_id_
+	);
+
+	if (!is_complete())
+		::std::cerr << "ERROR: Incomplete framebuffer of " << width << "x" << height << "\n";
+}
+
+framebuffer::~framebuffer()
+{
+	::glDeleteFramebuffers(1, &framebuffer_id_);
+	state::deleted_framebuffer(framebuffer_id_);
+	::glDeleteRenderbuffers(1, &depth_id_);
+	::glDeleteRenderbuffers(1, &colour_id_);
+	untrack_renderbuffer(depth_id_);
+	untrack_renderbuffer(colour_id_);
+}
+
+void framebuffer::bind() const
+{
+	state::bind_framebuffer(GL_FRAMEBUFFER, framebuffer_id_);
+	state::viewport(0, 0, width_, height_);
+}
+
+void framebuffer::bind_default()
+{
+	state::bind_framebuffer(GL_FRAMEBUFFER, 0);
+}
+
+bool framebuffer::is_complete() const
+{
+	state::bind_framebuffer(GL_FRAMEBUFFER, framebuffer_id_);
+	return ::glCheckFramebufferStatus(GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE;
+}
+
+GLsizei framebuffer::get_width() const
+{
+	return width_;
+}
+
+GLsizei framebuffer::get_height() const
+{
+	return height_;
+}
+
+
+//m=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-
+async_readback::async_readback(
+	GLsizei width, GLsizei height, consumer_type consumer, std::size_t buffer_count
+)
+	: width_(width), height_(height), consumer_(std::move(consumer)),
+	  slots_(buffer_count < 1 ? 1 : buffer_count), next_(0), pending_(0), frames_captured_(0)
+{
+	GLsizeiptr size = GLsizeiptr(width) * height * 4;
+	for (slot& s : slots_)
+	{
+		::glGenBuffers(1, &s.buffer_id);
+		state::bind_buffer(GL_PIXEL_PACK_BUFFER, s.buffer_id);
+		::glBufferData(GL_PIXEL_PACK_BUFFER, size, nullptr, GL_STREAM_READ);
+		track_buffer(s.buffer_id, memory_category::render_targets, std::size_t(size));
+		s.fence = 0;
+		s.frame = 0;
+	}
+	state::bind_buffer(GL_PIXEL_PACK_BUFFER, 0);
+}
+
+async_readback::~async_readback()
+{
+	for (slot& s : slots_)
+	{
+		if (s.fence)
+			::glDeleteSync(s.fence);
+		::glDeleteBuffers(1, &s.buffer_id);
+		state::deleted_buffer(s.buffer_id);
+		untrack_buffer(s.buffer_id);
+	}
+}
+
+void async_readback::capture()
+{
+	slot& s = slots_[next_];
+	if (s.fence)
+		finish(next_);
+
+	state::bind_buffer(GL_PIXEL_PACK_BUFFER, s.buffer_id);
+	::glPixelStorei(GL_PACK_ALIGNMENT, 1);
+	::glReadPixels(0, 0, width_, height_, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+	state::bind_buffer(GL_PIXEL_PACK_BUFFER, 0);
+
+	s.fence = ::glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+	s.frame = frames_captured_++;
+	++pending_;
+
+	// Make sure the copy is submitted now rather than when the ring wraps.
+	::glFlush();
+
+	next_ = (next_ + 1) % slots_.size();
+}
+
+void async_readback::flush()
+{
+	for (std::size_t i = 0; i < slots_.size(); ++i)
+	{
+		std::size_t index = (next_ + i) % slots_.size();
+		if (slots_[index].fence)
+			finish(index);
+	}
+}
+
+void async_readback::finish(std::size_t index)
+{
+	slot& s = slots_[index];
+
+	::glClientWaitSync(
+		s.fence, GL_SYNC_FLUSH_COMMANDS_BIT, std::numeric_limits<GLuint64>::max()
+	);
+	::glDeleteSync(s.fence);
+	s.fence = 0;
+	--pending_;
+
+	state::bind_buffer(GL_PIXEL_PACK_BUFFER, s.buffer_id);
+	void const* pixels = ::glMapBufferRange(
+		GL_PIXEL_PACK_BUFFER, 0, GLsizeiptr(width_) * height_ * 4, GL_MAP_READ_BIT
+	);
+	if (pixels)
+	{
+		if (consumer_)
+			consumer_(static_cast<unsigned char const*>(pixels), width_, height_, s.frame);
+		::glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+	}
+	else
+	{
+		::std::cerr << "ERROR: Could not map the read back pixels of frame " << s.frame << "\n";
+	}
+	state::bind_buffer(GL_PIXEL_PACK_BUFFER, 0);
+}
+
+std::size_t async_readback::get_pending() const
+{
+	return pending_;
+}
+
+std::size_t async_readback::get_frames_captured() const
+{
+	return frames_captured_;
+}
+
+
+//m=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-
+bool write_ppm(
+	::std::string const& path, unsigned char const* rgba, GLsizei width, GLsizei height
+)
+{
+	std::FILE* file = std::fopen(path.c_str(), "wb");
+	if (!file)
+	{
+		::std::cerr << "ERROR: Cannot open image for writing...\tpath: " << path << std::endl;
+		return false;
+	}
+
+	std::fprintf(file, "P6\n%d %d\n255\n", int(width), int(height));
+
+	std::vector<unsigned char> row(std::size_t(width) * 3);
+	for (GLsizei y = height; y-- > 0; )
+	{
+		unsigned char const* source = rgba + std::size_t(y) * width * 4;
+		for (GLsizei x = 0; x < width; ++x)
+		{
+			row[x * 3 + 0] = source[x * 4 + 0];
+			row[x * 3 + 1] = source[x * 4 + 1];
+			row[x * 3 + 2] = source[x * 4 + 2];
+		}
+		std::fwrite(row.data(), 1, row.size(), file);
+	}
+
+	bool ok = std::ferror(file) == 0;
+	ok = std::fclose(file) == 0 && ok;
+	if (!ok)
+		::std::cerr << "ERROR: Cannot write image...\tpath: " << path << std::endl;
+	return ok;
+}
+
+} // namespace gl
+} // namespace graphics
+} // namespace mrr
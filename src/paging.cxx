@@ -0,0 +1,709 @@
+#include <mrr/graphics/paging.hxx>
+#include <mrr/graphics/obj_loader.hxx>
+#include <mrr/graphics/stats.hxx>
+#include <mrr/graphics/state_cache.hxx>
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <limits>
+#include <ostream>
+
+namespace mrr {
+namespace graphics {
+namespace gl {
+
+namespace {
+
+// Pack file layout, in native byte order: a header, a table of chunks and
+// then the data of every chunk as arrays of positions, uvs and normals.
+std::uint32_t const pack_version = 1;
+
+struct pack_header
+{
+	char magic[4];
+	std::uint32_t version;
+	std::uint32_t chunk_count;
+	std::uint32_t reserved;
+};
+
+struct pack_chunk
+{
+	float lower[3];
+	float upper[3];
+	std::uint32_t vertex_count;
+	std::uint32_t reserved;
+	std::uint64_t offset;
+};
+
+static_assert(sizeof(pack_header) == 16, "pack_header must not be padded");
+static_assert(sizeof(pack_chunk) == 40, "pack_chunk must not be padded");
+
+struct pack_vertex
+{
+	glm::vec3 position;
+	glm::vec2 uv;
+	glm::vec3 normal;
+};
+
+std::size_t const vertex_size = sizeof(glm::vec3) + sizeof(glm::vec2) + sizeof(glm::vec3);
+
+// Vertices buffered per cell before they are spilled to its temporary file.
+std::size_t const spill_vertices = 1024;
+
+std::string cell_path(std::string const& pack_path, std::size_t cell)
+{
+	return pack_path + ".cell" + std::to_string(cell);
+}
+
+bool append_cell(std::string const& path, std::vector<pack_vertex>& vertices)
+{
+	std::FILE* file = std::fopen(path.c_str(), "ab");
+	if (!file)
+		return false;
+	bool ok = std::fwrite(vertices.data(), sizeof(pack_vertex), vertices.size(), file) == vertices.size();
+	ok = std::fclose(file) == 0 && ok;
+	vertices.clear();
+	return ok;
+}
+
+// Projected size of a sphere as a fraction of the viewport height, growing
+// without bound as the camera gets inside it.
+float projected_size(
+	::glm::vec3 const& center, float radius, ::glm::mat4 const& V, ::glm::mat4 const& P
+)
+{
+	float distance = ::glm::length(::glm::vec3(V * ::glm::vec4(center, 1.0f))) - radius;
+	return radius * P[1][1] / std::max(distance, 1e-3f);
+}
+
+// Chunks outside the view frustum are still loaded ahead of camera motion,
+// at this fraction of their priority.
+float const prefetch_priority = 0.25f;
+
+} // namespace
+
+
+//m=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-
+paged_mesh::paged_mesh()
+	: manager_(nullptr)
+{
+}
+
+paged_mesh::~paged_mesh()
+{
+	if (manager_ != nullptr)
+		manager_->remove(*this);
+}
+
+bool paged_mesh::build(
+	std::string const& obj_path, std::string const& pack_path, unsigned cells_per_axis
+)
+{
+	impl::wavefront_counts counts;
+	if (!impl::scan_wavefront(obj_path, counts))
+		return false;
+
+	std::size_t const chunk_triangles = 1 << 14;
+
+	aabb bounds;
+	bool streamed = impl::stream_wavefront(obj_path, counts, chunk_triangles,
+		[&](glm::vec3 const* vertices, glm::vec2 const*, glm::vec3 const*, std::size_t count) {
+			bounds.expand(compute_bounds(vertices, count));
+			return true;
+		}
+	);
+	if (!streamed)
+		return false;
+
+	std::size_t const cells = std::max(cells_per_axis, 1u);
+	std::size_t const cell_count = cells * cells * cells;
+	::glm::vec3 const extent = bounds.upper - bounds.lower;
+	::glm::vec3 const scale(
+		cells / std::max(extent.x, 1e-6f),
+		cells / std::max(extent.y, 1e-6f),
+		cells / std::max(extent.z, 1e-6f)
+	);
+
+	std::vector<std::vector<pack_vertex>> buffered(cell_count);
+	std::vector<std::size_t> cell_sizes(cell_count, 0);
+	bool spilled = true;
+
+	auto remove_cells = [&] {
+		for (std::size_t cell = 0; cell < cell_count; ++cell)
+			if (cell_sizes[cell] > 0)
+				std::remove(cell_path(pack_path, cell).c_str());
+	};
+
+	auto cell_of = [&](float value, float lower, float cell_scale) {
+		float i = (value - lower) * cell_scale;
+		return std::min(std::size_t(std::max(i, 0.0f)), cells - 1);
+	};
+
+	streamed = impl::stream_wavefront(obj_path, counts, chunk_triangles,
+		[&](glm::vec3 const* vertices, glm::vec2 const* uvs, glm::vec3 const* normals, std::size_t count) {
+			for (std::size_t i = 0; i < count; i += 3)
+			{
+				::glm::vec3 centroid = (vertices[i] + vertices[i + 1] + vertices[i + 2]) / 3.0f;
+				std::size_t cell
+					= (cell_of(centroid.z, bounds.lower.z, scale.z) * cells
+					   + cell_of(centroid.y, bounds.lower.y, scale.y)) * cells
+					  + cell_of(centroid.x, bounds.lower.x, scale.x);
+
+				std::vector<pack_vertex>& b = buffered[cell];
+				for (std::size_t v = i; v < i + 3; ++v)
+					b.push_back(pack_vertex{ vertices[v], uvs[v], normals[v] });
+				cell_sizes[cell] += 3;
+
+				if (b.size() >= spill_vertices && !append_cell(cell_path(pack_path, cell), b))
+					return spilled = false;
+			}
+			return true;
+		}
+	);
+
+	for (std::size_t cell = 0; cell < cell_count && streamed && spilled; ++cell)
+		if (!buffered[cell].empty())
+			spilled = append_cell(cell_path(pack_path, cell), buffered[cell]);
+	buffered.clear();
+
+	if (!streamed || !spilled)
+	{
+		std::cerr << "ERROR: Cannot split OBJ file into chunks...\tpath: " << obj_path << std::endl;
+		remove_cells();
+		return false;
+	}
+
+	std::vector<pack_chunk> table;
+	std::vector<std::size_t> table_cells;
+	for (std::size_t cell = 0; cell < cell_count; ++cell)
+		if (cell_sizes[cell] > 0)
+		{
+			table.push_back(pack_chunk());
+			table_cells.push_back(cell);
+		}
+
+	std::FILE* out = std::fopen(pack_path.c_str(), "wb");
+	if (!out)
+	{
+		std::cerr << "ERROR: Cannot open pack file for writing...\tpath: " << pack_path << std::endl;
+		remove_cells();
+		return false;
+	}
+
+	pack_header header;
+	std::memcpy(header.magic, "MRRP", 4);
+	header.version = pack_version;
+	header.chunk_count = table.size();
+	header.reserved = 0;
+
+	bool ok = std::fwrite(&header, sizeof header, 1, out) == 1;
+	std::uint64_t offset = sizeof header + table.size() * sizeof(pack_chunk);
+	std::fseek(out, offset, SEEK_SET);
+
+	// One cell in memory at a time, rearranged into attribute arrays.
+	std::vector<pack_vertex> vertices;
+	std::vector<unsigned char> data;
+	for (std::size_t i = 0; i < table.size() && ok; ++i)
+	{
+		std::size_t cell = table_cells[i];
+		std::string path = cell_path(pack_path, cell);
+
+		vertices.resize(cell_sizes[cell]);
+		std::FILE* in = std::fopen(path.c_str(), "rb");
+		ok = in && std::fread(vertices.data(), sizeof(pack_vertex), vertices.size(), in) == vertices.size();
+		if (in)
+			std::fclose(in);
+
+		aabb chunk_bounds;
+		std::size_t n = vertices.size();
+		data.resize(n * vertex_size);
+		glm::vec3* positions = reinterpret_cast<glm::vec3*>(data.data());
+		glm::vec2* chunk_uvs = reinterpret_cast<glm::vec2*>(positions + n);
+		glm::vec3* chunk_normals = reinterpret_cast<glm::vec3*>(chunk_uvs + n);
+		for (std::size_t v = 0; v < n; ++v)
+		{
+			positions[v] = vertices[v].position;
+			chunk_uvs[v] = vertices[v].uv;
+			chunk_normals[v] = vertices[v].normal;
+			chunk_bounds.expand(vertices[v].position);
+		}
+
+		pack_chunk& c = table[i];
+		for (int axis = 0; axis < 3; ++axis)
+		{
+			c.lower[axis] = chunk_bounds.lower[axis];
+			c.upper[axis] = chunk_bounds.upper[axis];
+		}
+		c.vertex_count = n;
+		c.reserved = 0;
+		c.offset = offset;
+		offset += data.size();
+
+		ok = ok && std::fwrite(data.data(), 1, data.size(), out) == data.size();
+	}
+
+	std::fseek(out, sizeof header, SEEK_SET);
+	ok = ok && std::fwrite(table.data(), sizeof(pack_chunk), table.size(), out) == table.size();
+	ok = std::fclose(out) == 0 && ok;
+	remove_cells();
+
+	if (!ok)
+	{
+		std::cerr << "ERROR: Cannot write pack file...\tpath: " << pack_path << std::endl;
+		std::remove(pack_path.c_str());
+		return false;
+	}
+
+	std::clog << "Wrote " << table.size() << " chunks of " << counts.triangles
+	          << " triangles to " << pack_path << '\n';
+	return true;
+}
+
+bool paged_mesh::open(std::string const& pack_path)
+{
+	if (manager_ != nullptr)
+		manager_->remove(*this);
+
+	mapped_file pack(pack_path);
+	pack_header header;
+	if (!pack || pack.size() < sizeof header)
+	{
+		std::cerr << "ERROR: Cannot open pack file...\tpath: " << pack_path << std::endl;
+		return false;
+	}
+
+	std::memcpy(&header, pack.data(), sizeof header);
+	if (std::memcmp(header.magic, "MRRP", 4) != 0 || header.version != pack_version
+	    || pack.size() < sizeof header + std::uint64_t(header.chunk_count) * sizeof(pack_chunk))
+	{
+		std::cerr << "ERROR: Not a pack file...\tpath: " << pack_path << std::endl;
+		return false;
+	}
+
+	std::vector<chunk> chunks(header.chunk_count);
+	aabb bounds;
+	std::size_t vertex_count = 0;
+	for (std::size_t i = 0; i < chunks.size(); ++i)
+	{
+		pack_chunk entry;
+		std::memcpy(&entry, pack.data() + sizeof header + i * sizeof entry, sizeof entry);
+
+		if (entry.offset > pack.size()
+		    || (pack.size() - entry.offset) / vertex_size < entry.vertex_count)
+		{
+			std::cerr << "ERROR: Truncated pack file...\tpath: " << pack_path << std::endl;
+			return false;
+		}
+
+		chunk& c = chunks[i];
+		c.bounds = aabb(
+			::glm::vec3(entry.lower[0], entry.lower[1], entry.lower[2]),
+			::glm::vec3(entry.upper[0], entry.upper[1], entry.upper[2])
+		);
+		c.offset = entry.offset;
+		c.vertex_count = entry.vertex_count;
+		c.state = chunk_state::absent;
+		c.priority = 0.0f;
+		c.visible = false;
+
+		bounds.expand(c.bounds);
+		vertex_count += c.vertex_count;
+	}
+
+	wavefront_file_ = pack_path;
+	pack_ = std::move(pack);
+	chunks_.swap(chunks);
+	bounds_ = bounds;
+	vertex_count_ = vertex_count;
+	va_size_ = vertex_count * sizeof(glm::vec3);
+	return true;
+}
+
+std::size_t paged_mesh::get_chunk_count() const
+{
+	return chunks_.size();
+}
+
+aabb const& paged_mesh::get_chunk_bounds(std::size_t chunk) const
+{
+	return chunks_[chunk].bounds;
+}
+
+std::size_t paged_mesh::get_chunk_size(std::size_t chunk) const
+{
+	return chunks_[chunk].vertex_count * vertex_size;
+}
+
+bool paged_mesh::is_resident(std::size_t chunk) const
+{
+	return chunks_[chunk].state == chunk_state::resident;
+}
+
+void paged_mesh::render(::glm::mat4 const& V, ::glm::mat4 const& P) const
+{
+	if (chunks_.empty())
+		return;
+
+	apply_uniforms(V, P);
+
+	// Planes of the model-view-projection matrix bound the view in model
+	// space, where the chunk bounds are.
+	frustum view(P * V * model_);
+	render_stats& stats = frame_stats();
+
+	state::set_vertex_attrib_arrays((1 << 0) | (1 << 1) | (1 << 2));
+
+	for (chunk const& c : chunks_)
+	{
+		if (c.state != chunk_state::resident || !view.intersects(c.bounds))
+			continue;
+
+		std::size_t n = c.vertex_count;
+		c.data.bind(GL_ARRAY_BUFFER);
+		::glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 0, (void*)0);
+		::glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 0, (void*)(n * sizeof(glm::vec3)));
+		::glVertexAttribPointer(2, 3, GL_FLOAT, GL_FALSE, 0, (void*)(n * (sizeof(glm::vec3) + sizeof(glm::vec2))));
+		::glDrawArrays(drawing_mode_, 0, n);
+
+		++stats.draw_calls;
+		stats.triangles_submitted += n / 3;
+		stats.triangles_full_detail += n / 3;
+	}
+}
+
+
+//m=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-
+residency_stats::residency_stats()
+	: chunks(0), visible_chunks(0), resident_chunks(0), resident_bytes(0),
+	  pending_loads(0), uploaded_bytes(0), missing_chunks(0),
+	  total_loads(0), total_evictions(0), total_stalled_frames(0),
+	  total_budget_stalls(0), total_cap_rejections(0)
+{
+}
+
+::std::ostream& operator <<(::std::ostream& out, residency_stats const& s)
+{
+	return out
+		<< "resident chunks: " << s.resident_chunks << "/" << s.chunks
+		<< " (" << s.resident_bytes / (1 << 20) << " MiB)"
+		<< ", visible: " << s.visible_chunks
+		<< ", missing: " << s.missing_chunks
+		<< ", pending: " << s.pending_loads
+		<< ", uploaded: " << s.uploaded_bytes / 1024 << " KiB"
+		<< "; loads: " << s.total_loads
+		<< ", evictions: " << s.total_evictions
+		<< ", stalled frames: " << s.total_stalled_frames
+		<< ", budget stalls: " << s.total_budget_stalls
+		<< ", cap rejections: " << s.total_cap_rejections;
+}
+
+
+//m=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-
+residency_manager::residency_manager(std::size_t memory_cap, std::size_t upload_budget)
+	: memory_cap_(memory_cap),
+	  upload_budget_(upload_budget),
+	  max_pending_loads_(8),
+	  stop_(false),
+	  thread_(&residency_manager::loader, this)
+{
+}
+
+residency_manager::~residency_manager()
+{
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		stop_ = true;
+	}
+	wake_.notify_all();
+	thread_.join();
+
+	while (!meshes_.empty())
+		remove(*meshes_.back());
+}
+
+void residency_manager::set_memory_cap(std::size_t bytes)
+{
+	memory_cap_ = bytes;
+}
+
+void residency_manager::set_upload_budget(std::size_t bytes_per_frame)
+{
+	upload_budget_ = bytes_per_frame;
+}
+
+void residency_manager::set_max_pending_loads(std::size_t count)
+{
+	max_pending_loads_ = std::max<std::size_t>(count, 1);
+}
+
+void residency_manager::add(paged_mesh& m)
+{
+	if (m.manager_ == this)
+		return;
+	if (m.manager_ != nullptr)
+		m.manager_->remove(m);
+
+	meshes_.push_back(&m);
+	m.manager_ = this;
+}
+
+void residency_manager::remove(paged_mesh& m)
+{
+	if (m.manager_ != this)
+		return;
+
+	{
+		// Wait for a read in progress, which may be from m.
+		std::lock_guard<std::mutex> reading(read_mutex_);
+		std::lock_guard<std::mutex> lock(mutex_);
+
+		requests_.erase(
+			std::remove_if(requests_.begin(), requests_.end(),
+				[&](chunk_ref const& r) { return r.mesh == &m; }),
+			requests_.end()
+		);
+		loaded_.erase(
+			std::remove_if(loaded_.begin(), loaded_.end(),
+				[&](load const& l) { return l.ref.mesh == &m; }),
+			loaded_.end()
+		);
+	}
+
+	for (std::size_t i = 0; i < m.chunks_.size(); ++i)
+	{
+		if (m.chunks_[i].state == paged_mesh::chunk_state::resident)
+			evict(chunk_ref{ &m, i });
+		m.chunks_[i].state = paged_mesh::chunk_state::absent;
+	}
+
+	meshes_.erase(std::find(meshes_.begin(), meshes_.end(), &m));
+	m.manager_ = nullptr;
+}
+
+void residency_manager::update(::glm::mat4 const& V, ::glm::mat4 const& P)
+{
+	prioritize(V, P);
+
+	// A lowered cap takes effect right away.
+	make_room(0, std::numeric_limits<float>::max());
+
+	upload_loads();
+	request_loads();
+
+	stats_.chunks = 0;
+	stats_.visible_chunks = 0;
+	stats_.resident_chunks = 0;
+	stats_.pending_loads = 0;
+	stats_.missing_chunks = 0;
+	for (paged_mesh* m : meshes_)
+		for (paged_mesh::chunk const& c : m->chunks_)
+		{
+			bool resident = c.state == paged_mesh::chunk_state::resident;
+			++stats_.chunks;
+			stats_.visible_chunks += c.visible;
+			stats_.resident_chunks += resident;
+			stats_.pending_loads += c.state == paged_mesh::chunk_state::requested
+				|| c.state == paged_mesh::chunk_state::loaded;
+			stats_.missing_chunks += c.visible && !resident;
+		}
+
+	if (stats_.missing_chunks > 0)
+		++stats_.total_stalled_frames;
+}
+
+residency_stats const& residency_manager::get_stats() const
+{
+	return stats_;
+}
+
+void residency_manager::prioritize(::glm::mat4 const& V, ::glm::mat4 const& P)
+{
+	for (paged_mesh* m : meshes_)
+	{
+		::glm::mat4 const& M = m->get_model();
+		frustum view(P * V * M);
+
+		for (paged_mesh::chunk& c : m->chunks_)
+		{
+			aabb world = c.bounds.transformed(M);
+			float size = projected_size(world.center(), world.radius(), V, P);
+
+			c.visible = view.intersects(c.bounds);
+			c.priority = c.visible ? size : size * prefetch_priority;
+		}
+	}
+}
+
+void residency_manager::request_loads()
+{
+	std::vector<chunk_ref> candidates;
+	float lowest_resident = std::numeric_limits<float>::max();
+	std::size_t pending = 0;
+
+	for (paged_mesh* m : meshes_)
+		for (std::size_t i = 0; i < m->chunks_.size(); ++i)
+		{
+			paged_mesh::chunk const& c = m->chunks_[i];
+			if (c.state == paged_mesh::chunk_state::absent)
+				candidates.push_back(chunk_ref{ m, i });
+			else if (c.state == paged_mesh::chunk_state::resident)
+				lowest_resident = std::min(lowest_resident, c.priority);
+			else
+				++pending;
+		}
+
+	auto priority = [](chunk_ref const& r) { return r.mesh->chunks_[r.chunk].priority; };
+	auto higher_priority = [&](chunk_ref const& a, chunk_ref const& b) {
+		return priority(a) > priority(b);
+	};
+
+	std::size_t slots = pending < max_pending_loads_ ? max_pending_loads_ - pending : 0;
+	if (slots < candidates.size())
+		std::partial_sort(candidates.begin(), candidates.begin() + slots, candidates.end(), higher_priority);
+	else
+		std::sort(candidates.begin(), candidates.end(), higher_priority);
+
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		for (std::size_t i = 0; i < std::min(slots, candidates.size()); ++i)
+		{
+			chunk_ref const& r = candidates[i];
+			paged_mesh::chunk& c = r.mesh->chunks_[r.chunk];
+
+			// A chunk that could not displace anything would only be dropped.
+			if (stats_.resident_bytes + r.mesh->get_chunk_size(r.chunk) > memory_cap_
+			    && c.priority <= lowest_resident)
+				break;
+
+			c.state = paged_mesh::chunk_state::requested;
+			requests_.push_back(r);
+		}
+
+		std::sort(requests_.begin(), requests_.end(), higher_priority);
+	}
+	wake_.notify_one();
+}
+
+void residency_manager::upload_loads()
+{
+	std::vector<load> ready;
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		ready.swap(loaded_);
+	}
+	for (load const& l : ready)
+		l.ref.mesh->chunks_[l.ref.chunk].state = paged_mesh::chunk_state::loaded;
+
+	std::sort(ready.begin(), ready.end(), [](load const& a, load const& b) {
+		return a.ref.mesh->chunks_[a.ref.chunk].priority > b.ref.mesh->chunks_[b.ref.chunk].priority;
+	});
+
+	std::vector<load> deferred;
+	std::size_t uploaded = 0;
+	for (load& l : ready)
+	{
+		paged_mesh::chunk& c = l.ref.mesh->chunks_[l.ref.chunk];
+		std::size_t bytes = l.data.size();
+
+		if (uploaded > 0 && uploaded + bytes > upload_budget_)
+		{
+			deferred.push_back(std::move(l));
+			continue;
+		}
+
+		if (!make_room(bytes, c.priority))
+		{
+			c.state = paged_mesh::chunk_state::absent;
+			++stats_.total_cap_rejections;
+			continue;
+		}
+
+		c.data.create();
+		c.data.set_data(GL_ARRAY_BUFFER, bytes, l.data.data(), GL_STATIC_DRAW, l.ref.mesh->get_wavefront_file());
+		c.state = paged_mesh::chunk_state::resident;
+
+		uploaded += bytes;
+		stats_.resident_bytes += bytes;
+		++stats_.total_loads;
+	}
+
+	stats_.uploaded_bytes = uploaded;
+	if (!deferred.empty())
+	{
+		++stats_.total_budget_stalls;
+
+		std::lock_guard<std::mutex> lock(mutex_);
+		for (load& l : deferred)
+			loaded_.push_back(std::move(l));
+	}
+}
+
+bool residency_manager::make_room(std::size_t bytes, float priority)
+{
+	if (bytes > memory_cap_)
+		return false;
+
+	while (stats_.resident_bytes + bytes > memory_cap_)
+	{
+		chunk_ref lowest = { nullptr, 0 };
+		float lowest_priority = priority;
+		for (paged_mesh* m : meshes_)
+			for (std::size_t i = 0; i < m->chunks_.size(); ++i)
+			{
+				paged_mesh::chunk const& c = m->chunks_[i];
+				if (c.state == paged_mesh::chunk_state::resident && c.priority < lowest_priority)
+				{
+					lowest = chunk_ref{ m, i };
+					lowest_priority = c.priority;
+				}
+			}
+
+		if (lowest.mesh == nullptr)
+			return false;
+		evict(lowest);
+	}
+	return true;
+}
+
+void residency_manager::evict(chunk_ref const& r)
+{
+	paged_mesh::chunk& c = r.mesh->chunks_[r.chunk];
+	c.data.destroy();
+	c.state = paged_mesh::chunk_state::absent;
+	stats_.resident_bytes -= r.mesh->get_chunk_size(r.chunk);
+	++stats_.total_evictions;
+}
+
+void residency_manager::loader()
+{
+	for (;;)
+	{
+		std::unique_lock<std::mutex> lock(mutex_);
+		wake_.wait(lock, [this] { return stop_ || !requests_.empty(); });
+		if (stop_)
+			return;
+		lock.unlock();
+
+		std::lock_guard<std::mutex> reading(read_mutex_);
+		lock.lock();
+		if (requests_.empty())
+			continue;
+		chunk_ref r = requests_.front();
+		requests_.pop_front();
+		lock.unlock();
+
+		// Copying out of the mapping is where the pages are read from disk.
+		paged_mesh::chunk const& c = r.mesh->chunks_[r.chunk];
+		unsigned char const* begin = r.mesh->pack_.data() + c.offset;
+		std::vector<unsigned char> data(begin, begin + r.mesh->get_chunk_size(r.chunk));
+
+		lock.lock();
+		loaded_.push_back(load{ r, std::move(data) });
+	}
+}
+
+} // namespace gl
+} // namespace graphics
+} // namespace mrr
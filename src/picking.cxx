@@ -0,0 +1,872 @@
+#include <mrr/graphics/picking.hxx>
+#include <mrr/graphics/parallel.hxx>
+#include <mrr/graphics/simd.hxx>
+
+#include <algorithm>
+#include <iostream>
+#include <mutex>
+#include <numeric>
+#include <thread>
+#include <utility>
+
+namespace mrr {
+namespace graphics {
+namespace gl {
+
+//m=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+// Packets of four rays, one a lane of float4 (simd.hxx).
+namespace impl {
+
+struct ray_packet
+{
+	float4 origin[3];
+	float4 direction[3];
+	float4 inverse_direction[3];
+	float4 t_min;
+	float4 t_max;
+	// Lanes whose direction is negative along each axis.
+	int negative[3];
+};
+
+} // namespace impl
+
+
+//m=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+namespace {
+
+std::size_t const bin_count = 16;
+// Below this depth splits follow the surface area heuristic, beyond it the
+// median, which bounds the depth of the traversal stacks.
+std::size_t const max_sah_depth = 48;
+std::size_t const stack_size = 128;
+// Nodes with more primitives than these bin, and build their second
+// subtree, on other threads.
+std::size_t const parallel_bin_threshold = 1 << 16;
+std::size_t const parallel_subtree_threshold = 1 << 13;
+
+float half_area(aabb const& b)
+{
+	if (b.is_empty())
+		return 0.0f;
+	::glm::vec3 e = b.upper - b.lower;
+	return e.x * e.y + e.y * e.z + e.z * e.x;
+}
+
+struct bin
+{
+	aabb bounds;
+	std::size_t count;
+};
+
+// Bounds of a primitive, moved rather than indexed as nodes are
+// partitioned, so that every pass over a node reads memory in order.
+struct primitive
+{
+	::glm::vec3 lower;
+	std::uint32_t id;
+	::glm::vec3 upper;
+	::glm::vec3 centroid;
+};
+
+struct bvh_builder
+{
+	std::vector<primitive>& primitives;
+	std::size_t leaf_size;
+
+	static std::size_t bin_of(primitive const& p, int axis, float lower, float scale)
+	{
+		float b = (p.centroid[axis] - lower) * scale;
+		return std::min<std::size_t>(bin_count - 1, std::size_t(std::max(b, 0.0f)));
+	}
+
+	// Bounds of the primitives and of their centroids in [begin, end).
+	void measure(std::size_t begin, std::size_t end, aabb& box, aabb& centroid_box) const
+	{
+		auto accumulate = [&](std::size_t first, std::size_t last, aabb& local_box, aabb& local_centroids) {
+			for (std::size_t i = first; i < last; ++i)
+			{
+				primitive const& p = primitives[i];
+				local_box.lower = ::glm::min(local_box.lower, p.lower);
+				local_box.upper = ::glm::max(local_box.upper, p.upper);
+				::glm::vec3 const& c = p.centroid;
+				local_centroids.lower = ::glm::min(local_centroids.lower, c);
+				local_centroids.upper = ::glm::max(local_centroids.upper, c);
+			}
+		};
+
+		if (end - begin <= parallel_bin_threshold)
+		{
+			accumulate(begin, end, box, centroid_box);
+			return;
+		}
+
+		std::mutex merge;
+		impl::parallel_for(end - begin, parallel_bin_threshold, [&](std::size_t b, std::size_t e) {
+			aabb local_box, local_centroids;
+			accumulate(begin + b, begin + e, local_box, local_centroids);
+
+			std::lock_guard<std::mutex> lock(merge);
+			box.expand(local_box);
+			centroid_box.expand(local_centroids);
+		});
+	}
+
+	void fill_bins(
+		std::size_t begin, std::size_t end, aabb const& centroid_box, bin (&bins)[3][bin_count]
+	) const
+	{
+		// Axes along which every centroid is the same are left empty.
+		float scale[3];
+		for (int axis = 0; axis < 3; ++axis)
+		{
+			float extent = centroid_box.upper[axis] - centroid_box.lower[axis];
+			scale[axis] = extent > 0.0f ? bin_count / extent : 0.0f;
+		}
+
+		auto fill = [&](std::size_t first, std::size_t last, bin (&target)[3][bin_count]) {
+			for (std::size_t i = first; i < last; ++i)
+			{
+				primitive const& p = primitives[i];
+				for (int axis = 0; axis < 3; ++axis)
+				{
+					if (scale[axis] == 0.0f)
+						continue;
+					bin& b = target[axis][bin_of(p, axis, centroid_box.lower[axis], scale[axis])];
+					b.bounds.lower = ::glm::min(b.bounds.lower, p.lower);
+					b.bounds.upper = ::glm::max(b.bounds.upper, p.upper);
+					++b.count;
+				}
+			}
+		};
+
+		if (end - begin <= parallel_bin_threshold)
+		{
+			fill(begin, end, bins);
+			return;
+		}
+
+		std::mutex merge;
+		impl::parallel_for(end - begin, parallel_bin_threshold, [&](std::size_t b, std::size_t e) {
+			bin local[3][bin_count] = {};
+			fill(begin + b, begin + e, local);
+
+			std::lock_guard<std::mutex> lock(merge);
+			for (int axis = 0; axis < 3; ++axis)
+				for (std::size_t i = 0; i < bin_count; ++i)
+				{
+					bins[axis][i].bounds.expand(local[axis][i].bounds);
+					bins[axis][i].count += local[axis][i].count;
+				}
+		});
+	}
+
+	void build(
+		std::size_t begin, std::size_t end, std::vector<impl::bvh_node>& nodes,
+		std::size_t depth, std::size_t spawn_depth
+	) const
+	{
+		aabb box, centroid_box;
+		measure(begin, end, box, centroid_box);
+
+		std::size_t const index = nodes.size();
+		nodes.push_back(impl::bvh_node{ box.lower, std::uint32_t(begin), box.upper, 0, 0 });
+
+		std::size_t const count = end - begin;
+		if (count <= 1)
+		{
+			nodes[index].count = std::uint16_t(count);
+			return;
+		}
+
+		// Cost of the best split, in primitives intersected times half area;
+		// traversing a node costs about as much as a primitive.
+		int best_axis = -1;
+		std::size_t best_bin = 0;
+		float best_cost = std::numeric_limits<float>::infinity();
+
+		if (depth < max_sah_depth)
+		{
+			bin bins[3][bin_count] = {};
+			fill_bins(begin, end, centroid_box, bins);
+
+			for (int axis = 0; axis < 3; ++axis)
+			{
+				if (centroid_box.upper[axis] - centroid_box.lower[axis] <= 0.0f)
+					continue;
+
+				// Cost of everything right of each boundary, then sweep left.
+				float right_cost[bin_count];
+				aabb right;
+				std::size_t right_count = 0;
+				for (std::size_t i = bin_count - 1; i > 0; --i)
+				{
+					right.expand(bins[axis][i].bounds);
+					right_count += bins[axis][i].count;
+					right_cost[i] = half_area(right) * right_count;
+				}
+
+				aabb left;
+				std::size_t left_count = 0;
+				for (std::size_t i = 1; i < bin_count; ++i)
+				{
+					left.expand(bins[axis][i - 1].bounds);
+					left_count += bins[axis][i - 1].count;
+					float cost = half_area(left) * left_count + right_cost[i];
+					if (left_count > 0 && left_count < count && cost < best_cost)
+					{
+						best_axis = axis;
+						best_bin = i;
+						best_cost = cost;
+					}
+				}
+			}
+		}
+
+		float const area = half_area(box);
+		if (count <= leaf_size && (best_axis < 0 || area + best_cost >= area * count))
+		{
+			nodes[index].count = std::uint16_t(count);
+			return;
+		}
+
+		primitive* const first = primitives.data() + begin;
+		primitive* const last = primitives.data() + end;
+		primitive* middle = first;
+		if (best_axis >= 0)
+		{
+			float lower = centroid_box.lower[best_axis];
+			float scale = bin_count / (centroid_box.upper[best_axis] - lower);
+			middle = std::partition(first, last, [&](primitive const& p) {
+				return bin_of(p, best_axis, lower, scale) < best_bin;
+			});
+		}
+
+		if (middle == first || middle == last)
+		{
+			// Identical centroids, or too deep: halve along the longest axis.
+			::glm::vec3 e = centroid_box.upper - centroid_box.lower;
+			best_axis = e.x >= e.y && e.x >= e.z ? 0 : (e.y >= e.z ? 1 : 2);
+			middle = first + count / 2;
+			int axis = best_axis;
+			std::nth_element(first, middle, last, [&](primitive const& a, primitive const& b) {
+				return a.centroid[axis] < b.centroid[axis];
+			});
+		}
+
+		nodes[index].axis = std::uint16_t(best_axis);
+		std::size_t const split = begin + (middle - first);
+
+		if (spawn_depth > 0 && count > parallel_subtree_threshold)
+		{
+			// The second subtree goes to its own vector, with offsets
+			// relative to it, and is appended once both are done.
+			std::vector<impl::bvh_node> second;
+			std::thread worker([&]() { build(split, end, second, depth + 1, spawn_depth - 1); });
+			build(begin, split, nodes, depth + 1, spawn_depth - 1);
+			worker.join();
+
+			std::uint32_t base = std::uint32_t(nodes.size());
+			nodes[index].offset = base;
+			for (impl::bvh_node& n : second)
+				if (n.count == 0)
+					n.offset += base;
+			nodes.insert(nodes.end(), second.begin(), second.end());
+		}
+		else
+		{
+			build(begin, split, nodes, depth + 1, spawn_depth);
+			nodes[index].offset = std::uint32_t(nodes.size());
+			build(split, end, nodes, depth + 1, spawn_depth);
+		}
+	}
+};
+
+// Slab test of a ray, with the inverse of its direction, against a box.
+bool intersects(
+	::glm::vec3 const& origin, ::glm::vec3 const& inverse_direction, float t_min, float t_max,
+	::glm::vec3 const& lower, ::glm::vec3 const& upper
+)
+{
+	for (int axis = 0; axis < 3; ++axis)
+	{
+		float t0 = (lower[axis] - origin[axis]) * inverse_direction[axis];
+		float t1 = (upper[axis] - origin[axis]) * inverse_direction[axis];
+		if (t0 > t1)
+			std::swap(t0, t1);
+		t_min = std::max(t_min, t0);
+		t_max = std::min(t_max, t1);
+	}
+	return t_min <= t_max;
+}
+
+int intersects(impl::ray_packet const& p, ::glm::vec3 const& lower, ::glm::vec3 const& upper)
+{
+	using namespace impl;
+
+	float4 t_near = p.t_min;
+	float4 t_far = p.t_max;
+	for (int axis = 0; axis < 3; ++axis)
+	{
+		float4 t0 = (splat(lower[axis]) - p.origin[axis]) * p.inverse_direction[axis];
+		float4 t1 = (splat(upper[axis]) - p.origin[axis]) * p.inverse_direction[axis];
+		t_near = max(t_near, min(t0, t1));
+		t_far = min(t_far, max(t0, t1));
+	}
+	return lanes(less_equal(t_near, t_far));
+}
+
+::glm::vec3 inverse(::glm::vec3 const& d)
+{
+	return ::glm::vec3(1.0f / d.x, 1.0f / d.y, 1.0f / d.z);
+}
+
+// Lanes of rays, as SoA packets of four.
+void load_packet(ray const* rays, std::size_t count, impl::ray_packet& p)
+{
+	float origin[3][4], direction[3][4], inverse_direction[3][4], t_min[4], t_max[4];
+	for (std::size_t lane = 0; lane < 4; ++lane)
+	{
+		// Empty lanes repeat the first ray; they are never active.
+		ray const& r = rays[lane < count ? lane : 0];
+		::glm::vec3 inv = inverse(r.direction);
+		for (int axis = 0; axis < 3; ++axis)
+		{
+			origin[axis][lane] = r.origin[axis];
+			direction[axis][lane] = r.direction[axis];
+			inverse_direction[axis][lane] = inv[axis];
+		}
+		t_min[lane] = r.t_min;
+		t_max[lane] = r.t_max;
+	}
+
+	for (int axis = 0; axis < 3; ++axis)
+	{
+		p.origin[axis] = impl::load(origin[axis]);
+		p.direction[axis] = impl::load(direction[axis]);
+		p.inverse_direction[axis] = impl::load(inverse_direction[axis]);
+		p.negative[axis] = impl::lanes(impl::less(p.direction[axis], impl::splat(0.0f)));
+	}
+	p.t_min = impl::load(t_min);
+	p.t_max = impl::load(t_max);
+}
+
+// The packet p in the space m maps to; t is unchanged.
+void transform_packet(impl::ray_packet const& p, ::glm::mat4 const& m, impl::ray_packet& r)
+{
+	using namespace impl;
+
+	for (int row = 0; row < 3; ++row)
+	{
+		r.origin[row] = splat(m[0][row]) * p.origin[0] + splat(m[1][row]) * p.origin[1]
+			+ splat(m[2][row]) * p.origin[2] + splat(m[3][row]);
+		r.direction[row] = splat(m[0][row]) * p.direction[0] + splat(m[1][row]) * p.direction[1]
+			+ splat(m[2][row]) * p.direction[2];
+		r.inverse_direction[row] = splat(1.0f) / r.direction[row];
+		r.negative[row] = lanes(less(r.direction[row], splat(0.0f)));
+	}
+	r.t_min = p.t_min;
+	r.t_max = p.t_max;
+}
+
+// Index of the lowest lane set.
+int first_lane(int lanes)
+{
+	int lane = 0;
+	while (!(lanes & (1 << lane)))
+		++lane;
+	return lane;
+}
+
+} // namespace
+
+
+//m=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+void impl::build_bvh(
+	std::vector<aabb> const& bounds, std::size_t leaf_size,
+	std::vector<bvh_node>& nodes, std::vector<std::uint32_t>& order
+)
+{
+	nodes.clear();
+	order.resize(bounds.size());
+	if (bounds.empty())
+		return;
+
+	std::vector<primitive> primitives(bounds.size());
+	parallel_for(bounds.size(), parallel_bin_threshold, [&](std::size_t begin, std::size_t end) {
+		for (std::size_t i = begin; i < end; ++i)
+			primitives[i] = primitive{ bounds[i].lower, std::uint32_t(i), bounds[i].upper, bounds[i].center() };
+	});
+
+	// Enough levels of subtrees on their own threads to occupy every worker.
+	std::size_t spawn_depth = 0;
+	while ((std::size_t(1) << spawn_depth) < worker_count())
+		++spawn_depth;
+
+	leaf_size = std::max<std::size_t>(1, std::min<std::size_t>(leaf_size, 0xffff));
+	nodes.reserve(2 * bounds.size() / leaf_size + 1);
+	bvh_builder builder{ primitives, leaf_size };
+	builder.build(0, bounds.size(), nodes, 0, spawn_depth);
+
+	for (std::size_t i = 0; i < primitives.size(); ++i)
+		order[i] = primitives[i].id;
+}
+
+
+//m=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+ray::ray()
+	: origin(0.0f, 0.0f, 0.0f),
+	  direction(0.0f, 0.0f, -1.0f),
+	  t_min(0.0f),
+	  t_max(std::numeric_limits<float>::infinity())
+{
+}
+
+ray::ray(::glm::vec3 const& origin, ::glm::vec3 const& direction, float t_min, float t_max)
+	: origin(origin),
+	  direction(direction),
+	  t_min(t_min),
+	  t_max(t_max)
+{
+}
+
+ray pick_ray(float x, float y, float width, float height, ::glm::mat4 const& V, ::glm::mat4 const& P)
+{
+	::glm::mat4 inverse_vp = ::glm::inverse(P * V);
+	float ndc_x = 2.0f * x / width - 1.0f;
+	float ndc_y = 1.0f - 2.0f * y / height;
+
+	::glm::vec4 near_point = inverse_vp * ::glm::vec4(ndc_x, ndc_y, -1.0f, 1.0f);
+	::glm::vec4 far_point = inverse_vp * ::glm::vec4(ndc_x, ndc_y, 1.0f, 1.0f);
+	::glm::vec3 origin = ::glm::vec3(near_point) / near_point.w;
+	return ray(origin, ::glm::vec3(far_point) / far_point.w - origin, 0.0f, 1.0f);
+}
+
+ray_hit::ray_hit()
+	: target(nullptr),
+	  triangle(0),
+	  t(std::numeric_limits<float>::infinity()),
+	  barycentrics(0.0f, 0.0f)
+{
+}
+
+
+//m=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+mesh_bvh::mesh_bvh()
+{
+}
+
+void mesh_bvh::build(std::vector<::glm::vec3> const& vertices, std::vector<unsigned int> const& indices)
+{
+	std::size_t const count = indices.empty() ? vertices.size() / 3 : indices.size() / 3;
+	auto vertex = [&](std::size_t t, std::size_t corner) -> ::glm::vec3 const& {
+		return vertices[indices.empty() ? 3 * t + corner : indices[3 * t + corner]];
+	};
+
+	std::vector<aabb> bounds(count);
+	impl::parallel_for(count, parallel_bin_threshold, [&](std::size_t begin, std::size_t end) {
+		for (std::size_t t = begin; t < end; ++t)
+		{
+			bounds[t].expand(vertex(t, 0));
+			bounds[t].expand(vertex(t, 1));
+			bounds[t].expand(vertex(t, 2));
+		}
+	});
+
+	impl::build_bvh(bounds, 4, nodes_, ids_);
+
+	triangles_.resize(count);
+	impl::parallel_for(count, parallel_bin_threshold, [&](std::size_t begin, std::size_t end) {
+		for (std::size_t i = begin; i < end; ++i)
+		{
+			::glm::vec3 const& v0 = vertex(ids_[i], 0);
+			triangles_[i] = triangle{ v0, vertex(ids_[i], 1) - v0, vertex(ids_[i], 2) - v0 };
+		}
+	});
+}
+
+std::size_t mesh_bvh::get_triangle_count() const
+{
+	return triangles_.size();
+}
+
+std::size_t mesh_bvh::get_node_count() const
+{
+	return nodes_.size();
+}
+
+std::size_t mesh_bvh::get_depth() const
+{
+	if (nodes_.empty())
+		return 0;
+
+	std::size_t depth = 0;
+	std::vector<std::pair<std::uint32_t, std::size_t>> stack(1, std::make_pair(0u, std::size_t(1)));
+	while (!stack.empty())
+	{
+		auto top = stack.back();
+		stack.pop_back();
+		depth = std::max(depth, top.second);
+		impl::bvh_node const& n = nodes_[top.first];
+		if (n.count == 0)
+		{
+			stack.push_back(std::make_pair(top.first + 1, top.second + 1));
+			stack.push_back(std::make_pair(n.offset, top.second + 1));
+		}
+	}
+	return depth;
+}
+
+bool mesh_bvh::intersect(ray const& r, ray_hit& hit) const
+{
+	if (nodes_.empty())
+		return false;
+
+	::glm::vec3 const inverse_direction = inverse(r.direction);
+	float t_max = std::min(r.t_max, hit.t);
+	bool found = false;
+
+	std::uint32_t stack[stack_size];
+	std::size_t size = 0;
+	stack[size++] = 0;
+	while (size > 0)
+	{
+		std::uint32_t index = stack[--size];
+		impl::bvh_node const& n = nodes_[index];
+		if (!intersects(r.origin, inverse_direction, r.t_min, t_max, n.lower, n.upper))
+			continue;
+
+		if (n.count == 0)
+		{
+			// Nearer child on top.
+			std::uint32_t nearer = index + 1, farther = n.offset;
+			if (r.direction[n.axis] < 0.0f)
+				std::swap(nearer, farther);
+			stack[size++] = farther;
+			stack[size++] = nearer;
+			continue;
+		}
+
+		for (std::uint32_t i = n.offset; i < n.offset + n.count; ++i)
+		{
+			// Moller-Trumbore, from both sides.
+			triangle const& tri = triangles_[i];
+			::glm::vec3 p = ::glm::cross(r.direction, tri.e2);
+			float det = ::glm::dot(tri.e1, p);
+			if (det == 0.0f)
+				continue;
+			float inverse_det = 1.0f / det;
+
+			::glm::vec3 s = r.origin - tri.v0;
+			float u = ::glm::dot(s, p) * inverse_det;
+			if (u < 0.0f || u > 1.0f)
+				continue;
+			::glm::vec3 q = ::glm::cross(s, tri.e1);
+			float v = ::glm::dot(r.direction, q) * inverse_det;
+			if (v < 0.0f || u + v > 1.0f)
+				continue;
+			float t = ::glm::dot(tri.e2, q) * inverse_det;
+			if (t < r.t_min || t >= t_max)
+				continue;
+
+			t_max = t;
+			hit.t = t;
+			hit.triangle = ids_[i];
+			hit.barycentrics = ::glm::vec2(u, v);
+			found = true;
+		}
+	}
+	return found;
+}
+
+int mesh_bvh::intersect(impl::ray_packet& p, int active, ray_hit* hits) const
+{
+	using namespace impl;
+
+	if (nodes_.empty())
+		return 0;
+
+	int found = 0;
+	std::uint32_t stack[stack_size];
+	std::size_t size = 0;
+	stack[size++] = 0;
+	while (size > 0)
+	{
+		std::uint32_t index = stack[--size];
+		bvh_node const& n = nodes_[index];
+		int live = intersects(p, n.lower, n.upper) & active;
+		if (!live)
+			continue;
+
+		if (n.count == 0)
+		{
+			// Ordered for the first live ray, as rays of a packet tend to
+			// point the same way.
+			std::uint32_t nearer = index + 1, farther = n.offset;
+			if (p.negative[n.axis] & (1 << first_lane(live)))
+				std::swap(nearer, farther);
+			stack[size++] = farther;
+			stack[size++] = nearer;
+			continue;
+		}
+
+		float4 const live_mask = mask(live);
+		for (std::uint32_t i = n.offset; i < n.offset + n.count; ++i)
+		{
+			triangle const& tri = triangles_[i];
+			float4 e1[3] = { splat(tri.e1.x), splat(tri.e1.y), splat(tri.e1.z) };
+			float4 e2[3] = { splat(tri.e2.x), splat(tri.e2.y), splat(tri.e2.z) };
+
+			float4 const* d = p.direction;
+			float4 pv[3] = {
+				d[1] * e2[2] - d[2] * e2[1],
+				d[2] * e2[0] - d[0] * e2[2],
+				d[0] * e2[1] - d[1] * e2[0]
+			};
+			float4 inverse_det = splat(1.0f) / (e1[0] * pv[0] + e1[1] * pv[1] + e1[2] * pv[2]);
+
+			float4 s[3] = {
+				p.origin[0] - splat(tri.v0.x),
+				p.origin[1] - splat(tri.v0.y),
+				p.origin[2] - splat(tri.v0.z)
+			};
+			float4 u = (s[0] * pv[0] + s[1] * pv[1] + s[2] * pv[2]) * inverse_det;
+			float4 q[3] = {
+				s[1] * e1[2] - s[2] * e1[1],
+				s[2] * e1[0] - s[0] * e1[2],
+				s[0] * e1[1] - s[1] * e1[0]
+			};
+			float4 v = (d[0] * q[0] + d[1] * q[1] + d[2] * q[2]) * inverse_det;
+			float4 t = (e2[0] * q[0] + e2[1] * q[1] + e2[2] * q[2]) * inverse_det;
+
+			// Comparisons with NaN, from parallel rays, fail.
+			float4 zero = splat(0.0f);
+			float4 hit = live_mask & less_equal(zero, u) & less_equal(zero, v)
+				& less_equal(u + v, splat(1.0f)) & less_equal(p.t_min, t) & less(t, p.t_max);
+			int hit_lanes = lanes(hit);
+			if (!hit_lanes)
+				continue;
+
+			p.t_max = select(hit, t, p.t_max);
+			float ts[4], us[4], vs[4];
+			store(ts, t);
+			store(us, u);
+			store(vs, v);
+			for (int lane = 0; lane < 4; ++lane)
+				if (hit_lanes & (1 << lane))
+				{
+					hits[lane].t = ts[lane];
+					hits[lane].triangle = ids_[i];
+					hits[lane].barycentrics = ::glm::vec2(us[lane], vs[lane]);
+				}
+			found |= hit_lanes;
+		}
+	}
+	return found;
+}
+
+
+//m=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+picker::picker()
+{
+}
+
+std::size_t picker::get_component_count() const
+{
+	return instances_.size();
+}
+
+mesh_bvh const* picker::get_mesh_bvh(component const& c) const
+{
+	auto it = meshes_.find(&c);
+	return it != meshes_.end() ? &it->second.bvh : nullptr;
+}
+
+void picker::collect(model const& m)
+{
+	if (auto c = dynamic_cast<component const*>(&m))
+	{
+		if (c->get_drawing_mode() == GL_TRIANGLES && !c->get_vertices().empty())
+			instances_.push_back(instance{ c, nullptr, ::glm::mat4(1.0f) });
+		else if (c->get_cpu_copy_policy() == cpu_copy_policy::release && c->get_vertex_count() > 0
+		         && released_.insert(c).second)
+			std::cerr << "WARNING: Cannot pick a component whose CPU copy of the mesh is released...\tpath: "
+			          << c->get_wavefront_file() << std::endl;
+		return;
+	}
+
+	for (model* child : m.get_components())
+		collect(*child);
+}
+
+void picker::update(model const& m)
+{
+	instances_.clear();
+	collect(m);
+
+	for (auto& entry : meshes_)
+		entry.second.used = false;
+
+	// Meshes seen for the first time, or since their storage changed.
+	std::vector<std::pair<component const*, cached_mesh*>> small, large;
+	for (instance& i : instances_)
+	{
+		cached_mesh& cached = meshes_[i.target];
+		i.bvh = &cached.bvh;
+		if (cached.used)
+			continue;
+		cached.used = true;
+
+		std::vector<::glm::vec3> const& vertices = i.target->get_vertices();
+		std::vector<unsigned int> const& indices = i.target->get_indices();
+		if (cached.vertices == vertices.data() && cached.vertex_count == vertices.size()
+		    && cached.indices == indices.data() && cached.index_count == indices.size())
+			continue;
+
+		cached.vertices = vertices.data();
+		cached.vertex_count = vertices.size();
+		cached.indices = indices.data();
+		cached.index_count = indices.size();
+
+		std::size_t triangles = indices.empty() ? vertices.size() / 3 : indices.size() / 3;
+		(triangles > parallel_subtree_threshold ? large : small).push_back(std::make_pair(i.target, &cached));
+	}
+
+	// Small meshes build one per thread; large ones one at a time, each on
+	// every thread.
+	impl::parallel_for(small.size(), 1, [&](std::size_t begin, std::size_t end) {
+		for (std::size_t i = begin; i < end; ++i)
+			small[i].second->bvh.build(small[i].first->get_vertices(), small[i].first->get_indices());
+	});
+	for (auto& pending : large)
+		pending.second->bvh.build(pending.first->get_vertices(), pending.first->get_indices());
+
+	for (auto it = meshes_.begin(); it != meshes_.end();)
+	{
+		if (it->second.used)
+			++it;
+		else
+			it = meshes_.erase(it);
+	}
+
+	std::vector<aabb> bounds(instances_.size());
+	for (std::size_t i = 0; i < instances_.size(); ++i)
+	{
+		bounds[i] = instances_[i].target->get_world_bounds();
+		instances_[i].world_to_model = ::glm::inverse(instances_[i].target->get_model());
+	}
+
+	std::vector<std::uint32_t> order;
+	impl::build_bvh(bounds, 2, nodes_, order);
+
+	std::vector<instance> ordered;
+	ordered.reserve(instances_.size());
+	for (std::uint32_t i : order)
+		ordered.push_back(instances_[i]);
+	instances_.swap(ordered);
+}
+
+ray_hit picker::intersect(ray const& r) const
+{
+	ray_hit hit;
+	hit.t = r.t_max;
+	if (nodes_.empty())
+		return hit;
+
+	::glm::vec3 const inverse_direction = inverse(r.direction);
+
+	std::uint32_t stack[stack_size];
+	std::size_t size = 0;
+	stack[size++] = 0;
+	while (size > 0)
+	{
+		std::uint32_t index = stack[--size];
+		impl::bvh_node const& n = nodes_[index];
+		if (!intersects(r.origin, inverse_direction, r.t_min, hit.t, n.lower, n.upper))
+			continue;
+
+		if (n.count == 0)
+		{
+			std::uint32_t nearer = index + 1, farther = n.offset;
+			if (r.direction[n.axis] < 0.0f)
+				std::swap(nearer, farther);
+			stack[size++] = farther;
+			stack[size++] = nearer;
+			continue;
+		}
+
+		for (std::uint32_t i = n.offset; i < n.offset + n.count; ++i)
+		{
+			instance const& in = instances_[i];
+			ray local(
+				::glm::vec3(in.world_to_model * ::glm::vec4(r.origin, 1.0f)),
+				::glm::vec3(in.world_to_model * ::glm::vec4(r.direction, 0.0f)),
+				r.t_min, hit.t
+			);
+			if (in.bvh->intersect(local, hit))
+				hit.target = in.target;
+		}
+	}
+	return hit;
+}
+
+void picker::intersect_packet(impl::ray_packet& p, int active, ray_hit* hits) const
+{
+	if (nodes_.empty())
+		return;
+
+	std::uint32_t stack[stack_size];
+	std::size_t size = 0;
+	stack[size++] = 0;
+	while (size > 0)
+	{
+		std::uint32_t index = stack[--size];
+		impl::bvh_node const& n = nodes_[index];
+		int live = intersects(p, n.lower, n.upper) & active;
+		if (!live)
+			continue;
+
+		if (n.count == 0)
+		{
+			std::uint32_t nearer = index + 1, farther = n.offset;
+			if (p.negative[n.axis] & (1 << first_lane(live)))
+				std::swap(nearer, farther);
+			stack[size++] = farther;
+			stack[size++] = nearer;
+			continue;
+		}
+
+		for (std::uint32_t i = n.offset; i < n.offset + n.count; ++i)
+		{
+			instance const& in = instances_[i];
+			impl::ray_packet local;
+			transform_packet(p, in.world_to_model, local);
+			int found = in.bvh->intersect(local, live, hits);
+			if (!found)
+				continue;
+
+			p.t_max = local.t_max;
+			for (int lane = 0; lane < 4; ++lane)
+				if (found & (1 << lane))
+					hits[lane].target = in.target;
+		}
+	}
+}
+
+void picker::intersect(ray const* rays, ray_hit* hits, std::size_t count) const
+{
+	for (std::size_t begin = 0; begin < count; begin += 4)
+	{
+		std::size_t lane_count = std::min<std::size_t>(4, count - begin);
+		impl::ray_packet p;
+		load_packet(rays + begin, lane_count, p);
+
+		ray_hit packet_hits[4];
+		intersect_packet(p, (1 << lane_count) - 1, packet_hits);
+		for (std::size_t lane = 0; lane < lane_count; ++lane)
+			hits[begin + lane] = packet_hits[lane];
+	}
+}
+
+} // namespace gl
+} // namespace graphics
+} // namespace mrr
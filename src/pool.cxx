@@ -0,0 +1,241 @@
+#include <mrr/graphics/pool.hxx>
+#include <mrr/graphics/stats.hxx>
+
+#include <algorithm>
+#include <cstdint>
+#include <mutex>
+
+namespace mrr {
+namespace graphics {
+namespace gl {
+
+namespace {
+
+std::size_t const smallest_block = 16;
+std::size_t const slab_bytes = std::size_t(1) << 16;
+int const size_classes = 13;
+
+struct size_class
+{
+	// Freed blocks, each holding the next.
+	void* free;
+	unsigned char* cursor;
+	unsigned char* end;
+};
+
+// Slabs are never returned, so the pools outlive every container using
+// them, static or not.
+struct pools
+{
+	std::mutex mutex;
+	size_class classes[size_classes];
+};
+
+pools& get_pools()
+{
+	static pools* p = new pools();
+	return *p;
+}
+
+int class_of(std::size_t bytes)
+{
+	int k = 0;
+	while ((smallest_block << k) < bytes)
+		++k;
+	return k;
+}
+
+} // namespace
+
+
+//m=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-
+namespace impl {
+
+void count_heap_allocation()
+{
+	++frame_stats().heap_allocations;
+}
+
+void* pool_allocate(std::size_t bytes)
+{
+	if (bytes > slab_bytes)
+	{
+		count_heap_allocation();
+		return ::operator new(bytes);
+	}
+
+	int k = class_of(bytes);
+	std::size_t const size = smallest_block << k;
+	pools& p = get_pools();
+	std::lock_guard<std::mutex> lock(p.mutex);
+	size_class& c = p.classes[k];
+
+	if (c.free != nullptr)
+	{
+		void* block = c.free;
+		c.free = *static_cast<void**>(block);
+		return block;
+	}
+
+	if (c.cursor == nullptr || std::size_t(c.end - c.cursor) < size)
+	{
+		count_heap_allocation();
+		c.cursor = static_cast<unsigned char*>(::operator new(slab_bytes));
+		c.end = c.cursor + slab_bytes;
+	}
+
+	void* block = c.cursor;
+	c.cursor += size;
+	return block;
+}
+
+void pool_deallocate(void* block, std::size_t bytes)
+{
+	if (block == nullptr)
+		return;
+
+	if (bytes > slab_bytes)
+	{
+		::operator delete(block);
+		return;
+	}
+
+	pools& p = get_pools();
+	std::lock_guard<std::mutex> lock(p.mutex);
+	size_class& c = p.classes[class_of(bytes)];
+	*static_cast<void**>(block) = c.free;
+	c.free = block;
+}
+
+} // namespace impl
+
+
+//m=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-
+child_list::const_iterator child_list::begin() const
+{
+	return models_.data();
+}
+
+child_list::const_iterator child_list::end() const
+{
+	return models_.data() + models_.size();
+}
+
+std::size_t child_list::size() const
+{
+	return models_.size();
+}
+
+bool child_list::empty() const
+{
+	return models_.empty();
+}
+
+bool child_list::contains(model* m) const
+{
+	return std::binary_search(models_.begin(), models_.end(), m);
+}
+
+bool child_list::insert(model* m)
+{
+	auto it = std::lower_bound(models_.begin(), models_.end(), m);
+	if (it != models_.end() && *it == m)
+		return false;
+	models_.insert(it, m);
+	return true;
+}
+
+bool child_list::erase(model* m)
+{
+	auto it = std::lower_bound(models_.begin(), models_.end(), m);
+	if (it == models_.end() || *it != m)
+		return false;
+	models_.erase(it);
+	return true;
+}
+
+
+//m=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-
+frame_arena::frame_arena(std::size_t block_size)
+	: block_size_(block_size),
+	  current_(0),
+	  offset_(0),
+	  used_(0),
+	  high_water_(0)
+{
+}
+
+void* frame_arena::allocate(std::size_t bytes, std::size_t alignment)
+{
+	for (;;)
+	{
+		if (current_ < blocks_.size())
+		{
+			block& b = blocks_[current_];
+			std::uintptr_t base = reinterpret_cast<std::uintptr_t>(b.data.get());
+			std::uintptr_t start = (base + offset_ + alignment - 1) & ~std::uintptr_t(alignment - 1);
+			if (start + bytes <= base + b.size)
+			{
+				offset_ = start + bytes - base;
+				used_ += bytes;
+				frame_stats().arena_bytes += bytes;
+				return reinterpret_cast<void*>(start);
+			}
+			if (current_ + 1 < blocks_.size())
+			{
+				++current_;
+				offset_ = 0;
+				continue;
+			}
+		}
+		add_block(std::max(block_size_, bytes + alignment));
+	}
+}
+
+void frame_arena::reset()
+{
+	high_water_ = std::max(high_water_, used_);
+
+	if (blocks_.size() > 1)
+	{
+		std::size_t total = 0;
+		for (block const& b : blocks_)
+			total += b.size;
+		blocks_.clear();
+		add_block(total);
+	}
+
+	current_ = 0;
+	offset_ = 0;
+	used_ = 0;
+}
+
+std::size_t frame_arena::get_used() const
+{
+	return used_;
+}
+
+std::size_t frame_arena::get_high_water() const
+{
+	return std::max(high_water_, used_);
+}
+
+std::size_t frame_arena::get_capacity() const
+{
+	std::size_t total = 0;
+	for (block const& b : blocks_)
+		total += b.size;
+	return total;
+}
+
+void frame_arena::add_block(std::size_t size)
+{
+	impl::count_heap_allocation();
+	blocks_.push_back(block{ std::unique_ptr<unsigned char[]>(new unsigned char[size]), size });
+	current_ = blocks_.size() - 1;
+	offset_ = 0;
+}
+
+} // namespace gl
+} // namespace graphics
+} // namespace mrr
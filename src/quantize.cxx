@@ -0,0 +1,265 @@
+#include <mrr/graphics/quantize.hxx>
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+namespace mrr {
+namespace graphics {
+namespace gl {
+namespace impl {
+
+namespace {
+
+inline float sign_not_zero(float v)
+{
+	return v >= 0.0f ? 1.0f : -1.0f;
+}
+
+inline std::int16_t to_snorm16(float v)
+{
+	v = std::max(-1.0f, std::min(1.0f, v));
+	return static_cast<std::int16_t>(std::lround(v * 32767.0f));
+}
+
+inline float from_snorm16(std::int16_t v)
+{
+	return std::max(static_cast<float>(v) / 32767.0f, -1.0f);
+}
+
+float const unorm16_max = 65535.0f;
+
+} // namespace
+
+
+//m=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-
+std::uint16_t float_to_half(float f)
+{
+	std::uint32_t bits;
+	std::memcpy(&bits, &f, sizeof(bits));
+
+	std::uint32_t sign = (bits >> 16) & 0x8000u;
+	std::uint32_t exponent = (bits >> 23) & 0xFFu;
+	std::uint32_t mantissa = bits & 0x7FFFFFu;
+
+	// NaN and infinity.
+	if (exponent == 0xFFu)
+		return sign | 0x7C00u | (mantissa ? 0x200u : 0u);
+
+	int half_exponent = static_cast<int>(exponent) - 127 + 15;
+
+	// Overflow saturates to infinity.
+	if (half_exponent >= 0x1F)
+		return sign | 0x7C00u;
+
+	// Subnormal half or zero.
+	if (half_exponent <= 0)
+	{
+		if (half_exponent < -10)
+			return sign;
+
+		mantissa |= 0x800000u;
+		int shift = 14 - half_exponent;
+		std::uint32_t half_mantissa = mantissa >> shift;
+		std::uint32_t remainder = mantissa & ((1u << shift) - 1u);
+		std::uint32_t halfway = 1u << (shift - 1);
+
+		if (remainder > halfway || (remainder == halfway && (half_mantissa & 1u)))
+			++half_mantissa;
+
+		return sign | half_mantissa;
+	}
+
+	// Normal number, round to nearest even. A carry out of the mantissa
+	// correctly bumps the exponent.
+	std::uint32_t half = sign | (half_exponent << 10) | (mantissa >> 13);
+	std::uint32_t remainder = mantissa & 0x1FFFu;
+
+	if (remainder > 0x1000u || (remainder == 0x1000u && (half & 1u)))
+		++half;
+
+	return static_cast<std::uint16_t>(half);
+}
+
+float half_to_float(std::uint16_t h)
+{
+	std::uint32_t sign = (h & 0x8000u) << 16;
+	std::uint32_t exponent = (h >> 10) & 0x1Fu;
+	std::uint32_t mantissa = h & 0x3FFu;
+	std::uint32_t bits;
+
+	if (exponent == 0)
+	{
+		if (mantissa == 0)
+		{
+			bits = sign;
+		}
+		else
+		{
+			// Renormalize the subnormal.
+			exponent = 127 - 15 + 1;
+			while ((mantissa & 0x400u) == 0)
+			{
+				mantissa <<= 1;
+				--exponent;
+			}
+			mantissa &= 0x3FFu;
+			bits = sign | (exponent << 23) | (mantissa << 13);
+		}
+	}
+	else if (exponent == 0x1F)
+	{
+		bits = sign | 0x7F800000u | (mantissa << 13);
+	}
+	else
+	{
+		bits = sign | ((exponent - 15 + 127) << 23) | (mantissa << 13);
+	}
+
+	float f;
+	std::memcpy(&f, &bits, sizeof(f));
+	return f;
+}
+
+
+//m=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-
+glm::vec2 encode_octahedral(glm::vec3 const& n)
+{
+	float l1 = std::fabs(n.x) + std::fabs(n.y) + std::fabs(n.z);
+	if (l1 == 0.0f)
+		return glm::vec2(0.0f, 0.0f);
+
+	glm::vec2 p(n.x / l1, n.y / l1);
+
+	// Fold the lower hemisphere over the diagonals.
+	if (n.z < 0.0f)
+	{
+		glm::vec2 folded(
+			(1.0f - std::fabs(p.y)) * sign_not_zero(p.x),
+			(1.0f - std::fabs(p.x)) * sign_not_zero(p.y)
+		);
+		p = folded;
+	}
+
+	return p;
+}
+
+glm::vec3 decode_octahedral(glm::vec2 const& e)
+{
+	glm::vec3 n(e.x, e.y, 1.0f - std::fabs(e.x) - std::fabs(e.y));
+	float t = std::max(-n.z, 0.0f);
+	n.x += n.x >= 0.0f ? -t : t;
+	n.y += n.y >= 0.0f ? -t : t;
+	return glm::normalize(n);
+}
+
+
+//m=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-
+void quantize_positions(
+	std::vector<glm::vec3> const& positions,
+	glm::vec3 const& offset,
+	glm::vec3 const& scale,
+	std::vector<quantized_position>& out
+)
+{
+	glm::vec3 inverse_scale(
+		scale.x > 0.0f ? 1.0f / scale.x : 0.0f,
+		scale.y > 0.0f ? 1.0f / scale.y : 0.0f,
+		scale.z > 0.0f ? 1.0f / scale.z : 0.0f
+	);
+
+	out.resize(positions.size());
+	for (std::size_t i = 0; i < positions.size(); ++i)
+	{
+		glm::vec3 t = glm::clamp((positions[i] - offset) * inverse_scale, 0.0f, 1.0f);
+		out[i].x = static_cast<std::uint16_t>(std::lround(t.x * unorm16_max));
+		out[i].y = static_cast<std::uint16_t>(std::lround(t.y * unorm16_max));
+		out[i].z = static_cast<std::uint16_t>(std::lround(t.z * unorm16_max));
+	}
+}
+
+void quantize_normals(
+	std::vector<glm::vec3> const& normals,
+	std::vector<quantized_normal>& out
+)
+{
+	out.resize(normals.size());
+	for (std::size_t i = 0; i < normals.size(); ++i)
+	{
+		glm::vec2 e = encode_octahedral(normals[i]);
+		out[i].x = to_snorm16(e.x);
+		out[i].y = to_snorm16(e.y);
+	}
+}
+
+void quantize_uvs(
+	std::vector<glm::vec2> const& uvs,
+	std::vector<quantized_uv>& out
+)
+{
+	out.resize(uvs.size());
+	for (std::size_t i = 0; i < uvs.size(); ++i)
+	{
+		out[i].u = float_to_half(uvs[i].x);
+		out[i].v = float_to_half(uvs[i].y);
+	}
+}
+
+quantization_error measure_quantization_error(
+	std::vector<glm::vec3> const& positions,
+	std::vector<glm::vec3> const& normals,
+	std::vector<glm::vec2> const& uvs,
+	glm::vec3 const& offset,
+	glm::vec3 const& scale,
+	std::vector<quantized_position> const& qpositions,
+	std::vector<quantized_normal> const& qnormals,
+	std::vector<quantized_uv> const& quvs
+)
+{
+	quantization_error e;
+	e.max_position = 0.0f;
+	e.mean_position = 0.0f;
+	e.max_normal_degrees = 0.0f;
+	e.max_uv = 0.0f;
+
+	double position_sum = 0.0;
+	for (std::size_t i = 0; i < positions.size() && i < qpositions.size(); ++i)
+	{
+		glm::vec3 decoded = offset + scale * glm::vec3(
+			qpositions[i].x / unorm16_max,
+			qpositions[i].y / unorm16_max,
+			qpositions[i].z / unorm16_max
+		);
+		float d = glm::length(decoded - positions[i]);
+		e.max_position = std::max(e.max_position, d);
+		position_sum += d;
+	}
+	if (!positions.empty())
+		e.mean_position = static_cast<float>(position_sum / positions.size());
+
+	for (std::size_t i = 0; i < normals.size() && i < qnormals.size(); ++i)
+	{
+		float l = glm::length(normals[i]);
+		if (l == 0.0f)
+			continue;
+
+		glm::vec3 decoded = decode_octahedral(
+			glm::vec2(from_snorm16(qnormals[i].x), from_snorm16(qnormals[i].y))
+		);
+		float c = glm::clamp(glm::dot(decoded, normals[i] / l), -1.0f, 1.0f);
+		e.max_normal_degrees = std::max(e.max_normal_degrees, std::acos(c) * 57.2957795f);
+	}
+
+	for (std::size_t i = 0; i < uvs.size() && i < quvs.size(); ++i)
+	{
+		e.max_uv = std::max(e.max_uv, std::fabs(half_to_float(quvs[i].u) - uvs[i].x));
+		e.max_uv = std::max(e.max_uv, std::fabs(half_to_float(quvs[i].v) - uvs[i].y));
+	}
+
+	return e;
+}
+
+} // namespace impl
+} // namespace gl
+} // namespace graphics
+} // namespace mrr
@@ -0,0 +1,1316 @@
+#include <mrr/graphics/scene.hxx>
+#include <mrr/graphics/mapped_file.hxx>
+#include <mrr/graphics/shader.hxx>
+#include <mrr/graphics/timing.hxx>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <type_traits>
+#include <unordered_map>
+
+#include <sys/mman.h>
+#include <unistd.h>
+
+namespace mrr {
+namespace graphics {
+namespace gl {
+
+namespace {
+
+//m=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-
+// File format, in the byte order of the machine that wrote it:
+//
+//   header
+//   data       strings, GPU buffer contents, CPU mesh arrays, LOD indices,
+//              each 16 byte aligned
+//   tables     records of the types below, each 8 byte aligned
+//
+// Records refer to other records by index into their table, none for no
+// record, and to data by offset from the start of the file.
+
+char const file_magic[8] = { 'M', 'R', 'R', 'S', 'C', 'E', 'N', 'E' };
+std::uint32_t const file_version = 3;
+std::uint32_t const byte_order_mark = 0x01020304;
+std::uint32_t const none = 0xffffffff;
+
+struct table_ref
+{
+	std::uint64_t offset;
+	std::uint32_t count;
+	std::uint32_t record_size;
+};
+
+// Absent if both are 0.
+struct data_ref
+{
+	std::uint64_t offset;
+	std::uint64_t bytes;
+};
+
+struct file_header
+{
+	char magic[8];
+	std::uint32_t version;
+	std::uint32_t byte_order;
+	std::uint64_t file_size;
+	std::uint32_t root;
+	std::uint32_t reserved;
+
+	table_ref strings;
+	table_ref shaders;
+	table_ref nodes;
+	table_ref children;
+	table_ref lights;
+	table_ref thresholds;
+	table_ref meshes;
+	table_ref lods;
+	table_ref waypoints;
+	table_ref targets;
+};
+
+struct string_record
+{
+	std::uint64_t offset;
+	std::uint32_t length;
+	std::uint32_t reserved;
+};
+
+struct shader_record
+{
+	std::uint32_t vertex_file;
+	std::uint32_t fragment_file;
+	std::uint32_t defines;
+};
+
+enum node_kind : std::uint32_t
+{
+	model_node,
+	component_node
+};
+
+enum node_flags : std::uint32_t
+{
+	colour_set = 1,
+	specular_colour_set = 2,
+	shader_variants = 4,
+	cpu_copy_released = 8
+};
+
+struct node_record
+{
+	std::uint32_t kind;
+	std::uint32_t shader;
+	std::uint32_t first_child;
+	std::uint32_t child_count;
+	std::uint32_t first_light;
+	std::uint32_t light_count;
+	float ambient_light_colour[3];
+
+	// Components only.
+	std::uint32_t flags;
+	std::uint32_t mesh;
+	std::uint32_t texture;
+	std::uint32_t drawing_mode;
+	std::uint32_t first_threshold;
+	std::uint32_t threshold_count;
+	float lod_hysteresis;
+	float colour[3];
+	float specular_colour[3];
+	float heading[3];
+	float model[16];
+	float init_model[16];
+	float model_save[16];
+};
+
+struct light_record
+{
+	float location[3];
+	float colour[3];
+	float power;
+};
+
+enum mesh_buffer : std::size_t
+{
+	vertex_buffer,
+	colour_buffer,
+	uv_buffer,
+	normal_buffer,
+	buffer_count
+};
+
+enum mesh_array : std::size_t
+{
+	vertex_array_data,
+	uv_array_data,
+	normal_array_data,
+	tangent_array_data,
+	array_count
+};
+
+struct mesh_record
+{
+	std::uint32_t source;
+	std::uint32_t format;
+	std::uint64_t stream_chunk_triangles;
+	std::int32_t va_size;
+	std::int32_t vertex_count;
+	std::uint32_t first_lod;
+	std::uint32_t lod_count;
+	float bounds[6];
+	float position_offset[3];
+	float position_scale[3];
+	float quantization_error[4];
+
+	// The GPU buffers as they were, and the CPU copies kept for picking,
+	// levels of detail and format changes.
+	data_ref buffers[buffer_count];
+	data_ref arrays[array_count];
+};
+
+struct waypoint_record
+{
+	double radius;
+	float location[3];
+	std::uint32_t first_target;
+	std::uint32_t target_count;
+	std::uint32_t reserved;
+};
+
+struct target_record
+{
+	std::uint32_t node;
+	std::uint32_t action;
+};
+
+static_assert(std::is_trivially_copyable<node_record>::value, "records are copied as bytes");
+static_assert(std::is_trivially_copyable<mesh_record>::value, "records are copied as bytes");
+
+
+// Bytes per vertex of each buffer, by vertex format.
+std::size_t buffer_stride(mesh_buffer b, vertex_format format)
+{
+	bool const quantized = format == vertex_format::quantized;
+	switch (b)
+	{
+	case vertex_buffer: return quantized ? sizeof(impl::quantized_position) : sizeof(glm::vec3);
+	case colour_buffer: return sizeof(glm::vec3);
+	case uv_buffer:     return quantized ? sizeof(impl::quantized_uv) : sizeof(glm::vec2);
+	case normal_buffer: return quantized ? sizeof(impl::quantized_normal) : sizeof(glm::vec3);
+	default:            return 0;
+	}
+}
+
+std::size_t const array_stride[array_count] = {
+	sizeof(glm::vec3), sizeof(glm::vec2), sizeof(glm::vec3), sizeof(glm::vec4)
+};
+
+
+void copy_to(float* out, glm::vec3 const& v)
+{
+	std::memcpy(out, &v[0], sizeof(float) * 3);
+}
+
+void copy_to(float* out, glm::mat4 const& m)
+{
+	std::memcpy(out, &m[0][0], sizeof(float) * 16);
+}
+
+glm::vec3 read_vec3(float const* in)
+{
+	return glm::vec3(in[0], in[1], in[2]);
+}
+
+glm::mat4 read_mat4(float const* in)
+{
+	glm::mat4 m;
+	std::memcpy(&m[0][0], in, sizeof(float) * 16);
+	return m;
+}
+
+std::uint64_t fnv1a(unsigned char const* p, std::size_t n, std::uint64_t h = 14695981039346656037ull)
+{
+	for (std::size_t i = 0; i < n; ++i)
+		h = (h ^ p[i]) * 1099511628211ull;
+	return h;
+}
+
+
+// Action wrappers that carry their name in the std::function.
+struct named_action
+{
+	std::shared_ptr<std::pair<std::string, waypoint::action_type> const> entry;
+
+	void operator()(component& c) const
+	{
+		entry->second(c);
+	}
+};
+
+} // namespace
+
+
+//m=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-
+void scene_actions::add(::std::string const& name, waypoint::action_type const& action)
+{
+	actions_[name] = action;
+}
+
+waypoint::action_type scene_actions::get(::std::string const& name) const
+{
+	auto it = actions_.find(name);
+	if (it == actions_.end())
+		return waypoint::action_type();
+
+	named_action a;
+	a.entry = std::make_shared<std::pair<std::string, waypoint::action_type> const>(name, it->second);
+	return a;
+}
+
+::std::string const* scene_actions::name_of(waypoint::action_type const& action)
+{
+	named_action const* a = action.target<named_action>();
+	return a != nullptr ? &a->entry->first : nullptr;
+}
+
+
+//m=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-
+scene::scene()
+	: models_(new node_pool<model>()),
+	  components_(new node_pool<component>()),
+	  root_(nullptr)
+{
+}
+
+model* scene::get_root() const
+{
+	return root_;
+}
+
+::std::vector<waypoint>& scene::get_waypoints()
+{
+	return waypoints_;
+}
+
+::std::vector<waypoint> const& scene::get_waypoints() const
+{
+	return waypoints_;
+}
+
+::std::size_t scene::get_model_count() const
+{
+	return models_->size();
+}
+
+::std::size_t scene::get_component_count() const
+{
+	return components_->size();
+}
+
+void scene::swap(scene& other)
+{
+	models_.swap(other.models_);
+	components_.swap(other.components_);
+	std::swap(root_, other.root_);
+	waypoints_.swap(other.waypoints_);
+}
+
+
+//m=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-
+scene_save_report::scene_save_report()
+	: models(0),
+	  components(0),
+	  meshes(0),
+	  shared_meshes(0),
+	  waypoints(0),
+	  skipped_actions(0),
+	  bytes(0),
+	  save_ms(0.0)
+{
+}
+
+::std::ostream& operator <<(::std::ostream& out, scene_save_report const& r)
+{
+	return out
+		<< "models: " << r.models
+		<< ", components: " << r.components
+		<< ", meshes: " << r.meshes << " (" << r.shared_meshes << " shared)"
+		<< ", waypoints: " << r.waypoints
+		<< ", skipped actions: " << r.skipped_actions
+		<< ", bytes: " << r.bytes
+		<< ", save time: " << r.save_ms << " ms";
+}
+
+scene_load_report::scene_load_report()
+	: models(0),
+	  components(0),
+	  meshes(0),
+	  waypoints(0),
+	  bytes(0),
+	  resident(0.0),
+	  map_ms(0.0),
+	  shader_ms(0.0),
+	  upload_ms(0.0),
+	  texture_ms(0.0),
+	  total_ms(0.0)
+{
+}
+
+::std::ostream& operator <<(::std::ostream& out, scene_load_report const& r)
+{
+	return out
+		<< "models: " << r.models
+		<< ", components: " << r.components
+		<< ", meshes: " << r.meshes
+		<< ", waypoints: " << r.waypoints
+		<< ", bytes: " << r.bytes
+		<< ", resident: " << r.resident * 100.0 << "%"
+		<< ", map time: " << r.map_ms << " ms"
+		<< ", shader time: " << r.shader_ms << " ms"
+		<< ", upload time: " << r.upload_ms << " ms"
+		<< ", texture time: " << r.texture_ms << " ms"
+		<< ", total time: " << r.total_ms << " ms";
+}
+
+
+//m=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-
+namespace impl {
+
+class scene_snapshot
+{
+public:
+	static bool save(
+		std::string const& path,
+		model const& root,
+		std::vector<waypoint> const& waypoints,
+		scene_save_report& report
+	);
+
+	static bool load(
+		std::string const& path,
+		scene& out,
+		scene_actions const& actions,
+		scene_load_report& report
+	);
+
+private:
+	class writer;
+	class reader;
+};
+
+
+//m=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-
+class scene_snapshot::writer
+{
+public:
+	writer()
+		: file_(sizeof(file_header), 0)
+	{
+	}
+
+	std::uint32_t add_string(std::string const& s)
+	{
+		auto it = string_index_.find(s);
+		if (it != string_index_.end())
+			return it->second;
+
+		string_record r = string_record();
+		r.offset = append(s.c_str(), s.size() + 1, 1);
+		r.length = s.size();
+		strings_.push_back(r);
+		return string_index_[s] = strings_.size() - 1;
+	}
+
+	std::uint32_t add_shader(shader_handle const& s)
+	{
+		if (s.get_program_id() == 0)
+			return none;
+
+		shader_record r;
+		r.vertex_file = add_string(s.get_vertex_shader_file());
+		r.fragment_file = add_string(s.get_fragment_shader_file());
+		r.defines = add_string(s.get_defines());
+		for (std::size_t i = 0; i < shaders_.size(); ++i)
+			if (std::memcmp(&shaders_[i], &r, sizeof(r)) == 0)
+				return i;
+
+		shaders_.push_back(r);
+		return shaders_.size() - 1;
+	}
+
+	// Nodes are numbered breadth first, so that the children of each node
+	// are one run of the children table.
+	void add_tree(model const& root)
+	{
+		index_of(root);
+		for (std::size_t i = 0; i < order_.size(); ++i)
+			add_node(*order_[i]);
+	}
+
+	void add_waypoints(std::vector<waypoint> const& waypoints, scene_save_report& report)
+	{
+		bool warned = false;
+		for (waypoint const& wp : waypoints)
+		{
+			waypoint_record r = waypoint_record();
+			r.radius = wp.get_radius();
+			copy_to(r.location, wp.get_location());
+			r.first_target = targets_.size();
+
+			for (auto const& entry : wp.get_actions())
+			{
+				auto node = node_index_.find(entry.first);
+				for (waypoint::action_type const& action : entry.second)
+				{
+					std::string const* name = scene_actions::name_of(action);
+					if (node == node_index_.end() || name == nullptr)
+					{
+						if (!warned)
+							std::cerr << "WARNING: Skipping waypoint actions that are unnamed or act outside the scene\n";
+						warned = true;
+						++report.skipped_actions;
+						continue;
+					}
+
+					target_record t;
+					t.node = node->second;
+					t.action = add_string(*name);
+					targets_.push_back(t);
+				}
+			}
+
+			r.target_count = targets_.size() - r.first_target;
+			waypoints_.push_back(r);
+		}
+		report.waypoints = waypoints_.size();
+	}
+
+	void report(scene_save_report& r) const
+	{
+		for (node_record const& n : nodes_)
+			++(n.kind == component_node ? r.components : r.models);
+		r.meshes = meshes_.size();
+		r.shared_meshes = shared_meshes_;
+	}
+
+	bool write(std::string const& path)
+	{
+		file_header h = file_header();
+		std::memcpy(h.magic, file_magic, sizeof(h.magic));
+		h.version = file_version;
+		h.byte_order = byte_order_mark;
+		h.root = 0;
+		h.strings = append_table(strings_);
+		h.shaders = append_table(shaders_);
+		h.nodes = append_table(nodes_);
+		h.children = append_table(children_);
+		h.lights = append_table(lights_);
+		h.thresholds = append_table(thresholds_);
+		h.meshes = append_table(meshes_);
+		h.lods = append_table(lods_);
+		h.waypoints = append_table(waypoints_);
+		h.targets = append_table(targets_);
+		h.file_size = file_.size();
+		std::memcpy(&file_[0], &h, sizeof(h));
+
+		// Written aside and renamed, so a failed save leaves the old file.
+		std::string temporary = path + ".tmp";
+		{
+			std::ofstream out(temporary, std::ios::binary | std::ios::trunc);
+			out.write(reinterpret_cast<char const*>(file_.data()), file_.size());
+			if (!out.flush())
+			{
+				std::remove(temporary.c_str());
+				return false;
+			}
+		}
+		return std::rename(temporary.c_str(), path.c_str()) == 0;
+	}
+
+	std::size_t size() const
+	{
+		return file_.size();
+	}
+
+private:
+	std::uint64_t align(std::size_t alignment)
+	{
+		file_.resize((file_.size() + alignment - 1) / alignment * alignment, 0);
+		return file_.size();
+	}
+
+	std::uint64_t append(void const* p, std::size_t bytes, std::size_t alignment = 16)
+	{
+		std::uint64_t offset = align(alignment);
+		file_.resize(offset + bytes);
+		if (bytes != 0)
+			std::memcpy(&file_[offset], p, bytes);
+		return offset;
+	}
+
+	template <typename T>
+	data_ref append_array(std::vector<T> const& v)
+	{
+		data_ref r = data_ref();
+		if (!v.empty())
+		{
+			r.bytes = v.size() * sizeof(T);
+			r.offset = append(v.data(), r.bytes);
+		}
+		return r;
+	}
+
+	template <typename T>
+	table_ref append_table(std::vector<T> const& v)
+	{
+		table_ref t;
+		t.offset = append(v.data(), v.size() * sizeof(T), 8);
+		t.count = v.size();
+		t.record_size = sizeof(T);
+		return t;
+	}
+
+	// Reads the whole of a GPU buffer into the file.
+	data_ref read_back(buffer const& b)
+	{
+		data_ref r = data_ref();
+		if (!b.is_created())
+			return r;
+
+		b.bind(GL_COPY_READ_BUFFER);
+		GLint size = 0;
+		::glGetBufferParameteriv(GL_COPY_READ_BUFFER, GL_BUFFER_SIZE, &size);
+		r.offset = align(16);
+		r.bytes = size;
+		file_.resize(r.offset + r.bytes);
+		if (size > 0)
+			::glGetBufferSubData(GL_COPY_READ_BUFFER, 0, size, &file_[r.offset]);
+		return r;
+	}
+
+	std::uint32_t index_of(model const& m)
+	{
+		auto it = node_index_.find(&m);
+		if (it != node_index_.end())
+			return it->second;
+
+		order_.push_back(&m);
+		return node_index_[&m] = order_.size() - 1;
+	}
+
+	void add_node(model const& m)
+	{
+		node_record r = node_record();
+		component const* c = dynamic_cast<component const*>(&m);
+		r.kind = c != nullptr ? component_node : model_node;
+		r.shader = c != nullptr && c->shader_variants_ ? none : add_shader(m.shader_);
+		copy_to(r.ambient_light_colour, m.ambient_light_colour_);
+
+		r.first_light = lights_.size();
+		r.light_count = m.point_source_locations_.size();
+		for (std::size_t i = 0; i < r.light_count; ++i)
+		{
+			light_record l;
+			copy_to(l.location, m.point_source_locations_[i]);
+			copy_to(l.colour, m.point_source_colours_[i]);
+			l.power = m.point_source_powers_[i];
+			lights_.push_back(l);
+		}
+
+		r.first_child = children_.size();
+		r.child_count = m.components_.size();
+		for (model* child : m.components_)
+			children_.push_back(index_of(*child));
+
+		if (c != nullptr)
+			add_component(*c, r);
+
+		nodes_.push_back(r);
+	}
+
+	void add_component(component const& c, node_record& r)
+	{
+		r.flags = 0;
+		if (c.shape_colour_id_ != 0)
+			r.flags |= colour_set;
+		if (c.specular_colour_id_ != 0)
+			r.flags |= specular_colour_set;
+		if (c.shader_variants_)
+			r.flags |= shader_variants;
+		if (c.cpu_copy_policy_ == cpu_copy_policy::release)
+			r.flags |= cpu_copy_released;
+		r.mesh = c.vertex_buffer_.is_created() ? add_mesh(c) : none;
+		r.texture = c.texture_.is_loaded() ? add_string(c.texture_.get_filename()) : none;
+		r.drawing_mode = c.drawing_mode_;
+		r.first_threshold = thresholds_.size();
+		r.threshold_count = c.lod_thresholds_.size();
+		thresholds_.insert(thresholds_.end(), c.lod_thresholds_.begin(), c.lod_thresholds_.end());
+		r.lod_hysteresis = c.lod_hysteresis_;
+		copy_to(r.colour, c.shape_colour_);
+		copy_to(r.specular_colour, c.specular_colour_);
+		copy_to(r.heading, c.heading_);
+		copy_to(r.model, c.model_);
+		copy_to(r.init_model, c.init_model_);
+		copy_to(r.model_save, c.model_save_);
+	}
+
+	// Appends the mesh of c, then drops it again for an earlier copy with
+	// the same contents, as components loaded from one file have.
+	std::uint32_t add_mesh(component const& c)
+	{
+		std::uint32_t const source = c.wavefront_file_.empty() ? none : add_string(c.wavefront_file_);
+		std::size_t const begin = align(16);
+		std::size_t const first_lod = lods_.size();
+
+		mesh_record r = mesh_record();
+		r.source = source;
+		r.format = static_cast<std::uint32_t>(c.vertex_format_);
+		r.stream_chunk_triangles = c.stream_chunk_triangles_;
+		r.va_size = c.va_size_;
+		r.vertex_count = c.vertex_count_;
+		copy_to(r.bounds, c.bounds_.lower);
+		copy_to(r.bounds + 3, c.bounds_.upper);
+		copy_to(r.position_offset, c.position_offset_);
+		copy_to(r.position_scale, c.position_scale_);
+		r.quantization_error[0] = c.quantization_error_.max_position;
+		r.quantization_error[1] = c.quantization_error_.mean_position;
+		r.quantization_error[2] = c.quantization_error_.max_normal_degrees;
+		r.quantization_error[3] = c.quantization_error_.max_uv;
+
+		r.buffers[vertex_buffer] = read_back(c.vertex_buffer_);
+		r.buffers[colour_buffer] = read_back(c.colour_buffer_);
+		r.buffers[uv_buffer] = read_back(c.uv_buffer_);
+		r.buffers[normal_buffer] = read_back(c.normal_buffer_);
+		r.arrays[vertex_array_data] = append_array(c.vertices_);
+		r.arrays[uv_array_data] = append_array(c.uvs_);
+		r.arrays[normal_array_data] = append_array(c.normals_);
+		r.arrays[tangent_array_data] = append_array(c.tangents_);
+
+		r.first_lod = first_lod;
+		r.lod_count = c.lods_.size();
+		for (auto const& level : c.lods_)
+			lods_.push_back(append_array(level.indices));
+
+		// The key is the record and LOD references relative to the mesh.
+		mesh_record key = r;
+		key.first_lod = 0;
+		for (data_ref& d : key.buffers)
+			if (d.bytes != 0 || d.offset != 0)
+				d.offset -= begin;
+		for (data_ref& d : key.arrays)
+			if (d.bytes != 0 || d.offset != 0)
+				d.offset -= begin;
+		std::vector<data_ref> lod_keys(lods_.begin() + first_lod, lods_.end());
+		for (data_ref& d : lod_keys)
+			if (d.bytes != 0 || d.offset != 0)
+				d.offset -= begin;
+
+		std::size_t const end = file_.size();
+		std::uint64_t hash = fnv1a(reinterpret_cast<unsigned char const*>(&key), sizeof(key));
+		hash = fnv1a(reinterpret_cast<unsigned char const*>(lod_keys.data()), lod_keys.size() * sizeof(data_ref), hash);
+		hash = fnv1a(file_.data() + begin, end - begin, hash);
+
+		auto candidates = mesh_index_.equal_range(hash);
+		for (auto it = candidates.first; it != candidates.second; ++it)
+		{
+			mesh_copy const& other = mesh_copies_[it->second];
+			if (other.end - other.begin == end - begin
+			    && std::memcmp(&other.key, &key, sizeof(key)) == 0
+			    && other.lod_keys.size() == lod_keys.size()
+			    && std::equal(other.lod_keys.begin(), other.lod_keys.end(), lod_keys.begin(),
+			                  [](data_ref const& a, data_ref const& b) { return a.offset == b.offset && a.bytes == b.bytes; })
+			    && std::memcmp(file_.data() + other.begin, file_.data() + begin, end - begin) == 0)
+			{
+				file_.resize(begin);
+				lods_.resize(first_lod);
+				++shared_meshes_;
+				return it->second;
+			}
+		}
+
+		meshes_.push_back(r);
+		mesh_copies_.push_back(mesh_copy{ key, std::move(lod_keys), begin, end });
+		mesh_index_.insert(std::make_pair(hash, std::uint32_t(meshes_.size() - 1)));
+		return meshes_.size() - 1;
+	}
+
+	struct mesh_copy
+	{
+		mesh_record key;
+		std::vector<data_ref> lod_keys;
+		std::size_t begin;
+		std::size_t end;
+	};
+
+	std::vector<unsigned char> file_;
+
+	std::unordered_map<std::string, std::uint32_t> string_index_;
+	std::unordered_map<model const*, std::uint32_t> node_index_;
+	std::vector<model const*> order_;
+	std::unordered_multimap<std::uint64_t, std::uint32_t> mesh_index_;
+	std::vector<mesh_copy> mesh_copies_;
+	std::size_t shared_meshes_ = 0;
+
+	std::vector<string_record> strings_;
+	std::vector<shader_record> shaders_;
+	std::vector<node_record> nodes_;
+	std::vector<std::uint32_t> children_;
+	std::vector<light_record> lights_;
+	std::vector<float> thresholds_;
+	std::vector<mesh_record> meshes_;
+	std::vector<data_ref> lods_;
+	std::vector<waypoint_record> waypoints_;
+	std::vector<target_record> targets_;
+};
+
+bool scene_snapshot::save(
+	std::string const& path,
+	model const& root,
+	std::vector<waypoint> const& waypoints,
+	scene_save_report& report
+)
+{
+	auto start = std::chrono::steady_clock::now();
+
+	writer w;
+	w.add_tree(root);
+	w.add_waypoints(waypoints, report);
+	w.report(report);
+
+	if (!w.write(path))
+	{
+		std::cerr << "ERROR: Cannot write scene snapshot...\tpath: " << path << std::endl;
+		return false;
+	}
+
+	report.bytes = w.size();
+	report.save_ms = impl::elapsed_ms(start);
+	return true;
+}
+
+
+//m=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-
+// Checks every reference in the file once, so that building the scene can
+// follow them without further tests.
+class scene_snapshot::reader
+{
+public:
+	explicit reader(mapped_file const& file)
+		: data_(file.data()),
+		  size_(file.size()),
+		  header_(nullptr)
+	{
+	}
+
+	char const* validate()
+	{
+		if (size_ < sizeof(file_header))
+			return "truncated header";
+		header_ = reinterpret_cast<file_header const*>(data_);
+		if (std::memcmp(header_->magic, file_magic, sizeof(file_magic)) != 0)
+			return "not a scene snapshot";
+		if (header_->version != file_version)
+			return "unsupported version";
+		if (header_->byte_order != byte_order_mark)
+			return "written with another byte order";
+		if (header_->file_size != size_)
+			return "truncated file";
+
+		if (!get(header_->strings, strings)
+		    || !get(header_->shaders, shaders)
+		    || !get(header_->nodes, nodes)
+		    || !get(header_->children, children)
+		    || !get(header_->lights, lights)
+		    || !get(header_->thresholds, thresholds)
+		    || !get(header_->meshes, meshes)
+		    || !get(header_->lods, lods)
+		    || !get(header_->waypoints, waypoints)
+		    || !get(header_->targets, targets))
+			return "bad table";
+
+		for (std::size_t i = 0; i < count(header_->strings); ++i)
+		{
+			string_record const& s = strings[i];
+			if (s.offset >= size_ || s.length >= size_ - s.offset || data_[s.offset + s.length] != '\0')
+				return "bad string";
+		}
+
+		for (std::size_t i = 0; i < count(header_->shaders); ++i)
+			if (!is_string(shaders[i].vertex_file) || !is_string(shaders[i].fragment_file) || !is_string(shaders[i].defines))
+				return "bad shader";
+
+		for (std::size_t i = 0; i < count(header_->meshes); ++i)
+			if (char const* e = validate_mesh(meshes[i]))
+				return e;
+
+		for (std::size_t i = 0; i < count(header_->nodes); ++i)
+			if (char const* e = validate_node(nodes[i]))
+				return e;
+		if (count(header_->nodes) == 0 || header_->root >= count(header_->nodes))
+			return "bad root";
+		if (has_cycle())
+			return "cyclic tree";
+
+		for (std::size_t i = 0; i < count(header_->waypoints); ++i)
+		{
+			waypoint_record const& w = waypoints[i];
+			if (!in_table(w.first_target, w.target_count, header_->targets))
+				return "bad waypoint";
+			for (std::size_t t = w.first_target; t < w.first_target + w.target_count; ++t)
+				if (targets[t].node >= count(header_->nodes)
+				    || nodes[targets[t].node].kind != component_node
+				    || !is_string(targets[t].action))
+					return "bad waypoint target";
+		}
+
+		return nullptr;
+	}
+
+	file_header const& header() const
+	{
+		return *header_;
+	}
+
+	static std::size_t count(table_ref const& t)
+	{
+		return t.count;
+	}
+
+	std::string string(std::uint32_t i) const
+	{
+		return std::string(reinterpret_cast<char const*>(data_ + strings[i].offset), strings[i].length);
+	}
+
+	unsigned char const* at(data_ref const& d) const
+	{
+		return data_ + d.offset;
+	}
+
+	string_record const* strings;
+	shader_record const* shaders;
+	node_record const* nodes;
+	std::uint32_t const* children;
+	light_record const* lights;
+	float const* thresholds;
+	mesh_record const* meshes;
+	data_ref const* lods;
+	waypoint_record const* waypoints;
+	target_record const* targets;
+
+private:
+	template <typename T>
+	bool get(table_ref const& t, T const*& out) const
+	{
+		if (t.record_size != sizeof(T) || t.offset % alignof(T) != 0
+		    || t.offset > size_ || t.count > (size_ - t.offset) / sizeof(T))
+			return false;
+		out = reinterpret_cast<T const*>(data_ + t.offset);
+		return true;
+	}
+
+	static bool in_table(std::uint32_t first, std::uint32_t n, table_ref const& t)
+	{
+		return first <= t.count && n <= t.count - first;
+	}
+
+	bool is_string(std::uint32_t i) const
+	{
+		return i < count(header_->strings);
+	}
+
+	bool is_data(data_ref const& d, std::size_t element) const
+	{
+		if (d.offset == 0 && d.bytes == 0)
+			return true;
+		return d.offset >= sizeof(file_header) && d.offset <= size_ && d.bytes <= size_ - d.offset
+			&& d.offset % 4 == 0 && d.bytes % element == 0;
+	}
+
+	char const* validate_mesh(mesh_record const& m) const
+	{
+		if ((m.source != none && !is_string(m.source))
+		    || m.format > static_cast<std::uint32_t>(vertex_format::quantized)
+		    || m.va_size < 0 || m.vertex_count < 0
+		    || !in_table(m.first_lod, m.lod_count, header_->lods))
+			return "bad mesh";
+
+		// Every present buffer must hold the vertices drawn from it.
+		vertex_format const format = static_cast<vertex_format>(m.format);
+		if (m.buffers[vertex_buffer].bytes == 0 && m.buffers[vertex_buffer].offset == 0)
+			return "mesh without vertex buffer";
+		for (std::size_t b = 0; b < buffer_count; ++b)
+		{
+			data_ref const& d = m.buffers[b];
+			if (!is_data(d, 1))
+				return "bad mesh buffer";
+			if (d.offset != 0 && d.bytes / buffer_stride(mesh_buffer(b), format) < std::uint64_t(m.vertex_count))
+				return "short mesh buffer";
+		}
+		for (std::size_t a = 0; a < array_count; ++a)
+			if (!is_data(m.arrays[a], array_stride[a]))
+				return "bad mesh array";
+		// Tangents, where kept, are one per vertex of the CPU copy.
+		if (m.arrays[tangent_array_data].bytes != 0
+		    && m.arrays[tangent_array_data].bytes / sizeof(glm::vec4)
+		       != m.arrays[vertex_array_data].bytes / sizeof(glm::vec3))
+			return "bad mesh array";
+
+		// Indices must stay within both the GPU buffers and the CPU copy.
+		std::uint64_t vertices = m.vertex_count;
+		if (m.arrays[vertex_array_data].bytes != 0)
+			vertices = std::min<std::uint64_t>(vertices, m.arrays[vertex_array_data].bytes / sizeof(glm::vec3));
+		for (std::size_t l = m.first_lod; l < m.first_lod + m.lod_count; ++l)
+		{
+			if (!is_data(lods[l], sizeof(std::uint32_t)))
+				return "bad mesh indices";
+			std::uint32_t const* indices = reinterpret_cast<std::uint32_t const*>(at(lods[l]));
+			std::uint32_t highest = 0;
+			for (std::size_t i = 0; i < lods[l].bytes / sizeof(std::uint32_t); ++i)
+				highest = std::max(highest, indices[i]);
+			if (lods[l].bytes != 0 && highest >= vertices)
+				return "mesh index out of range";
+		}
+		return nullptr;
+	}
+
+	char const* validate_node(node_record const& n) const
+	{
+		if (n.kind > component_node
+		    || (n.shader != none && n.shader >= count(header_->shaders))
+		    || !in_table(n.first_child, n.child_count, header_->children)
+		    || !in_table(n.first_light, n.light_count, header_->lights))
+			return "bad node";
+
+		for (std::size_t i = n.first_child; i < n.first_child + n.child_count; ++i)
+			if (children[i] >= count(header_->nodes))
+				return "bad child";
+
+		if (n.kind == component_node
+		    && ((n.mesh != none && n.mesh >= count(header_->meshes))
+		        || (n.texture != none && !is_string(n.texture))
+		        || !in_table(n.first_threshold, n.threshold_count, header_->thresholds)))
+			return "bad component";
+		return nullptr;
+	}
+
+	// Kahn's algorithm: a node tree must be acyclic for rendering to end.
+	bool has_cycle() const
+	{
+		std::size_t const n = count(header_->nodes);
+		std::vector<std::uint32_t> parents(n, 0);
+		for (std::size_t i = 0; i < n; ++i)
+			for (std::size_t c = nodes[i].first_child; c < nodes[i].first_child + nodes[i].child_count; ++c)
+				++parents[children[c]];
+
+		std::vector<std::uint32_t> ready;
+		for (std::size_t i = 0; i < n; ++i)
+			if (parents[i] == 0)
+				ready.push_back(i);
+
+		std::size_t visited = 0;
+		while (!ready.empty())
+		{
+			std::uint32_t i = ready.back();
+			ready.pop_back();
+			++visited;
+			for (std::size_t c = nodes[i].first_child; c < nodes[i].first_child + nodes[i].child_count; ++c)
+				if (--parents[children[c]] == 0)
+					ready.push_back(children[c]);
+		}
+		return visited != n;
+	}
+
+	unsigned char const* data_;
+	std::size_t size_;
+	file_header const* header_;
+};
+
+namespace {
+
+// Uploads data from the mapping as the whole of a buffer, or destroys the
+// buffer if the data is absent.
+void upload(buffer& b, GLenum target, unsigned char const* file, data_ref const& d, std::string const& asset)
+{
+	if (d.offset == 0 && d.bytes == 0)
+	{
+		b.destroy();
+		return;
+	}
+
+	b.create();
+	b.set_data(target, d.bytes, file + d.offset, GL_STATIC_DRAW, asset);
+}
+
+template <typename T>
+void assign(std::vector<T>& out, unsigned char const* file, data_ref const& d)
+{
+	T const* first = reinterpret_cast<T const*>(file + d.offset);
+	out.assign(first, first + d.bytes / sizeof(T));
+}
+
+// Fraction of the pages of a mapping that are in the page cache.
+double resident_fraction(mapped_file const& file)
+{
+	if (file.size() == 0)
+		return 1.0;
+
+	std::size_t const page = ::sysconf(_SC_PAGESIZE);
+	std::vector<unsigned char> pages((file.size() + page - 1) / page);
+	void* address = const_cast<unsigned char*>(file.data());
+	if (::mincore(address, file.size(), pages.data()) != 0)
+		return 0.0;
+
+	std::size_t resident = 0;
+	for (unsigned char p : pages)
+		resident += p & 1;
+	return double(resident) / pages.size();
+}
+
+} // namespace
+
+bool scene_snapshot::load(
+	std::string const& path,
+	scene& out,
+	scene_actions const& actions,
+	scene_load_report& report
+)
+{
+	auto start = std::chrono::steady_clock::now();
+
+	mapped_file file(path);
+	if (!file)
+	{
+		std::cerr << "ERROR: Cannot open scene snapshot...\tpath: " << path << std::endl;
+		return false;
+	}
+
+	report.bytes = file.size();
+	report.resident = resident_fraction(file);
+	// Read the data ahead while the tables are checked and shaders compile.
+	if (file.size() != 0)
+		::madvise(const_cast<unsigned char*>(file.data()), file.size(), MADV_WILLNEED);
+
+	reader r(file);
+	if (char const* e = r.validate())
+	{
+		std::cerr << "ERROR: Cannot load scene snapshot (" << e << ")...\tpath: " << path << std::endl;
+		return false;
+	}
+	file_header const& h = r.header();
+	report.map_ms = impl::elapsed_ms(start);
+
+	// Shaders, all compiled at once.
+	auto phase = std::chrono::steady_clock::now();
+	shader_batch batch;
+	for (std::size_t i = 0; i < reader::count(h.shaders); ++i)
+		batch.add(r.string(r.shaders[i].vertex_file), r.string(r.shaders[i].fragment_file), r.string(r.shaders[i].defines));
+	batch.submit();
+	std::vector<GLuint> programs = batch.finish();
+
+	std::vector<shader_handle> shaders;
+	bool shaders_built = true;
+	for (std::size_t i = 0; i < programs.size(); ++i)
+	{
+		shaders.push_back(shader_handle(
+			programs[i], r.string(r.shaders[i].vertex_file), r.string(r.shaders[i].fragment_file), r.string(r.shaders[i].defines)
+		));
+		shaders_built = shaders_built && programs[i] != 0;
+	}
+	if (!shaders_built)
+	{
+		std::cerr << "ERROR: Cannot build the shaders of scene snapshot...\tpath: " << path << std::endl;
+		return false;
+	}
+	report.shader_ms = impl::elapsed_ms(phase);
+
+	// Nodes and meshes, straight from the mapping.
+	phase = std::chrono::steady_clock::now();
+	scene loaded;
+	std::size_t const node_count = reader::count(h.nodes);
+	std::vector<model*> nodes(node_count);
+	for (std::size_t i = 0; i < node_count; ++i)
+	{
+		if (r.nodes[i].kind == component_node)
+			nodes[i] = loaded.components_->create();
+		else
+			nodes[i] = loaded.models_->create();
+	}
+
+	for (std::size_t i = 0; i < node_count; ++i)
+	{
+		node_record const& n = r.nodes[i];
+		model& m = *nodes[i];
+
+		if (n.shader != none)
+			m.shader_ = shaders[n.shader];
+		m.ambient_light_colour_ = read_vec3(n.ambient_light_colour);
+		for (std::size_t l = n.first_light; l < n.first_light + n.light_count; ++l)
+		{
+			m.point_source_locations_.push_back(read_vec3(r.lights[l].location));
+			m.point_source_colours_.push_back(read_vec3(r.lights[l].colour));
+			m.point_source_powers_.push_back(r.lights[l].power);
+		}
+		// Lights are those of the node already, so children are not given
+		// their parent's again as add_component would.
+		for (std::size_t c = n.first_child; c < n.first_child + n.child_count; ++c)
+			m.components_.insert(nodes[r.children[c]]);
+
+		if (n.kind != component_node)
+			continue;
+
+		component& c = static_cast<component&>(m);
+		c.shape_colour_ = read_vec3(n.colour);
+		c.specular_colour_ = read_vec3(n.specular_colour);
+		c.heading_ = read_vec3(n.heading);
+		c.model_ = read_mat4(n.model);
+		c.init_model_ = read_mat4(n.init_model);
+		c.model_save_ = read_mat4(n.model_save);
+		c.drawing_mode_ = n.drawing_mode;
+		c.lod_thresholds_.assign(r.thresholds + n.first_threshold, r.thresholds + n.first_threshold + n.threshold_count);
+		c.lod_hysteresis_ = n.lod_hysteresis;
+
+		if (n.mesh != none)
+		{
+			mesh_record const& mesh = r.meshes[n.mesh];
+			unsigned char const* data = file.data();
+			if (mesh.source != none)
+				c.wavefront_file_ = r.string(mesh.source);
+			upload(c.vertex_buffer_, GL_ARRAY_BUFFER, data, mesh.buffers[vertex_buffer], c.wavefront_file_);
+			upload(c.colour_buffer_, GL_ARRAY_BUFFER, data, mesh.buffers[colour_buffer], c.wavefront_file_);
+			upload(c.uv_buffer_, GL_ARRAY_BUFFER, data, mesh.buffers[uv_buffer], c.wavefront_file_);
+			upload(c.normal_buffer_, GL_ARRAY_BUFFER, data, mesh.buffers[normal_buffer], c.wavefront_file_);
+			assign(c.vertices_, data, mesh.arrays[vertex_array_data]);
+			assign(c.uvs_, data, mesh.arrays[uv_array_data]);
+			assign(c.normals_, data, mesh.arrays[normal_array_data]);
+			assign(c.tangents_, data, mesh.arrays[tangent_array_data]);
+
+			c.lods_.resize(mesh.lod_count);
+			for (std::size_t l = 0; l < mesh.lod_count; ++l)
+			{
+				data_ref const& indices = r.lods[mesh.first_lod + l];
+				assign(c.lods_[l].indices, data, indices);
+				upload(c.lods_[l].index_buffer, GL_ELEMENT_ARRAY_BUFFER, data, indices, c.wavefront_file_);
+			}
+
+			c.stream_chunk_triangles_ = mesh.stream_chunk_triangles;
+			c.va_size_ = mesh.va_size;
+			c.vertex_count_ = mesh.vertex_count;
+			c.bounds_.lower = read_vec3(mesh.bounds);
+			c.bounds_.upper = read_vec3(mesh.bounds + 3);
+			c.vertex_format_ = static_cast<vertex_format>(mesh.format);
+			c.position_offset_ = read_vec3(mesh.position_offset);
+			c.position_scale_ = read_vec3(mesh.position_scale);
+			c.quantization_error_.max_position = mesh.quantization_error[0];
+			c.quantization_error_.mean_position = mesh.quantization_error[1];
+			c.quantization_error_.max_normal_degrees = mesh.quantization_error[2];
+			c.quantization_error_.max_uv = mesh.quantization_error[3];
+		}
+
+		// Released copies were saved empty, so nothing is freed here.
+		if (n.flags & cpu_copy_released)
+			c.cpu_copy_policy_ = cpu_copy_policy::release;
+		c.account_cpu_memory();
+
+		c.update_location();
+	}
+	report.upload_ms = impl::elapsed_ms(phase);
+
+	phase = std::chrono::steady_clock::now();
+	for (std::size_t i = 0; i < node_count; ++i)
+		if (r.nodes[i].kind == component_node && r.nodes[i].texture != none)
+			static_cast<component*>(nodes[i])->texture_.load(r.string(r.nodes[i].texture));
+	report.texture_ms = impl::elapsed_ms(phase);
+
+	// Uniform locations once shaders, meshes and textures are in place.
+	for (std::size_t i = 0; i < node_count; ++i)
+	{
+		node_record const& n = r.nodes[i];
+		if (n.shader != none)
+			nodes[i]->get_uniform_locations();
+		if (n.kind != component_node)
+			continue;
+
+		component& c = static_cast<component&>(*nodes[i]);
+		if (n.flags & colour_set)
+			c.shape_colour_id_ = c.shader_.get_uniform_location("shape_colour");
+		if (n.flags & specular_colour_set)
+			c.specular_colour_id_ = c.shader_.get_uniform_location("specular_colour");
+		if (n.flags & shader_variants)
+			c.use_shader_variants(true);
+	}
+
+	bool warned = false;
+	for (std::size_t i = 0; i < reader::count(h.waypoints); ++i)
+	{
+		waypoint_record const& w = r.waypoints[i];
+		waypoint wp(read_vec3(w.location), w.radius);
+		for (std::size_t t = w.first_target; t < w.first_target + w.target_count; ++t)
+		{
+			std::string name = r.string(r.targets[t].action);
+			waypoint::action_type action = actions.get(name);
+			if (!action)
+			{
+				if (!warned)
+					std::cerr << "WARNING: Skipping unknown waypoint action...\tname: " << name << std::endl;
+				warned = true;
+				continue;
+			}
+			wp.add_action(*nodes[r.targets[t].node], action);
+		}
+		loaded.waypoints_.push_back(std::move(wp));
+	}
+
+	loaded.root_ = nodes[h.root];
+	out.swap(loaded);
+
+	report.models = out.get_model_count();
+	report.components = out.get_component_count();
+	report.meshes = reader::count(h.meshes);
+	report.waypoints = out.waypoints_.size();
+	report.total_ms = impl::elapsed_ms(start);
+	return true;
+}
+
+} // namespace impl
+
+
+//m=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-
+bool save_scene(
+	::std::string const& path,
+	model const& root,
+	::std::vector<waypoint> const& waypoints,
+	scene_save_report* out_report
+)
+{
+	scene_save_report report;
+	if (!impl::scene_snapshot::save(path, root, waypoints, report))
+		return false;
+
+	if (out_report != nullptr)
+		*out_report = report;
+	return true;
+}
+
+bool load_scene(
+	::std::string const& path,
+	scene& out,
+	scene_actions const& actions,
+	scene_load_report* out_report
+)
+{
+	scene_load_report report;
+	if (!impl::scene_snapshot::load(path, out, actions, report))
+		return false;
+
+	if (out_report != nullptr)
+		*out_report = report;
+	return true;
+}
+
+} // namespace gl
+} // namespace graphics
+} // namespace mrr
@@ -11,6 +11,9 @@
 #include <GL/glew.h>
 
 #include <mrr/graphics/shader.hxx>
+#include <mrr/graphics/parallel.hxx>
+
+#include <unordered_map>
 
 static std::string file_contents_to_string(std::ifstream& in)
 {
@@ -24,104 +27,300 @@ static std::string file_contents_to_string(std::ifstream& in)
 	return file_contents;
 }
 
+// #version must stay the first directive, so the defines go right after it.
+// The #line directive keeps compiler messages pointing at the file's lines.
+static void insert_defines(std::string& source, char const* defines)
+{
+	if (defines == NULL || *defines == '\0')
+		return;
+
+	std::string::size_type version = source.find("#version");
+	std::string::size_type insert_at = 0;
+	int line = 1;
+	if (version != std::string::npos)
+	{
+		insert_at = source.find('\n', version);
+		insert_at = insert_at == std::string::npos ? source.size() : insert_at + 1;
+		line += std::count(source.begin(), source.begin() + insert_at, '\n');
+	}
+
+	std::string preamble(defines);
+	if (preamble[preamble.size() - 1] != '\n')
+		preamble += '\n';
+	preamble += "#line " + std::to_string(line) + "\n";
+
+	source.insert(insert_at, preamble);
+}
+
 
 GLuint load_shaders(
 	const char* vertex_shader_path,
 	const char* fragment_shader_path
 )
 {
-	std::clog << "Loading shaders...\n";
-	std::clog << "  Vertex shader: \t" << vertex_shader_path << std::endl
-	          << "  Fragment shader: \t" << vertex_shader_path << std::endl;
+	return load_shaders(vertex_shader_path, fragment_shader_path, NULL);
+}
+
+GLuint load_shaders(
+	const char* vertex_shader_path,
+	const char* fragment_shader_path,
+	const char* defines
+)
+{
+	shader_batch batch;
+	batch.add(vertex_shader_path, fragment_shader_path, defines != NULL ? defines : "");
+	batch.submit();
+	return batch.finish()[0];
+}
 
-	GLuint vertex_shader_id = ::glCreateShader(GL_VERTEX_SHADER);
-	GLuint fragment_shader_id = ::glCreateShader(GL_FRAGMENT_SHADER);
 
-	// Read vertex shader code from file.
-	std::string vertex_shader_code;
-	std::ifstream vertex_shader_stream(vertex_shader_path);
+static bool has_parallel_shader_compile()
+{
+	return GLEW_KHR_parallel_shader_compile || GLEW_ARB_parallel_shader_compile;
+}
 
-	if (vertex_shader_stream)
+// Prints the info log of a shader or program, if there is one, and returns
+// its compile or link status.
+static bool check_shader(GLuint shader_id, char const* what, std::string const& path)
+{
+	GLint result = GL_FALSE;
+	int info_log_length;
+	::glGetShaderiv(shader_id, GL_COMPILE_STATUS, &result);
+	::glGetShaderiv(shader_id, GL_INFO_LOG_LENGTH, &info_log_length);
+	if (info_log_length > 1)
 	{
-		vertex_shader_code = file_contents_to_string(vertex_shader_stream);
+		std::vector<char> error_message(info_log_length+1);
+		::glGetShaderInfoLog(shader_id, info_log_length, NULL, &error_message[0]);
+		std::cerr << "  " << what << " shader " << path << ":\n"
+		          << std::string(&error_message[0]) << std::endl;
 	}
-	else
+	return result == GL_TRUE;
+}
+
+static bool check_program(GLuint program_id)
+{
+	GLint result = GL_FALSE;
+	int info_log_length;
+	::glGetProgramiv(program_id, GL_LINK_STATUS, &result);
+	::glGetProgramiv(program_id, GL_INFO_LOG_LENGTH, &info_log_length);
+	if (info_log_length > 1)
 	{
-		std::cerr << "ERROR: Cannot open vertex shader...\tpath: " << vertex_shader_path << std::endl;
-		return 0;
+		std::vector<char> program_error_message(info_log_length+1);
+		::glGetProgramInfoLog(program_id, info_log_length, NULL, &program_error_message[0]);
+		std::cerr << std::string(&program_error_message[0]) << std::endl;
 	}
+	return result == GL_TRUE;
+}
 
-	// Read fragment shader code from file.
-	std::string fragment_shader_code;
-	std::ifstream fragment_shader_stream(fragment_shader_path);
 
-	if (fragment_shader_stream)
+//m=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-
+shader_batch::shader_batch()
+	: submitted_(false)
+{
+}
+
+shader_batch::~shader_batch()
+{
+	// Programs that were submitted but never finished.
+	for (auto const& p : programs_)
 	{
-		fragment_shader_code = file_contents_to_string(fragment_shader_stream);
+		if (p.vertex_shader_id != 0)
+			::glDeleteShader(p.vertex_shader_id);
+		if (p.fragment_shader_id != 0)
+			::glDeleteShader(p.fragment_shader_id);
+		if (p.program_id != 0)
+			::glDeleteProgram(p.program_id);
 	}
-	else
+}
+
+std::size_t shader_batch::add(
+	std::string const& vertex_file_path,
+	std::string const& fragment_file_path,
+	std::string const& defines
+)
+{
+	program p;
+	p.vertex_file_path = vertex_file_path;
+	p.fragment_file_path = fragment_file_path;
+	p.defines = defines;
+	p.vertex_shader_id = 0;
+	p.fragment_shader_id = 0;
+	p.program_id = 0;
+	programs_.push_back(p);
+
+	return programs_.size() - 1;
+}
+
+std::size_t shader_batch::size() const
+{
+	return programs_.size();
+}
+
+void shader_batch::submit()
+{
+	if (submitted_)
+		return;
+	submitted_ = true;
+
+	std::clog << "Loading " << programs_.size() << " shader program(s)...\n";
+	for (auto const& p : programs_)
 	{
-		std::cerr << "ERROR: Cannot open fragment shader...\tpath: " << fragment_shader_path << std::endl;
-		return 0;
+		std::clog << "  Vertex shader: \t" << p.vertex_file_path << std::endl
+		          << "  Fragment shader: \t" << p.fragment_file_path << std::endl;
 	}
 
+	// Read every distinct file once, on worker threads.
+	std::vector<std::string> paths;
+	std::unordered_map<std::string, std::size_t> path_index;
+	for (auto const& p : programs_)
+	{
+		if (path_index.emplace(p.vertex_file_path, paths.size()).second)
+			paths.push_back(p.vertex_file_path);
+		if (path_index.emplace(p.fragment_file_path, paths.size()).second)
+			paths.push_back(p.fragment_file_path);
+	}
 
-	GLint result = GL_FALSE;
-	int info_log_length;
+	std::vector<std::string> contents(paths.size());
+	std::vector<char> is_read(paths.size(), 0);
+	::mrr::graphics::gl::impl::parallel_for(paths.size(), 1, [&](std::size_t begin, std::size_t end)
+	{
+		for (std::size_t i = begin; i < end; ++i)
+		{
+			std::ifstream in(paths[i]);
+			if (in)
+			{
+				contents[i] = file_contents_to_string(in);
+				is_read[i] = 1;
+			}
+		}
+	});
 
-	// Compile the vertex shader.
-	std::clog << "  Compiling vertex shader...\n";
-	const char* vertex_source_ptr = vertex_shader_code.c_str();
-	::glShaderSource(vertex_shader_id, 1, &vertex_source_ptr, NULL);
-	::glCompileShader(vertex_shader_id);
+	// Specialize the sources of every program, also on worker threads. The
+	// workers only look paths up, through a const reference.
+	std::unordered_map<std::string, std::size_t> const& index = path_index;
+	std::vector<std::string> vertex_sources(programs_.size());
+	std::vector<std::string> fragment_sources(programs_.size());
+	::mrr::graphics::gl::impl::parallel_for(programs_.size(), 1, [&](std::size_t begin, std::size_t end)
+	{
+		for (std::size_t i = begin; i < end; ++i)
+		{
+			vertex_sources[i] = contents[index.at(programs_[i].vertex_file_path)];
+			fragment_sources[i] = contents[index.at(programs_[i].fragment_file_path)];
+			insert_defines(vertex_sources[i], programs_[i].defines.c_str());
+			insert_defines(fragment_sources[i], programs_[i].defines.c_str());
+		}
+	});
 
-	// Check that the vertex shader was loaded correctly.
-	::glGetShaderiv(vertex_shader_id, GL_COMPILE_STATUS, &result);
-	::glGetShaderiv(vertex_shader_id, GL_INFO_LOG_LENGTH, &info_log_length);
-	if (info_log_length > 1)
+	if (GLEW_KHR_parallel_shader_compile)
+		::glMaxShaderCompilerThreadsKHR(0xFFFFFFFF);
+	else if (GLEW_ARB_parallel_shader_compile)
+		::glMaxShaderCompilerThreadsARB(0xFFFFFFFF);
+
+	// Issue every compile before any link, and every link before any query.
+	for (std::size_t i = 0; i < programs_.size(); ++i)
 	{
-		std::vector<char> vertex_shader_error_message(info_log_length+1);
-		::glGetShaderInfoLog(vertex_shader_id, info_log_length, NULL, &vertex_shader_error_message[0]);
-		std::cerr << std::string(&vertex_shader_error_message[0]) << std::endl;
-	}
+		program& p = programs_[i];
 
-	// Compile the fragment shader.
-	std::clog << "  Compiling fragment shader...\n";
-	const char* fragment_source_ptr = fragment_shader_code.c_str();
-	::glShaderSource(fragment_shader_id, 1, &fragment_source_ptr, NULL);
-	::glCompileShader(fragment_shader_id);
+		if (!is_read[index.at(p.vertex_file_path)])
+		{
+			std::cerr << "ERROR: Cannot open vertex shader...\tpath: " << p.vertex_file_path << std::endl;
+			continue;
+		}
+		if (!is_read[index.at(p.fragment_file_path)])
+		{
+			std::cerr << "ERROR: Cannot open fragment shader...\tpath: " << p.fragment_file_path << std::endl;
+			continue;
+		}
 
-	// Check that the fragment shader was loaded correctly.
-	::glGetShaderiv(fragment_shader_id, GL_COMPILE_STATUS, &result);
-	::glGetShaderiv(fragment_shader_id, GL_INFO_LOG_LENGTH, &info_log_length);
-	if (info_log_length > 1)
+		const char* vertex_source_ptr = vertex_sources[i].c_str();
+		p.vertex_shader_id = ::glCreateShader(GL_VERTEX_SHADER);
+		::glShaderSource(p.vertex_shader_id, 1, &vertex_source_ptr, NULL);
+		::glCompileShader(p.vertex_shader_id);
+
+		const char* fragment_source_ptr = fragment_sources[i].c_str();
+		p.fragment_shader_id = ::glCreateShader(GL_FRAGMENT_SHADER);
+		::glShaderSource(p.fragment_shader_id, 1, &fragment_source_ptr, NULL);
+		::glCompileShader(p.fragment_shader_id);
+	}
+
+	for (auto& p : programs_)
 	{
-		std::vector<char> fragment_shader_error_message(info_log_length+1);
-		::glGetShaderInfoLog(fragment_shader_id, info_log_length, NULL, &fragment_shader_error_message[0]);
-		std::cerr << std::string(&fragment_shader_error_message[0]) << std::endl;
+		if (p.vertex_shader_id == 0)
+			continue;
+
+		p.program_id = ::glCreateProgram();
+		::glAttachShader(p.program_id, p.vertex_shader_id);
+		::glAttachShader(p.program_id, p.fragment_shader_id);
+		::glLinkProgram(p.program_id);
 	}
+}
 
-	// Link the shader program.
-	std::clog << "  Linking shader program...\n";
-	GLuint program_id = ::glCreateProgram();
-	::glAttachShader(program_id, vertex_shader_id);
-	::glAttachShader(program_id, fragment_shader_id);
-	::glLinkProgram(program_id);
+bool shader_batch::is_ready() const
+{
+	if (!submitted_)
+		return false;
 
-	// Check the program for correctness.
-	::glGetProgramiv(program_id, GL_LINK_STATUS, &result);
-	::glGetProgramiv(program_id, GL_INFO_LOG_LENGTH, &info_log_length);
-	if (info_log_length > 1)
+	if (!has_parallel_shader_compile())
+		return true;
+
+	for (auto const& p : programs_)
 	{
-		std::vector<char> program_error_message(info_log_length+1);
-		::glGetProgramInfoLog(program_id, info_log_length, NULL, &program_error_message[0]);
-		std::cerr << std::string(&program_error_message[0]) << std::endl;
+		if (p.program_id == 0)
+			continue;
+
+		GLint done = GL_FALSE;
+		::glGetProgramiv(p.program_id, GL_COMPLETION_STATUS_KHR, &done);
+		if (done != GL_TRUE)
+			return false;
 	}
+	return true;
+}
 
-	::glDeleteShader(vertex_shader_id);
-	::glDeleteShader(fragment_shader_id);
+std::vector<GLuint> shader_batch::finish()
+{
+	submit();
+
+	std::vector<GLuint> result;
+	result.reserve(programs_.size());
+	std::size_t loaded = 0;
+
+	for (auto& p : programs_)
+	{
+		if (p.program_id == 0)
+		{
+			result.push_back(0);
+			continue;
+		}
+
+		bool ok = check_shader(p.vertex_shader_id, "Vertex", p.vertex_file_path);
+		ok = check_shader(p.fragment_shader_id, "Fragment", p.fragment_file_path) && ok;
+		ok = check_program(p.program_id) && ok;
+
+		::glDetachShader(p.program_id, p.vertex_shader_id);
+		::glDetachShader(p.program_id, p.fragment_shader_id);
+		::glDeleteShader(p.vertex_shader_id);
+		::glDeleteShader(p.fragment_shader_id);
+
+		if (!ok)
+		{
+			std::cerr << "ERROR: Cannot build shader program...\tpaths: "
+			          << p.vertex_file_path << ", " << p.fragment_file_path << std::endl;
+			::glDeleteProgram(p.program_id);
+			p.program_id = 0;
+		}
+
+		else
+		{
+			++loaded;
+		}
+
+		result.push_back(p.program_id);
+		p.vertex_shader_id = p.fragment_shader_id = p.program_id = 0;
+	}
 
-	std::clog << "  Shader successfully loaded...\n";
+	std::clog << "  " << loaded << " of " << result.size() << " shader program(s) successfully loaded...\n";
+	programs_.clear();
+	submitted_ = false;
 
-	return program_id;
+	return result;
 }
@@ -0,0 +1,133 @@
+#include <mrr/graphics/shader_variants.hxx>
+#include <mrr/graphics/shader.hxx>
+
+#include <algorithm>
+
+namespace mrr {
+namespace graphics {
+namespace gl {
+
+shader_key make_shader_key(
+	bool textured, bool vertex_colour, bool normals, bool quantized, std::size_t light_count
+)
+{
+	shader_key key = 0;
+
+	// Textures and vertex colours share attribute 1; the texture wins.
+	if (textured)
+		key |= shader_feature::textured;
+	else if (vertex_colour)
+		key |= shader_feature::vertex_colour;
+
+	if (quantized)
+		key |= shader_feature::quantized;
+
+	if (normals && light_count > 0)
+	{
+		key |= shader_feature::lit;
+		key |= shader_key(std::min<std::size_t>(light_count, max_variant_lights)) << 8;
+	}
+
+	return key;
+}
+
+unsigned get_light_count(shader_key key)
+{
+	return key >> 8;
+}
+
+std::string get_shader_defines(shader_key key)
+{
+	std::string defines;
+	if (key & shader_feature::textured)
+		defines += "#define TEXTURED\n";
+	if (key & shader_feature::vertex_colour)
+		defines += "#define VERTEX_COLOUR\n";
+	if (key & shader_feature::lit)
+		defines += "#define LIT\n";
+	if (key & shader_feature::quantized)
+		defines += "#define QUANTIZED\n";
+	if (key & shader_feature::multi_view)
+		defines += "#define MULTI_VIEW\n#define MAX_VIEWS " + std::to_string(max_variant_views) + "\n";
+	defines += "#define LIGHT_COUNT " + std::to_string(get_light_count(key)) + "\n";
+	return defines;
+}
+
+
+//m=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-
+shader_variants::shader_variants(
+	::std::string const& vertex_shader_file,
+	::std::string const& fragment_shader_file
+)
+	: vertex_shader_file_(vertex_shader_file),
+	  fragment_shader_file_(fragment_shader_file)
+{
+}
+
+shader_handle const& shader_variants::get(shader_key key)
+{
+	auto it = programs_.find(key);
+	if (it == programs_.end())
+	{
+		it = programs_.emplace(
+			key,
+			shader_handle(vertex_shader_file_, fragment_shader_file_, get_shader_defines(key))
+		).first;
+	}
+	return it->second;
+}
+
+void shader_variants::preload(std::vector<shader_key> const& keys)
+{
+	shader_batch batch;
+	std::vector<shader_key> batched;
+	for (shader_key key : keys)
+	{
+		if (programs_.count(key) != 0
+		    || std::find(batched.begin(), batched.end(), key) != batched.end())
+			continue;
+
+		batch.add(vertex_shader_file_, fragment_shader_file_, get_shader_defines(key));
+		batched.push_back(key);
+	}
+
+	if (batched.empty())
+		return;
+
+	batch.submit();
+	std::vector<GLuint> program_ids = batch.finish();
+
+	// Failed variants are left out; get() reports them again when used.
+	for (std::size_t i = 0; i < batched.size(); ++i)
+		if (program_ids[i] != 0)
+			programs_.emplace(
+				batched[i],
+				shader_handle(
+					program_ids[i], vertex_shader_file_, fragment_shader_file_,
+					get_shader_defines(batched[i])
+				)
+			);
+}
+
+std::size_t shader_variants::size() const
+{
+	return programs_.size();
+}
+
+void shader_variants::clear()
+{
+	programs_.clear();
+}
+
+shader_variants& default_shader_variants()
+{
+	static shader_variants variants(
+		"/usr/local/share/mrr/graphics/shaders/variant-vertex-shader.glsl",
+		"/usr/local/share/mrr/graphics/shaders/variant-fragment-shader.glsl"
+	);
+	return variants;
+}
+
+} // namespace gl
+} // namespace graphics
+} // namespace mrr
@@ -0,0 +1,416 @@
+#include <mrr/graphics/state_cache.hxx>
+#include <mrr/graphics/stats.hxx>
+
+#include <cstddef>
+#include <unordered_map>
+
+namespace mrr {
+namespace graphics {
+namespace gl {
+namespace state {
+
+namespace {
+
+// Never a GL name, so never equal to one being bound.
+GLuint const unknown = ~GLuint(0);
+GLenum const unknown_unit = ~GLenum(0);
+
+std::size_t const texture_units = 32;
+std::uint32_t const vertex_attribs = 16;
+
+enum buffer_slot
+{
+	array_buffer_slot,
+	copy_read_buffer_slot,
+	copy_write_buffer_slot,
+	pixel_pack_buffer_slot,
+	pixel_unpack_buffer_slot,
+	texture_buffer_slot,
+	shader_storage_buffer_slot,
+	draw_indirect_buffer_slot,
+	uniform_buffer_slot,
+	buffer_slot_count
+};
+
+int get_buffer_slot(GLenum target)
+{
+	switch (target)
+	{
+	case GL_ARRAY_BUFFER:          return array_buffer_slot;
+	case GL_COPY_READ_BUFFER:      return copy_read_buffer_slot;
+	case GL_COPY_WRITE_BUFFER:     return copy_write_buffer_slot;
+	case GL_PIXEL_PACK_BUFFER:     return pixel_pack_buffer_slot;
+	case GL_PIXEL_UNPACK_BUFFER:   return pixel_unpack_buffer_slot;
+	case GL_TEXTURE_BUFFER:        return texture_buffer_slot;
+	case GL_SHADER_STORAGE_BUFFER: return shader_storage_buffer_slot;
+	case GL_DRAW_INDIRECT_BUFFER:  return draw_indirect_buffer_slot;
+	case GL_UNIFORM_BUFFER:        return uniform_buffer_slot;
+	default:                       return -1;
+	}
+}
+
+enum texture_slot
+{
+	texture_2d_slot,
+	texture_2d_array_slot,
+	texture_3d_slot,
+	texture_cube_map_slot,
+	texture_cube_map_array_slot,
+	texture_buffer_texture_slot,
+	texture_slot_count
+};
+
+int get_texture_slot(GLenum target)
+{
+	switch (target)
+	{
+	case GL_TEXTURE_2D:             return texture_2d_slot;
+	case GL_TEXTURE_2D_ARRAY:       return texture_2d_array_slot;
+	case GL_TEXTURE_3D:             return texture_3d_slot;
+	case GL_TEXTURE_CUBE_MAP:       return texture_cube_map_slot;
+	case GL_TEXTURE_CUBE_MAP_ARRAY: return texture_cube_map_array_slot;
+	case GL_TEXTURE_BUFFER:         return texture_buffer_texture_slot;
+	default:                        return -1;
+	}
+}
+
+// State that GL keeps per vertex array object.
+struct vertex_array_state
+{
+	vertex_array_state()
+		: element_buffer(unknown),
+		  enabled(0),
+		  known(0)
+	{
+	}
+
+	GLuint element_buffer;
+	// Attribute arrays, one bit per location.
+	std::uint32_t enabled;
+	std::uint32_t known;
+};
+
+struct tracker
+{
+	tracker()
+	{
+		reset();
+	}
+
+	void reset()
+	{
+		program = unknown;
+		vertex_array = unknown;
+		current_vertex_array = nullptr;
+		vertex_arrays.clear();
+		for (GLuint& b : buffers)
+			b = unknown;
+		indexed_buffers.clear();
+		active_unit = unknown_unit;
+		for (auto& unit : textures)
+			for (GLuint& t : unit)
+				t = unknown;
+		draw_framebuffer = read_framebuffer = unknown;
+		capabilities.clear();
+		viewport_known = false;
+	}
+
+	GLuint program;
+	GLuint vertex_array;
+	// Entry of vertex_array, nullptr while it is unknown.
+	vertex_array_state* current_vertex_array;
+	std::unordered_map<GLuint, vertex_array_state> vertex_arrays;
+	GLuint buffers[buffer_slot_count];
+	// By target in the high and index in the low 32 bits.
+	std::unordered_map<std::uint64_t, GLuint> indexed_buffers;
+	GLenum active_unit;
+	GLuint textures[texture_units][texture_slot_count];
+	GLuint draw_framebuffer;
+	GLuint read_framebuffer;
+	std::unordered_map<GLenum, bool> capabilities;
+	GLint viewport[4];
+	bool viewport_known;
+};
+
+tracker current;
+
+// Counts a call that is needed, and so issued, or elided.
+bool needed(bool differs)
+{
+	render_stats& s = frame_stats();
+	if (differs)
+		++s.state_changes;
+	else
+		++s.state_changes_elided;
+	return differs;
+}
+
+void set_capability(GLenum capability, bool enabled)
+{
+	auto it = current.capabilities.find(capability);
+	if (needed(it == current.capabilities.end() || it->second != enabled))
+	{
+		if (enabled)
+			::glEnable(capability);
+		else
+			::glDisable(capability);
+	}
+	current.capabilities[capability] = enabled;
+}
+
+} // namespace
+
+
+void use_program(GLuint program)
+{
+	if (needed(current.program != program))
+		::glUseProgram(program);
+	current.program = program;
+}
+
+void bind_vertex_array(GLuint vertex_array)
+{
+	if (needed(current.vertex_array != vertex_array))
+		::glBindVertexArray(vertex_array);
+	current.vertex_array = vertex_array;
+	current.current_vertex_array = &current.vertex_arrays[vertex_array];
+}
+
+GLuint get_vertex_array()
+{
+	if (current.vertex_array == unknown)
+	{
+		GLint vertex_array = 0;
+		::glGetIntegerv(GL_VERTEX_ARRAY_BINDING, &vertex_array);
+		current.vertex_array = vertex_array;
+		current.current_vertex_array = &current.vertex_arrays[vertex_array];
+	}
+	return current.vertex_array;
+}
+
+void bind_buffer(GLenum target, GLuint buffer)
+{
+	GLuint* shadow = nullptr;
+	if (target == GL_ELEMENT_ARRAY_BUFFER)
+	{
+		if (current.current_vertex_array != nullptr)
+			shadow = &current.current_vertex_array->element_buffer;
+	}
+	else
+	{
+		int slot = get_buffer_slot(target);
+		if (slot >= 0)
+			shadow = &current.buffers[slot];
+	}
+
+	if (needed(shadow == nullptr || *shadow != buffer))
+		::glBindBuffer(target, buffer);
+	if (shadow != nullptr)
+		*shadow = buffer;
+}
+
+void bind_buffer_base(GLenum target, GLuint index, GLuint buffer)
+{
+	// Also binds the buffer to the target itself.
+	int slot = get_buffer_slot(target);
+	std::uint64_t key = (std::uint64_t(target) << 32) | index;
+	auto it = current.indexed_buffers.find(key);
+
+	bool same = slot >= 0 && current.buffers[slot] == buffer
+		&& it != current.indexed_buffers.end() && it->second == buffer;
+	if (needed(!same))
+		::glBindBufferBase(target, index, buffer);
+
+	current.indexed_buffers[key] = buffer;
+	if (slot >= 0)
+		current.buffers[slot] = buffer;
+}
+
+void active_texture(GLenum unit)
+{
+	if (needed(current.active_unit != unit))
+		::glActiveTexture(unit);
+	current.active_unit = unit;
+}
+
+void bind_texture(GLenum target, GLuint texture)
+{
+	GLuint* shadow = nullptr;
+	int slot = get_texture_slot(target);
+	std::size_t unit = current.active_unit - GL_TEXTURE0;
+	if (current.active_unit != unknown_unit && unit < texture_units && slot >= 0)
+		shadow = &current.textures[unit][slot];
+
+	if (needed(shadow == nullptr || *shadow != texture))
+		::glBindTexture(target, texture);
+	if (shadow != nullptr)
+		*shadow = texture;
+}
+
+// The active unit is changed only if the binding is.
+void bind_texture(GLenum unit, GLenum target, GLuint texture)
+{
+	int slot = get_texture_slot(target);
+	std::size_t index = unit - GL_TEXTURE0;
+	if (index < texture_units && slot >= 0 && current.textures[index][slot] == texture)
+	{
+		needed(false);
+		return;
+	}
+
+	active_texture(unit);
+	bind_texture(target, texture);
+}
+
+void bind_framebuffer(GLenum target, GLuint framebuffer)
+{
+	bool draw = target == GL_FRAMEBUFFER || target == GL_DRAW_FRAMEBUFFER;
+	bool read = target == GL_FRAMEBUFFER || target == GL_READ_FRAMEBUFFER;
+
+	if (needed((draw && current.draw_framebuffer != framebuffer) || (read && current.read_framebuffer != framebuffer)))
+		::glBindFramebuffer(target, framebuffer);
+	if (draw)
+		current.draw_framebuffer = framebuffer;
+	if (read)
+		current.read_framebuffer = framebuffer;
+}
+
+void enable(GLenum capability)
+{
+	set_capability(capability, true);
+}
+
+void disable(GLenum capability)
+{
+	set_capability(capability, false);
+}
+
+bool is_enabled(GLenum capability)
+{
+	auto it = current.capabilities.find(capability);
+	if (it != current.capabilities.end())
+		return it->second;
+
+	bool enabled = ::glIsEnabled(capability);
+	current.capabilities[capability] = enabled;
+	return enabled;
+}
+
+void set_vertex_attrib_arrays(std::uint32_t mask)
+{
+	get_vertex_array();
+	vertex_array_state& va = *current.current_vertex_array;
+
+	for (std::uint32_t location = 0; location < vertex_attribs; ++location)
+	{
+		std::uint32_t bit = std::uint32_t(1) << location;
+		bool known = (va.known & bit) != 0;
+		bool enabled = (va.enabled & bit) != 0;
+		bool wanted = (mask & bit) != 0;
+
+		// Untouched arrays that are known to be disabled are not counted.
+		if (known && !enabled && !wanted)
+			continue;
+
+		if (needed(!known || enabled != wanted))
+		{
+			if (wanted)
+				::glEnableVertexAttribArray(location);
+			else
+				::glDisableVertexAttribArray(location);
+		}
+	}
+
+	va.enabled = mask;
+	va.known = (std::uint32_t(1) << vertex_attribs) - 1;
+}
+
+void viewport(GLint x, GLint y, GLsizei width, GLsizei height)
+{
+	GLint const v[4] = { x, y, width, height };
+	bool same = current.viewport_known;
+	for (int i = 0; same && i < 4; ++i)
+		same = current.viewport[i] == v[i];
+
+	if (needed(!same))
+		::glViewport(x, y, width, height);
+	for (int i = 0; i < 4; ++i)
+		current.viewport[i] = v[i];
+	current.viewport_known = true;
+}
+
+void viewport_indexed(GLuint index, GLfloat x, GLfloat y, GLfloat width, GLfloat height)
+{
+	needed(true);
+	::glViewportIndexedf(index, x, y, width, height);
+	if (index == 0)
+		current.viewport_known = false;
+}
+
+void get_viewport(GLint out[4])
+{
+	if (!current.viewport_known)
+	{
+		::glGetIntegerv(GL_VIEWPORT, current.viewport);
+		current.viewport_known = true;
+	}
+	for (int i = 0; i < 4; ++i)
+		out[i] = current.viewport[i];
+}
+
+// Forgetting a deleted object's bindings, rather than zeroing them, also
+// covers the vertex arrays that are not bound, which GL leaves as they are.
+void deleted_program(GLuint program)
+{
+	if (current.program == program)
+		current.program = unknown;
+}
+
+void deleted_vertex_array(GLuint vertex_array)
+{
+	current.vertex_arrays.erase(vertex_array);
+	if (current.vertex_array == vertex_array)
+	{
+		current.vertex_array = unknown;
+		current.current_vertex_array = nullptr;
+	}
+}
+
+void deleted_buffer(GLuint buffer)
+{
+	for (GLuint& b : current.buffers)
+		if (b == buffer)
+			b = unknown;
+	for (auto& entry : current.indexed_buffers)
+		if (entry.second == buffer)
+			entry.second = unknown;
+	for (auto& entry : current.vertex_arrays)
+		if (entry.second.element_buffer == buffer)
+			entry.second.element_buffer = unknown;
+}
+
+void deleted_texture(GLuint texture)
+{
+	for (auto& unit : current.textures)
+		for (GLuint& t : unit)
+			if (t == texture)
+				t = unknown;
+}
+
+void deleted_framebuffer(GLuint framebuffer)
+{
+	if (current.draw_framebuffer == framebuffer)
+		current.draw_framebuffer = unknown;
+	if (current.read_framebuffer == framebuffer)
+		current.read_framebuffer = unknown;
+}
+
+void invalidate()
+{
+	current.reset();
+}
+
+} // namespace state
+} // namespace gl
+} // namespace graphics
+} // namespace mrr
@@ -0,0 +1,57 @@
+#include <mrr/graphics/stats.hxx>
+
+#include <ostream>
+
+namespace mrr {
+namespace graphics {
+namespace gl {
+
+namespace {
+
+render_stats current_stats;
+render_stats previous_stats;
+
+} // namespace
+
+render_stats::render_stats()
+	: draw_calls(0),
+	  triangles_submitted(0),
+	  triangles_full_detail(0),
+	  state_changes(0),
+	  state_changes_elided(0),
+	  heap_allocations(0),
+	  arena_bytes(0)
+{
+}
+
+render_stats& frame_stats()
+{
+	return current_stats;
+}
+
+render_stats const& previous_frame_stats()
+{
+	return previous_stats;
+}
+
+void next_frame_stats()
+{
+	previous_stats = current_stats;
+	current_stats = render_stats();
+}
+
+::std::ostream& operator <<(::std::ostream& out, render_stats const& s)
+{
+	return out
+		<< "draw calls: " << s.draw_calls
+		<< ", triangles: " << s.triangles_submitted
+		<< " (" << s.triangles_full_detail << " at full detail)"
+		<< ", state changes: " << s.state_changes
+		<< " (" << s.state_changes_elided << " elided)"
+		<< ", heap allocations: " << s.heap_allocations
+		<< ", arena bytes: " << s.arena_bytes;
+}
+
+} // namespace gl
+} // namespace graphics
+} // namespace mrr
@@ -0,0 +1,283 @@
+#include <mrr/graphics/tangent_space.hxx>
+#include <mrr/graphics/parallel.hxx>
+#include <mrr/graphics/simd.hxx>
+
+#include <algorithm>
+#include <cmath>
+#include <unordered_map>
+
+namespace mrr {
+namespace graphics {
+namespace gl {
+namespace impl {
+
+namespace {
+
+// Triangles or vertices per parallel_for range.
+std::size_t const grain = 1 << 14;
+
+//m=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+// Triangles four at a time, one a lane of float4 (simd.hxx).
+struct vec3x4
+{
+	float4 x, y, z;
+};
+
+inline vec3x4 operator +(vec3x4 const& a, vec3x4 const& b) { return vec3x4{ a.x + b.x, a.y + b.y, a.z + b.z }; }
+inline vec3x4 operator -(vec3x4 const& a, vec3x4 const& b) { return vec3x4{ a.x - b.x, a.y - b.y, a.z - b.z }; }
+inline vec3x4 operator *(vec3x4 const& a, float4 s) { return vec3x4{ a.x * s, a.y * s, a.z * s }; }
+inline float4 dot(vec3x4 const& a, vec3x4 const& b) { return a.x * b.x + a.y * b.y + a.z * b.z; }
+
+inline vec3x4 cross(vec3x4 const& a, vec3x4 const& b)
+{
+	return vec3x4{ a.y * b.z - a.z * b.y, a.z * b.x - a.x * b.z, a.x * b.y - a.y * b.x };
+}
+
+// 1 / a, or 0 where |a| is below epsilon.
+inline float4 safe_reciprocal(float4 a, float epsilon)
+{
+	float4 usable = less(splat(epsilon), abs(a));
+	return select(usable, splat(1.0f) / select(usable, a, splat(1.0f)), splat(0.0f));
+}
+
+// Abramowitz and Stegun 4.4.45, within 7e-5 radians; plenty for weights.
+inline float4 acos(float4 x)
+{
+	float4 a = min(abs(x), splat(1.0f));
+	float4 p = splat(-0.0187293f) * a + splat(0.0742610f);
+	p = p * a + splat(-0.2121144f);
+	p = p * a + splat(1.5707288f);
+	float4 r = sqrt(splat(1.0f) - a) * p;
+	return select(less(x, splat(0.0f)), splat(3.14159265f) - r, r);
+}
+
+// Gathers the N components of the corner'th vertex of triangles first to
+// first + 3, repeating the last of count triangles in lanes past it.
+template <int N, typename Vec>
+inline void gather(
+	std::vector<Vec> const& values, unsigned int const* indices, std::size_t first, std::size_t count,
+	int corner, float out[][4]
+)
+{
+	for (int lane = 0; lane < 4; ++lane)
+	{
+		std::size_t t = std::min(first + lane, count - 1);
+		Vec const& v = values[indices[3 * t + corner]];
+		for (int c = 0; c < N; ++c)
+			out[c][lane] = v[c];
+	}
+}
+
+inline vec3x4 gather_vec3(
+	std::vector<glm::vec3> const& values, unsigned int const* indices, std::size_t first, std::size_t count, int corner
+)
+{
+	float lanes[3][4];
+	gather<3>(values, indices, first, count, corner, lanes);
+	return vec3x4{ load(lanes[0]), load(lanes[1]), load(lanes[2]) };
+}
+
+inline void scatter(vec3x4 const& v, glm::vec3* out, std::size_t stride, std::size_t lanes)
+{
+	float x[4], y[4], z[4];
+	store(x, v.x);
+	store(y, v.y);
+	store(z, v.z);
+	for (std::size_t lane = 0; lane < lanes; ++lane)
+		out[lane * stride] = glm::vec3(x[lane], y[lane], z[lane]);
+}
+
+// Per triangle: its unit normal, and that normal weighted by the triangle's
+// angle at each corner.
+void weigh_normals(
+	std::vector<glm::vec3> const& positions, unsigned int const* indices,
+	std::size_t begin, std::size_t end, std::size_t count,
+	glm::vec3* face_normals, glm::vec3* weighted
+)
+{
+	for (std::size_t t = begin; t < end; t += 4)
+	{
+		vec3x4 a = gather_vec3(positions, indices, t, count, 0);
+		vec3x4 b = gather_vec3(positions, indices, t, count, 1);
+		vec3x4 c = gather_vec3(positions, indices, t, count, 2);
+
+		vec3x4 ab = b - a, ac = c - a, bc = c - b;
+		vec3x4 n = cross(ab, ac);
+		n = n * safe_reciprocal(sqrt(dot(n, n)), 1e-30f);
+
+		float4 ab_length = sqrt(dot(ab, ab)), ac_length = sqrt(dot(ac, ac)), bc_length = sqrt(dot(bc, bc));
+		float4 angle_a = acos(dot(ab, ac) * safe_reciprocal(ab_length * ac_length, 1e-30f));
+		float4 angle_b = acos((splat(0.0f) - dot(ab, bc)) * safe_reciprocal(ab_length * bc_length, 1e-30f));
+		float4 angle_c = max(splat(3.14159265f) - angle_a - angle_b, splat(0.0f));
+
+		std::size_t lanes = std::min<std::size_t>(4, end - t);
+		scatter(n, face_normals + t, 1, lanes);
+		scatter(n * angle_a, weighted + 3 * t, 3, lanes);
+		scatter(n * angle_b, weighted + 3 * t + 1, 3, lanes);
+		scatter(n * angle_c, weighted + 3 * t + 2, 3, lanes);
+	}
+}
+
+// Per triangle: the rates of change of position with u and with v across
+// it, which are zero where its uvs are degenerate.
+void weigh_tangents(
+	std::vector<glm::vec3> const& vertices, std::vector<glm::vec2> const& uvs, unsigned int const* indices,
+	std::size_t begin, std::size_t end, std::size_t count,
+	glm::vec3* u_directions, glm::vec3* v_directions
+)
+{
+	for (std::size_t t = begin; t < end; t += 4)
+	{
+		vec3x4 a = gather_vec3(vertices, indices, t, count, 0);
+		vec3x4 b = gather_vec3(vertices, indices, t, count, 1);
+		vec3x4 c = gather_vec3(vertices, indices, t, count, 2);
+
+		float uv_a[2][4], uv_b[2][4], uv_c[2][4];
+		gather<2>(uvs, indices, t, count, 0, uv_a);
+		gather<2>(uvs, indices, t, count, 1, uv_b);
+		gather<2>(uvs, indices, t, count, 2, uv_c);
+		float4 du1 = load(uv_b[0]) - load(uv_a[0]), dv1 = load(uv_b[1]) - load(uv_a[1]);
+		float4 du2 = load(uv_c[0]) - load(uv_a[0]), dv2 = load(uv_c[1]) - load(uv_a[1]);
+
+		vec3x4 e1 = b - a, e2 = c - a;
+		float4 r = safe_reciprocal(du1 * dv2 - du2 * dv1, 1e-20f);
+
+		std::size_t lanes = std::min<std::size_t>(4, end - t);
+		scatter((e1 * dv2 - e2 * dv1) * r, u_directions + t, 1, lanes);
+		scatter((e2 * du1 - e1 * du2) * r, v_directions + t, 1, lanes);
+	}
+}
+
+// Runs body on ranges of [0, count) whose starts are multiples of four, so
+// that only the last range has a partial group of triangles.
+template <typename Body>
+void parallel_for_groups(std::size_t count, Body const& body)
+{
+	std::size_t groups = (count + 3) / 4;
+	parallel_for(groups, grain / 4, [&](std::size_t begin, std::size_t end) {
+		body(4 * begin, std::min(count, 4 * end));
+	});
+}
+
+glm::vec3 any_perpendicular(glm::vec3 const& n)
+{
+	glm::vec3 axis = std::fabs(n.x) < 0.9f ? glm::vec3(1, 0, 0) : glm::vec3(0, 1, 0);
+	glm::vec3 t = glm::cross(n, axis);
+	float length = glm::length(t);
+	return length > 1e-20f ? t / length : glm::vec3(1, 0, 0);
+}
+
+} // namespace
+
+
+void generate_normals(
+	std::vector<glm::vec3> const& positions,
+	std::vector<unsigned int> const& indices,
+	std::vector<std::uint32_t> const& groups,
+	std::vector<glm::vec3>& out_normals
+)
+{
+	std::size_t const triangles = indices.size() / 3;
+	out_normals.resize(3 * triangles);
+	if (triangles == 0)
+		return;
+
+	std::vector<glm::vec3> face_normals(triangles);
+	std::vector<glm::vec3> weighted(3 * triangles);
+	parallel_for_groups(triangles, [&](std::size_t begin, std::size_t end) {
+		weigh_normals(positions, indices.data(), begin, end, triangles, face_normals.data(), weighted.data());
+	});
+
+	// Corners are summed by position, or by position and group where more
+	// than one smoothing group is used.
+	bool single_group = true;
+	for (std::size_t t = 1; t < groups.size() && single_group; ++t)
+		single_group = groups[t] == groups[0];
+
+	std::vector<unsigned int> keys;
+	std::size_t key_count = positions.size();
+	if (!single_group)
+	{
+		std::unordered_map<std::uint64_t, unsigned int> key_of;
+		keys.resize(3 * triangles);
+		for (std::size_t c = 0; c < 3 * triangles; ++c)
+		{
+			std::uint64_t id = std::uint64_t(groups[c / 3]) << 32 | indices[c];
+			keys[c] = key_of.insert(std::make_pair(id, unsigned(key_of.size()))).first->second;
+		}
+		key_count = key_of.size();
+	}
+	unsigned int const* key = single_group ? indices.data() : keys.data();
+
+	std::vector<glm::vec3> sums(key_count, glm::vec3(0.0f));
+	for (std::size_t c = 0; c < 3 * triangles; ++c)
+		if (groups.empty() || groups[c / 3] != 0)
+			sums[key[c]] += weighted[c];
+
+	parallel_for(key_count, grain, [&](std::size_t begin, std::size_t end) {
+		for (std::size_t k = begin; k < end; ++k)
+		{
+			float length = glm::length(sums[k]);
+			sums[k] = length > 1e-30f ? sums[k] / length : glm::vec3(0.0f);
+		}
+	});
+
+	parallel_for(triangles, grain, [&](std::size_t begin, std::size_t end) {
+		for (std::size_t t = begin; t < end; ++t)
+		{
+			glm::vec3 face = face_normals[t] != glm::vec3(0.0f) ? face_normals[t] : glm::vec3(0, 0, 1);
+			bool flat = !groups.empty() && groups[t] == 0;
+			for (std::size_t c = 3 * t; c < 3 * t + 3; ++c)
+			{
+				glm::vec3 const& smooth = sums[key[c]];
+				out_normals[c] = flat || smooth == glm::vec3(0.0f) ? face : smooth;
+			}
+		}
+	});
+}
+
+void generate_tangents(
+	std::vector<glm::vec3> const& vertices,
+	std::vector<glm::vec2> const& uvs,
+	std::vector<glm::vec3> const& normals,
+	std::vector<unsigned int> const& indices,
+	std::vector<glm::vec4>& out_tangents
+)
+{
+	std::size_t const triangles = indices.size() / 3;
+	out_tangents.resize(vertices.size());
+
+	std::vector<glm::vec3> u_sums(vertices.size(), glm::vec3(0.0f));
+	std::vector<glm::vec3> v_sums(vertices.size(), glm::vec3(0.0f));
+	if (triangles > 0 && uvs.size() == vertices.size())
+	{
+		std::vector<glm::vec3> u_directions(triangles), v_directions(triangles);
+		parallel_for_groups(triangles, [&](std::size_t begin, std::size_t end) {
+			weigh_tangents(vertices, uvs, indices.data(), begin, end, triangles, u_directions.data(), v_directions.data());
+		});
+
+		for (std::size_t c = 0; c < 3 * triangles; ++c)
+		{
+			u_sums[indices[c]] += u_directions[c / 3];
+			v_sums[indices[c]] += v_directions[c / 3];
+		}
+	}
+
+	// Gram-Schmidt against the normal.
+	parallel_for(vertices.size(), grain, [&](std::size_t begin, std::size_t end) {
+		for (std::size_t v = begin; v < end; ++v)
+		{
+			glm::vec3 n = v < normals.size() ? normals[v] : glm::vec3(0, 0, 1);
+			glm::vec3 t = u_sums[v] - n * glm::dot(n, u_sums[v]);
+			float length = glm::length(t);
+			t = length > 1e-20f ? t / length : any_perpendicular(n);
+			float w = glm::dot(glm::cross(n, t), v_sums[v]) < 0.0f ? -1.0f : 1.0f;
+			out_tangents[v] = glm::vec4(t, w);
+		}
+	});
+}
+
+} // namespace impl
+} // namespace gl
+} // namespace graphics
+} // namespace mrr
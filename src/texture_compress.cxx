@@ -0,0 +1,890 @@
+#include <mrr/graphics/texture_compress.hxx>
+#include <mrr/graphics/parallel.hxx>
+#include <mrr/graphics/timing.hxx>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <limits>
+#include <ostream>
+#include <utility>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define MRR_GRAPHICS_TEXTURE_COMPRESS_SSE2
+#endif
+
+namespace mrr {
+namespace graphics {
+namespace gl {
+
+namespace {
+
+// Blocks encoded per thread.
+std::size_t const encode_grain = 1024;
+// Rounds of endpoint refinement; each stops early once it no longer helps.
+int const refinements = 3;
+
+// A 4x4 block of texels, channel major, in [0, 255].
+struct block
+{
+	float texels[4][16];
+};
+
+// Up to 16 colours, channel major like block.
+struct palette
+{
+	float colours[4][16];
+	int count;
+};
+
+void load_block(rgba_image const& image, std::uint32_t bx, std::uint32_t by, block& b)
+{
+	for (int i = 0; i < 16; ++i)
+	{
+		std::size_t x = std::min(bx * 4 + i % 4, image.width - 1);
+		std::size_t y = std::min(by * 4 + i / 4, image.height - 1);
+		std::uint8_t const* texel = &image.pixels[4 * (y * image.width + x)];
+		for (int c = 0; c < 4; ++c)
+			b.texels[c][i] = texel[c];
+	}
+}
+
+// Picks the nearest palette colour for each texel, over channels [first,
+// first + channels), and returns the squared error summed over the texels
+// whose bits are set in mask. Four texels at a time where SSE2 is
+// available.
+float select_indices(
+	block const& b, palette const& p, int first, int channels, unsigned mask, std::uint8_t indices[16]
+)
+{
+	float error = 0.0f;
+
+#ifdef MRR_GRAPHICS_TEXTURE_COMPRESS_SSE2
+	__m128i const lane_bits = ::_mm_set_epi32(8, 4, 2, 1);
+	for (int group = 0; group < 4; ++group)
+	{
+		__m128 texels[4];
+		for (int c = 0; c < channels; ++c)
+			texels[c] = ::_mm_loadu_ps(&b.texels[first + c][4 * group]);
+
+		__m128 best = ::_mm_set1_ps(std::numeric_limits<float>::max());
+		__m128 best_index = ::_mm_setzero_ps();
+		for (int k = 0; k < p.count; ++k)
+		{
+			__m128 distance = ::_mm_setzero_ps();
+			for (int c = 0; c < channels; ++c)
+			{
+				__m128 d = ::_mm_sub_ps(texels[c], ::_mm_set1_ps(p.colours[first + c][k]));
+				distance = ::_mm_add_ps(distance, ::_mm_mul_ps(d, d));
+			}
+			__m128 closer = ::_mm_cmplt_ps(distance, best);
+			best = ::_mm_min_ps(distance, best);
+			best_index = ::_mm_or_ps(
+				::_mm_and_ps(closer, ::_mm_set1_ps(float(k))), ::_mm_andnot_ps(closer, best_index)
+			);
+		}
+
+		__m128 counted = ::_mm_castsi128_ps(::_mm_cmpeq_epi32(
+			::_mm_and_si128(::_mm_set1_epi32(int(mask >> (4 * group))), lane_bits), lane_bits
+		));
+		best = ::_mm_and_ps(best, counted);
+
+		float lanes[4], lane_indices[4];
+		::_mm_storeu_ps(lanes, best);
+		::_mm_storeu_ps(lane_indices, best_index);
+		for (int i = 0; i < 4; ++i)
+		{
+			error += lanes[i];
+			indices[4 * group + i] = std::uint8_t(lane_indices[i]);
+		}
+	}
+#else
+	for (int i = 0; i < 16; ++i)
+	{
+		float best = std::numeric_limits<float>::max();
+		int best_index = 0;
+		for (int k = 0; k < p.count; ++k)
+		{
+			float distance = 0.0f;
+			for (int c = first; c < first + channels; ++c)
+			{
+				float d = b.texels[c][i] - p.colours[c][k];
+				distance += d * d;
+			}
+			if (distance < best)
+			{
+				best = distance;
+				best_index = k;
+			}
+		}
+		indices[i] = std::uint8_t(best_index);
+		if (mask & (1u << i))
+			error += best;
+	}
+#endif
+
+	return error;
+}
+
+// The line through the texels in mask that fits them best, by power
+// iteration on their covariance, as the endpoints of their projections
+// onto it. The first endpoint is at the positive end.
+void fit_endpoints(block const& b, int channels, unsigned mask, float e0[4], float e1[4])
+{
+	float mean[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+	int count = 0;
+	for (int i = 0; i < 16; ++i)
+		if (mask & (1u << i))
+		{
+			++count;
+			for (int c = 0; c < channels; ++c)
+				mean[c] += b.texels[c][i];
+		}
+	for (int c = 0; c < channels; ++c)
+		mean[c] /= count;
+
+	float covariance[4][4] = {};
+	for (int i = 0; i < 16; ++i)
+		if (mask & (1u << i))
+			for (int r = 0; r < channels; ++r)
+				for (int c = 0; c < channels; ++c)
+					covariance[r][c] += (b.texels[r][i] - mean[r]) * (b.texels[c][i] - mean[c]);
+
+	// Starting from the row of the channel that varies most, which is never
+	// orthogonal to the principal axis unless the texels are all the same.
+	int widest = 0;
+	for (int c = 1; c < channels; ++c)
+		if (covariance[c][c] > covariance[widest][widest])
+			widest = c;
+	float axis[4] = { 1.0f, 1.0f, 1.0f, 1.0f };
+	if (covariance[widest][widest] > 0.0f)
+		std::copy(covariance[widest], covariance[widest] + 4, axis);
+
+	for (int iteration = 0; iteration < 8; ++iteration)
+	{
+		float next[4] = { 0.0f, 0.0f, 0.0f, 0.0f }, length = 0.0f;
+		for (int r = 0; r < channels; ++r)
+		{
+			for (int c = 0; c < channels; ++c)
+				next[r] += covariance[r][c] * axis[c];
+			length = std::max(length, std::fabs(next[r]));
+		}
+		if (length < 1e-6f)
+			break;
+		for (int c = 0; c < channels; ++c)
+			axis[c] = next[c] / length;
+	}
+
+	float length_squared = 0.0f;
+	for (int c = 0; c < channels; ++c)
+		length_squared += axis[c] * axis[c];
+
+	float low = 0.0f, high = 0.0f;
+	for (int i = 0; i < 16; ++i)
+		if (mask & (1u << i))
+		{
+			float t = 0.0f;
+			for (int c = 0; c < channels; ++c)
+				t += (b.texels[c][i] - mean[c]) * axis[c];
+			low = std::min(low, t);
+			high = std::max(high, t);
+		}
+
+	for (int c = 0; c < channels; ++c)
+	{
+		e0[c] = std::min(255.0f, std::max(0.0f, mean[c] + axis[c] * high / length_squared));
+		e1[c] = std::min(255.0f, std::max(0.0f, mean[c] + axis[c] * low / length_squared));
+	}
+}
+
+// Least squares endpoints for the chosen indices, where weights[index] is
+// how far along from the first endpoint to the second each index lies.
+// Leaves the endpoints unchanged when every texel has the same weight.
+void refine_endpoints(
+	block const& b, int channels, unsigned mask,
+	std::uint8_t const indices[16], float const* weights,
+	float e0[4], float e1[4]
+)
+{
+	float aa = 0.0f, ab = 0.0f, bb = 0.0f, ax[4] = {}, bx[4] = {};
+	for (int i = 0; i < 16; ++i)
+		if (mask & (1u << i))
+		{
+			float w = weights[indices[i]];
+			aa += (1.0f - w) * (1.0f - w);
+			ab += (1.0f - w) * w;
+			bb += w * w;
+			for (int c = 0; c < channels; ++c)
+			{
+				ax[c] += (1.0f - w) * b.texels[c][i];
+				bx[c] += w * b.texels[c][i];
+			}
+		}
+
+	float determinant = aa * bb - ab * ab;
+	if (std::fabs(determinant) < 1e-6f)
+		return;
+
+	for (int c = 0; c < channels; ++c)
+	{
+		e0[c] = std::min(255.0f, std::max(0.0f, (bb * ax[c] - ab * bx[c]) / determinant));
+		e1[c] = std::min(255.0f, std::max(0.0f, (aa * bx[c] - ab * ax[c]) / determinant));
+	}
+}
+
+inline std::uint16_t read_u16(std::uint8_t const* p)
+{
+	return std::uint16_t(p[0] | (p[1] << 8));
+}
+
+inline void write_u16(std::uint8_t* p, std::uint16_t v)
+{
+	p[0] = std::uint8_t(v);
+	p[1] = std::uint8_t(v >> 8);
+}
+
+inline void write_u32(std::uint8_t* p, std::uint32_t v)
+{
+	for (int i = 0; i < 4; ++i)
+		p[i] = std::uint8_t(v >> (8 * i));
+}
+
+
+//m=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-
+// BC1 colour blocks: two RGB565 endpoints and 2 bit indices. With the
+// first endpoint greater there are two interpolated colours, otherwise one
+// and transparent black. BC3 always decodes the colour as the former.
+
+std::uint16_t pack_565(float const c[3])
+{
+	auto quantize = [](float v, int max) {
+		return std::uint16_t(std::min<float>(max, std::max(0.0f, v * max / 255.0f + 0.5f)));
+	};
+	return std::uint16_t((quantize(c[0], 31) << 11) | (quantize(c[1], 63) << 5) | quantize(c[2], 31));
+}
+
+void unpack_565(std::uint16_t v, int out[3])
+{
+	int r = (v >> 11) & 31, g = (v >> 5) & 63, b = v & 31;
+	out[0] = (r << 3) | (r >> 2);
+	out[1] = (g << 2) | (g >> 4);
+	out[2] = (b << 3) | (b >> 2);
+}
+
+// The palette as decoders compute it, in integers.
+void bc1_palette(std::uint16_t q0, std::uint16_t q1, bool four_colours, int out[4][4])
+{
+	int c0[3], c1[3];
+	unpack_565(q0, c0);
+	unpack_565(q1, c1);
+	for (int c = 0; c < 3; ++c)
+	{
+		out[0][c] = c0[c];
+		out[1][c] = c1[c];
+		if (four_colours)
+		{
+			out[2][c] = (2 * c0[c] + c1[c]) / 3;
+			out[3][c] = (c0[c] + 2 * c1[c]) / 3;
+		}
+		else
+		{
+			out[2][c] = (c0[c] + c1[c]) / 2;
+			out[3][c] = 0;
+		}
+	}
+	for (int i = 0; i < 4; ++i)
+		out[i][3] = four_colours || i < 3 ? 255 : 0;
+}
+
+void encode_bc1_colour(block const& b, bool allow_transparent, std::uint8_t out[8])
+{
+	unsigned opaque = 0xFFFF;
+	if (allow_transparent)
+		for (int i = 0; i < 16; ++i)
+			if (b.texels[3][i] < 128.0f)
+				opaque &= ~(1u << i);
+
+	std::memset(out, 0, 8);
+	if (opaque == 0)
+	{
+		// Three colour mode with every index transparent.
+		std::memset(out + 4, 0xFF, 4);
+		return;
+	}
+
+	bool const four_colours = opaque == 0xFFFF;
+	static float const weights_4[4] = { 0.0f, 1.0f, 1.0f / 3.0f, 2.0f / 3.0f };
+	static float const weights_3[3] = { 0.0f, 1.0f, 0.5f };
+
+	float e0[4], e1[4];
+	fit_endpoints(b, 3, opaque, e0, e1);
+
+	float best_error = std::numeric_limits<float>::max();
+	std::uint16_t best_q0 = 0, best_q1 = 0;
+	std::uint8_t best_indices[16] = {};
+	for (int round = 0; round < refinements; ++round)
+	{
+		std::uint16_t q0 = pack_565(e0), q1 = pack_565(e1);
+		if (four_colours ? q0 < q1 : q0 > q1)
+		{
+			std::swap(q0, q1);
+			for (int c = 0; c < 3; ++c)
+				std::swap(e0[c], e1[c]);
+		}
+
+		// Equal endpoints decode in three colour mode; only the first
+		// colour is of any use then.
+		int colours[4][4];
+		bc1_palette(q0, q1, four_colours && q0 != q1, colours);
+		palette p;
+		p.count = q0 == q1 ? 1 : four_colours ? 4 : 3;
+		for (int k = 0; k < p.count; ++k)
+			for (int c = 0; c < 3; ++c)
+				p.colours[c][k] = float(colours[k][c]);
+
+		std::uint8_t indices[16];
+		float error = select_indices(b, p, 0, 3, opaque, indices);
+		if (error >= best_error)
+			break;
+
+		best_error = error;
+		best_q0 = q0;
+		best_q1 = q1;
+		std::memcpy(best_indices, indices, 16);
+		if (error == 0.0f || q0 == q1)
+			break;
+
+		refine_endpoints(b, 3, opaque, indices, four_colours ? weights_4 : weights_3, e0, e1);
+	}
+
+	write_u16(out, best_q0);
+	write_u16(out + 2, best_q1);
+	std::uint32_t bits = 0;
+	for (int i = 0; i < 16; ++i)
+		bits |= std::uint32_t(opaque & (1u << i) ? best_indices[i] : 3) << (2 * i);
+	write_u32(out + 4, bits);
+}
+
+void decode_bc1_colour(std::uint8_t const* in, bool allow_transparent, std::uint8_t out[16][4])
+{
+	std::uint16_t q0 = read_u16(in), q1 = read_u16(in + 2);
+	int colours[4][4];
+	bc1_palette(q0, q1, !allow_transparent || q0 > q1, colours);
+
+	std::uint32_t bits = std::uint32_t(in[4]) | (std::uint32_t(in[5]) << 8)
+		| (std::uint32_t(in[6]) << 16) | (std::uint32_t(in[7]) << 24);
+	for (int i = 0; i < 16; ++i)
+		for (int c = 0; c < 4; ++c)
+			out[i][c] = std::uint8_t(colours[(bits >> (2 * i)) & 3][c]);
+}
+
+
+//m=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-
+// BC3 alpha blocks: two 8 bit endpoints and 3 bit indices. The encoder
+// always uses the mode with six interpolated values.
+
+void alpha_palette(int a0, int a1, int out[8])
+{
+	out[0] = a0;
+	out[1] = a1;
+	for (int code = 2; code < 8; ++code)
+		out[code] = a0 > a1
+			? ((8 - code) * a0 + (code - 1) * a1) / 7
+			: code < 6 ? ((6 - code) * a0 + (code - 1) * a1) / 5 : code == 6 ? 0 : 255;
+}
+
+void encode_bc3_alpha(block const& b, std::uint8_t out[8])
+{
+	float low = 255.0f, high = 0.0f;
+	for (int i = 0; i < 16; ++i)
+	{
+		low = std::min(low, b.texels[3][i]);
+		high = std::max(high, b.texels[3][i]);
+	}
+
+	std::memset(out, 0, 8);
+	out[0] = std::uint8_t(high);
+	out[1] = std::uint8_t(low);
+	if (out[0] == out[1])
+		return;
+
+	int values[8];
+	alpha_palette(out[0], out[1], values);
+	palette p;
+	p.count = 8;
+	for (int k = 0; k < 8; ++k)
+		p.colours[3][k] = float(values[k]);
+
+	std::uint8_t indices[16];
+	select_indices(b, p, 3, 1, 0xFFFF, indices);
+
+	std::uint64_t bits = 0;
+	for (int i = 0; i < 16; ++i)
+		bits |= std::uint64_t(indices[i]) << (3 * i);
+	for (int i = 0; i < 6; ++i)
+		out[2 + i] = std::uint8_t(bits >> (8 * i));
+}
+
+void decode_bc3_alpha(std::uint8_t const* in, std::uint8_t out[16][4])
+{
+	int values[8];
+	alpha_palette(in[0], in[1], values);
+
+	std::uint64_t bits = 0;
+	for (int i = 0; i < 6; ++i)
+		bits |= std::uint64_t(in[2 + i]) << (8 * i);
+	for (int i = 0; i < 16; ++i)
+		out[i][3] = std::uint8_t(values[(bits >> (3 * i)) & 7]);
+}
+
+
+//m=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-
+// BC7 mode 6 blocks: RGBA endpoints of 7 bits plus a shared low bit each,
+// and 4 bit indices. The first texel's index has an implicit high bit of
+// zero, which the encoder ensures by swapping the endpoints.
+
+int const bc7_mode = 6;
+int const bc7_weights[16] = { 0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64 };
+
+struct bit_writer
+{
+	std::uint8_t* out;
+	unsigned position;
+
+	void put(std::uint32_t value, unsigned bits)
+	{
+		for (unsigned i = 0; i < bits; ++i, ++position)
+			out[position / 8] |= std::uint8_t(((value >> i) & 1) << (position % 8));
+	}
+};
+
+struct bit_reader
+{
+	std::uint8_t const* in;
+	unsigned position;
+
+	std::uint32_t get(unsigned bits)
+	{
+		std::uint32_t value = 0;
+		for (unsigned i = 0; i < bits; ++i, ++position)
+			value |= std::uint32_t((in[position / 8] >> (position % 8)) & 1) << i;
+		return value;
+	}
+};
+
+// Endpoint channels of 7 bits and the low bit that brings them closest.
+void quantize_bc7(float const e[4], int q[4], int& p_bit)
+{
+	float best = std::numeric_limits<float>::max();
+	for (int p = 0; p < 2; ++p)
+	{
+		int candidate[4];
+		float error = 0.0f;
+		for (int c = 0; c < 4; ++c)
+		{
+			candidate[c] = std::min(127, std::max(0, int(std::floor((e[c] - p) / 2.0f + 0.5f))));
+			float d = float(2 * candidate[c] + p) - e[c];
+			error += d * d;
+		}
+		if (error < best)
+		{
+			best = error;
+			p_bit = p;
+			std::copy(candidate, candidate + 4, q);
+		}
+	}
+}
+
+void bc7_palette(int const q0[4], int p0, int const q1[4], int p1, palette& out)
+{
+	out.count = 16;
+	for (int c = 0; c < 4; ++c)
+	{
+		int v0 = 2 * q0[c] + p0, v1 = 2 * q1[c] + p1;
+		for (int k = 0; k < 16; ++k)
+			out.colours[c][k] = float(((64 - bc7_weights[k]) * v0 + bc7_weights[k] * v1 + 32) >> 6);
+	}
+}
+
+void encode_bc7(block const& b, std::uint8_t out[16])
+{
+	static float const weights[16] = {
+		0 / 64.0f, 4 / 64.0f, 9 / 64.0f, 13 / 64.0f, 17 / 64.0f, 21 / 64.0f, 26 / 64.0f, 30 / 64.0f,
+		34 / 64.0f, 38 / 64.0f, 43 / 64.0f, 47 / 64.0f, 51 / 64.0f, 55 / 64.0f, 60 / 64.0f, 64 / 64.0f
+	};
+
+	float e0[4], e1[4];
+	fit_endpoints(b, 4, 0xFFFF, e0, e1);
+
+	float best_error = std::numeric_limits<float>::max();
+	int best_q0[4] = {}, best_q1[4] = {}, best_p0 = 0, best_p1 = 0;
+	std::uint8_t best_indices[16] = {};
+	for (int round = 0; round < refinements; ++round)
+	{
+		int q0[4], q1[4], p0, p1;
+		quantize_bc7(e0, q0, p0);
+		quantize_bc7(e1, q1, p1);
+
+		palette p;
+		bc7_palette(q0, p0, q1, p1, p);
+		std::uint8_t indices[16];
+		float error = select_indices(b, p, 0, 4, 0xFFFF, indices);
+		if (error >= best_error)
+			break;
+
+		best_error = error;
+		std::copy(q0, q0 + 4, best_q0);
+		std::copy(q1, q1 + 4, best_q1);
+		best_p0 = p0;
+		best_p1 = p1;
+		std::memcpy(best_indices, indices, 16);
+		if (error == 0.0f)
+			break;
+
+		refine_endpoints(b, 4, 0xFFFF, indices, weights, e0, e1);
+	}
+
+	if (best_indices[0] & 8)
+	{
+		std::swap(best_q0, best_q1);
+		std::swap(best_p0, best_p1);
+		for (int i = 0; i < 16; ++i)
+			best_indices[i] = std::uint8_t(15 - best_indices[i]);
+	}
+
+	std::memset(out, 0, 16);
+	bit_writer writer{ out, 0 };
+	writer.put(1u << bc7_mode, bc7_mode + 1);
+	for (int c = 0; c < 4; ++c)
+	{
+		writer.put(best_q0[c], 7);
+		writer.put(best_q1[c], 7);
+	}
+	writer.put(best_p0, 1);
+	writer.put(best_p1, 1);
+	writer.put(best_indices[0], 3);
+	for (int i = 1; i < 16; ++i)
+		writer.put(best_indices[i], 4);
+}
+
+void decode_bc7(std::uint8_t const* in, std::uint8_t out[16][4])
+{
+	bit_reader reader{ in, 0 };
+	if (reader.get(bc7_mode + 1) != 1u << bc7_mode)
+	{
+		// Other modes are never written.
+		std::memset(out, 0, 64);
+		return;
+	}
+
+	int q0[4], q1[4];
+	for (int c = 0; c < 4; ++c)
+	{
+		q0[c] = int(reader.get(7));
+		q1[c] = int(reader.get(7));
+	}
+	int p0 = int(reader.get(1)), p1 = int(reader.get(1));
+
+	palette p;
+	bc7_palette(q0, p0, q1, p1, p);
+	for (int i = 0; i < 16; ++i)
+	{
+		int index = int(reader.get(i == 0 ? 3 : 4));
+		for (int c = 0; c < 4; ++c)
+			out[i][c] = std::uint8_t(p.colours[c][index]);
+	}
+}
+
+
+//m=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-
+// DDS files, as dds::parse reads them.
+
+std::size_t const dds_header_size = 124;
+std::size_t const dds_dx10_header_size = 20;
+
+std::uint32_t const dds_flags = 0x1 | 0x2 | 0x4 | 0x1000 | 0x80000; // caps, size, pixel format, linear size
+std::uint32_t const dds_flag_mip_count = 0x20000;
+std::uint32_t const dds_pixel_format_has_fourcc = 0x4;
+std::uint32_t const dds_caps_texture = 0x1000;
+std::uint32_t const dds_caps_mipmap = 0x8 | 0x400000;
+std::uint32_t const dx10_dimension_texture2d = 3;
+
+constexpr std::uint32_t fourcc(char a, char b, char c, char d)
+{
+	return std::uint32_t(std::uint8_t(a))
+		| (std::uint32_t(std::uint8_t(b)) << 8)
+		| (std::uint32_t(std::uint8_t(c)) << 16)
+		| (std::uint32_t(std::uint8_t(d)) << 24);
+}
+
+std::uint32_t dxgi_format(block_format format, bool srgb)
+{
+	switch (format)
+	{
+	case block_format::bc1: return srgb ? 72 : 71;
+	case block_format::bc3: return srgb ? 78 : 77;
+	case block_format::bc7: return srgb ? 99 : 98;
+	}
+	return 0;
+}
+
+} // namespace
+
+
+//m=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-
+char const* describe(block_format format)
+{
+	switch (format)
+	{
+	case block_format::bc1: return "BC1";
+	case block_format::bc3: return "BC3";
+	case block_format::bc7: return "BC7";
+	}
+	return "unknown";
+}
+
+std::size_t block_bytes(block_format format)
+{
+	return format == block_format::bc1 ? 8 : 16;
+}
+
+std::vector<std::uint8_t> encode_image(rgba_image const& image, block_format format)
+{
+	std::uint32_t const blocks_x = (image.width + 3) / 4, blocks_y = (image.height + 3) / 4;
+	std::size_t const bytes = block_bytes(format);
+	std::vector<std::uint8_t> out(std::size_t(blocks_x) * blocks_y * bytes);
+
+	std::size_t rows_per_chunk = std::max<std::size_t>(encode_grain / blocks_x, 1);
+	impl::parallel_for(blocks_y, rows_per_chunk, [&](std::size_t begin, std::size_t end) {
+		block b;
+		for (std::size_t by = begin; by < end; ++by)
+			for (std::uint32_t bx = 0; bx < blocks_x; ++bx)
+			{
+				load_block(image, bx, std::uint32_t(by), b);
+				std::uint8_t* dst = &out[(by * blocks_x + bx) * bytes];
+				switch (format)
+				{
+				case block_format::bc1:
+					encode_bc1_colour(b, true, dst);
+					break;
+				case block_format::bc3:
+					encode_bc3_alpha(b, dst);
+					encode_bc1_colour(b, false, dst + 8);
+					break;
+				case block_format::bc7:
+					encode_bc7(b, dst);
+					break;
+				}
+			}
+	});
+
+	return out;
+}
+
+rgba_image decode_image(
+	std::vector<std::uint8_t> const& blocks,
+	std::uint32_t width, std::uint32_t height,
+	block_format format
+)
+{
+	rgba_image image(width, height);
+	std::uint32_t const blocks_x = (width + 3) / 4, blocks_y = (height + 3) / 4;
+	std::size_t const bytes = block_bytes(format);
+	if (blocks.size() < std::size_t(blocks_x) * blocks_y * bytes)
+		return image;
+
+	std::size_t rows_per_chunk = std::max<std::size_t>(encode_grain / blocks_x, 1);
+	impl::parallel_for(blocks_y, rows_per_chunk, [&](std::size_t begin, std::size_t end) {
+		std::uint8_t texels[16][4];
+		for (std::size_t by = begin; by < end; ++by)
+			for (std::uint32_t bx = 0; bx < blocks_x; ++bx)
+			{
+				std::uint8_t const* src = &blocks[(by * blocks_x + bx) * bytes];
+				switch (format)
+				{
+				case block_format::bc1:
+					decode_bc1_colour(src, true, texels);
+					break;
+				case block_format::bc3:
+					decode_bc1_colour(src + 8, false, texels);
+					decode_bc3_alpha(src, texels);
+					break;
+				case block_format::bc7:
+					decode_bc7(src, texels);
+					break;
+				}
+
+				for (int i = 0; i < 16; ++i)
+				{
+					std::size_t x = bx * 4 + i % 4, y = by * 4 + i / 4;
+					if (x < width && y < height)
+						std::memcpy(&image.pixels[4 * (y * width + x)], texels[i], 4);
+				}
+			}
+	});
+
+	return image;
+}
+
+double psnr(rgba_image const& a, rgba_image const& b)
+{
+	if (a.width != b.width || a.height != b.height || a.pixels.empty())
+		return 0.0;
+
+	double sum = 0.0;
+	for (std::size_t i = 0; i < a.pixels.size(); ++i)
+	{
+		double d = double(a.pixels[i]) - b.pixels[i];
+		sum += d * d;
+	}
+	if (sum == 0.0)
+		return std::numeric_limits<double>::infinity();
+
+	double mse = sum / a.pixels.size();
+	return 10.0 * std::log10(255.0 * 255.0 / mse);
+}
+
+bool write_dds(
+	std::string const& path,
+	std::uint32_t width, std::uint32_t height,
+	block_format format, bool srgb,
+	std::vector<std::vector<std::uint8_t>> const& levels
+)
+{
+	bool const dx10 = srgb || format == block_format::bc7;
+	std::vector<std::uint8_t> header(4 + dds_header_size + (dx10 ? dds_dx10_header_size : 0), 0);
+
+	std::memcpy(header.data(), "DDS ", 4);
+	std::uint8_t* h = header.data() + 4;
+	write_u32(h, dds_header_size);
+	write_u32(h + 4, dds_flags | (levels.size() > 1 ? dds_flag_mip_count : 0));
+	write_u32(h + 8, height);
+	write_u32(h + 12, width);
+	write_u32(h + 16, levels.empty() ? 0 : std::uint32_t(levels.front().size()));
+	write_u32(h + 24, std::uint32_t(levels.size()));
+
+	std::uint8_t* pixel_format = h + 72;
+	write_u32(pixel_format, 32);
+	write_u32(pixel_format + 4, dds_pixel_format_has_fourcc);
+	write_u32(pixel_format + 8,
+		dx10 ? fourcc('D', 'X', '1', '0')
+		: format == block_format::bc1 ? fourcc('D', 'X', 'T', '1') : fourcc('D', 'X', 'T', '5')
+	);
+	write_u32(h + 104, dds_caps_texture | (levels.size() > 1 ? dds_caps_mipmap : 0));
+
+	if (dx10)
+	{
+		std::uint8_t* extended = h + dds_header_size;
+		write_u32(extended, dxgi_format(format, srgb));
+		write_u32(extended + 4, dx10_dimension_texture2d);
+		write_u32(extended + 12, 1);
+	}
+
+	std::ofstream out(path, std::ios::binary);
+	out.write(reinterpret_cast<char const*>(header.data()), header.size());
+	for (auto const& level : levels)
+		out.write(reinterpret_cast<char const*>(level.data()), level.size());
+
+	if (!out)
+	{
+		std::cerr << "ERROR: Cannot write DDS texture...\tpath: " << path << std::endl;
+		return false;
+	}
+	return true;
+}
+
+
+//m=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-
+texture_compress_options::texture_compress_options()
+	: format(block_format::bc7),
+	  srgb(true),
+	  mips(true),
+	  measure(false)
+{
+}
+
+texture_compress_report::texture_compress_report()
+	: width(0),
+	  height(0),
+	  levels(0),
+	  texels(0),
+	  bytes(0),
+	  decode_ms(0.0),
+	  mip_ms(0.0),
+	  encode_ms(0.0),
+	  psnr(0.0)
+{
+}
+
+::std::ostream& operator <<(::std::ostream& out, texture_compress_report const& r)
+{
+	out
+		<< "size: " << r.width << "x" << r.height
+		<< ", levels: " << r.levels
+		<< ", texels: " << r.texels
+		<< ", bytes: " << r.bytes
+		<< ", decode time: " << r.decode_ms << " ms"
+		<< ", mip time: " << r.mip_ms << " ms"
+		<< ", encode time: " << r.encode_ms << " ms";
+	if (r.encode_ms > 0.0)
+		out << " (" << r.texels / (r.encode_ms * 1000.0) << " Mtexels/s)";
+	if (r.psnr != 0.0)
+		out << ", PSNR: " << r.psnr << " dB";
+	return out;
+}
+
+bool compress_texture(
+	std::string const& source,
+	std::string const& destination,
+	texture_compress_options const& options,
+	texture_compress_report* out_report
+)
+{
+	texture_compress_report report;
+
+	auto start = std::chrono::steady_clock::now();
+	rgba_image image;
+	if (!load_image(source, image))
+		return false;
+	report.decode_ms = impl::elapsed_ms(start);
+
+	start = std::chrono::steady_clock::now();
+	std::vector<rgba_image> mips;
+	if (options.mips)
+		mips = generate_mips(image, options.srgb);
+	else
+		mips.push_back(std::move(image));
+	report.mip_ms = impl::elapsed_ms(start);
+
+	start = std::chrono::steady_clock::now();
+	std::vector<std::vector<std::uint8_t>> levels;
+	for (rgba_image const& mip : mips)
+	{
+		levels.push_back(encode_image(mip, options.format));
+		report.texels += mip.pixels.size() / 4;
+		report.bytes += levels.back().size();
+	}
+	report.encode_ms = impl::elapsed_ms(start);
+
+	rgba_image const& top = mips.front();
+	if (options.measure)
+		report.psnr = psnr(top, decode_image(levels.front(), top.width, top.height, options.format));
+
+	if (!write_dds(destination, top.width, top.height, options.format, options.srgb, levels))
+		return false;
+
+	report.width = top.width;
+	report.height = top.height;
+	report.levels = levels.size();
+	if (out_report != nullptr)
+		*out_report = report;
+	return true;
+}
+
+} // namespace gl
+} // namespace graphics
+} // namespace mrr
@@ -1,5 +1,7 @@
 #include <mrr/graphics/waypoint.hxx>
 
+#include <algorithm>
+
 namespace mrr {
 namespace graphics {
 namespace gl {
@@ -31,15 +33,44 @@ double waypoint::get_radius() const
 
 void waypoint::add_action(model& m, action_type const& action)
 {
-	actions_[&m].push_back(action);
+	auto it = ::std::lower_bound(
+		actions_.begin(), actions_.end(), &m,
+		[](action_list_type::value_type const& entry, model* target) { return entry.first < target; }
+	);
+	if (it == actions_.end() || it->first != &m)
+		it = actions_.insert(it, action_list_type::value_type(&m, ::std::vector<action_type>()));
+	it->second.push_back(action);
 }
 
 auto waypoint::get_actions() const
-	-> ::std::map<model*, std::vector<action_type> > const&
+	-> action_list_type const&
 {
 	return actions_;
 }
 
+
+//m=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-
+void process_waypoints(::std::vector<waypoint> const& waypoints)
+{
+	for (auto const& wp : waypoints)
+	{
+		for (auto& target_action_list_pair : wp.get_actions())
+		{
+			auto& target = dynamic_cast<component&>(*target_action_list_pair.first);
+
+			double distance = glm::length(target.get_location() - wp.get_location());
+
+			if (distance < wp.get_radius())
+			{
+				for (auto const& action : target_action_list_pair.second)
+				{
+					action(target);
+				}
+			}
+		}
+	}
+}
+
 } // namespace gl
 } // namespace graphics
 } // namespace mrr
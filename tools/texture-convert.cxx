@@ -0,0 +1,99 @@
+// Converts PNG and TGA images to block compressed DDS textures with full mip
+// chains, next to each source unless one destination is given, and reports
+// the encode throughput and, with --psnr, the error of each.
+//
+// usage: texture-convert [--bc1 | --bc3 | --bc7] [--linear] [--no-mips]
+//                        [--psnr] [-o out.dds] image...
+
+#include <mrr/graphics/texture_compress.hxx>
+
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+namespace gl = ::mrr::graphics::gl;
+
+static int usage(char const* program)
+{
+	std::fprintf(
+		stderr,
+		"usage: %s [--bc1 | --bc3 | --bc7] [--linear] [--no-mips] [--psnr] [-o out.dds] image...\n",
+		program
+	);
+	return 1;
+}
+
+static std::string dds_path(std::string const& source)
+{
+	std::size_t dot = source.find_last_of('.');
+	std::size_t slash = source.find_last_of('/');
+	if (dot == std::string::npos || (slash != std::string::npos && dot < slash))
+		return source + ".dds";
+	return source.substr(0, dot) + ".dds";
+}
+
+int main(int argc, char* argv[])
+{
+	gl::texture_compress_options options;
+	std::string destination;
+	std::vector<std::string> sources;
+
+	for (int i = 1; i < argc; ++i)
+	{
+		if (std::strcmp(argv[i], "--bc1") == 0)
+			options.format = gl::block_format::bc1;
+		else if (std::strcmp(argv[i], "--bc3") == 0)
+			options.format = gl::block_format::bc3;
+		else if (std::strcmp(argv[i], "--bc7") == 0)
+			options.format = gl::block_format::bc7;
+		else if (std::strcmp(argv[i], "--linear") == 0)
+			options.srgb = false;
+		else if (std::strcmp(argv[i], "--no-mips") == 0)
+			options.mips = false;
+		else if (std::strcmp(argv[i], "--psnr") == 0)
+			options.measure = true;
+		else if (std::strcmp(argv[i], "-o") == 0 && i + 1 < argc)
+			destination = argv[++i];
+		else if (argv[i][0] == '-')
+			return usage(argv[0]);
+		else
+			sources.push_back(argv[i]);
+	}
+
+	if (sources.empty() || (!destination.empty() && sources.size() > 1))
+		return usage(argv[0]);
+
+	std::printf("%-32s %6s %11s %7s %10s %10s %10s %12s %9s\n",
+	            "image", "format", "size", "levels", "load (ms)", "mips (ms)",
+	            "encode (ms)", "Mtexels/s", "PSNR (dB)");
+
+	std::size_t texels = 0;
+	double encode_ms = 0.0;
+	int failures = 0;
+	for (std::string const& source : sources)
+	{
+		gl::texture_compress_report r;
+		if (!gl::compress_texture(source, destination.empty() ? dds_path(source) : destination, options, &r))
+		{
+			++failures;
+			continue;
+		}
+
+		std::printf("%-32s %6s %5ux%-5u %7zu %10.1f %10.1f %10.1f %12.2f",
+		            source.c_str(), gl::describe(options.format), r.width, r.height, r.levels,
+		            r.decode_ms, r.mip_ms, r.encode_ms, r.texels / (r.encode_ms * 1000.0));
+		if (options.measure)
+			std::printf(" %9.2f\n", r.psnr);
+		else
+			std::printf(" %9s\n", "-");
+
+		texels += r.texels;
+		encode_ms += r.encode_ms;
+	}
+
+	if (sources.size() > 1 && encode_ms > 0.0)
+		std::printf("total: %zu texels encoded at %.2f Mtexels/s\n", texels, texels / (encode_ms * 1000.0));
+
+	return failures == 0 ? 0 : 1;
+}